@@ -1,21 +1,28 @@
 from ctypes import *
 from functools import partial
+import array
 
 _libchewing = CDLL('libchewing.so.3')
-_libchewing.chewing_commit_String.restype = c_char_p
-_libchewing.chewing_buffer_String.restype = c_char_p
-_libchewing.chewing_cand_String.restype = c_char_p
-_libchewing.chewing_zuin_String.restype = c_char_p
-_libchewing.chewing_aux_String.restype = c_char_p
+_libchewing.chewing_new.restype = c_void_p
+
+# the bytes of a character at most, see chewing_convert_batch_buffer
+_MAX_UTF8_SIZE = 6
+
+class _Interval(Structure):
+    _fields_ = [('from_', c_int), ('to', c_int)]
 
 def Init(datadir, userdir):
     return _libchewing.chewing_Init(datadir, userdir)
 
+def _phone_array(phones):
+    return (c_ushort * len(phones))(*phones)
+
 class ChewingContext:
     def __init__(self):
-        self.ctx = _libchewing.chewing_new()
+        self.ctx = c_void_p(_libchewing.chewing_new())
+        self._buf = create_string_buffer(256)
     def __del__(self):
-        _libchewing.chewing_free(self.ctx)
+        _libchewing.chewing_delete(self.ctx)
     def __getattr__(self, name):
         func = 'chewing_' + name
         if func in _libchewing.__dict__:
@@ -27,10 +34,107 @@ class ChewingContext:
             setattr(self, name, wrap)
             return wrap
         else:
-            raise AttributeError, name
+            raise AttributeError(name)
     def Configure(self, cpp, maxlen, direction, space, kbtype):
         self.set_candPerPage(cpp)
         self.set_maxChiSymbolLen(maxlen)
         self.set_addPhraseDirection(direction)
         self.set_spaceAsSelection(space)
         self.set_KBType(kbtype)
+
+    # strings are copied into a buffer of the context, nothing to free
+    def _string(self, func):
+        while True:
+            n = func(self.ctx, self._buf, len(self._buf))
+            if n < len(self._buf):
+                return self._buf.value.decode('utf-8')
+            self._buf = create_string_buffer(n + 1)
+    def commit_String(self):
+        return self._string(_libchewing.chewing_commit_String_copy)
+    def buffer_String(self):
+        return self._string(_libchewing.chewing_buffer_String_copy)
+    def zuin_String(self):
+        return self._string(_libchewing.chewing_zuin_String_copy)
+    def cand_String(self):
+        return self._string(_libchewing.chewing_cand_String_copy)
+    def aux_String(self):
+        return self._string(_libchewing.chewing_aux_String_copy)
+
+    def handle_keys(self, keys):
+        """Handle keys as handle_Default does each, return what they commit.
+
+        The keys go to the library in one call until one commits.
+        """
+        codes = (c_int * len(keys))(*[ord(key) for key in keys])
+        committed = []
+        done = 0
+        while done < len(keys):
+            n = _libchewing.chewing_handle_KeySequence(self.ctx,
+                byref(codes, done * sizeof(c_int)), len(keys) - done)
+            if n <= 0:
+                break
+            done += n
+            if self.commit_Check():
+                committed.append(self.commit_String())
+        return u''.join(committed)
+
+    def convert(self, phones, intervals=False):
+        """Convert a sequence of phones into a sentence at once.
+
+        With intervals, also return the (from, to) of its phrases.
+        """
+        seq = _phone_array(phones)
+        size = len(phones) * _MAX_UTF8_SIZE + 1
+        buf = create_string_buffer(size)
+        found = (_Interval * len(phones))()
+        n = c_int(len(phones))
+        if _libchewing.chewing_convert_phone(self.ctx, seq, len(phones),
+                buf, size, found, byref(n)) < 0:
+            raise ValueError('invalid phone sequence')
+        return self._sentence(buf, found, n.value, intervals)
+    def convert_bopomofo(self, bopomofo, intervals=False):
+        """Convert bopomofo syllables separated by spaces into a sentence."""
+        if not isinstance(bopomofo, bytes):
+            bopomofo = bopomofo.encode('utf-8')
+        # a syllable and its space take 2 bytes at least
+        size = len(bopomofo) * _MAX_UTF8_SIZE // 2 + 1
+        buf = create_string_buffer(size)
+        found = (_Interval * (len(bopomofo) // 2 + 1))()
+        n = c_int(len(found))
+        if _libchewing.chewing_convert_bopomofo(self.ctx, bopomofo,
+                buf, size, found, byref(n)) < 0:
+            raise ValueError('invalid bopomofo')
+        return self._sentence(buf, found, n.value, intervals)
+    def _sentence(self, buf, found, n, intervals):
+        text = buf.value.decode('utf-8')
+        if not intervals:
+            return text
+        return text, [(i.from_, i.to) for i in found[:n]]
+
+    def convert_batch(self, seqs, threads=1, raw=False):
+        """Convert many sequences of phones on threads, in one call.
+
+        seqs is a list of sequences, or an array('H') of them one after
+        another, each terminated by 0. Returns the list of sentences in the
+        same order, or with raw, a memoryview of the UTF-8 bytes of them one
+        after another, each terminated by NUL.
+        """
+        if isinstance(seqs, array.array) and seqs.typecode == 'H':
+            flat = seqs
+        else:
+            flat = array.array('H')
+            for seq in seqs:
+                flat.extend(seq)
+                flat.append(0)
+        if len(flat) == 0:
+            return b'' if raw else []
+        phones = (c_ushort * len(flat)).from_buffer(flat)
+        size = len(flat) * _MAX_UTF8_SIZE
+        buf = create_string_buffer(size)
+        n = _libchewing.chewing_convert_batch_buffer(self.ctx, phones,
+            len(flat), threads, buf, size)
+        if n < 0:
+            raise ValueError('invalid phone sequences')
+        if raw:
+            return memoryview(buf)[:n]
+        return [s.decode('utf-8') for s in buf.raw[:n - 1].split(b'\0')]
@@ -1,21 +1,23 @@
 #!/usr/bin/env python
 # -*- coding: utf-8 -*-
+from __future__ import print_function
 import chewing
 
 chewing.Init('/usr/share/chewing', '/tmp')
 ctx = chewing.ChewingContext()
 ctx.Configure (18, 16, 0, 1, 0);
 ctx.set_ChiEngMode(1)
-ctx.handle_Default("g")
-ctx.handle_Default("j")
+ctx.handle_Default(ord("g"))
+ctx.handle_Default(ord("j"))
 ctx.handle_Space()
-print ctx.buffer_String()
-ctx.handle_Default("b")
-ctx.handle_Default("j")
-ctx.handle_Default("4")
-ctx.handle_Default("z")
-ctx.handle_Default("8")
-ctx.handle_Default("3")
+print(ctx.buffer_String())
+ctx.handle_keys("bj4z83")
 ctx.handle_Enter()
-print ctx.commit_String()
+print(ctx.commit_String())
+
+# whole sentences, without the keys
+print(ctx.convert_bopomofo(u"ㄘㄜˋ ㄕˋ", intervals=True))
+phones = [10268, 8708]
+print(ctx.convert(phones))
+print(ctx.convert_batch([phones, phones[:1], phones[1:]], threads=2))
 ctx = None
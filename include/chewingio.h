@@ -141,6 +141,21 @@ CHEWING_API int chewing_handle_Capslock( ChewingContext *ctx );
  */
 CHEWING_API int chewing_handle_Default( ChewingContext *ctx, int key );
 
+/**
+ * @brief Handle many casual keys, as chewing_handle_Default() does each
+ *
+ * Phrasing runs once after the last key, rather than after every key,
+ * unless a key needs it sooner. It stops after a key that commits, so
+ * that the commit string can be taken before the rest is handled.
+ *
+ * @param ctx Chewing IM context
+ * @param keys scan codes of key strokes
+ * @param n number of keys
+ *
+ * @return the number of keys handled, -1 on invalid arguments
+ */
+CHEWING_API int chewing_handle_KeySequence( ChewingContext *ctx, const int keys[], int n );
+
 /**
  * @brief Handle the input key stroke: Ctrl + Number-key
  * @param ctx Chewing IM context
@@ -176,9 +191,43 @@ CHEWING_API int chewing_handle_Numlock( ChewingContext *ctx, int key);
 /**
  * @brief Create new handle of the instance for Chewing IM
  * @see chewing_delete()
+ *
+ * Different contexts may be used on different threads at once, each by
+ * one thread at a time; the static data they share is read-only.
  */
 CHEWING_API ChewingContext *chewing_new();
 
+/**
+ * @brief Create new handle on the dictionary data in memory
+ * @see chewing_new()
+ *
+ * data is the container packdata writes as chewing.dat, put in memory by
+ * the caller, for instance one of its own package or a shared memory
+ * segment. It is read in place rather than copied, so it must stay
+ * unchanged until every context made on it is deleted. Contexts given the
+ * same data share it as the contexts of chewing_new() share their files.
+ * The user phrases are in the user path as with chewing_new().
+ *
+ * @param data The container, aligned to 16 bytes at least
+ * @param size Its size in bytes
+ * @return NULL if the data is not a valid container, or the library is
+ * built without --enable-binary-data
+ */
+CHEWING_API ChewingContext *chewing_new_with_data( const void *data, size_t size );
+
+/**
+ * @brief Create new handle that shares the loaded data of template_ctx
+ * @see chewing_new()
+ *
+ * The dictionary is neither searched for nor loaded again, and the user
+ * phrases are copied from template_ctx instead of read from the file. The
+ * settings of template_ctx are taken, its input state is not. The template
+ * is read and flushed, and must not be in use on another thread meanwhile.
+ *
+ * @param template_ctx Chewing IM context to start from
+ */
+CHEWING_API ChewingContext *chewing_new_from( ChewingContext *template_ctx );
+
 /**
  * @brief Release the handle and internal memory by given Chewing instance
  * @see chewing_new()
@@ -528,6 +577,132 @@ CHEWING_API int chewing_get_phraseChoiceRearward( ChewingContext *ctx );
 /*@}*/
 
 
+/*! \name Order of the phrase candidates
+ */
+
+/*@{*/
+/**
+ * @brief Rank the phrase candidates by frequency
+ *
+ * The frequency of a phrase is the higher of the dictionary's and the
+ * user's. Only the pages shown are ranked, so a ranked list opens as fast
+ * as one in dictionary order. Characters keep the dictionary order. It is
+ * kept across chewing_Reset.
+ *
+ * @param ctx
+ * @param mode 1 to rank, 0 for the dictionary order (the default)
+ */
+CHEWING_API void chewing_set_rankCandidates( ChewingContext *ctx, int mode );
+
+/**
+ * @brief Get whether the phrase candidates are ranked by frequency
+ *
+ * @param ctx
+ */
+CHEWING_API int chewing_get_rankCandidates( ChewingContext *ctx );
+/*@}*/
+
+
+/*! \name Engine used to segment the phonetic sequence into phrases
+ */
+
+/*@{*/
+/**
+ * @brief Set the engine used to segment the phonetic sequence into phrases
+ *
+ * Both engines apply the same scoring rules.  PHRASING_ENGINE_DP avoids
+ * enumerating every segmentation of long ambiguous buffers, and keeps only
+ * the best few segmentations for cycling with Tab.
+ *
+ * @param ctx
+ * @param engine PHRASING_ENGINE_ENUMERATE or PHRASING_ENGINE_DP
+ * @return If successed then return 0
+ */
+CHEWING_API int chewing_set_phrasingEngine( ChewingContext *ctx, int engine );
+
+/**
+ * @brief Get the engine used to segment the phonetic sequence into phrases
+ *
+ * @param ctx
+ */
+CHEWING_API int chewing_get_phrasingEngine( ChewingContext *ctx );
+/*@}*/
+
+
+/*! \name Statistics of the work done by the context
+ */
+
+/*@{*/
+/**
+ * @brief Get the counters of what ctx has done
+ *
+ * Counting costs next to nothing, and is always on. Compare two calls to
+ * see what a key stroke has done.
+ *
+ * @param ctx
+ * @param stats filled with the counters
+ * @return 0 on success, -1 if an argument is NULL
+ */
+CHEWING_API int chewing_get_stats( ChewingContext *ctx, ChewingStats *stats );
+
+/**
+ * @brief Set every counter of ctx back to 0
+ *
+ * @param ctx
+ */
+CHEWING_API void chewing_reset_stats( ChewingContext *ctx );
+
+/**
+ * @brief Time the stages of phrasing into the counters
+ *
+ * It reads a clock a few times a key stroke, which the counters alone do
+ * not. It is kept across chewing_Reset.
+ *
+ * @param ctx
+ * @param mode 1 to time, 0 not to (the default)
+ */
+CHEWING_API void chewing_set_statsTimer( ChewingContext *ctx, int mode );
+
+/**
+ * @brief Get whether the stages of phrasing are timed
+ *
+ * @param ctx
+ */
+CHEWING_API int chewing_get_statsTimer( ChewingContext *ctx );
+
+/**
+ * @brief Get the bytes of memory ctx, and the data it shares, use
+ *
+ * The data is shared by every context with the same search path, add its
+ * figures once for all of them.
+ *
+ * @param ctx
+ * @param mem filled with the bytes of every kind of memory
+ * @return 0 on success, -1 if an argument is NULL
+ */
+CHEWING_API int chewing_get_memory( ChewingContext *ctx, ChewingMemory *mem );
+
+/**
+ * @brief Call callback on every event of ctx, see ChewingTraceEvent
+ *
+ * Events are only raised by a library configured with --enable-trace.
+ * Without a callback they cost a test each, and without the option
+ * nothing. The callback is called on the thread ctx is used on, and may
+ * pass the events on to perf, ETW or a log. Some events are raised with
+ * a lock of the user phrases held, so the callback must not call back
+ * into the library, on ctx or on any other context. It is kept across
+ * chewing_Reset, and not given to chewing_new_from.
+ *
+ * @param ctx
+ * @param callback called with userdata and the event, NULL for none
+ * @param userdata
+ * @return 0 on success, -1 if ctx is NULL or the library cannot trace
+ */
+CHEWING_API int chewing_set_traceCallback( ChewingContext *ctx,
+		ChewingTraceCallback callback, void *userdata );
+/*@}*/
+
+
 /*! \name Phonetic sequence in Chewing internal state machine
  */
 
@@ -547,4 +722,310 @@ CHEWING_API unsigned short *chewing_get_phoneSeq( ChewingContext *ctx );
 CHEWING_API int chewing_get_phoneSeqLen( ChewingContext *ctx );
 /*@}*/
 
+/*! \name Dictionary lookup
+ */
+
+/*@{*/
+/**
+ * @brief Find the phrases of many phone sequences at once
+ *
+ * For every phone sequence, callback gets the phrases of the system
+ * dictionary, most frequent first, then those of the user dictionary.
+ * entry->phrase is left in the dictionary where possible and is valid
+ * only during the call. Nothing is allocated, and the input state of ctx
+ * is not touched.
+ *
+ * @param ctx
+ * @param phoneSeqs n phone sequences, each terminated by 0
+ * @param n
+ * @param callback
+ * @param userdata passed to callback
+ *
+ * @return the number of phrases passed to callback, -1 on invalid arguments
+ */
+CHEWING_API int chewing_dict_lookup_batch( ChewingContext *ctx,
+		const unsigned short *const phoneSeqs[], int n,
+		ChewingDictCallback callback, void *userdata );
+/*@}*/
+
+/*! \name Work done while idle
+ */
+
+/*@{*/
+/**
+ * @brief Prepare the candidates the next key to open them would show
+ *
+ * Call it when the keys have stopped for a while, after chewing_handle_*.
+ * The lengths of the phrases at the cursor are looked up, then the
+ * candidates of the longest, each as long as budget_us is not spent, so
+ * that opening the candidates mostly picks them up. What is prepared is
+ * kept while the input and the settings it depends on stay the same.
+ *
+ * @param ctx
+ * @param budget_us microseconds to spend at most, a step started runs to
+ * its end
+ *
+ * @return 0 if nothing is left to prepare, 1 if there is more to do in the
+ * next call, -1 on invalid arguments
+ */
+CHEWING_API int chewing_idle( ChewingContext *ctx, int budget_us );
+/*@}*/
+
+/*! \name Snapshot of the input state
+ */
+
+/*@{*/
+/**
+ * @brief Write the input state of ctx into buf, to move it to another context
+ *
+ * The state is the one a key stroke builds up: the edit buffer, the
+ * phones, the selections, the breakpoints, the zuin and the cursor. The
+ * sentence is not in it, chewing_restore() phrases it again once. It is
+ * compact, versioned, and the same on every platform. A choice window open
+ * is not kept, the settings of ctx and the user phrases neither.
+ *
+ * @param ctx
+ * @param buf buffer to receive the snapshot, may be NULL if size is 0
+ * @param size size of buf in bytes
+ *
+ * @return the bytes of the snapshot, buf has it whole if it is no more than
+ * size; -1 on invalid arguments
+ */
+CHEWING_API int chewing_snapshot( ChewingContext *ctx, void *buf, int size );
+
+/**
+ * @brief Set the input state of ctx to a snapshot from chewing_snapshot()
+ *
+ * The input state of ctx is reset, then set to the snapshot, and the
+ * sentence is phrased once. Nothing commits. ctx keeps its own settings,
+ * the keyboard layout among them, and user phrases, and may be in another
+ * process than the snapshot was taken in. A snapshot taken partway
+ * through a syllable on another layout is refused.
+ *
+ * @param ctx
+ * @param buf the size bytes chewing_snapshot() wrote
+ * @param size
+ *
+ * @return 0 on success, -1 on invalid arguments or if buf is not a snapshot
+ * of this version, and then ctx is not changed
+ */
+CHEWING_API int chewing_restore( ChewingContext *ctx, const void *buf, int size );
+/*@}*/
+
+/*! \name Sentence conversion
+ */
+
+/*@{*/
+/**
+ * @brief Convert a whole phone sequence into a sentence
+ *
+ * The phones are phrased as if typed with no breakpoint or selection, and
+ * the edit buffer, cursor and output of ctx are not touched. The learned
+ * phrases of ctx are used. A sequence that fills the edit buffer, or a
+ * longer one, is phrased a window of phones at a time, so that the time
+ * taken grows with its length alone.
+ *
+ * @param ctx
+ * @param phoneSeq len phones, none of them 0
+ * @param len
+ * @param buf buffer to receive the sentence, may be NULL if size is 0
+ * @param size size of buf in bytes
+ * @param interval buffer to receive the phrases of the sentence, may be
+ * NULL if nInterval is NULL or points to 0
+ * @param nInterval room in interval on entry, the number of phrases on
+ * return; may be NULL
+ *
+ * @return the length of the sentence in bytes, buf is left empty if it is
+ * size or more; -1 on invalid arguments
+ */
+CHEWING_API int chewing_convert_phone( ChewingContext *ctx,
+		const unsigned short *phoneSeq, int len,
+		char *buf, int size, IntervalType *interval, int *nInterval );
+
+/**
+ * @brief Convert bopomofo syllables separated by spaces into a sentence
+ *
+ * As chewing_convert_phone(), with the syllables written as in tsi.src,
+ * for example "ㄘㄜˋ ㄕˋ"; the first tone has no mark.
+ *
+ * @return the length of the sentence in bytes, -1 on invalid arguments or
+ * if a syllable is not bopomofo
+ */
+CHEWING_API int chewing_convert_bopomofo( ChewingContext *ctx, const char *bopomofo,
+		char *buf, int size, IntervalType *interval, int *nInterval );
+
+/**
+ * @brief Convert many phone sequences into sentences on several threads
+ *
+ * Each sequence is converted as by chewing_convert_phone(). The calling
+ * thread converts on ctx, and nThread - 1 more threads each on a context
+ * copied from ctx, taking sequences in turn until none is left.
+ *
+ * @param ctx
+ * @param phoneSeqs n phone sequences, each terminated by 0
+ * @param n
+ * @param nThread the threads to convert on, 1 for the calling one alone
+ * @param results n pointers, results[ i ] is set to the sentence of
+ * phoneSeqs[ i ], to be freed by chewing_free(), or NULL if out of memory
+ *
+ * @return the number of sequences converted, -1 on invalid arguments
+ */
+CHEWING_API int chewing_convert_batch( ChewingContext *ctx,
+		const unsigned short *const phoneSeqs[], int n, int nThread,
+		char *results[] );
+
+/**
+ * @brief Convert many phone sequences in one buffer into sentences in another
+ *
+ * As chewing_convert_batch(), with the sequences one after another in
+ * phones, each terminated by 0, and the sentences one after another in
+ * buf, each terminated by NUL, in the same order. Nothing is allocated for
+ * the caller to free, which suits bindings to other languages.
+ *
+ * @param ctx
+ * @param phones the sequences, nPhone elements ending with 0
+ * @param nPhone
+ * @param nThread the threads to convert on, 1 for the calling one alone
+ * @param buf buffer to receive the sentences
+ * @param size size of buf in bytes, at least 6 for every element of phones
+ *
+ * @return the bytes of the sentences in buf, -1 on invalid arguments, if
+ * size is less than that needed, or if out of memory
+ */
+CHEWING_API int chewing_convert_batch_buffer( ChewingContext *ctx,
+		const unsigned short *phones, int nPhone, int nThread,
+		char *buf, int size );
+/*@}*/
+
+/*! \name User phrases
+ */
+
+/*@{*/
+/**
+ * @brief Write the pending changes of user phrases into the user dictionary
+ *
+ * Learned phrases are kept in a journal next to the dictionary and are
+ * written back a batch at a time, at the latest when ctx is deleted.
+ * Call it before another process is to read the dictionary. It also takes
+ * in the phrases other processes have added to the dictionary since.
+ *
+ * @param ctx
+ *
+ * @return 0 on success, -1 if the dictionary cannot be written
+ */
+CHEWING_API int chewing_userphrase_flush( ChewingContext *ctx );
+
+/**
+ * @brief Leave the writing of learned phrases to chewing_userphrase_pump()
+ *
+ * A committed phrase is learned at once, and is preferred from the next
+ * key stroke on, but nothing is written to the journal on the key stroke
+ * that commits it. Turning it off writes what is pending. It is kept
+ * across chewing_Reset.
+ *
+ * @param ctx
+ * @param mode 1 to defer, 0 to journal on commit (the default)
+ */
+CHEWING_API void chewing_set_deferLearning( ChewingContext *ctx, int mode );
+
+/**
+ * @brief Get whether learned phrases wait for chewing_userphrase_pump()
+ *
+ * @param ctx
+ */
+CHEWING_API int chewing_get_deferLearning( ChewingContext *ctx );
+
+/**
+ * @brief Hold the user phrases together with other contexts of the process
+ *
+ * With mode 1, the contexts sharing them hold one copy of the user
+ * phrases of the same user dictionary, and each sees at once what any of
+ * them learns. They may run on different threads: lookups take no lock,
+ * and phrases are learned one at a time. A context that starts sharing
+ * writes back what it learned first, and contexts made from it with
+ * chewing_new_from share too. With mode 0, the default, ctx takes a copy
+ * of its own.
+ *
+ * @param ctx
+ * @param mode 1 to share, 0 to hold them alone
+ */
+CHEWING_API void chewing_set_shareUserPhrase( ChewingContext *ctx, int mode );
+
+/**
+ * @brief Get whether the user phrases are shared with other contexts
+ *
+ * @param ctx
+ *
+ * @return 1 if they are, 0 if not or if sharing ran out of memory
+ */
+CHEWING_API int chewing_get_shareUserPhrase( ChewingContext *ctx );
+
+/**
+ * @brief Journal the phrases learned since the last pump
+ *
+ * Call it when the user pauses typing, or from another thread that takes
+ * turns with the one typing into ctx. Phrases still pending are also
+ * written by chewing_userphrase_flush and when ctx is deleted, and at
+ * most a batch of them wait at once.
+ *
+ * @param ctx
+ *
+ * @return the number of phrases written, -1 if ctx is NULL
+ */
+CHEWING_API int chewing_userphrase_pump( ChewingContext *ctx );
+
+/**
+ * @brief Rewrite the user dictionary with only the phrases in use
+ *
+ * The user dictionary only grows as phrases are learned. This writes a
+ * new one without unreadable records, and starts the ages of phrases
+ * again from the oldest, then puts it in place of the old one at once.
+ * Other processes using the dictionary move over to the new one on their
+ * next write. It reads the whole dictionary, call it when the user is
+ * not typing.
+ *
+ * @param ctx
+ * @param evict Also drop phrases of the system dictionary whose frequency
+ * has fallen back to the one of the system dictionary.
+ *
+ * @return 0 on success, -1 if the dictionary cannot be rewritten
+ */
+CHEWING_API int chewing_userphrase_compact( ChewingContext *ctx, int evict );
+
+/**
+ * @brief Add many phrases to the user dictionary at once
+ *
+ * reader is called for phrase after phrase until it returns 0. A new
+ * phrase is added with the frequency given, or like a learned one if it
+ * is 0; the frequency of a phrase there already is set if it is not 0.
+ * Nothing is written until the last phrase is in, then the dictionary is
+ * written once.
+ *
+ * @param ctx
+ * @param reader
+ * @param userdata passed to reader
+ *
+ * @return the number of phrases added or changed, -1 on invalid arguments
+ * or if the dictionary cannot be written. Invalid phrases are skipped.
+ */
+CHEWING_API int chewing_userphrase_import( ChewingContext *ctx,
+		ChewingUserPhraseReader reader, void *userdata );
+
+/**
+ * @brief Pass every phrase of the user dictionary to callback
+ *
+ * The phrases are in no particular order. entry points into the user
+ * dictionary, is valid only during the call, and the user dictionary
+ * must not be changed from callback.
+ *
+ * @param ctx
+ * @param callback
+ * @param userdata passed to callback
+ *
+ * @return the number of phrases passed to callback, -1 on invalid arguments
+ */
+CHEWING_API int chewing_userphrase_export( ChewingContext *ctx,
+		ChewingUserPhraseCallback callback, void *userdata );
+/*@}*/
+
 #endif /* _CHEWING_IO_H */
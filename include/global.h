@@ -15,6 +15,8 @@
 #ifndef _CHEWING_GLOBAL_H
 #define _CHEWING_GLOBAL_H
 
+#include <stddef.h>
+
 /*! \file global.h
  *  \brief Chewing Global Definitions
  *  \author libchewing Core Team
@@ -89,6 +91,125 @@ typedef struct {
  */
 typedef struct _ChewingContext ChewingContext;
 
+/** @brief a phrase found by chewing_dict_lookup_batch()
+ */
+typedef struct {
+	/*@{*/
+	const char *phrase;	/**< UTF-8 of the phrase, not terminated */
+	int len;		/**< bytes of phrase */
+	int freq;		/**< frequency, the user frequency of a user phrase */
+	int isUser;		/**< 1 if from the user dictionary, 0 if from the system one */
+	/*@}*/
+} ChewingDictEntry;
+
+/** @brief called by chewing_dict_lookup_batch() for every phrase found
+ *
+ * index is the position of the phone sequence in the batch. A non-zero
+ * return value stops the lookup.
+ */
+typedef int (*ChewingDictCallback)( void *userdata, int index, const ChewingDictEntry *entry );
+
+/** @brief a user phrase, as chewing_userphrase_import() takes it and
+ * chewing_userphrase_export() gives it
+ */
+typedef struct {
+	/*@{*/
+	const unsigned short *phoneSeq;	/**< phones of the phrase, terminated by 0 */
+	const char *phrase;	/**< UTF-8 of the phrase, one character a phone */
+	int freq;		/**< user frequency, 0 to import as if learned */
+	/*@}*/
+} ChewingUserPhrase;
+
+/** @brief gives chewing_userphrase_import() the next phrase
+ *
+ * It fills entry and returns non-zero, or returns 0 once there are no
+ * more. What entry points to has to stay valid until the next call.
+ */
+typedef int (*ChewingUserPhraseReader)( void *userdata, ChewingUserPhrase *entry );
+
+/** @brief called by chewing_userphrase_export() for every user phrase
+ *
+ * A non-zero return value stops the export.
+ */
+typedef int (*ChewingUserPhraseCallback)( void *userdata, const ChewingUserPhrase *entry );
+
+/** @brief what a context has done, as chewing_get_stats() gives it
+ *
+ * The counters add up from chewing_new or chewing_reset_stats() on. The
+ * times are in nanoseconds, and stay 0 unless chewing_set_statsTimer()
+ * turns the timers on.
+ */
+typedef struct {
+	/*@{*/
+	unsigned long nPhrasing;	/**< segmentations of the buffer */
+	unsigned long nInterval;	/**< phrases found on spans of the buffer by them */
+	unsigned long nRecord;	/**< segmentations of phrases they scored */
+	unsigned long nTreeNode;	/**< nodes of the phrase tree visited */
+	unsigned long nHashLookup;	/**< lookups of user phrases */
+	unsigned long nHashProbe;	/**< slots of the user phrases visited by them */
+	unsigned long nHashWrite;	/**< changes of user phrases written */
+	unsigned long nHashWriteBytes;	/**< bytes written to the journal and the user dictionary */
+	unsigned long nCandList;	/**< candidate lists filled */
+	unsigned long nCandidate;	/**< candidates in them */
+	unsigned long maxCandidate;	/**< candidates of the longest of them */
+	unsigned long long timePhrasing;	/**< of the segmentations */
+	unsigned long long timeFindInterval;	/**< finding their phrases */
+	unsigned long long timeDiscard;	/**< dropping phrases inside others */
+	unsigned long long timeSaveList;	/**< listing the segmentations */
+	unsigned long long timeSort;	/**< scoring and sorting them */
+	/*@}*/
+} ChewingStats;
+
+/** @brief bytes of memory in use, as chewing_get_memory() gives them
+ *
+ * The shared figures are those of the data every context with the same
+ * search path shares, once for all of them.
+ */
+typedef struct {
+	/*@{*/
+	size_t context;	/**< ChewingContext, ChewingData and ChewingOutput */
+	size_t userPhrase;	/**< heap of the user phrases, their table and items */
+	size_t phrasing;	/**< heap of the temporaries and caches of phrasing */
+	size_t candidate;	/**< heap of the candidate list */
+	size_t shared;	/**< the shared data, less what follows */
+	size_t sharedSymbol;	/**< heap of the symbol tables */
+	size_t sharedPinyin;	/**< heap of the pinyin keymaps */
+	size_t sharedMapped;	/**< dictionary files mapped */
+	size_t sharedResident;	/**< of them in memory, (size_t) -1 if the platform cannot tell */
+	int nSharedContext;	/**< contexts sharing the data */
+	/*@}*/
+} ChewingMemory;
+
+/** @brief Phrasing of the buffer starts, nPhone long */
+#define CHEWING_TRACE_PHRASING_BEGIN 1
+
+/** @brief Phrasing ends, having found nInterval phrases and scored nRecord segmentations */
+#define CHEWING_TRACE_PHRASING_END 2
+
+/** @brief The user phrase of nPhone phones is written, or listed to be */
+#define CHEWING_TRACE_USERPHRASE_WRITE 3
+
+/** @brief A candidate list of nCandidate candidates on nPhone phones is filled */
+#define CHEWING_TRACE_CANDIDATE_OPEN 4
+
+/** @brief an event given to the callback of chewing_set_traceCallback()
+ *
+ * The fields an event does not have are 0. The event, and its phrase, are
+ * valid during the call only.
+ */
+typedef struct {
+	/*@{*/
+	int type;	/**< CHEWING_TRACE_* */
+	int nPhone;	/**< phones phrased, of the user phrase or of the candidates */
+	int nInterval;	/**< phrases found on spans of the buffer */
+	int nRecord;	/**< segmentations scored */
+	int nCandidate;	/**< candidates in the list */
+	const char *phrase;	/**< the user phrase, in UTF-8 */
+	/*@}*/
+} ChewingTraceEvent;
+
+typedef void (*ChewingTraceCallback)( void *userdata, const ChewingTraceEvent *event );
+
 /** @brief use "asdfjkl789" as selection key
  */
 #define HSU_SELKEY_TYPE1 1
@@ -97,4 +218,12 @@ typedef struct _ChewingContext ChewingContext;
  */
 #define HSU_SELKEY_TYPE2 2
 
+/** @brief enumerate every segmentation of the buffer, then sort them (default)
+ */
+#define PHRASING_ENGINE_ENUMERATE 0
+
+/** @brief find the best segmentations by dynamic programming
+ */
+#define PHRASING_ENGINE_DP 1
+
 #endif
@@ -0,0 +1,23 @@
+/**
+ * arena-private.h
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+#ifndef _CHEWING_ARENA_PRIVATE_H
+#define _CHEWING_ARENA_PRIVATE_H
+
+#include <stddef.h>
+
+void *ArenaAlloc( Arena *pa, size_t size );
+void ResetArena( Arena *pa );
+void TerminateArena( Arena *pa );
+
+#define ARENA_ALC( pa, type, size ) \
+	(type *) ArenaAlloc( pa, ( size ) * sizeof( type ) )
+
+#endif
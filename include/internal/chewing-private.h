@@ -21,20 +21,28 @@
 #  include <stdint.h>
 #endif
 
+#include <stdio.h>
+#include <time.h>
+
 #include "global.h"
 #include "plat_mmap.h"
 
 #define MAX_KBTYPE 11
+/* the places of a key in a layout, see KeyTable */
+#define MAX_KEY_READING 3
+#define KEY_TABLE_SIZE 128
 #define MAX_UTF8_SIZE 6
 #define ZUIN_SIZE 4
 #define PINYIN_SIZE 10
 #define MAX_PHRASE_LEN 10
 #define MAX_PHONE_SEQ_LEN 50
 #define MAX_INTERVAL ( ( MAX_PHONE_SEQ_LEN + 1 ) * MAX_PHONE_SEQ_LEN / 2 )
+/* a selected phrase, no longer than the phrases of the choice list */
+#define MAX_SELECT_STR_SIZE ( MAX_PHRASE_LEN * MAX_UTF8_SIZE + 1 )
 #define MAX_CHOICE (567)
 #define MAX_CHOICE_BUF (50)                   /* max length of the choise buffer */
-#define N_HASH_BIT (14)
-#define HASH_TABLE_SIZE (1<<N_HASH_BIT)
+#define HASH_TABLE_MIN_SIZE (256)	/* slots of a new user phrase table, a power of 2 */
+#define HASH_DIRTY_MAX (32)		/* user phrases written back at once */
 #define EASY_SYMBOL_KEY_TAB_LEN (36)
 
 #undef max
@@ -54,19 +62,34 @@ typedef union {
 	uint16_t wch;
 } wch_t;
 
+/**
+ * @brief a node of PHONE_TREE_FILE
+ *
+ * Little-endian in STATIC_DATA_FILE, see tree.c for the accessors.
+ */
 typedef struct {
 	uint16_t phone_id;
-	int phrase_id;
-	int child_begin, child_end;
+	uint16_t reserved;
+	int32_t phrase_id;	/* -1 if no phrase ends here */
+	int32_t child_begin, child_end;	/* -1 if there is no child */
 } TreeType;
 
 typedef struct {
 	char chiBuf[ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ];
-	IntervalType dispInterval[ MAX_INTERVAL ];
+	/* the character of phone i starts at chiBuf + chiPos[ i ], see ChiBufSeek() */
+	int chiPos[ MAX_PHONE_SEQ_LEN + 1 ];
+	/* the intervals of one sentence, which do not overlap */
+	IntervalType dispInterval[ MAX_PHONE_SEQ_LEN ];
 	int nDispInterval;
 	int nNumCut;
 } PhrasingOutput;
 
+/* the character of phone i in the sentence, without scanning the ones before */
+static inline char *ChiBufSeek( PhrasingOutput *ppo, int i )
+{
+	return ppo->chiBuf + ppo->chiPos[ i ];
+}
+
 typedef struct {
     int type;
     char keySeq[ PINYIN_SIZE ];
@@ -96,6 +119,14 @@ typedef struct {
  *	@brief information of available phrases or characters choices.
  */
 
+/** @brief what a candidate is ranked by, see ChoiceRank() */
+typedef struct {
+	/** @brief frequency in the dictionary or of the user, the higher of the two */
+	int freq;
+	/** @brief position the candidate was found at, ties keep it */
+	int order;
+} ChoiceScore;
+
 typedef struct {
 	/** @brief total page number. */
 	int nPage;
@@ -103,14 +134,40 @@ typedef struct {
 	int pageNo;
 	/** @brief number of choices per page. */
 	int nChoicePerPage;
-	/** @brief store possible phrases for being chosen. */
-	char totalChoiceStr[ MAX_CHOICE ][ MAX_PHRASE_LEN * MAX_UTF8_SIZE + 1 ];
+	/** @brief store possible phrases for being chosen, see ChoiceInfoAppend(). */
+	char ( *totalChoiceStr )[ MAX_PHRASE_LEN * MAX_UTF8_SIZE + 1 ];
 	/** @brief number of phrases to choose. */
 	int nTotalChoice;
+	/** @brief number of phrases totalChoiceStr has room for. */
+	int nChoiceAlloc;
+	/** @brief score of each phrase of totalChoiceStr, as long as it. */
+	ChoiceScore *choiceScore;
+	/** @brief phrases before this one are in the order they are shown in. */
+	int nChoiceRanked;
 	int oldChiSymbolCursor;
 	int isSymbol;
 } ChoiceInfo;
 
+enum {
+	PREPARED_NONE,
+	PREPARED_AVAIL,		/* availInfo is found */
+	PREPARED_CHOICE		/* and the candidates of its longest phrase */
+};
+
+/** @brief the choice ChoiceFirstAvail() would open, see chewing_idle() */
+typedef struct {
+	int stage;
+	/* the span and what it was prepared from */
+	int begin, end;
+	uint16_t phoneSeq[ MAX_PHONE_SEQ_LEN ];
+	int nPhoneSeq;
+	int bSymbolArrBrkpt[ MAX_PHONE_SEQ_LEN + 1 ];
+	int kbtype, bPhraseChoiceRearward, candPerPage, bRankCandidates;
+	unsigned int hashGeneration;
+	AvailInfo availInfo;
+	ChoiceInfo choiceInfo;
+} PreparedChoice;
+
 /** @brief entry of symbol table */
 typedef struct _SymbolEntry {
 	/** @brief  nSymnols is total number of symbols in this category.
@@ -118,7 +175,7 @@ typedef struct _SymbolEntry {
 	 * which is a zero-terminated utf-8 string. 
 	 * In that case, symbols[] is unused and isn't allocated at all.
 	 */
-	int nSymbols;
+	int32_t nSymbols;
 
 	/** @brief  Category name of these symbols */
 	char category[ MAX_PHRASE_LEN * MAX_UTF8_SIZE + 1 ];
@@ -130,45 +187,86 @@ typedef struct _SymbolEntry {
 	char symbols[][ MAX_UTF8_SIZE + 1 ];
 } SymbolEntry;
 
+/**
+ * @brief read-only data loaded from the data files
+ *
+ * Shared by every context created with the same search path and released
+ * with the last of them, see chewingio.c.
+ */
+/**
+ * @brief the components every key of a layout stands for, see InitKeyTable()
+ *
+ * reading[ key ][ n ] is the KEY_READING() of the n + 1 th place of key in
+ * the layout, 0 past the last one. The phone engine of zuin.c looks the
+ * keys up here, instead of searching the layout string of key2pho.c.
+ */
+typedef struct tag_KeyTable {
+	uint8_t reading[ KEY_TABLE_SIZE ][ MAX_KEY_READING ];
+} KeyTable;
+
+#define KEY_READING( type, inx ) ( ( type ) << 5 | ( inx ) )
+#define KEY_READING_TYPE( r ) ( ( r ) >> 5 )
+#define KEY_READING_INX( r ) ( ( r ) & 0x1F )
+
+/** @brief a node of PinYinTrie */
 typedef struct {
-	TreeType *tree;
-	size_t tree_size;
+	char key;
+	/* the first child and the next sibling, 0 if none */
+	int16_t child, next;
+	/* the first keymap whose pinyin ends here, -1 if none */
+	int16_t entry;
+} PinYinTrieNode;
+
+/** @brief the pinyin of a keymap array by their letters, see hanyupinyin.c */
+typedef struct {
+	PinYinTrieNode *node;	/* node[ 0 ] is the root */
+	int nNode;
+} PinYinTrie;
+
+typedef struct tag_ChewingStaticData {
+	char search_path[ PATH_MAX ];
+	int refcount;
+	struct tag_ChewingStaticData *next;
+
 #ifdef USE_BINARY_DATA
-	plat_mmap tree_mmap;
+	/* STATIC_DATA_FILE, the tables below point into it, see datafile.c.
+	 * Their integers are little-endian, see container-private.h */
+	plat_mmap data_mmap;
+	void *data;
+	size_t dataSize;	/* mapped, or linked in with USE_EMBEDDED_DATA */
+	/* the container of chewing_new_with_data(), NULL if searched for */
+	const void *buffer;
 #endif
 
+	TreeType *tree;
+	size_t tree_size;
+
 	uint16_t *arrPhone;
-	int *char_begin;
+#ifdef USE_BINARY_DATA
+	/* index + 1 in arrPhone of every phone, 0 if none, see GetCharFirst() */
+	uint16_t *char_index;
+#endif
+	int32_t *char_begin;
 	size_t phone_num;
 	void *char_;
-	void *char_cur_pos;
-	int char_end_pos;
-#ifdef USE_BINARY_DATA
-	plat_mmap char_mmap;
-	plat_mmap char_begin_mmap;
-	plat_mmap char_phone_mmap;
-#else
+#ifndef USE_BINARY_DATA
 	FILE *charfile;
 #endif
 
-	int *dict_begin;
-	void *dict_cur_pos;
-	int dict_end_pos;
+	int32_t *dict_begin;
 
 	void *dict;
-
 #ifdef USE_BINARY_DATA
-	plat_mmap dict_mmap;
-	plat_mmap index_mmap;
-#else
-	FILE *dictfile;
+	/* dict_record is NULL if the dictionary is compressed, see dict-private.h */
+	struct tag_DictRecord *dict_record;
+	char *dict_chars;
 #endif
 
-
-	int chewing_lifetime;
-
-	char hashfilename[ 200 ];
-	struct tag_HASH_ITEM *hashtable[ HASH_TABLE_SIZE ];
+#ifndef USE_BINARY_DATA
+	FILE *dictfile;
+#endif
+	/* DICT_OVERLAY_FILE, NULL without one, see overlay-private.h */
+	struct tag_DictOverlay *overlay;
 
 	unsigned int n_symbol_entry;
 	SymbolEntry ** symbol_table;
@@ -180,9 +278,90 @@ typedef struct {
 	struct keymap *hanyuFinalsMap;
 	int HANYU_INITIALS;
 	int HANYU_FINALS;
+	PinYinTrie hanyuInitialsTrie;
+	PinYinTrie hanyuFinalsTrie;
+
+	KeyTable keyTable[ MAX_KBTYPE ];
 } ChewingStaticData;
 
+struct tag_ArenaBlock;
+
+/** @brief bump allocator, see arena.c */
+typedef struct {
+	struct tag_ArenaBlock *block;	/* the block in use, older ones follow */
+	size_t total;	/* total size of all blocks */
+	unsigned int nAlloc;	/* ArenaAlloc() calls since the last reset */
+	unsigned int nBlockAlloc;	/* blocks taken from the heap since the last reset */
+} Arena;
+
+/**
+ * @brief a context reading the user phrases without their lock
+ *
+ * epoch is that of the store when the outermost HashReadBegin() started,
+ * 0 outside of one; the tables replaced before it are not freed until it
+ * ends. See hash.c.
+ */
+typedef struct tag_HashReader {
+	unsigned int epoch;
+	int depth;
+	struct tag_HashReader *next;	/* of the store */
+} HashReader;
+
+/** @brief where HashFindPhonePhrase() left off, in the table it found */
+typedef struct {
+	struct tag_HASH_TABLE *table;
+	unsigned int hash;
+	unsigned int slot;
+} HashCursor;
+
+/** @brief lookup cursors and user phrases of one context */
+typedef struct {
+	void *char_cur_pos;
+	int char_end_pos;
+
+	void *dict_cur_pos;
+	int dict_end_pos;
+	/* the phrase before dict_cur_pos in a compressed dictionary, and
+	 * the phrase of GetPhraseViewNext() where it has to be decoded */
+	char dict_last[ MAX_PHRASE_LEN * MAX_UTF8_SIZE + 1 ];
+	/* the phrases of an overlay phrase id, NULL for the dictionary */
+	void *overlay_cur;
+	void *overlay_end;
+
+	/* the user phrases, of this context alone or shared, see hash.c */
+	struct tag_HASH_STORE *hashStore;
+	HashReader hashReader;
+	/* lookups of the user phrases, and the slots they visited */
+	unsigned int nHashLookup;
+	unsigned int nHashProbe;
+} ChewingSessionData;
+
 struct tag_HASH_ITEM;
+struct tag_PhrasingCacheEntry;
+
+/** @brief input and span lookups of the previous Phrasing() call, see tree.c */
+typedef struct {
+	int valid;
+	unsigned int hashGeneration;
+	uint16_t phoneSeq[ MAX_PHONE_SEQ_LEN ];
+	int nPhoneSeq;
+	int bArrBrkpt[ MAX_PHONE_SEQ_LEN + 1 ];
+	IntervalType selectInterval[ MAX_PHONE_SEQ_LEN ];
+	/* selectStr[ selectStrPos[ i ] ] is the string of selectInterval[ i ] */
+	int selectStrPos[ MAX_PHONE_SEQ_LEN ];
+	char selectStr[ MAX_PHONE_SEQ_LEN * ( MAX_UTF8_SIZE + 1 ) ];
+	int nSelect;
+	/* the intervals found, in the order FindInterval adds them */
+	struct tag_PhrasingCacheEntry *entry;
+	int nEntry, nEntryAlloc;
+} PhrasingCache;
+
+struct tag_SpanCacheEntry;
+
+/** @brief bounded cache of span lookups keyed by phone sequence, see tree.c */
+typedef struct {
+	struct tag_SpanCacheEntry *entry;	/* allocated on first use */
+} SpanCache;
 
 typedef struct {
 	AvailInfo availInfo;
@@ -190,10 +369,35 @@ typedef struct {
 	PhrasingOutput phrOut;
 	ZuinData zuinData;
 	ChewingConfigData config;
+	/** @brief PHRASING_ENGINE_* used by Phrasing(), kept across chewing_Reset */
+	int phrasingEngine;
+	/** @brief learned phrases wait for chewing_userphrase_pump(), kept across chewing_Reset */
+	int bDeferLearning;
+	/** @brief counters of chewing_get_stats(), kept across chewing_Reset */
+	ChewingStats stats;
+	/** @brief stats times the stages of Phrasing(), see chewing_set_statsTimer() */
+	int bStatsTimer;
+	/** @brief candidates are ranked by frequency, kept across chewing_Reset */
+	int bRankCandidates;
+	/** @brief prepared by chewing_idle(), kept across chewing_Reset */
+	PreparedChoice prepared;
+#ifdef ENABLE_TRACE
+	/** @brief sink of TRACE_EVENT(), see chewing_set_traceCallback() */
+	ChewingTraceCallback traceCallback;
+	void *traceData;
+#endif
+	/** @brief temporaries of Phrasing(), kept across chewing_Reset */
+	Arena phrasingArena;
+	/** @brief span lookups reused by the next Phrasing(), kept across chewing_Reset */
+	PhrasingCache phrasingCache;
+	/** @brief lookups shared by Phrasing() and the choice module, kept across chewing_Reset */
+	SpanCache spanCache;
     /** @brief current input buffer, content==0 means Chinese code */
 	wch_t chiSymbolBuf[ MAX_PHONE_SEQ_LEN ];
 	int chiSymbolCursor;
 	int chiSymbolBufLen;
+	/* the longest chiSymbolBufLen since chewing_Reset, which clears that much */
+	int chiSymbolBufUsed;
 	int PointStart;
 	int PointEnd;
 	wch_t showMsg[ MAX_PHONE_SEQ_LEN ];
@@ -201,10 +405,10 @@ typedef struct {
 
 	uint16_t phoneSeq[ MAX_PHONE_SEQ_LEN ];
 	int nPhoneSeq;
-	char selectStr[ MAX_PHONE_SEQ_LEN ][ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ];
+	char selectStr[ MAX_PHONE_SEQ_LEN ][ MAX_SELECT_STR_SIZE ];
 	IntervalType selectInterval[ MAX_PHONE_SEQ_LEN ];
 	int nSelect;
-	IntervalType preferInterval[ MAX_INTERVAL ]; /* add connect points */
+	IntervalType preferInterval[ MAX_PHONE_SEQ_LEN ]; /* add connect points, no overlaps */
 	int nPrefer;
 	int bUserArrCnnct[ MAX_PHONE_SEQ_LEN + 1 ];
 	int bUserArrBrkpt[ MAX_PHONE_SEQ_LEN + 1 ];   
@@ -212,12 +416,32 @@ typedef struct {
 	int bSymbolArrBrkpt[ MAX_PHONE_SEQ_LEN + 1 ];
 	/* "bArrBrkpt[10]=True" means "it breaks between 9 and 10" */
 	int bChiSym, bSelect, bCaseChange, bFirstKey, bFullShape;
+	/* a key may leave phrasing to the next one, see chewing_handle_KeySequence() */
+	int bDeferPhrasing;
 	/* Symbol Key buffer */
 	char symbolKeyBuf[ MAX_PHONE_SEQ_LEN ];
 
-	ChewingStaticData static_data;
+	ChewingStaticData *static_data;
+	ChewingSessionData session;
 } ChewingData;
 
+/*
+ * TRACE_EVENT( pgdata, .type = CHEWING_TRACE_..., fields ) gives the event
+ * to the callback of pgdata. Without ENABLE_TRACE it is nothing, and its
+ * arguments are not evaluated.
+ */
+#ifdef ENABLE_TRACE
+#define TRACE_EVENT( pgdata, ... ) \
+	do { \
+		if ( ( pgdata )->traceCallback ) { \
+			ChewingTraceEvent trace_event = { __VA_ARGS__ }; \
+			( pgdata )->traceCallback( ( pgdata )->traceData, &trace_event ); \
+		} \
+	} while ( 0 )
+#else
+#define TRACE_EVENT( pgdata, ... )
+#endif
+
 typedef struct {
 	/** @brief the content of Edit buffer. */
 	wch_t chiSymbolBuf[ MAX_PHONE_SEQ_LEN ];
@@ -230,7 +454,7 @@ typedef struct {
 	/** @brief the zuin-yin symbols have already entered. */
 	wch_t zuinBuf[ ZUIN_SIZE ];
 	/** @brief indicate the method of showing sentence break. */
-	IntervalType dispInterval[ MAX_INTERVAL ]; /* from prefer, considering symbol */
+	IntervalType dispInterval[ MAX_PHONE_SEQ_LEN ]; /* from prefer, considering symbol */
 	int nDispInterval;
 	/** @brief indicate the break points going to display.*/ 
 	int dispBrkpt[ MAX_PHONE_SEQ_LEN + 1 ];
@@ -22,6 +22,29 @@
 #define DECREASE_CURSOR 1
 #define NONDECREASE_CURSOR 0
 
+/* the longest value of a key in SOFTKBD_TABLE_FILE, in characters */
+#define MAX_EASY_SYMBOL_LEN 10
+
+#ifdef USE_BINARY_DATA
+/*
+ * maketables compiles SYMBOL_TABLE_FILE into SYMBOL_TABLE_BIN_FILE:
+ *
+ *	int32 nEntry;
+ *	int32 offset[ nEntry ];	of each entry from the start of the file
+ *	SymbolEntry entries, each with its nSymbols symbols and aligned
+ *	  to 4 bytes
+ *
+ * and SOFTKBD_TABLE_FILE into EASY_SYMBOL_BIN_FILE, one EasySymbolRecord
+ * for each key of the easy symbol input, nSymbols is 0 for a key without
+ * symbols. The library uses both in place.
+ */
+typedef struct {
+	int32_t nSymbols;
+	/* MAX_EASY_SYMBOL_LEN characters and '\0', padded to 4 bytes */
+	char symbols[ ( MAX_EASY_SYMBOL_LEN * MAX_UTF8_SIZE + 4 ) / 4 * 4 ];
+} EasySymbolRecord;
+#endif
+
 void AutoLearnPhrase( ChewingData *pgdata );
 void SetUpdatePhraseMsg( ChewingData *pgdata, char *addWordSeq, int len, int state );
 int NoSymbolBetween( ChewingData *pgdata, int begin, int end );
@@ -35,7 +58,9 @@ int SymbolChoice( ChewingData *pgdata, int sel_i );
 int HaninSymbolInput( ChewingData *pgdata );
 int WriteChiSymbolToBuf( wch_t csBuf[], int csBufLen, ChewingData *pgdata );
 int ReleaseChiSymbolBuf( ChewingData *pgdata, ChewingOutput *);
+int ChiSymbolBufFull( ChewingData *pgdata );
 int AddChi( uint16_t phone, ChewingData *pgdata );
+void SetBreakpoints( ChewingData *pgdata );
 int CallPhrasing( ChewingData *pgdata );
 int MakeOutputWithRtn( ChewingOutput *pgo, ChewingData *pgdata, int keystrokeRtn );
 void MakeOutputAddMsgAndCleanInterval( ChewingOutput *pgo, ChewingData *pgdata );
@@ -57,6 +82,7 @@ void TerminateSymbolTable( ChewingData *pgdata );
 
 int InitEasySymbolInput( ChewingData *pgdata, const char *prefix );
 void TerminateEasySymbolTable( ChewingData *pgdata );
+size_t SymbolTableBytes( ChewingData *pgdata );
 
 #endif
 
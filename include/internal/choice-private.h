@@ -16,5 +16,10 @@ int ChoiceNextAvail( ChewingData * );
 int ChoicePrevAvail( ChewingContext * );
 int ChoiceSelect( ChewingData *, int selectNo );
 int ChoiceEndChoice( ChewingData * );
+char *ChoiceInfoAppend( ChoiceInfo *pci );
+void ChoiceRank( ChoiceInfo *pci, int index );
+void TerminateChoice( ChewingData *pgdata );
+int ChoicePrepare( ChewingData *pgdata, unsigned long long deadline );
+void ChoiceDropPrepared( ChewingData *pgdata );
 
 #endif
@@ -0,0 +1,128 @@
+/**
+ * container-private.h
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file container-private.h
+ * @brief Layout of the static data container, see src/common/container.c
+ *
+ * All static dictionary data lives in one file, STATIC_DATA_FILE:\code
+ *	offset 0	char magic[ 8 ];	"CHEWDATA"
+ *	offset 8	uint32 version;		CONTAINER_VERSION
+ *	offset 12	uint32 nSection;
+ *	offset 16	{ uint32 id, offset, size, checksum; } section[ nSection ];
+ *	...		section payloads, each at a multiple of CONTAINER_ALIGN
+ *\endcode
+ * Header fields are little-endian. The checksum is the CRC-32 of the
+ * payload.
+ *
+ * Payloads are laid out the same on every platform, so that one file can
+ * be mapped as it is anywhere: integers have explicit widths and are
+ * little-endian, and records have no padding the compiler would choose.
+ * Read them with GetUint16LE() and GetUint32LE(), never directly.
+ */
+
+#ifndef _CHEWING_CONTAINER_PRIVATE_H
+#define _CHEWING_CONTAINER_PRIVATE_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#ifdef HAVE_INTTYPES_H
+#  include <inttypes.h>
+#elif defined HAVE_STDINT_H
+#  include <stdint.h>
+#endif
+
+#include <stddef.h>
+
+#define CONTAINER_MAGIC		"CHEWDATA"
+#define CONTAINER_MAGIC_LEN	8
+#define CONTAINER_VERSION	2
+#define CONTAINER_HEADER_SIZE	16
+#define CONTAINER_ENTRY_SIZE	16
+/* enough for every record type stored in a section */
+#define CONTAINER_ALIGN		16
+
+/** @brief section ids, the file each section replaces is noted */
+enum {
+	SECTION_CHAR,			/* us_freq.dat */
+	SECTION_CHAR_INDEX_BEGIN,	/* ch_index_begin.dat */
+	SECTION_CHAR_INDEX_PHONE,	/* ch_index_phone.dat */
+	SECTION_DICT,			/* dict.dat */
+	SECTION_PH_INDEX,		/* ph_index.dat */
+	SECTION_PHONE_TREE,		/* fonetree.dat */
+	SECTION_CHAR_INDEX_DIRECT,	/* ch_index_direct.dat */
+	SECTION_DICT_RECORD,		/* dict_record.dat */
+	SECTION_DICT_COMPRESSED,	/* dict_compressed.dat */
+	SECTION_DICT_CHARS,		/* dict_chars.dat */
+	SECTION_SYMBOL_TABLE,		/* symbol_table.dat */
+	SECTION_EASY_SYMBOL,		/* easy_symbol.dat */
+	SECTION_PINYIN,			/* pinyin_table.dat */
+	SECTION_NUM
+};
+
+static inline uint16_t GetUint16LE( const void *p )
+{
+	const unsigned char *b = p;
+
+	return (uint16_t) ( b[ 0 ] | b[ 1 ] << 8 );
+}
+
+static inline uint32_t GetUint32LE( const void *p )
+{
+	const unsigned char *b = p;
+
+	return (uint32_t) b[ 0 ] | (uint32_t) b[ 1 ] << 8 |
+		(uint32_t) b[ 2 ] << 16 | (uint32_t) b[ 3 ] << 24;
+}
+
+static inline void PutUint16LE( void *p, uint16_t value )
+{
+	unsigned char *b = p;
+
+	b[ 0 ] = value & 0xff;
+	b[ 1 ] = ( value >> 8 ) & 0xff;
+}
+
+static inline void PutUint32LE( void *p, uint32_t value )
+{
+	unsigned char *b = p;
+
+	b[ 0 ] = value & 0xff;
+	b[ 1 ] = ( value >> 8 ) & 0xff;
+	b[ 2 ] = ( value >> 16 ) & 0xff;
+	b[ 3 ] = ( value >> 24 ) & 0xff;
+}
+
+uint32_t ContainerChecksum( const void *data, size_t size );
+
+/**
+ * @brief check the header and the section table of a container
+ *
+ * @return 0 if every section lies aligned within size, -1 otherwise
+ */
+int ContainerCheck( const void *base, size_t size );
+
+/**
+ * @brief find a section of a container accepted by ContainerCheck()
+ *
+ * @return the payload, or NULL if the container has no such section
+ */
+const void *ContainerGetSection( const void *base, uint32_t id, size_t *section_size );
+
+/**
+ * @brief ContainerCheck(), plus the checksum of every section
+ *
+ * Reads the whole file, meant for deploy time rather than for startup.
+ */
+int ContainerVerify( const void *base, size_t size );
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * datafile-private.h
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+#ifndef _CHEWING_DATAFILE_PRIVATE_H
+#define _CHEWING_DATAFILE_PRIVATE_H
+
+#include "chewing-private.h"
+#include "container-private.h"
+
+#ifdef USE_EMBEDDED_DATA
+/* STATIC_DATA_FILE as built, see src/tools/embeddata.c */
+extern const unsigned char embedded_data[];
+extern const size_t embedded_data_size;
+#endif
+
+#ifdef USE_BINARY_DATA
+/* with USE_EMBEDDED_DATA, prefix is ignored and embedded_data is taken */
+int InitDataFile( ChewingData *pgdata, const char *prefix );
+void TerminateDataFile( ChewingData *pgdata );
+/* the container at data, of the caller and read in place */
+int InitDataBuffer( ChewingData *pgdata, const void *data, size_t size );
+/* a read-only view of section id, NULL if there is no such section */
+void *GetDataSection( ChewingData *pgdata, uint32_t id, size_t *size );
+/* FLAG_ADVICE_* of plat_mmap.h for a section */
+void AdviseDataSection( ChewingData *pgdata, const void *section, size_t size, int advice );
+#endif
+
+#endif
@@ -19,8 +19,63 @@
 
 #define PHONE_PHRASE_NUM (162244)
 
+#ifdef USE_BINARY_DATA
+/**
+ * @brief a phrase of DICT_RECORD_FILE
+ *
+ * sort_dic writes one record for each phrase, in the order of phrase ids.
+ * PH_INDEX_FILE holds the first record of each phrase id as int32, and
+ * DICT_FILE holds the phrases, not terminated. Integers are little-endian.
+ */
+typedef struct tag_DictRecord {
+	int32_t freq;
+	uint32_t pos;		/* offset of the phrase in DICT_FILE */
+	uint8_t nChar;		/* characters of the phrase */
+	uint8_t size;		/* bytes of the phrase */
+	uint16_t reserved;
+} DictRecord;
+
+/*
+ * The compressed dictionary, "sort_dic -c", replaces DICT_FILE and
+ * DICT_RECORD_FILE. PH_INDEX_FILE then holds the offset of each phrase id
+ * in DICT_COMPRESSED_FILE, where every phrase is:
+ *
+ *	a byte, the characters shared with the previous phrase of the
+ *	  phrase id in the high 4 bits, the characters that follow in the
+ *	  low 4 bits
+ *	the frequency, 7 bits per byte from the lowest, the high bit set on
+ *	  all bytes but the last
+ *	the codes of the following characters, one byte below 0x80, else
+ *	  0x80 + ( ( b0 & 0x7f ) << 8 | b1 )
+ *
+ * DICT_CHARS_FILE holds the UTF-8 of each code in DICT_CHAR_SIZE bytes,
+ * padded with '\0'. The most used characters get the shortest codes.
+ */
+#define DICT_CHAR_SIZE 4
+#define DICT_CHAR_CODE_NUM ( 0x80 + 0x8000 )
+#endif
+
+/**
+ * @brief a phrase of the dictionary, left where it is stored if possible
+ *
+ * phrase is not terminated. It points into DICT_FILE when the dictionary
+ * is plain, else into the cursor of the context, until the next call.
+ */
+typedef struct {
+	const char *phrase;
+	int len;		/* bytes of phrase */
+	int freq;
+} PhraseView;
+
+/* GetPhraseFirst() and GetPhraseNext() return the bytes of the phrase, 0 at the end */
 int GetPhraseFirst( ChewingData *pgdata, Phrase *phr_ptr, int phone_phr_id );
 int GetPhraseNext ( ChewingData *pgdata, Phrase *phr_ptr );
+/* the same without copying the phrase, they share the cursor */
+int GetPhraseViewFirst( ChewingData *pgdata, PhraseView *view, int phone_phr_id );
+int GetPhraseViewNext( ChewingData *pgdata, PhraseView *view );
+int GetPhraseMaxFreq( ChewingData *pgdata, int phone_phr_id );
+int GetPhraseCount( ChewingData *pgdata, int phone_phr_id );
+int GetPhraseNth( ChewingData *pgdata, Phrase *phr_ptr, int phone_phr_id, int n );
 int InitDict( ChewingData *pgdata, const char * prefix );
 void TerminateDict( ChewingData *pgdata );
 
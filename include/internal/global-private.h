@@ -16,13 +16,24 @@
 #define PHONE_TREE_FILE		"fonetree.dat"
 #define DICT_FILE		"dict.dat"
 #define PH_INDEX_FILE		"ph_index.dat"
+#define DICT_RECORD_FILE	"dict_record.dat"
+#define DICT_COMPRESSED_FILE	"dict_compressed.dat"
+#define DICT_CHARS_FILE		"dict_chars.dat"
 #define CHAR_FILE		"us_freq.dat"
 #define CHAR_INDEX_FILE		"ch_index.dat"
 #define CHAR_INDEX_BEGIN_FILE	"ch_index_begin.dat"
 #define CHAR_INDEX_PHONE_FILE	"ch_index_phone.dat"
+#define CHAR_INDEX_DIRECT_FILE	"ch_index_direct.dat"
+#define SYMBOL_TABLE_BIN_FILE	"symbol_table.dat"
+#define EASY_SYMBOL_BIN_FILE	"easy_symbol.dat"
+#define PINYIN_BIN_FILE		"pinyin_table.dat"
+/* the files above packed by packdata, see container-private.h */
+#define STATIC_DATA_FILE	"chewing.dat"
 #define SYMBOL_TABLE_FILE	"symbols.dat"
 #define SOFTKBD_TABLE_FILE	"swkb.dat"
 #define CHEWING_DEFINITION_FILE "chewing-definition.h"
 #define PINYIN_TAB_NAME         "pinyin.tab"
+/* changes to tsi.src written by dictdiff, see overlay-private.h */
+#define DICT_OVERLAY_FILE	"dict_overlay.src"
 
 #endif
@@ -22,13 +22,23 @@
   Eg: Zhang -> {"zh","5"}, {"ang",";"}
  */
 struct keymap {
-	char pinyin[7];
+	char pinyin[8];	/* 6 letters and '\0', padded to 4 bytes */
 	char zuin[4];
 };
 typedef struct keymap keymap;
 
+/*
+ * maketables compiles PINYIN_TAB_NAME into PINYIN_BIN_FILE:
+ *
+ *	int32 nInitials, nFinals;
+ *	keymap initials[ nInitials ], finals[ nFinals ];
+ *
+ * Each array ends with an empty keymap, as the text table gets at load.
+ */
+
 int HanyuPinYinToZuin( ChewingData *pgdata, char *pinyinKeySeq, char *zuinKeySeq );
 int InitHanyuPinYin( ChewingData *pgdata, const char * );
 void TerminateHanyuPinyin( ChewingData *pgdata );
+size_t HanyuPinYinBytes( ChewingData *pgdata );
 
 #endif
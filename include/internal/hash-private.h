@@ -24,20 +24,137 @@
 #define BIN_HASH_SIG "CBiH"
 #define HASH_FILE  "uhash.dat"
 
+/*
+ * HashModify() appends every change to a journal, HASH_FILE followed by
+ * HASH_JOURNAL_SUFFIX and a slot number, and writes HASH_FILE itself once
+ * HASH_DIRTY_MAX phrases are dirty, HASH_FLUSH_INTERVAL seconds after the
+ * first of them, or on HashFlush(). An entry of the journal is:
+ *
+ *	int32 lifetime, item_index;	-1 for a phrase not in HASH_FILE yet
+ *	char record[ FIELD_SIZE ];	as in HASH_FILE
+ *
+ * all little-endian.
+ *
+ * Several processes may share HASH_FILE. Each context holds an exclusive
+ * lock on the journal of its slot, out of HASH_JOURNAL_SLOTS. InitHash()
+ * writes the entries of the journals nobody holds, left by a crash, into
+ * HASH_FILE before reading it. HASH_FILE is locked exclusively to be
+ * written and shared to be read. A new phrase gets its record index only
+ * when it is written, after the records other processes appended, which
+ * are taken into the table then and by HashSync(). Records others changed
+ * in place are seen from the next InitHash() on.
+ *
+ * HashModifyDeferred() only lists a change, made in memory already, for
+ * HashWritePending() to give to HashModify() later, off the path of the
+ * key that learned it.
+ *
+ * HashCompact() writes the records in use to HASH_FILE followed by
+ * HASH_COMPACT_SUFFIX, renames it over HASH_FILE and overwrites the
+ * signature of the old file, still open elsewhere, with STALE_HASH_SIG.
+ * Whoever finds that signature opens HASH_FILE again, and looks for its
+ * phrases there anew.
+ *
+ * The phrases are held by a HASH_STORE, of one context or, after
+ * HashShare(), of every context in the process that shares the same
+ * HASH_FILE; to the file they are one context. Changes are made with the
+ * lock of the store held, see HashLock(). Lookups take no lock: the table
+ * is replaced as a whole when it grows, and readers find it between
+ * HashReadBegin() and HashReadEnd(). A replaced table is freed once every
+ * reader that may have found it has ended, counted by the epoch of the
+ * store. Items are never freed before the store, and their frequencies
+ * are single words changed in place.
+ */
+#define HASH_JOURNAL_SUFFIX ".journal"
+#define HASH_JOURNAL_SLOTS (8)
+#define HASH_JOURNAL_ENTRY_SIZE ( 8 + FIELD_SIZE )
+#define HASH_FLUSH_INTERVAL (5)
+#define HASH_COMPACT_SUFFIX ".compact"
+#define STALE_HASH_SIG "CBiS"
+
 typedef struct tag_HASH_ITEM {
 	int item_index;
-	UserPhraseData data;
-	struct tag_HASH_ITEM *next;
+	int dirty;	/* in hash_dirty of the store */
+	int pending;	/* in hash_pending of the store */
+	unsigned int hash;	/* of data.phoneSeq */
+	UserPhraseData data;	/* its sequences point into the item */
+	uint16_t phoneSeq[ MAX_PHRASE_LEN + 1 ];
+	char wordSeq[ MAX_PHRASE_LEN * MAX_UTF8_SIZE + 1 ];
 } HASH_ITEM;
 
+/** @brief open addressing with linear probing, see hash.c */
+typedef struct tag_HASH_TABLE {
+	HASH_ITEM **slot;
+	unsigned int nSlot;	/* a power of 2 */
+	/* a Bloom filter of the hashes in the table, nSlot / 8 words */
+	uint64_t *filter;
+	int nFilterShift;	/* 32 minus the bits of a word index */
+	/* once replaced, the epoch of the store then */
+	unsigned int retiredEpoch;
+	struct tag_HASH_TABLE *nextRetired;
+} HASH_TABLE;
+
+/** @brief the user phrases of HASH_FILE, held by one context or more */
+typedef struct tag_HASH_STORE {
+	char hashfilename[ 200 ];
+	/* contexts holding the store, and the next shared one, under a lock */
+	int refcount;
+	int bShared;
+	struct tag_HASH_STORE *next;
+
+	plat_mutex lock;	/* see HashLock() */
+	HASH_TABLE *table;	/* read without the lock */
+	unsigned int nHashItem;
+	/* the items read from hashfilename, one array, and those learned since */
+	HASH_ITEM *hash_pool;
+	unsigned int nHashPool;	/* items hash_pool has room for */
+	Arena hashArena;
+
+	/* the contexts between HashReadBegin() and HashReadEnd() may be */
+	HashReader *readers;
+	unsigned int epoch;
+	HASH_TABLE *retired;	/* replaced tables not freed yet */
+
+	int chewing_lifetime;
+	/* user phrases changed since the last HashFlush() */
+	FILE *hashfile;
+	FILE *journal;
+	HASH_ITEM *hash_dirty[ HASH_DIRTY_MAX ];
+	int nHashDirty;
+	int nHashUnlisted;	/* dirty items not in hash_dirty */
+	/* changed in memory, not journaled yet, see HashModifyDeferred() */
+	HASH_ITEM *hash_pending[ HASH_DIRTY_MAX ];
+	int nHashPending;
+	time_t hash_dirty_since;
+	int nHashRecord;	/* records of hashfilename, flushed or not */
+	/* bumped whenever a user phrase is added or changed, see HashGeneration() */
+	unsigned int hash_generation;
+} HASH_STORE;
+
 HASH_ITEM *HashFindPhone( const uint16_t phoneSeq[] );
 HASH_ITEM *HashFindEntry( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[] );
 HASH_ITEM *HashInsert( ChewingData *pgdata, UserPhraseData *pData );
-HASH_ITEM *HashFindPhonePhrase( ChewingData *pgdata, const uint16_t phoneSeq[], HASH_ITEM *pHashLast );
+HASH_ITEM *HashFindPhonePhrase( ChewingData *pgdata, const uint16_t phoneSeq[], HashCursor *cursor );
+HASH_ITEM *HashFindNextPhrase( ChewingData *pgdata, const uint16_t phoneSeq[], HashCursor *cursor );
+void HashReadBegin( ChewingData *pgdata );
+void HashReadEnd( ChewingData *pgdata );
+void HashLock( ChewingData *pgdata );
+void HashUnlock( ChewingData *pgdata );
+unsigned int HashGeneration( ChewingData *pgdata );
+void HashChanged( ChewingData *pgdata );
+void HashTick( ChewingData *pgdata );
 void HashModify( ChewingData *pgdata, HASH_ITEM *pItem );
-int AlcUserPhraseSeq( UserPhraseData *pData, int phonelen, int wordlen );
+void HashModifyBulk( ChewingData *pgdata, HASH_ITEM *pItem );
+void HashModifyDeferred( ChewingData *pgdata, HASH_ITEM *pItem );
+int HashWritePending( ChewingData *pgdata );
+int HashFlush( ChewingData *pgdata );
+int HashSync( ChewingData *pgdata );
+int HashCompact( ChewingData *pgdata, int evict );
 int InitHash( ChewingData *ctx );
+int HashClone( ChewingData *pgdata, ChewingData *from );
+int HashShare( ChewingData *pgdata, int bShare );
+int HashShared( ChewingData *pgdata );
 void TerminateHash( ChewingData *pgdata );
+size_t HashBytes( ChewingData *pgdata );
 void FreeHashTable( void );
 
 #endif
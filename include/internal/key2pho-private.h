@@ -21,9 +21,13 @@
 #  include <stdint.h>
 #endif
 
+struct tag_KeyTable;
+
 uint16_t UintFromPhone( const char *phone );
 uint16_t UintFromPhoneInx( const int ph_inx[] );
+int ComponentCountFromUint( uint16_t phone );
 int PhoneFromKey( char *pho, const char *inputkey, int kbtype, int searchTimes );
 int PhoneInxFromKey( int key, int type, int kbtype, int searchTimes );
+int InitKeyTable( struct tag_KeyTable *table, int kbtype );
 
 #endif
@@ -0,0 +1,62 @@
+/**
+ * overlay-private.h
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+#ifndef _CHEWING_OVERLAY_PRIVATE_H
+#define _CHEWING_OVERLAY_PRIVATE_H
+
+#include "chewing-private.h"
+
+/*
+ * DICT_OVERLAY_FILE changes the phrases of tsi.src without rebuilding the
+ * dictionary. dictdiff writes it from two versions of tsi.src, one line
+ * for each phrase:
+ *
+ *	+ phrase freq zuin1 zuin2 ...	add the phrase, or set its frequency
+ *	- phrase zuin1 zuin2 ...	remove the phrase
+ *
+ * '#' starts a comment. When the context starts, the phrases of every
+ * phone sequence it names are taken from the dictionary, changed and
+ * sorted again by decreasing frequency. The sequence then has a phrase id
+ * of its own, OVERLAY_PHRASE_ID(), which the phone tree cursor returns in
+ * place of the one of the dictionary, see TreeCursorPhraseId(); a sequence
+ * the tree does not have is found all the same.
+ */
+
+/* above every phrase id of the dictionary */
+#define OVERLAY_PHRASE_ID( index )	( PHONE_PHRASE_NUM + ( index ) )
+#define IS_OVERLAY_PHRASE_ID( id )	( ( id ) >= PHONE_PHRASE_NUM )
+
+/** @brief a phone sequence of DICT_OVERLAY_FILE and its phrases */
+typedef struct tag_OverlayEntry {
+	uint16_t phoneSeq[ MAX_PHRASE_LEN ];
+	int len;
+	int begin;	/* its phrases are DictOverlay.phrase[ begin ] to [ end - 1 ] */
+	int end;
+} OverlayEntry;
+
+/** @brief the sequences, in the order of their phones, shorter first */
+typedef struct tag_DictOverlay {
+	OverlayEntry *entry;
+	int nEntry;
+	Phrase *phrase;
+	int nPhrase;
+} DictOverlay;
+
+/* the overlay in prefix, after InitTree() and InitDict() */
+int InitOverlay( ChewingData *pgdata, const char *prefix );
+void TerminateOverlay( ChewingData *pgdata );
+size_t OverlayBytes( ChewingData *pgdata );
+
+/* narrow [ *pLow, *pHigh ) to the sequences with phone at depth */
+void OverlayAdvance( ChewingData *pgdata, int *pLow, int *pHigh, int depth, uint16_t phone );
+/* the entry of [ low, high ) that is depth phones long, NULL if none */
+const OverlayEntry *OverlayExact( ChewingData *pgdata, int low, int high, int depth );
+
+#endif
@@ -14,15 +14,48 @@
 #define IS_USER_PHRASE 1
 #define IS_DICT_PHRASE 0
 
+/**
+ * @brief Position in the phone tree, advanced one phone at a time.
+ *
+ * A cursor lets a caller extend a span phone by phone instead of walking
+ * the tree from the root for every span. It narrows the sequences of the
+ * overlay along, see overlay-private.h.
+ */
+typedef struct {
+	int node;	/* current tree node, -1 once the prefix has no match */
+	int depth;	/* phones advanced over */
+	int overlayLow;	/* the overlay entries with the prefix, an empty range if none */
+	int overlayHigh;
+} TreeCursor;
+
+/**
+ * @brief What the dictionary and the user hash hold for a span of phones.
+ */
+typedef struct {
+	int pho_id;	/* phrase id in the phone tree, -1 if none */
+	Phrase dictPhrase;	/* first candidate of pho_id, set if pho_id != -1 */
+	int bUserPhrase;	/* the user hash has a phrase for the span */
+} SpanInfo;
+
 int InitTree( ChewingData *pgdata, const char *prefix );
 void TerminateTree( ChewingData *pgdata );
+void TerminatePhrasing( ChewingData *pgdata );
+size_t PhrasingBytes( ChewingData *pgdata );
 
 int Phrasing( ChewingData *pgdata, PhrasingOutput *ppo, uint16_t phoneSeq[], int nPhoneSeq,
-		char selectStr[][ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ], 
+		char selectStr[][ MAX_SELECT_STR_SIZE ], 
 		IntervalType selectInterval[], int nSelect, 
 		int bArrBrkpt[], int bUserArrCnnct[] );
 int IsIntersect( IntervalType in1, IntervalType in2 );
 
 int TreeFindPhrase( ChewingData *pgdata, int begin, int end, const uint16_t *phoneSeq );
 
+void TreeCursorInit( ChewingData *pgdata, TreeCursor *pcur );
+int TreeCursorAdvance( ChewingData *pgdata, TreeCursor *pcur, uint16_t phone );
+int TreeCursorPhraseId( ChewingData *pgdata, const TreeCursor *pcur );
+
+int FindSpanInfo( ChewingData *pgdata, const uint16_t phoneSeq[], int len, SpanInfo *pinfo );
+void AddSpanInfo( ChewingData *pgdata, const uint16_t phoneSeq[], int len, int pho_id, SpanInfo *pinfo );
+void GetSpanInfo( ChewingData *pgdata, const uint16_t phoneSeq[], int len, SpanInfo *pinfo );
+
 #endif
@@ -33,6 +33,18 @@ typedef struct tag_UserPhraseData {
 	int maxfreq;	/* the maximum frequency of the phrase of the same pid */
 } UserPhraseData ;
 
+/**
+ * @brief Cursor of UserGetPhraseFirst() and UserGetPhraseNext()
+ *
+ * Owned by the caller, so that lookups may nest and contexts do not
+ * share anything. The caller iterates between HashReadBegin() and
+ * HashReadEnd(), or with HashLock() held.
+ */
+typedef struct {
+	HashCursor cursor;
+	const uint16_t *phoneSeq;
+} UserPhraseIter;
+
 /**
  * @brief Update or add a new UserPhrase.
  *
@@ -46,22 +58,50 @@ typedef struct tag_UserPhraseData {
  */
 int UserUpdatePhrase( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[] );
 
+/**
+ * @brief Add or set a user phrase, as one of many.
+ *
+ * The change goes to the next HashFlush(), which the caller runs once all
+ * of them are in; nothing is written per phrase.
+ *
+ * @param phoneSeq[] Phone sequence, terminated by 0
+ * @param wordSeq[] Phrase against the phone sequence, one character a phone
+ * @param freq The user frequency, or 0 to start from the dictionary like a
+ * learned phrase and to leave a phrase that exists alone.
+ *
+ * @return
+ * @retval USER_UPDATE_FAIL The phrase is invalid, or out of memory.
+ * @retval USER_UPDATE_INSERT Sequence is new, add new entry.
+ * @retval USER_UPDATE_MODIFY Sequence is existing, its frequency is set.
+ * @retval USER_UPDATE_IGNORE Sequence is existing, and freq is 0.
+ */
+int UserImportPhrase( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[], int freq );
+
+/**
+ * @brief Whether a user phrase no longer says more than the dictionary.
+ *
+ * @return 1 if pData is a phrase of the dictionary and its frequency has
+ * fallen back to the one it started from, 0 otherwise.
+ */
+int UserPhraseDecayed( ChewingData *pgdata, const UserPhraseData *pData );
+
 /**
  * @brief Read the first phrase of the phone in user phrase database.
  *
- * @param phoneSeq[] Phone sequence
+ * @param iter Cursor to start
+ * @param phoneSeq[] Phone sequence, which has to outlive iter
  * 
  * @return UserPhraseData, if it's not existing then return NULL.
  */
-UserPhraseData *UserGetPhraseFirst( ChewingData *pgdata, const uint16_t phoneSeq[] );
+UserPhraseData *UserGetPhraseFirst( ChewingData *pgdata, UserPhraseIter *iter, const uint16_t phoneSeq[] );
 
 /**
  * @brief Read the next phrase of the phone in user phrase database.
  * 
- * @param phoneSeq[] Phone sequence
+ * @param iter Cursor of UserGetPhraseFirst()
  *
  * @return UserPhraseData, if it's not existing then return NULL.
  */
-UserPhraseData *UserGetPhraseNext( ChewingData *pgdata, const uint16_t phoneSeq[] );
+UserPhraseData *UserGetPhraseNext( ChewingData *pgdata, UserPhraseIter *iter );
 
 #endif
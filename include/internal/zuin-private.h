@@ -36,6 +36,7 @@ enum {
 	KB_TYPE_NUM
 };
 
+int InitZuin( ChewingData *pgdata );
 int ZuinPhoInput( ChewingData *, ZuinData *,int key );  /* assume `key' is "ascii" code. */
 int ZuinRemoveLast( ZuinData * );
 int ZuinRemoveAll( ZuinData * );
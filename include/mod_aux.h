@@ -33,12 +33,28 @@ CHEWING_API int chewing_commit_Check( ChewingContext *ctx );
  */
 CHEWING_API char *chewing_commit_String( ChewingContext *ctx );
 
+/**
+ * @brief Copy current commit string into a caller buffer
+ * @param ctx handle to Chewing IM context
+ * @param buf buffer to receive the string, may be NULL if size is 0
+ * @param size size of buf in bytes
+ *
+ * The string is truncated at a character boundary if it does not fit, and
+ * buf is always NUL-terminated when size > 0. Returns the length of the
+ * whole string in bytes, so a return value >= size means truncation. The
+ * other *_String_copy functions behave the same.
+ */
+CHEWING_API int chewing_commit_String_copy( ChewingContext *ctx,
+	char *buf, int size );
+
 
 /*! \name Preedit string buffer
  */
 
 /*@{*/
 CHEWING_API char *chewing_buffer_String( ChewingContext *ctx );
+CHEWING_API int chewing_buffer_String_copy( ChewingContext *ctx,
+	char *buf, int size );
 CHEWING_API int chewing_buffer_Check( ChewingContext *ctx );
 CHEWING_API int chewing_buffer_Len( ChewingContext *ctx );
 /*@}*/
@@ -52,6 +68,8 @@ CHEWING_API int chewing_buffer_Len( ChewingContext *ctx );
  * Always returns a C-style string (char pointer), caller must free it.
  */
 CHEWING_API char *chewing_zuin_String( ChewingContext *ctx, int *zuin_count );
+CHEWING_API int chewing_zuin_String_copy( ChewingContext *ctx,
+	char *buf, int size );
 
 CHEWING_API int chewing_zuin_Check( ChewingContext *ctx );
 /*@}*/
@@ -67,6 +85,12 @@ CHEWING_API int chewing_cand_CurrentPage( ChewingContext *ctx );
 CHEWING_API void chewing_cand_Enumerate( ChewingContext *ctx );
 CHEWING_API int chewing_cand_hasNext( ChewingContext *ctx );
 CHEWING_API char *chewing_cand_String( ChewingContext *ctx );
+/**
+ * Moves to the next candidate only if the current one fits in buf;
+ * otherwise buf has it truncated, as by the other *_String_copy functions.
+ */
+CHEWING_API int chewing_cand_String_copy( ChewingContext *ctx,
+	char *buf, int size );
 /*@}*/
 
 
@@ -80,6 +104,8 @@ CHEWING_API void chewing_interval_Get( ChewingContext *ctx, IntervalType *it );
 CHEWING_API int chewing_aux_Check( ChewingContext *ctx );
 CHEWING_API int chewing_aux_Length( ChewingContext *ctx );
 CHEWING_API char *chewing_aux_String( ChewingContext *ctx );
+CHEWING_API int chewing_aux_String_copy( ChewingContext *ctx,
+	char *buf, int size );
 /*@}*/
 
 
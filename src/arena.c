@@ -0,0 +1,125 @@
+/**
+ * arena.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file arena.c
+ * @brief Bump allocator for short-lived temporaries.
+ *
+ * Memory from an arena is never freed piecemeal.  ResetArena() drops
+ * everything at once and keeps the memory for the next round, so a
+ * round of the same size as the one before does not touch the heap.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chewing-private.h"
+#include "arena-private.h"
+#include "private.h"
+
+/* default block size, large enough for a typical Phrasing call */
+#define ARENA_BLOCK_SIZE ( 64 * 1024 )
+/* do not keep more than this between rounds */
+#define ARENA_RETAIN_LIMIT ( 1024 * 1024 )
+#define ARENA_ALIGN ( 2 * sizeof( void * ) )
+
+struct tag_ArenaBlock {
+	struct tag_ArenaBlock *next;
+	size_t size, used;
+};
+
+/* keep the payload of a block aligned */
+#define ARENA_HEADER_SIZE \
+	( ( sizeof( struct tag_ArenaBlock ) + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 ) )
+
+static struct tag_ArenaBlock *NewArenaBlock( size_t size )
+{
+	struct tag_ArenaBlock *block = malloc( ARENA_HEADER_SIZE + size );
+
+	if ( block ) {
+		block->next = NULL;
+		block->size = size;
+		block->used = 0;
+	}
+	return block;
+}
+
+static void FreeArenaBlocks( Arena *pa )
+{
+	struct tag_ArenaBlock *block;
+
+	while ( pa->block ) {
+		block = pa->block;
+		pa->block = block->next;
+		free( block );
+	}
+	pa->total = 0;
+}
+
+/**
+ * @brief Allocate zero-filled memory from the arena.
+ *
+ * @return NULL if out of memory.
+ */
+void *ArenaAlloc( Arena *pa, size_t size )
+{
+	struct tag_ArenaBlock *block = pa->block;
+	void *ptr;
+
+	size = ( size + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 );
+	if ( ! block || block->size - block->used < size ) {
+		block = NewArenaBlock( size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE );
+		if ( ! block )
+			return NULL;
+		block->next = pa->block;
+		pa->block = block;
+		pa->total += block->size;
+		pa->nBlockAlloc++;
+	}
+	pa->nAlloc++;
+	ptr = (char *) block + ARENA_HEADER_SIZE + block->used;
+	block->used += size;
+	memset( ptr, 0, size );
+	return ptr;
+}
+
+/**
+ * @brief Release everything allocated from the arena.
+ *
+ * When the last round needed several blocks, they are replaced by a single
+ * block of the same total size.  Nothing is kept once the arena has grown
+ * beyond ARENA_RETAIN_LIMIT.
+ */
+void ResetArena( Arena *pa )
+{
+	size_t total = pa->total;
+
+	pa->nAlloc = 0;
+	pa->nBlockAlloc = 0;
+	if ( ! pa->block )
+		return;
+	if ( total > ARENA_RETAIN_LIMIT ) {
+		FreeArenaBlocks( pa );
+		return;
+	}
+	if ( ! pa->block->next ) {
+		pa->block->used = 0;
+		return;
+	}
+	FreeArenaBlocks( pa );
+	pa->block = NewArenaBlock( total );
+	if ( pa->block )
+		pa->total = total;
+}
+
+void TerminateArena( Arena *pa )
+{
+	FreeArenaBlocks( pa );
+}
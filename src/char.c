@@ -25,7 +25,7 @@
 #include "chewing-definition.h"
 #include "char-private.h"
 #include "private.h"
-#include "plat_mmap.h"
+#include "datafile-private.h"
 
 #if ! defined(USE_BINARY_DATA)
 static char *fgettab( char *buf, int maxlen, FILE *fp )
@@ -46,91 +46,71 @@ static char *fgettab( char *buf, int maxlen, FILE *fp )
 }
 #endif
 
+/* offset in CHAR_FILE of the characters of arrPhone[ i ] */
+static int CharBegin( ChewingData *pgdata, int i )
+{
+#ifdef USE_BINARY_DATA
+	return (int32_t) GetUint32LE( &pgdata->static_data->char_begin[ i ] );
+#else
+	return pgdata->static_data->char_begin[ i ];
+#endif
+}
+
+#if ! defined(USE_BINARY_DATA)
 static int CompUint16( const uint16_t *pa, const uint16_t *pb )
 {
 	return ( (*pa) - (*pb) );
 }
+#endif
 
 void TerminateChar( ChewingData *pgdata )
 {
 #ifdef USE_BINARY_DATA
-	pgdata->static_data.arrPhone = NULL;
-	plat_mmap_close( &pgdata->static_data.char_phone_mmap );
-
-	pgdata->static_data.char_begin = NULL;
-	plat_mmap_close( &pgdata->static_data.char_begin_mmap );
-
-	pgdata->static_data.char_ = NULL;
-	plat_mmap_close( &pgdata->static_data.char_mmap );
-
-	pgdata->static_data.phone_num = 0;
+	/* views of STATIC_DATA_FILE, unmapped by TerminateDataFile() */
+	pgdata->static_data->arrPhone = NULL;
+	pgdata->static_data->char_index = NULL;
+	pgdata->static_data->char_begin = NULL;
+	pgdata->static_data->char_ = NULL;
+	pgdata->static_data->phone_num = 0;
 #else
-	if ( pgdata->static_data.charfile )
-		fclose( pgdata->static_data.charfile );
-	free( pgdata->static_data.char_begin );
-	free( pgdata->static_data.arrPhone );
-	pgdata->static_data.phone_num = 0;
+	if ( pgdata->static_data->charfile )
+		fclose( pgdata->static_data->charfile );
+	free( pgdata->static_data->char_begin );
+	free( pgdata->static_data->arrPhone );
+	pgdata->static_data->phone_num = 0;
 #endif
 }
 
-int InitChar( ChewingData *pgdata , const char * prefix )
+int InitChar( ChewingData *pgdata , const char *prefix UNUSED )
 {
 #ifdef USE_BINARY_DATA
-	char filename[ PATH_MAX ];
-	size_t len;
-	size_t offset;
-	size_t file_size;
-	size_t csize;
+	size_t size;
 
-	len = snprintf( filename, sizeof( filename ), "%s" PLAT_SEPARATOR "%s", prefix, CHAR_FILE );
-	if ( len + 1 > sizeof( filename ) )
+	/* every key stroke reads these small tables, have them read in now */
+	pgdata->static_data->char_ = GetDataSection( pgdata, SECTION_CHAR, &size );
+	if ( !pgdata->static_data->char_ )
 		return -1;
+	AdviseDataSection( pgdata, pgdata->static_data->char_, size, FLAG_ADVICE_WILLNEED );
 
-	plat_mmap_set_invalid( &pgdata->static_data.char_mmap );
-	file_size = plat_mmap_create( &pgdata->static_data.char_mmap, filename, FLAG_ATTRIBUTE_READ );
-	if ( file_size <= 0 )
+	pgdata->static_data->char_begin = GetDataSection( pgdata, SECTION_CHAR_INDEX_BEGIN, &size );
+	if ( !pgdata->static_data->char_begin )
 		return -1;
+	pgdata->static_data->phone_num = size / sizeof( int32_t );
+	AdviseDataSection( pgdata, pgdata->static_data->char_begin, size, FLAG_ADVICE_WILLNEED );
 
-	csize = file_size;
-	offset = 0;
-	pgdata->static_data.char_ = plat_mmap_set_view( &pgdata->static_data.char_mmap, &offset, &csize );
-	if ( !pgdata->static_data.char_ )
+	pgdata->static_data->arrPhone = GetDataSection( pgdata, SECTION_CHAR_INDEX_PHONE, &size );
+	if ( !pgdata->static_data->arrPhone )
 		return -1;
-
-	len = snprintf( filename, sizeof( filename ), "%s" PLAT_SEPARATOR "%s", prefix, CHAR_INDEX_BEGIN_FILE );
-	if ( len + 1 > sizeof( filename ) )
+	if ( pgdata->static_data->phone_num != size / sizeof( uint16_t ) )
 		return -1;
+	AdviseDataSection( pgdata, pgdata->static_data->arrPhone, size, FLAG_ADVICE_WILLNEED );
 
-	plat_mmap_set_invalid( &pgdata->static_data.char_begin_mmap );
-	file_size = plat_mmap_create( &pgdata->static_data.char_begin_mmap, filename, FLAG_ATTRIBUTE_READ );
-	if ( file_size <= 0 )
+	pgdata->static_data->char_index = GetDataSection( pgdata, SECTION_CHAR_INDEX_DIRECT, &size );
+	if ( !pgdata->static_data->char_index )
 		return -1;
-
-	pgdata->static_data.phone_num = file_size / sizeof( int );
-
-	offset = 0;
-	csize = file_size;
-	pgdata->static_data.char_begin = plat_mmap_set_view( &pgdata->static_data.char_begin_mmap, &offset, &csize );
-	if ( !pgdata->static_data.char_begin )
-		return -1;
-
-	len = snprintf( filename, sizeof( filename ), "%s" PLAT_SEPARATOR "%s", prefix, CHAR_INDEX_PHONE_FILE );
-	if ( len + 1 > sizeof( filename ) )
-		return -1;
-
-	plat_mmap_set_invalid( &pgdata->static_data.char_phone_mmap );
-	file_size = plat_mmap_create( &pgdata->static_data.char_phone_mmap, filename, FLAG_ATTRIBUTE_READ );
-	if ( file_size <= 0 )
-		return -1;
-
-	if ( pgdata->static_data.phone_num != file_size / sizeof( uint16_t ))
-		return -1;
-
-	offset = 0;
-	csize = file_size;
-	pgdata->static_data.arrPhone = plat_mmap_set_view( &pgdata->static_data.char_phone_mmap, &offset, &csize );
-	if ( !pgdata->static_data.arrPhone )
+	if ( size != ( 1 << 16 ) * sizeof( uint16_t ) )
 		return -1;
+	AdviseDataSection( pgdata, pgdata->static_data->char_index, size, FLAG_ADVICE_WILLNEED );
 
 	return 0;
 #else
@@ -145,7 +125,7 @@ int InitChar( ChewingData *pgdata , const char * prefix )
 	if ( !pgdata->arrPhone )
 	    return -1;
 
-	pgdata->char_begin = ALC( int, pgdata->phone_num );
+	pgdata->char_begin = ALC( int32_t, pgdata->phone_num );
 	if ( !pgdata->char_begin )
 	    return -1;
 
@@ -185,30 +165,39 @@ static void Str2Word( ChewingData *pgdata, Word *wrd_ptr )
 	assert( wrd_ptr->word != '\0' );
 #else
 	unsigned char size;
-	size = *(unsigned char *) pgdata->static_data.char_cur_pos;
-	pgdata->static_data.char_cur_pos = (unsigned char*) pgdata->static_data.char_cur_pos + sizeof(unsigned char);
-	memcpy( wrd_ptr->word, pgdata->static_data.char_cur_pos, size );
-	pgdata->static_data.char_cur_pos = (unsigned char*) pgdata->static_data.char_cur_pos + size;
+	size = *(unsigned char *) pgdata->session.char_cur_pos;
+	pgdata->session.char_cur_pos = (unsigned char*) pgdata->session.char_cur_pos + sizeof(unsigned char);
+	memcpy( wrd_ptr->word, pgdata->session.char_cur_pos, size );
+	pgdata->session.char_cur_pos = (unsigned char*) pgdata->session.char_cur_pos + size;
 	wrd_ptr->word[ size ] = '\0';
 #endif
 }
 
 int GetCharFirst( ChewingData *pgdata, Word *wrd_ptr, uint16_t phoneid )
 {
+	int i;
+
+#ifndef USE_BINARY_DATA
 	uint16_t *pinx;
 
 	pinx = (uint16_t *) bsearch(
-		&phoneid, pgdata->static_data.arrPhone, pgdata->static_data.phone_num,
+		&phoneid, pgdata->arrPhone, pgdata->phone_num,
 		sizeof( uint16_t ), (CompFuncType) CompUint16 );
 	if ( ! pinx )
 		return 0;
 
-#ifndef USE_BINARY_DATA
-	fseek( pgdata->charfile, pgdata->char_begin[ pinx - pgdata->arrPhone ], SEEK_SET );
+	i = pinx - pgdata->arrPhone;
+	fseek( pgdata->charfile, CharBegin( pgdata, i ), SEEK_SET );
 #else
-	pgdata->static_data.char_cur_pos = (unsigned char*)pgdata->static_data.char_ + pgdata->static_data.char_begin[ pinx - pgdata->static_data.arrPhone ];
+	/* phone ids are 16 bits, so the index written by sort_word covers
+	 * every one of them */
+	i = GetUint16LE( &pgdata->static_data->char_index[ phoneid ] ) - 1;
+	if ( i < 0 )
+		return 0;
+
+	pgdata->session.char_cur_pos = (unsigned char*)pgdata->static_data->char_ + CharBegin( pgdata, i );
 #endif
-	pgdata->static_data.char_end_pos = pgdata->static_data.char_begin[ pinx - pgdata->static_data.arrPhone + 1 ];
+	pgdata->session.char_end_pos = CharBegin( pgdata, i + 1 );
 	Str2Word( pgdata, wrd_ptr );
 	return 1;
 }
@@ -219,7 +208,7 @@ int GetCharNext( ChewingData *pgdata, Word *wrd_ptr )
 	if ( ftell( pgdata->charfile ) >= pgdata->char_end_pos )
 		return 0;
 #else
-	if ( (unsigned char*)pgdata->static_data.char_cur_pos >= (unsigned char*)pgdata->static_data.char_ + pgdata->static_data.char_end_pos )
+	if ( (unsigned char*)pgdata->session.char_cur_pos >= (unsigned char*)pgdata->static_data->char_ + pgdata->session.char_end_pos )
 		return 0;
 #endif
 	Str2Word( pgdata, wrd_ptr );
@@ -31,20 +31,26 @@
 #include "choice-private.h"
 #include "dict-private.h"
 #include "char-private.h"
+#include "datafile-private.h"
 #include "hash-private.h"
 #include "tree-private.h"
+#include "overlay-private.h"
 #include "hanyupinyin-private.h"
+#include "key2pho-private.h"
 #include "private.h"
 #include "chewingio.h"
 #include "mod_aux.h"
 #include "global-private.h"
 #include "plat_path.h"
+#include "plat_types.h"
 
 #ifdef ENABLE_DEBUG
 #include <stdio.h>
 #include <assert.h>
 #define FAILSAFE_OUTPUT "/tmp/chewing-debug.out"
 FILE *fp_g = NULL;
+/* chewing_Init() and chewing_Terminate() open and close fp_g once */
+static plat_mutex debug_lock = PLAT_MUTEX_INITIALIZER;
 #endif
 
 char *kb_type_str[] = {
@@ -60,6 +66,12 @@ char *kb_type_str[] = {
 	"KB_HANYU_PINYIN"
 };
 
+#ifdef USE_BINARY_DATA
+const char * const DATA_FILES[] = {
+	STATIC_DATA_FILE,
+	NULL,
+};
+#else
 const char * const CHAR_FILES[] = {
 	CHAR_FILE,
 	CHAR_INDEX_BEGIN_FILE,
@@ -72,7 +84,14 @@ const char * const DICT_FILES[] = {
 	PHONE_TREE_FILE,
 	NULL,
 };
+#endif
+
+const char * const DICT_OVERLAY_FILES[] = {
+	DICT_OVERLAY_FILE,
+	NULL,
+};
 
+#ifndef USE_BINARY_DATA
 const char * const SYMBOL_TABLE_FILES[] = {
 	SYMBOL_TABLE_FILE,
 	NULL,
@@ -87,6 +106,7 @@ const char * const PINYIN_FILES[] = {
 	PINYIN_TAB_NAME,
 	NULL,
 };
+#endif
 
 CHEWING_API int chewing_KBStr2Num( char str[] )
 {
@@ -103,10 +123,13 @@ CHEWING_API int chewing_KBStr2Num( char str[] )
 #ifdef ENABLE_DEBUG     
 static void TerminateDebug()
 {
+	PLAT_MUTEX_LOCK( &debug_lock );
 	DEBUG_OUT( "DEBUG: logging service is about to terminate.\n" );
 	if ( fp_g ) {
 		fclose( fp_g );
+		fp_g = NULL;
 	}
+	PLAT_MUTEX_UNLOCK( &debug_lock );
 }               
 #endif
 
@@ -152,12 +175,231 @@ static ChewingData * allocate_ChewingData()
 	return data;
 }
 
-CHEWING_API ChewingContext *chewing_new()
+/*
+ * The static data in use, one for each search path. The list and the
+ * reference counts are the only state contexts share that changes, and
+ * static_data_lock guards them; the data itself is read-only once loaded.
+ */
+static ChewingStaticData *static_data_list;
+static plat_mutex static_data_lock = PLAT_MUTEX_INITIALIZER;
+
+static void TerminateStaticData( ChewingData *pgdata )
+{
+	TerminateHanyuPinyin( pgdata );
+	TerminateEasySymbolTable( pgdata );
+	TerminateSymbolTable( pgdata );
+	TerminateOverlay( pgdata );
+	TerminateTree( pgdata );
+	TerminateDict( pgdata );
+	TerminateChar( pgdata );
+#ifdef USE_BINARY_DATA
+	TerminateDataFile( pgdata );
+#endif
+}
+
+static int InitStaticData( ChewingData *pgdata, const char *search_path,
+		const void *data, size_t size )
+{
+	char path[PATH_MAX];
+	char overlay_path[PATH_MAX];
+	int ret;
+
+#ifdef USE_BINARY_DATA
+	if ( data ) {
+		/* given by the caller, nothing to search for */
+		path[ 0 ] = '\0';
+		ret = InitDataBuffer( pgdata, data, size );
+	} else {
+#ifdef USE_EMBEDDED_DATA
+		/* linked in, nothing to search for */
+		(void) search_path;
+		path[ 0 ] = '\0';
+		ret = InitDataFile( pgdata, path );
+#else
+		ret = find_path_by_files(
+			search_path, DATA_FILES, path, sizeof( path ) );
+		if ( !ret )
+			ret = InitDataFile( pgdata, path );
+#endif
+	}
+	if ( ret )
+		return -1;
+	ret = InitChar( pgdata, path );
+	if ( ret )
+		return -1;
+#else
+	/* the text tables are read from files only */
+	if ( data )
+		return -1;
+	(void) size;
+	ret = find_path_by_files(
+		search_path, CHAR_FILES, path, sizeof( path ) );
+	if ( ret )
+		return -1;
+	ret = InitChar( pgdata, path );
+	if ( ret )
+		return -1;
+
+	ret = find_path_by_files(
+		search_path, DICT_FILES, path, sizeof( path ) );
+	if ( ret )
+		return -1;
+#endif
+	ret = InitDict( pgdata, path );
+	if ( ret )
+		return -1;
+	ret = InitTree( pgdata, path );
+	if ( ret )
+		return -1;
+
+	/* optional, from the first directory of the search path that has one */
+	if ( search_path[ 0 ] && ! find_path_by_files(
+			search_path, DICT_OVERLAY_FILES, overlay_path, sizeof( overlay_path ) ) ) {
+		ret = InitOverlay( pgdata, overlay_path );
+		if ( ret )
+			return -1;
+	}
+
+#ifdef USE_BINARY_DATA
+	/* maketables compiled the tables into STATIC_DATA_FILE */
+	ret = InitSymbolTable( pgdata, path );
+	if ( ret )
+		return -1;
+	ret = InitEasySymbolInput( pgdata, path );
+	if ( ret )
+		return -1;
+	ret = InitHanyuPinYin( pgdata, path );
+	if ( !ret )
+		return -1;
+#else
+	ret = find_path_by_files(
+		search_path, SYMBOL_TABLE_FILES, path, sizeof( path ) );
+	if ( ret )
+		return -1;
+	ret = InitSymbolTable( pgdata, path );
+	if ( ret )
+		return -1;
+
+	ret = find_path_by_files(
+		search_path, EASY_SYMBOL_FILES, path, sizeof( path ) );
+	if ( ret )
+		return -1;
+	ret = InitEasySymbolInput( pgdata, path );
+	if ( ret )
+		return -1;
+
+	ret = find_path_by_files(
+		search_path, PINYIN_FILES, path, sizeof( path ) );
+	if ( ret )
+		return -1;
+	ret = InitHanyuPinYin( pgdata, path );
+	if ( !ret )
+		return -1;
+#endif
+
+	ret = InitZuin( pgdata );
+	if ( ret )
+		return -1;
+
+	return 0;
+}
+
+/**
+ * @brief point pgdata->static_data to the static data found in search_path
+ *
+ * The data is loaded by the first context using search_path and shared
+ * by the later ones. The lock is held while it loads, so that a context
+ * on another thread waits for it rather than loading it again. If data is
+ * not NULL, it is the container to take instead, and is shared by the
+ * contexts given the same one.
+ */
+static int AcquireStaticData( ChewingData *pgdata, const char *search_path,
+		const void *data, size_t size )
+{
+	ChewingStaticData *static_data;
+	int ret = 0;
+
+	PLAT_MUTEX_LOCK( &static_data_lock );
+	for ( static_data = static_data_list; static_data; static_data = static_data->next ) {
+#ifdef USE_BINARY_DATA
+		if ( static_data->buffer != data ||
+				( data && static_data->dataSize != size ) )
+			continue;
+#endif
+		if ( data || ! strcmp( static_data->search_path, search_path ) ) {
+			++static_data->refcount;
+			pgdata->static_data = static_data;
+			goto end;
+		}
+	}
+
+	static_data = ALC( ChewingStaticData, 1 );
+	if ( !static_data ) {
+		ret = -1;
+		goto end;
+	}
+	snprintf( static_data->search_path, sizeof( static_data->search_path ), "%s", search_path );
+#ifdef USE_BINARY_DATA
+	plat_mmap_set_invalid( &static_data->data_mmap );
+#endif
+
+	pgdata->static_data = static_data;
+	if ( InitStaticData( pgdata, search_path, data, size ) ) {
+		TerminateStaticData( pgdata );
+		free( static_data );
+		pgdata->static_data = NULL;
+		ret = -1;
+		goto end;
+	}
+
+	static_data->refcount = 1;
+	static_data->next = static_data_list;
+	static_data_list = static_data;
+end:
+	PLAT_MUTEX_UNLOCK( &static_data_lock );
+	return ret;
+}
+
+/* take another reference to the static data of from, for pgdata */
+static void ShareStaticData( ChewingData *pgdata, ChewingData *from )
+{
+	PLAT_MUTEX_LOCK( &static_data_lock );
+	pgdata->static_data = from->static_data;
+	++pgdata->static_data->refcount;
+	PLAT_MUTEX_UNLOCK( &static_data_lock );
+}
+
+/* drop the reference of pgdata, the last one frees the static data */
+static void ReleaseStaticData( ChewingData *pgdata )
+{
+	ChewingStaticData **pp;
+
+	if ( !pgdata->static_data )
+		return;
+	PLAT_MUTEX_LOCK( &static_data_lock );
+	if ( --pgdata->static_data->refcount > 0 ) {
+		PLAT_MUTEX_UNLOCK( &static_data_lock );
+		return;
+	}
+
+	for ( pp = &static_data_list; *pp; pp = &( *pp )->next ) {
+		if ( *pp == pgdata->static_data ) {
+			*pp = pgdata->static_data->next;
+			break;
+		}
+	}
+	TerminateStaticData( pgdata );
+	free( pgdata->static_data );
+	pgdata->static_data = NULL;
+	PLAT_MUTEX_UNLOCK( &static_data_lock );
+}
+
+/* chewing_new(), with the container at data instead if it is not NULL */
+static ChewingContext *NewContext( const void *data, size_t size )
 {
 	ChewingContext *ctx;
 	int ret;
 	char search_path[PATH_MAX];
-	char path[PATH_MAX];
 
 	ctx = ALC( ChewingContext, 1 );
 	if ( !ctx )
@@ -173,58 +415,84 @@ CHEWING_API ChewingContext *chewing_new()
 
 	chewing_Reset( ctx );
 
-	ret = get_search_path( search_path, sizeof( search_path ) );
-	if ( ret )
-		goto error;
-
-	ret = find_path_by_files(
-		search_path, CHAR_FILES, path, sizeof( path ) );
-	if ( ret )
-		goto error;
-	ret = InitChar( ctx->data, path );
-	if ( ret )
-		goto error;
+#ifdef USE_EMBEDDED_DATA
+	/* one data for every context, whatever CHEWING_PATH says */
+	search_path[ 0 ] = '\0';
+#else
+	if ( data ) {
+		search_path[ 0 ] = '\0';
+	} else {
+		ret = get_search_path( search_path, sizeof( search_path ) );
+		if ( ret )
+			goto error;
+	}
+#endif
 
-	ret = find_path_by_files(
-		search_path, DICT_FILES, path, sizeof( path ) );
-	if ( ret )
-		goto error;
-	ret = InitDict( ctx->data, path );
-	if ( ret )
-		goto error;
-	ret = InitTree( ctx->data, path );
+	ret = AcquireStaticData( ctx->data, search_path, data, size );
 	if ( ret )
 		goto error;
 
 	// FIXME: Which return code indicate error?
 	ret = InitHash( ctx->data );
+	if ( !ctx->data->session.hashStore )
+		goto error;
 
 	ctx->cand_no = 0;
 
-	ret = find_path_by_files(
-		search_path, SYMBOL_TABLE_FILES, path, sizeof( path ) );
-	if ( ret )
-		goto error;
-	ret = InitSymbolTable( ctx->data, path );
-	if ( ret )
-		goto error;
+	return ctx;
+error:
+	chewing_delete( ctx );
+	return NULL;
+}
 
-	ret = find_path_by_files(
-		search_path, EASY_SYMBOL_FILES, path, sizeof( path ) );
-	if ( ret )
+CHEWING_API ChewingContext *chewing_new()
+{
+	return NewContext( NULL, 0 );
+}
+
+CHEWING_API ChewingContext *chewing_new_with_data( const void *data, size_t size )
+{
+	if ( !data )
+		return NULL;
+	return NewContext( data, size );
+}
+
+CHEWING_API ChewingContext *chewing_new_from( ChewingContext *template_ctx )
+{
+	ChewingContext *ctx;
+
+	if ( !template_ctx )
+		return NULL;
+
+	ctx = ALC( ChewingContext, 1 );
+	if ( !ctx )
 		goto error;
-	ret = InitEasySymbolInput( ctx->data, path );
-	if ( ret )
+
+	ctx->output = ALC ( ChewingOutput, 1 );
+	if ( !ctx->output )
 		goto error;
 
-	ret = find_path_by_files(
-		search_path, PINYIN_FILES, path, sizeof( path ) );
-	if ( ret )
+	ctx->data = allocate_ChewingData();
+	if ( !ctx->data )
 		goto error;
-	ret = InitHanyuPinYin( ctx->data, path );
-	if ( !ret )
+
+	/* the settings of the template, with fresh input state */
+	ctx->data->config = template_ctx->data->config;
+	ctx->data->phrasingEngine = template_ctx->data->phrasingEngine;
+	ctx->data->bDeferLearning = template_ctx->data->bDeferLearning;
+	ctx->data->bStatsTimer = template_ctx->data->bStatsTimer;
+	ctx->data->bRankCandidates = template_ctx->data->bRankCandidates;
+	chewing_Reset( ctx );
+	ctx->data->zuinData.kbtype = template_ctx->data->zuinData.kbtype;
+
+	/* the static data the template found, instead of searching again */
+	ShareStaticData( ctx->data, template_ctx->data );
+
+	if ( HashClone( ctx->data, template_ctx->data ) )
 		goto error;
 
+	ctx->cand_no = 0;
+
 	return ctx;
 error:
 	chewing_delete( ctx );
@@ -239,6 +507,13 @@ CHEWING_API int chewing_Init(
 {
 	char *dbg_path;
 	int failsafe = 1;
+
+	PLAT_MUTEX_LOCK( &debug_lock );
+	if ( fp_g ) {
+		/* opened by an earlier call */
+		PLAT_MUTEX_UNLOCK( &debug_lock );
+		return 0;
+	}
 	dbg_path = getenv( "CHEWING_DEBUG" );
 	if ( dbg_path ) {
 		fp_g = fopen( dbg_path, "w+" );
@@ -254,6 +529,7 @@ CHEWING_API int chewing_Init(
 				"--> Output to stderr\n" );
 		}
 	}
+	PLAT_MUTEX_UNLOCK( &debug_lock );
 	/* register debug service */
 }
 #endif
@@ -263,34 +539,56 @@ CHEWING_API int chewing_Init(
 CHEWING_API int chewing_Reset( ChewingContext *ctx )
 {
 	ChewingData *pgdata = ctx->data;
-	ChewingStaticData static_data;
-	ChewingConfigData old_config;
-
-	/* Backup old config and restore it after clearing pgdata structure. */
-	old_config = pgdata->config;
-	static_data = pgdata->static_data;
-	memset( pgdata, 0, sizeof( ChewingData ) );
-	pgdata->config = old_config;
-	pgdata->static_data = static_data;
+	/* nothing past chiSymbolBufUsed has been written since the last reset */
+	int used = pgdata->chiSymbolBufUsed;
+
+	/*
+	 * Only the input state is cleared, the rest of ChewingData (config,
+	 * phrasingEngine, the caches, static_data and session) is kept. The
+	 * buffers are cleared as far as they have been used, so that a reset
+	 * costs as much as the preedit typed since the previous one.
+	 */
+	TerminateChoice( pgdata );
+	memset( &( pgdata->choiceInfo ), 0, sizeof( ChoiceInfo ) );
+	memset( &( pgdata->availInfo ), 0, sizeof( AvailInfo ) );
 
 	/* zuinData */
 	memset( &( pgdata->zuinData ), 0, sizeof( ZuinData ) );
 
-	/* choiceInfo */
-	memset( &( pgdata->choiceInfo ), 0, sizeof( ChoiceInfo ) );
+	/* phrOut */
+	memset( pgdata->phrOut.chiBuf, 0, used * MAX_UTF8_SIZE + 1 );
+	memset( pgdata->phrOut.chiPos, 0, sizeof( int ) * ( used + 1 ) );
+	memset( pgdata->phrOut.dispInterval, 0, sizeof( IntervalType ) * used );
+	pgdata->phrOut.nDispInterval = 0;
+	pgdata->phrOut.nNumCut = 0;
 
+	memset( pgdata->chiSymbolBuf, 0, sizeof( wch_t ) * used );
 	pgdata->chiSymbolCursor = 0;
 	pgdata->chiSymbolBufLen = 0;
+	pgdata->chiSymbolBufUsed = 0;
+	pgdata->PointStart = -1;
+	pgdata->PointEnd = 0;
+	memset( pgdata->showMsg, 0, sizeof( wch_t ) * pgdata->showMsgLen );
+	pgdata->showMsgLen = 0;
+
+	memset( pgdata->phoneSeq, 0, sizeof( uint16_t ) * used );
 	pgdata->nPhoneSeq = 0;
-	memset( pgdata->bUserArrCnnct, 0, sizeof( int ) * ( MAX_PHONE_SEQ_LEN + 1 ) );
-	memset( pgdata->bUserArrBrkpt, 0, sizeof( int ) * ( MAX_PHONE_SEQ_LEN + 1 ) );
+	memset( pgdata->selectStr, 0, sizeof( pgdata->selectStr[ 0 ] ) * used );
+	memset( pgdata->selectInterval, 0, sizeof( IntervalType ) * used );
+	pgdata->nSelect = 0;
+	memset( pgdata->preferInterval, 0, sizeof( IntervalType ) * used );
+	pgdata->nPrefer = 0;
+	memset( pgdata->bUserArrCnnct, 0, sizeof( int ) * ( used + 1 ) );
+	memset( pgdata->bUserArrBrkpt, 0, sizeof( int ) * ( used + 1 ) );
+	memset( pgdata->bArrBrkpt, 0, sizeof( int ) * ( used + 1 ) );
+	memset( pgdata->bSymbolArrBrkpt, 0, sizeof( int ) * ( used + 1 ) );
 	pgdata->bChiSym = CHINESE_MODE;
-	pgdata->bFullShape = HALFSHAPE_MODE;
 	pgdata->bSelect = 0;
-	pgdata->nSelect = 0;
-	pgdata->PointStart = -1;
-	pgdata->PointEnd = 0;
-	pgdata->phrOut.nNumCut = 0;
+	pgdata->bCaseChange = 0;
+	pgdata->bFirstKey = 0;
+	pgdata->bFullShape = HALFSHAPE_MODE;
+	pgdata->bDeferPhrasing = 0;
+	memset( pgdata->symbolKeyBuf, 0, sizeof( pgdata->symbolKeyBuf[ 0 ] ) * used );
 	return 0;
 }
 
@@ -326,13 +624,11 @@ CHEWING_API void chewing_delete( ChewingContext *ctx )
 {
 	if ( ctx ) {
 		if ( ctx->data ) {
-			TerminateHanyuPinyin( ctx->data );
-			TerminateEasySymbolTable( ctx->data );
-			TerminateSymbolTable( ctx->data );
 			TerminateHash( ctx->data );
-			TerminateTree( ctx->data );
-			TerminateDict( ctx->data );
-			TerminateChar( ctx->data );
+			ReleaseStaticData( ctx->data );
+			TerminatePhrasing( ctx->data );
+			TerminateChoice( ctx->data );
+			ChoiceDropPrepared( ctx->data );
 			free( ctx->data );
 		}
 
@@ -481,6 +777,107 @@ CHEWING_API int chewing_get_phraseChoiceRearward( ChewingContext *ctx )
 	return ctx->data->config.bPhraseChoiceRearward;
 }
 
+CHEWING_API void chewing_set_rankCandidates( ChewingContext *ctx, int mode )
+{
+	ctx->data->bRankCandidates = ( mode ? 1 : 0 );
+}
+
+CHEWING_API int chewing_get_rankCandidates( ChewingContext *ctx )
+{
+	return ctx->data->bRankCandidates;
+}
+
+CHEWING_API int chewing_set_phrasingEngine( ChewingContext *ctx, int engine )
+{
+	if ( engine != PHRASING_ENGINE_ENUMERATE && engine != PHRASING_ENGINE_DP )
+		return -1;
+	ctx->data->phrasingEngine = engine;
+	return 0;
+}
+
+CHEWING_API int chewing_get_phrasingEngine( ChewingContext *ctx )
+{
+	return ctx->data->phrasingEngine;
+}
+
+CHEWING_API int chewing_get_stats( ChewingContext *ctx, ChewingStats *stats )
+{
+	if ( !ctx || !stats )
+		return -1;
+	*stats = ctx->data->stats;
+	/* the user hash counts its own, see HashFindPhonePhrase() */
+	stats->nHashLookup = ctx->data->session.nHashLookup;
+	stats->nHashProbe = ctx->data->session.nHashProbe;
+	return 0;
+}
+
+CHEWING_API void chewing_reset_stats( ChewingContext *ctx )
+{
+	memset( &ctx->data->stats, 0, sizeof( ctx->data->stats ) );
+	ctx->data->session.nHashLookup = 0;
+	ctx->data->session.nHashProbe = 0;
+}
+
+CHEWING_API void chewing_set_statsTimer( ChewingContext *ctx, int mode )
+{
+	ctx->data->bStatsTimer = ( mode ? 1 : 0 );
+}
+
+CHEWING_API int chewing_get_statsTimer( ChewingContext *ctx )
+{
+	return ctx->data->bStatsTimer;
+}
+
+CHEWING_API int chewing_set_traceCallback( ChewingContext *ctx,
+		ChewingTraceCallback callback, void *userdata )
+{
+#ifdef ENABLE_TRACE
+	if ( !ctx )
+		return -1;
+	ctx->data->traceCallback = callback;
+	ctx->data->traceData = userdata;
+	return 0;
+#else
+	(void) ctx;
+	(void) callback;
+	(void) userdata;
+	return -1;
+#endif
+}
+
+CHEWING_API int chewing_get_memory( ChewingContext *ctx, ChewingMemory *mem )
+{
+	ChewingData *pgdata;
+
+	if ( !ctx || !mem )
+		return -1;
+	pgdata = ctx->data;
+	memset( mem, 0, sizeof( *mem ) );
+	mem->context = sizeof( ChewingContext ) + sizeof( ChewingData ) + sizeof( ChewingOutput );
+	mem->userPhrase = HashBytes( pgdata );
+	mem->phrasing = PhrasingBytes( pgdata );
+	mem->candidate = ( pgdata->choiceInfo.nChoiceAlloc +
+			pgdata->prepared.choiceInfo.nChoiceAlloc ) *
+		( sizeof( pgdata->choiceInfo.totalChoiceStr[ 0 ] ) +
+		  sizeof( pgdata->choiceInfo.choiceScore[ 0 ] ) );
+
+	mem->shared = sizeof( ChewingStaticData ) + OverlayBytes( pgdata );
+	mem->sharedSymbol = SymbolTableBytes( pgdata );
+	mem->sharedPinyin = HanyuPinYinBytes( pgdata );
+#ifdef USE_BINARY_DATA
+	mem->sharedMapped = pgdata->static_data->dataSize;
+	if ( plat_mmap_is_valid( &pgdata->static_data->data_mmap ) )
+		mem->sharedResident = plat_mmap_resident( &pgdata->static_data->data_mmap );
+	else
+		/* the library's own pages or the caller's, no mapping tells about them */
+		mem->sharedResident = (size_t) -1;
+#endif
+	PLAT_MUTEX_LOCK( &static_data_lock );
+	mem->nSharedContext = pgdata->static_data->refcount;
+	PLAT_MUTEX_UNLOCK( &static_data_lock );
+	return 0;
+}
+
 CHEWING_API void chewing_set_ChiEngMode( ChewingContext *ctx, int mode )
 {
 	ctx->data->bChiSym = ( mode == CHINESE_MODE ? 1 : 0 );
@@ -515,6 +912,7 @@ static int DoSelect( ChewingData *pgdata, int num )
 		num += pgdata->choiceInfo.pageNo * pgdata->choiceInfo.nChoicePerPage;
 		/* Note: if num is larger than the total, there will be big troubles. */
 		if ( num < pgdata->choiceInfo.nTotalChoice ) {
+			ChoiceRank( &( pgdata->choiceInfo ), num );
 			if ( pgdata->choiceInfo.isSymbol ) {
 				SymbolChoice( pgdata, num );
 			}
@@ -1052,9 +1450,10 @@ CHEWING_API int chewing_handle_Default( ChewingContext *ctx, int key )
 	int rtn, num;
 	int keystrokeRtn = KEYSTROKE_ABSORB;
 	int bQuickCommit = 0;
+	int bDefer = 0;
 
 	/* Update lifetime */
-	ctx->data->static_data.chewing_lifetime++;
+	HashTick( ctx->data );
 
 	/* Skip the special key */
 	if ( key & 0xFF00 ) {
@@ -1147,12 +1546,15 @@ CHEWING_API int chewing_handle_Default( ChewingContext *ctx, int key )
 			switch ( rtn ) {
 				case ZUIN_ABSORB:
 					keystrokeRtn = KEYSTROKE_ABSORB;
+					bDefer = pgdata->bDeferPhrasing;
 					break;
 				case ZUIN_COMMIT:
 					AddChi( pgdata->zuinData.phone, pgdata );
+					bDefer = pgdata->bDeferPhrasing;
 					break;
 				case ZUIN_NO_WORD:
 					keystrokeRtn = KEYSTROKE_BELL | KEYSTROKE_ABSORB;
+					bDefer = pgdata->bDeferPhrasing;
 					break;
 				case ZUIN_KEY_ERROR:
 				case ZUIN_IGNORE:
@@ -1215,6 +1617,14 @@ CHEWING_API int chewing_handle_Default( ChewingContext *ctx, int key )
 	}
 
 End_keyproc:
+	/* nothing before the next phrasing looks at this one */
+	if ( bDefer && pgdata->phrOut.nNumCut == 0 && ! ChiSymbolBufFull( pgdata ) ) {
+		SetBreakpoints( pgdata );
+		pgo->nCommitStr = 0;
+		pgo->keystrokeRtn = keystrokeRtn;
+		return 0;
+	}
+
 	if ( ! bQuickCommit ) {
 		CallPhrasing( pgdata );
 		if ( ReleaseChiSymbolBuf( pgdata, pgo ) != 0 )
@@ -1248,6 +1658,24 @@ End_Paging:
 	return 0;
 }
 
+CHEWING_API int chewing_handle_KeySequence( ChewingContext *ctx, const int keys[], int n )
+{
+	int i;
+
+	if ( !ctx || n < 0 || ( n > 0 && !keys ) )
+		return -1;
+
+	for ( i = 0; i < n; i++ ) {
+		/* the last key leaves the output as a single key would */
+		ctx->data->bDeferPhrasing = ( i < n - 1 );
+		chewing_handle_Default( ctx, keys[ i ] );
+		ctx->data->bDeferPhrasing = 0;
+		if ( ctx->output->keystrokeRtn & KEYSTROKE_COMMIT )
+			return i + 1;
+	}
+	return n;
+}
+
 CHEWING_API int chewing_handle_CtrlNum( ChewingContext *ctx, int key )
 {
 	ChewingData *pgdata = ctx->data;
@@ -1293,8 +1721,7 @@ CHEWING_API int chewing_handle_CtrlNum( ChewingContext *ctx, int key )
 				        sizeof( uint16_t ) * newPhraseLen );
 				addPhoneSeq[ newPhraseLen ] = 0;
 				ueStrNCpy( addWordSeq,
-				           ueStrSeek( (char *) &pgdata->phrOut.chiBuf,
-				                      cursor ),
+				           ChiBufSeek( &pgdata->phrOut, cursor ),
 				           newPhraseLen, 1);
 
 
@@ -1324,8 +1751,7 @@ CHEWING_API int chewing_handle_CtrlNum( ChewingContext *ctx, int key )
 				        sizeof( uint16_t ) * newPhraseLen );
 				addPhoneSeq[ newPhraseLen ] = 0;
 				ueStrNCpy( addWordSeq,
-				           ueStrSeek( (char *) &pgdata->phrOut.chiBuf,
-				           cursor - newPhraseLen ),
+				           ChiBufSeek( &pgdata->phrOut, cursor - newPhraseLen ),
 				           newPhraseLen, 1);
 
 				phraseState = UserUpdatePhrase( pgdata, addPhoneSeq, addWordSeq );
@@ -1440,3 +1866,491 @@ CHEWING_API int chewing_get_phoneSeqLen( ChewingContext *ctx )
 {
 	return ctx->data->nPhoneSeq;
 }
+
+CHEWING_API int chewing_dict_lookup_batch( ChewingContext *ctx,
+		const unsigned short *const phoneSeqs[], int n,
+		ChewingDictCallback callback, void *userdata )
+{
+	ChewingData *pgdata;
+	ChewingDictEntry entry;
+	PhraseView view;
+	HashCursor cursor;
+	HASH_ITEM *pItem;
+	const uint16_t *phoneSeq;
+	int nFound = 0;
+	int len, pho_id;
+	int i;
+
+	if ( !ctx || n < 0 || ( n > 0 && !phoneSeqs ) || !callback )
+		return -1;
+	pgdata = ctx->data;
+
+	for ( i = 0; i < n; i++ ) {
+		phoneSeq = phoneSeqs[ i ];
+		for ( len = 0; len <= MAX_PHRASE_LEN && phoneSeq[ len ]; len++ )
+			;
+		if ( len == 0 || len > MAX_PHRASE_LEN )
+			continue;
+
+		entry.isUser = 0;
+		pho_id = TreeFindPhrase( pgdata, 0, len - 1, phoneSeq );
+		if ( pho_id != -1 && GetPhraseViewFirst( pgdata, &view, pho_id ) ) {
+			do {
+				entry.phrase = view.phrase;
+				entry.len = view.len;
+				entry.freq = view.freq;
+				nFound++;
+				if ( callback( userdata, i, &entry ) )
+					return nFound;
+			} while ( GetPhraseViewNext( pgdata, &view ) );
+		}
+
+		entry.isUser = 1;
+		HashReadBegin( pgdata );
+		for ( pItem = HashFindPhonePhrase( pgdata, phoneSeq, &cursor ); pItem;
+				pItem = HashFindNextPhrase( pgdata, phoneSeq, &cursor ) ) {
+			entry.phrase = pItem->data.wordSeq;
+			entry.len = strlen( pItem->data.wordSeq );
+			entry.freq = pItem->data.userfreq;
+			nFound++;
+			if ( callback( userdata, i, &entry ) ) {
+				HashReadEnd( pgdata );
+				return nFound;
+			}
+		}
+		HashReadEnd( pgdata );
+	}
+	return nFound;
+}
+
+/*
+ * A sequence that fills the edit buffer, or a longer one, is phrased a
+ * window at a time, the segmentation kept up to the last phrase boundary at
+ * least a phrase away from the end of the window, and the next window
+ * starts there; no pass of Phrasing() is then as long as its arrays.
+ * Windows are phrased by the dynamic programming, the enumeration takes
+ * milliseconds on one this long.
+ */
+#define CONVERT_WINDOW_LEN ( 3 * MAX_PHRASE_LEN )
+
+/* phrase phoneSeq alone, with no breakpoint, selection or edit buffer */
+static void PhraseWindow( ChewingData *pgdata, uint16_t phoneSeq[], int len,
+		PhrasingOutput *ppo )
+{
+	char selectStr[ 1 ][ MAX_SELECT_STR_SIZE ];
+	IntervalType selectInterval[ 1 ];
+	int bArrBrkpt[ MAX_PHONE_SEQ_LEN + 1 ];
+	int bUserArrCnnct[ MAX_PHONE_SEQ_LEN + 1 ];
+
+	ppo->chiBuf[ 0 ] = '\0';
+	ppo->chiPos[ 0 ] = 0;
+	ppo->nDispInterval = 0;
+	ppo->nNumCut = 0;
+	if ( len == 0 )
+		return;
+	memset( bArrBrkpt, 0, sizeof( bArrBrkpt ) );
+	memset( bUserArrCnnct, 0, sizeof( bUserArrCnnct ) );
+	Phrasing( pgdata, ppo, phoneSeq, len,
+		selectStr, selectInterval, 0, bArrBrkpt, bUserArrCnnct );
+}
+
+/* the last position up to limit that no phrase of ppo crosses */
+static int LastBoundary( const PhrasingOutput *ppo, int limit )
+{
+	char inside[ MAX_PHONE_SEQ_LEN + 1 ];
+	int i, j;
+
+	memset( inside, 0, sizeof( inside ) );
+	for ( i = 0; i < ppo->nDispInterval; i++ ) {
+		for ( j = ppo->dispInterval[ i ].from + 1; j < ppo->dispInterval[ i ].to; j++ )
+			inside[ j ] = 1;
+	}
+	while ( limit > 1 && inside[ limit ] )
+		limit--;
+	return limit;
+}
+
+static int ConvertPhoneSeq( ChewingData *pgdata, const uint16_t phoneSeq[], int len,
+		char *buf, int size, IntervalType *interval, int *nInterval )
+{
+	PhrasingOutput out;
+	uint16_t window[ MAX_PHONE_SEQ_LEN ];
+	int room = nInterval ? *nInterval : 0;
+	int engine = pgdata->phrasingEngine;
+	int bWindow = len >= MAX_PHONE_SEQ_LEN;
+	int pos = 0, n, keep, bytes, textLen = 0, nFound = 0;
+	int i;
+
+	if ( size > 0 )
+		buf[ 0 ] = '\0';
+	if ( bWindow )
+		pgdata->phrasingEngine = PHRASING_ENGINE_DP;
+	do {
+		n = len - pos;
+		if ( bWindow && n > CONVERT_WINDOW_LEN )
+			n = CONVERT_WINDOW_LEN;
+		memcpy( window, &phoneSeq[ pos ], n * sizeof( uint16_t ) );
+		PhraseWindow( pgdata, window, n, &out );
+		keep = ( pos + n == len ) ? n : LastBoundary( &out, n - MAX_PHRASE_LEN );
+
+		/* one character for every phone */
+		bytes = out.chiPos[ keep ];
+		if ( textLen + bytes < size )
+			memcpy( buf + textLen, out.chiBuf, bytes );
+		textLen += bytes;
+		for ( i = 0; i < out.nDispInterval; i++ ) {
+			if ( out.dispInterval[ i ].to > keep )
+				continue;
+			if ( nFound < room ) {
+				interval[ nFound ].from = out.dispInterval[ i ].from + pos;
+				interval[ nFound ].to = out.dispInterval[ i ].to + pos;
+			}
+			nFound++;
+		}
+		pos += keep;
+	} while ( pos < len );
+	pgdata->phrasingEngine = engine;
+
+	if ( size > 0 )
+		buf[ textLen < size ? textLen : 0 ] = '\0';
+	if ( nInterval )
+		*nInterval = nFound;
+	return textLen;
+}
+
+CHEWING_API int chewing_convert_phone( ChewingContext *ctx,
+		const unsigned short *phoneSeq, int len,
+		char *buf, int size, IntervalType *interval, int *nInterval )
+{
+	int i;
+
+	if ( !ctx || len < 0 || ( len > 0 && !phoneSeq ) ||
+			( size > 0 && !buf ) || ( nInterval && *nInterval > 0 && !interval ) )
+		return -1;
+	for ( i = 0; i < len; i++ ) {
+		if ( phoneSeq[ i ] == 0 )
+			return -1;
+	}
+	return ConvertPhoneSeq( ctx->data, phoneSeq, len, buf, size, interval, nInterval );
+}
+
+CHEWING_API int chewing_convert_bopomofo( ChewingContext *ctx, const char *bopomofo,
+		char *buf, int size, IntervalType *interval, int *nInterval )
+{
+	uint16_t *seq;
+	/* a syllable has a component of every kind at most */
+	char syllable[ ZUIN_SIZE * MAX_UTF8_SIZE + 1 ];
+	const char *p, *end;
+	int len = 0, ret;
+
+	if ( !ctx || !bopomofo ||
+			( size > 0 && !buf ) || ( nInterval && *nInterval > 0 && !interval ) )
+		return -1;
+	/* a syllable and the space after it take 2 bytes at least */
+	seq = ALC( uint16_t, strlen( bopomofo ) / 2 + 1 );
+	if ( !seq )
+		return -1;
+
+	for ( p = bopomofo; ; p = end ) {
+		while ( *p && isspace( (unsigned char) *p ) )
+			p++;
+		if ( !*p )
+			break;
+		for ( end = p; *end && !isspace( (unsigned char) *end ); end++ )
+			;
+		if ( end - p >= (int) sizeof( syllable ) ) {
+			free( seq );
+			return -1;
+		}
+		memcpy( syllable, p, end - p );
+		syllable[ end - p ] = '\0';
+		/* UintFromPhone() skips what it does not know, take only whole syllables */
+		seq[ len ] = UintFromPhone( syllable );
+		if ( seq[ len ] == 0 || ueStrLen( syllable ) != ComponentCountFromUint( seq[ len ] ) ) {
+			free( seq );
+			return -1;
+		}
+		len++;
+	}
+	ret = ConvertPhoneSeq( ctx->data, seq, len, buf, size, interval, nInterval );
+	free( seq );
+	return ret;
+}
+
+/* the sequences a worker takes from a batch at a time */
+#define CONVERT_BATCH_CHUNK 16
+
+typedef struct {
+	const unsigned short *const *phoneSeqs;
+	/* allocated by the workers, or room for the sentences set beforehand */
+	char **results;
+	int bAlloc;
+	int n;
+	int next;	/* the first sequence no worker has taken, under lock */
+	plat_mutex lock;
+} ConvertBatch;
+
+typedef struct {
+	ConvertBatch *batch;
+	ChewingContext *ctx;	/* for this worker alone */
+	plat_thread thread;
+	int nConverted;
+} ConvertWorker;
+
+/* convert chunks of the batch until none is left */
+static void RunConvertWorker( ConvertWorker *pw )
+{
+	ConvertBatch *pb = pw->batch;
+	const unsigned short *phoneSeq;
+	int begin, end, i, len;
+
+	for ( ;; ) {
+		PLAT_MUTEX_LOCK( &pb->lock );
+		begin = pb->next;
+		end = pb->next = min( begin + CONVERT_BATCH_CHUNK, pb->n );
+		PLAT_MUTEX_UNLOCK( &pb->lock );
+		if ( begin == end )
+			return;
+
+		for ( i = begin; i < end; i++ ) {
+			phoneSeq = pb->phoneSeqs[ i ];
+			if ( !phoneSeq )
+				continue;
+			for ( len = 0; phoneSeq[ len ]; len++ )
+				;
+			/* a character for every phone */
+			if ( pb->bAlloc )
+				pb->results[ i ] = ALC( char, len * MAX_UTF8_SIZE + 1 );
+			if ( !pb->results[ i ] )
+				continue;
+			ConvertPhoneSeq( pw->ctx->data, phoneSeq, len,
+				pb->results[ i ], len * MAX_UTF8_SIZE + 1, NULL, NULL );
+			pw->nConverted++;
+		}
+	}
+}
+
+static PLAT_THREAD_FUNC( ConvertWorkerThread, arg )
+{
+	RunConvertWorker( arg );
+	return 0;
+}
+
+/* the number of sequences converted, -1 if out of memory */
+static int ConvertBatchOn( ChewingContext *ctx,
+		const unsigned short *const phoneSeqs[], int n, int nThread,
+		char *results[], int bAlloc )
+{
+	ConvertBatch batch;
+	ConvertWorker *worker;
+	int nStarted, nConverted, i;
+
+	/* no more workers than chunks */
+	nThread = max( 1, min( nThread, ( n + CONVERT_BATCH_CHUNK - 1 ) / CONVERT_BATCH_CHUNK ) );
+	worker = ALC( ConvertWorker, nThread );
+	if ( !worker )
+		return -1;
+
+	batch.phoneSeqs = phoneSeqs;
+	batch.results = results;
+	batch.bAlloc = bAlloc;
+	batch.n = n;
+	batch.next = 0;
+	PLAT_MUTEX_INIT( &batch.lock );
+
+	/*
+	 * The caller converts on ctx, every other worker on a context of its
+	 * own, sharing the static data and a copy of the user phrases.
+	 */
+	for ( i = 0; i < nThread; i++ )
+		worker[ i ].batch = &batch;
+	worker[ 0 ].ctx = ctx;
+	for ( nStarted = 1; nStarted < nThread; nStarted++ ) {
+		worker[ nStarted ].ctx = chewing_new_from( ctx );
+		if ( !worker[ nStarted ].ctx )
+			break;
+		if ( PLAT_THREAD_CREATE( &worker[ nStarted ].thread,
+				ConvertWorkerThread, &worker[ nStarted ] ) ) {
+			chewing_delete( worker[ nStarted ].ctx );
+			break;
+		}
+	}
+	RunConvertWorker( &worker[ 0 ] );
+
+	nConverted = worker[ 0 ].nConverted;
+	for ( i = 1; i < nStarted; i++ ) {
+		PLAT_THREAD_JOIN( worker[ i ].thread );
+		nConverted += worker[ i ].nConverted;
+		chewing_delete( worker[ i ].ctx );
+	}
+	PLAT_MUTEX_DESTROY( &batch.lock );
+	free( worker );
+	return nConverted;
+}
+
+CHEWING_API int chewing_convert_batch( ChewingContext *ctx,
+		const unsigned short *const phoneSeqs[], int n, int nThread,
+		char *results[] )
+{
+	int i;
+
+	if ( !ctx || n < 0 || ( n > 0 && ( !phoneSeqs || !results ) ) || nThread < 1 )
+		return -1;
+	for ( i = 0; i < n; i++ )
+		results[ i ] = NULL;
+	return ConvertBatchOn( ctx, phoneSeqs, n, nThread, results, 1 );
+}
+
+CHEWING_API int chewing_convert_batch_buffer( ChewingContext *ctx,
+		const unsigned short *phones, int nPhone, int nThread,
+		char *buf, int size )
+{
+	const unsigned short **phoneSeqs;
+	char **results;
+	int n = 0, pos, len, i;
+
+	if ( !ctx || nPhone < 0 || ( nPhone > 0 && ( !phones || !buf ) ) || nThread < 1 ||
+			( nPhone > 0 && phones[ nPhone - 1 ] != 0 ) )
+		return -1;
+	/* a sentence and its NUL take a character for every phone and its 0 at most */
+	if ( size / MAX_UTF8_SIZE < nPhone )
+		return -1;
+	for ( i = 0; i < nPhone; i++ ) {
+		if ( phones[ i ] == 0 )
+			n++;
+	}
+	phoneSeqs = ALC( const unsigned short *, n + 1 );
+	results = ALC( char *, n + 1 );
+	if ( !phoneSeqs || !results ) {
+		free( phoneSeqs );
+		free( results );
+		return -1;
+	}
+
+	/* every sentence in room of its own, moved together at the end */
+	for ( i = 0, n = 0; i < nPhone; i = pos + 1, n++ ) {
+		phoneSeqs[ n ] = &phones[ i ];
+		for ( pos = i; phones[ pos ]; pos++ )
+			;
+		results[ n ] = buf + i * MAX_UTF8_SIZE;
+		results[ n ][ 0 ] = '\0';
+	}
+	if ( ConvertBatchOn( ctx, phoneSeqs, n, nThread, results, 0 ) != n ) {
+		free( phoneSeqs );
+		free( results );
+		return -1;
+	}
+	for ( i = 0, pos = 0; i < n; i++ ) {
+		len = strlen( results[ i ] ) + 1;
+		memmove( buf + pos, results[ i ], len );
+		pos += len;
+	}
+	free( phoneSeqs );
+	free( results );
+	return pos;
+}
+
+CHEWING_API int chewing_userphrase_flush( ChewingContext *ctx )
+{
+	if ( !ctx )
+		return -1;
+	HashWritePending( ctx->data );
+	if ( HashFlush( ctx->data ) )
+		return -1;
+	return HashSync( ctx->data );
+}
+
+CHEWING_API int chewing_idle( ChewingContext *ctx, int budget_us )
+{
+	if ( !ctx || budget_us < 0 )
+		return -1;
+	return ChoicePrepare( ctx->data,
+		PLAT_CLOCK_NSEC() + (unsigned long long) budget_us * 1000 );
+}
+
+CHEWING_API void chewing_set_deferLearning( ChewingContext *ctx, int mode )
+{
+	ctx->data->bDeferLearning = ( mode ? 1 : 0 );
+	if ( ! mode )
+		HashWritePending( ctx->data );
+}
+
+CHEWING_API int chewing_get_deferLearning( ChewingContext *ctx )
+{
+	return ctx->data->bDeferLearning;
+}
+
+CHEWING_API void chewing_set_shareUserPhrase( ChewingContext *ctx, int mode )
+{
+	HashShare( ctx->data, mode );
+}
+
+CHEWING_API int chewing_get_shareUserPhrase( ChewingContext *ctx )
+{
+	return HashShared( ctx->data );
+}
+
+CHEWING_API int chewing_userphrase_pump( ChewingContext *ctx )
+{
+	if ( !ctx )
+		return -1;
+	return HashWritePending( ctx->data );
+}
+
+CHEWING_API int chewing_userphrase_compact( ChewingContext *ctx, int evict )
+{
+	if ( !ctx )
+		return -1;
+	return HashCompact( ctx->data, evict );
+}
+
+CHEWING_API int chewing_userphrase_import( ChewingContext *ctx,
+		ChewingUserPhraseReader reader, void *userdata )
+{
+	ChewingUserPhrase entry;
+	int nImport = 0;
+	int ret;
+
+	if ( !ctx || !reader )
+		return -1;
+
+	while ( reader( userdata, &entry ) ) {
+		if ( !entry.phoneSeq || !entry.phrase )
+			continue;
+		ret = UserImportPhrase( ctx->data, entry.phoneSeq, entry.phrase, entry.freq );
+		if ( ret == USER_UPDATE_INSERT || ret == USER_UPDATE_MODIFY )
+			nImport++;
+	}
+	if ( HashFlush( ctx->data ) )
+		return -1;
+	return nImport;
+}
+
+CHEWING_API int chewing_userphrase_export( ChewingContext *ctx,
+		ChewingUserPhraseCallback callback, void *userdata )
+{
+	HASH_TABLE *table;
+	ChewingUserPhrase entry;
+	HASH_ITEM *pItem;
+	unsigned int i;
+	int nExport = 0;
+
+	if ( !ctx || !callback )
+		return -1;
+
+	/* contexts sharing the phrases learn nothing meanwhile */
+	HashLock( ctx->data );
+	table = ctx->data->session.hashStore->table;
+	for ( i = 0; table && i < table->nSlot; i++ ) {
+		if ( ! ( pItem = table->slot[ i ] ) )
+			continue;
+		entry.phoneSeq = pItem->data.phoneSeq;
+		entry.phrase = pItem->data.wordSeq;
+		entry.freq = pItem->data.userfreq;
+		nExport++;
+		if ( callback( userdata, &entry ) )
+			break;
+	}
+	HashUnlock( ctx->data );
+	return nExport;
+}
@@ -32,6 +32,7 @@
 #include "tree-private.h"
 #include "userphrase-private.h"
 #include "private.h"
+#include "datafile-private.h"
 
 #if HAVE_ASPRINTF
 #include <stdio.h>
@@ -46,6 +47,24 @@ static int ChewingKillSelectIntervalAcross( int cursor, ChewingData *pgdata );
 
 static int FindSymbolKey( const char *symbol );
 
+/* one more entry in chiSymbolBuf, see ChewingData.chiSymbolBufUsed */
+static void GrowChiSymbolBuf( ChewingData *pgdata )
+{
+	pgdata->chiSymbolBufLen++;
+	if ( pgdata->chiSymbolBufUsed < pgdata->chiSymbolBufLen )
+		pgdata->chiSymbolBufUsed = pgdata->chiSymbolBufLen;
+}
+
+/* the symbols of an entry, little-endian when it is in STATIC_DATA_FILE */
+static int SymbolCount( const SymbolEntry *entry )
+{
+#ifdef USE_BINARY_DATA
+	return (int32_t) GetUint32LE( &entry->nSymbols );
+#else
+	return entry->nSymbols;
+#endif
+}
+
 static const char G_EASY_SYMBOL_KEY[EASY_SYMBOL_KEY_TAB_LEN] = {
 	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
 	'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J',
@@ -142,19 +161,21 @@ int ChewingIsEntering( ChewingData *pgdata )
 int HaninSymbolInput( ChewingData *pgdata )
 {
 	unsigned int i;
+	char *str;
 
 	ChoiceInfo *pci = &( pgdata->choiceInfo );
 	AvailInfo *pai = &( pgdata->availInfo );
 	int candPerPage = pgdata->config.candPerPage;
 
 	/* No available symbol table */
-	if ( ! pgdata->static_data.symbol_table )
+	if ( ! pgdata->static_data->symbol_table )
 		return ZUIN_ABSORB;
 
 	pci->nTotalChoice = 0;
-	for ( i = 0; i < pgdata->static_data.n_symbol_entry; i++ ) {
-		strcpy( pci->totalChoiceStr[ pci->nTotalChoice ], 
-			pgdata->static_data.symbol_table[ i ]->category );
+	for ( i = 0; i < pgdata->static_data->n_symbol_entry; i++ ) {
+		if ( ! ( str = ChoiceInfoAppend( pci ) ) )
+			break;
+		strcpy( str, pgdata->static_data->symbol_table[ i ]->category );
 		pci->nTotalChoice++; 
 	}
 	pai->avail[ 0 ].len = 1;
@@ -192,7 +213,7 @@ static int _Inner_InternalSpecialSymbol(
 		pgdata->symbolKeyBuf[ pgdata->chiSymbolCursor ] = key;
 		pgdata->bUserArrCnnct[ PhoneSeqCursor( pgdata ) ] = 0;
 		pgdata->chiSymbolCursor++;
-		pgdata->chiSymbolBufLen++;
+		GrowChiSymbolBuf( pgdata );
 		/* reset Zuin data */
 		/* Don't forget the kbtype */
 		kbtype = pgdata->zuinData.kbtype;
@@ -320,9 +341,9 @@ int EasySymbolInput( int key, ChewingData *pgdata )
 
 	_index = FindEasySymbolIndex( key );
 	if ( -1 != _index ) {
-		for ( loop = 0; loop < pgdata->static_data.g_easy_symbol_num[ _index ]; ++loop ) {
+		for ( loop = 0; loop < pgdata->static_data->g_easy_symbol_num[ _index ]; ++loop ) {
 			ueStrNCpy( wordbuf, 
-				ueStrSeek( pgdata->static_data.g_easy_symbol_value[ _index ],
+				ueStrSeek( pgdata->static_data->g_easy_symbol_value[ _index ],
 					loop),
 				1, 1 );
 			rtn = _Inner_InternalSpecialSymbol(
@@ -333,7 +354,7 @@ int EasySymbolInput( int key, ChewingData *pgdata )
 
 	rtn = InternalSpecialSymbol( 
 			key, pgdata, nSpecial, 
-			G_EASY_SYMBOL_KEY, pgdata->static_data.g_easy_symbol_value );
+			G_EASY_SYMBOL_KEY, pgdata->static_data->g_easy_symbol_value );
 	if ( rtn == ZUIN_IGNORE )
 		rtn = SpecialSymbolInput( key, pgdata );
 	return ( rtn == ZUIN_IGNORE ? SYMBOL_KEY_ERROR : SYMBOL_KEY_OK );
@@ -368,12 +389,13 @@ int SymbolChoice( ChewingData *pgdata, int sel_i )
 	int i;
 	int symbol_type;
 	int key;
+	char *str;
 
-	if ( ! pgdata->static_data.symbol_table && pgdata->choiceInfo.isSymbol != 3 )
+	if ( ! pgdata->static_data->symbol_table && pgdata->choiceInfo.isSymbol != 3 )
 		return ZUIN_ABSORB;
 
 	if ( pgdata->choiceInfo.isSymbol == 1 && 
-			0 == pgdata->static_data.symbol_table[sel_i]->nSymbols )
+			0 == SymbolCount( pgdata->static_data->symbol_table[ sel_i ] ) )
 		symbol_type = 2;
 	else
 		symbol_type = pgdata->choiceInfo.isSymbol;
@@ -385,9 +407,10 @@ int SymbolChoice( ChewingData *pgdata, int sel_i )
 
 		/* Display all symbols in this category */
 		pci->nTotalChoice = 0;
-		for ( i = 0; i < pgdata->static_data.symbol_table[ sel_i ]->nSymbols; i++ ) {
-			ueStrNCpy( pci->totalChoiceStr[ pci->nTotalChoice ],
-					pgdata->static_data.symbol_table[ sel_i ]->symbols[ i ], 1, 1 );
+		for ( i = 0; i < SymbolCount( pgdata->static_data->symbol_table[ sel_i ] ); i++ ) {
+			if ( ! ( str = ChoiceInfoAppend( pci ) ) )
+				break;
+			ueStrNCpy( str, pgdata->static_data->symbol_table[ sel_i ]->symbols[ i ], 1, 1 );
 			pci->nTotalChoice++;
 		}
 		pai->avail[ 0 ].len = 1;
@@ -423,7 +446,7 @@ int SymbolChoice( ChewingData *pgdata, int sel_i )
 		pgdata->zuinData.kbtype = kbtype;
 
 		if ( symbol_type == 2 ) {
-			pgdata->chiSymbolBufLen++;
+			GrowChiSymbolBuf( pgdata );
 			pgdata->chiSymbolCursor ++ ; 
 			if ( ! pgdata->config.bAutoShiftCur ) {
 				/* No action */
@@ -458,7 +481,7 @@ int SymbolInput( int key, ChewingData *pgdata )
 
 		pgdata->bUserArrCnnct[ PhoneSeqCursor( pgdata ) ] = 0;
 		pgdata->chiSymbolCursor++;
-		pgdata->chiSymbolBufLen++;
+		GrowChiSymbolBuf( pgdata );
 		return SYMBOL_KEY_OK;
 	}
 	return SYMBOL_KEY_ERROR;
@@ -504,13 +527,18 @@ int WriteChiSymbolToBuf( wch_t csBuf[], int csBufLen, ChewingData *pgdata )
 	return 0;
 }
 
+/* whether ReleaseChiSymbolBuf() would commit, and so needs the phrasing */
+int ChiSymbolBufFull( ChewingData *pgdata )
+{
+	/* reserve ZUIN_SIZE positions for Zuin */
+	return pgdata->config.maxChiSymbolLen - ( pgdata->chiSymbolBufLen + ZUIN_SIZE ) <= 0;
+}
+
 static int CountReleaseNum( ChewingData *pgdata )
 {
-	int remain, i;
+	int i;
 
-	/* reserve ZUIN_SIZE positions for Zuin */
-	remain = pgdata->config.maxChiSymbolLen - (pgdata->chiSymbolBufLen + ZUIN_SIZE);
-	if ( remain > 0 )
+	if ( ! ChiSymbolBufFull( pgdata ) )
 		return 0;
 
 	qsort(
@@ -546,35 +574,40 @@ static void KillFromLeft( ChewingData *pgdata, int nKill )
 
 void CleanAllBuf( ChewingData *pgdata )
 {
+	/* nothing past chiSymbolBufUsed has been written since chewing_Reset */
+	int used = pgdata->chiSymbolBufUsed;
+
 	/* 1 */
 	pgdata->nPhoneSeq = 0 ;
-	memset( pgdata->phoneSeq, 0, sizeof( pgdata->phoneSeq ) );
+	memset( pgdata->phoneSeq, 0, sizeof( pgdata->phoneSeq[ 0 ] ) * used );
 	/* 2 */
 	pgdata->chiSymbolBufLen = 0;
-	memset( pgdata->chiSymbolBuf, 0, sizeof( pgdata->chiSymbolBuf ) );
+	memset( pgdata->chiSymbolBuf, 0, sizeof( pgdata->chiSymbolBuf[ 0 ] ) * used );
 	/* 3 */
-	memset( pgdata->bUserArrBrkpt, 0, sizeof( pgdata->bUserArrBrkpt ) );
+	memset( pgdata->bUserArrBrkpt, 0, sizeof( pgdata->bUserArrBrkpt[ 0 ] ) * ( used + 1 ) );
 	/* 4 */
 	pgdata->nSelect = 0;
 	/* 5 */
 	pgdata->chiSymbolCursor = 0;
 	/* 6 */
-	memset( pgdata->bUserArrCnnct, 0, sizeof( pgdata->bUserArrCnnct ) );
+	memset( pgdata->bUserArrCnnct, 0, sizeof( pgdata->bUserArrCnnct[ 0 ] ) * ( used + 1 ) );
 
 	pgdata->phrOut.nNumCut = 0;
 
-	memset( pgdata->symbolKeyBuf, 0, sizeof( pgdata->symbolKeyBuf ) );
+	memset( pgdata->symbolKeyBuf, 0, sizeof( pgdata->symbolKeyBuf[ 0 ] ) * used );
 
 	pgdata->nPrefer = 0;
 }
 
 int ReleaseChiSymbolBuf( ChewingData *pgdata, ChewingOutput *pgo )
 {
-	int throwEnd;
+	int throwEnd, nPhone;
 	uint16_t bufPhoneSeq[ MAX_PHONE_SEQ_LEN + 1 ];
 	char bufWordSeq[ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ];
 
 	throwEnd = CountReleaseNum( pgdata );
+	/* throwEnd counts the symbols too, chiPos only the phones phrased */
+	nPhone = throwEnd < pgdata->nPhoneSeq ? throwEnd : pgdata->nPhoneSeq;
 
 	pgo->nCommitStr = throwEnd;
 	if ( throwEnd ) {
@@ -585,10 +618,12 @@ int ReleaseChiSymbolBuf( ChewingData *pgdata, ChewingOutput *pgo )
 		WriteChiSymbolToBuf( pgo->commitStr, throwEnd, pgdata );
 
 		/* Add to userphrase */
-		memcpy( bufPhoneSeq, pgdata->phoneSeq, sizeof( uint16_t ) * throwEnd );
-		bufPhoneSeq[ throwEnd ] = (uint16_t) 0;
-		ueStrNCpy( bufWordSeq, pgdata->phrOut.chiBuf, throwEnd, 1 );
-		UserUpdatePhrase( pgdata, bufPhoneSeq, bufWordSeq );
+		memcpy( bufPhoneSeq, pgdata->phoneSeq, sizeof( uint16_t ) * nPhone );
+		bufPhoneSeq[ nPhone ] = (uint16_t) 0;
+		memcpy( bufWordSeq, pgdata->phrOut.chiBuf, pgdata->phrOut.chiPos[ nPhone ] );
+		bufWordSeq[ pgdata->phrOut.chiPos[ nPhone ] ] = '\0';
+		if ( nPhone > 0 )
+			UserUpdatePhrase( pgdata, bufPhoneSeq, bufWordSeq );
 
 		KillFromLeft( pgdata, throwEnd );
 	}
@@ -630,7 +665,7 @@ static int ChewingIsBreakPoint( int cursor, ChewingData *pgdata )
 		return 1;
 	else {
 		ueStrNCpy( buf,
-				ueStrSeek( (char *) &pgdata->phrOut.chiBuf, cursor ),
+				ChiBufSeek( &pgdata->phrOut, cursor ),
 				1, 1 );
 		for ( i = 0; (size_t) i < ARRAY_SIZE( break_word ); i++ ) {
 			if ( ! strcmp ( buf, break_word[ i ] ) )
@@ -645,7 +680,7 @@ void AutoLearnPhrase( ChewingData *pgdata )
 	uint16_t bufPhoneSeq[ MAX_PHONE_SEQ_LEN + 1 ];
 	char bufWordSeq[ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ];
 	int i, from, len;
-	int prev_pos = 0;
+	int prev_pos = 0, bytes = 0;
 	int pending = 0;
 
 	for ( i = 0; i < pgdata->nPrefer; i++ ) {
@@ -654,8 +689,8 @@ void AutoLearnPhrase( ChewingData *pgdata )
 		if ( len == 1 && ! ChewingIsBreakPoint( from, pgdata ) ) {
 			memcpy( bufPhoneSeq + prev_pos, &pgdata->phoneSeq[ from ], sizeof( uint16_t ) * len );
 			bufPhoneSeq[ prev_pos + len ] = (uint16_t) 0;
-			ueStrNCpy( ueStrSeek( bufWordSeq, prev_pos ),
-					ueStrSeek( (char *) &pgdata->phrOut.chiBuf, from ),
+			bytes += ueStrNCpy( bufWordSeq + bytes,
+					ChiBufSeek( &pgdata->phrOut, from ),
 					len, 1);
 			prev_pos += len;
 			pending = 1;
@@ -664,12 +699,13 @@ void AutoLearnPhrase( ChewingData *pgdata )
 			if ( pending ) {
 				UserUpdatePhrase( pgdata, bufPhoneSeq, bufWordSeq );
 				prev_pos = 0;
+				bytes = 0;
 				pending = 0;
 			}
 			memcpy( bufPhoneSeq, &pgdata->phoneSeq[ from ], sizeof( uint16_t ) * len );
 			bufPhoneSeq[ len ] = (uint16_t) 0;
 			ueStrNCpy( bufWordSeq,
-					ueStrSeek( (char *) &pgdata->phrOut.chiBuf, from ),
+					ChiBufSeek( &pgdata->phrOut, from ),
 					len, 1);
 			UserUpdatePhrase( pgdata, bufPhoneSeq, bufWordSeq );
 		}
@@ -719,7 +755,7 @@ int AddChi( uint16_t phone, ChewingData *pgdata )
 		sizeof( wch_t ) * ( pgdata->chiSymbolBufLen - pgdata->chiSymbolCursor ) );
 	/* "0" means Chinese word */
 	pgdata->chiSymbolBuf[ pgdata->chiSymbolCursor ].wch = 0;
-	pgdata->chiSymbolBufLen++;
+	GrowChiSymbolBuf( pgdata );
 	pgdata->chiSymbolCursor++;
 
 	return 0;
@@ -773,7 +809,11 @@ static void ShowChewingData( ChewingData *pgdata )
 }
 #endif
 
-int CallPhrasing( ChewingData *pgdata )
+/*
+ * The part of CallPhrasing() that changes the input: a select interval
+ * across a breakpoint is gone, whether phrasing follows now or later.
+ */
+void SetBreakpoints( ChewingData *pgdata )
 {
 	/* set "bSymbolArrBrkpt" && "bArrBrkpt" */
 	int i, ch_count = 0;
@@ -801,6 +841,11 @@ int CallPhrasing( ChewingData *pgdata )
 			ChewingKillSelectIntervalAcross( i, pgdata );
 		}
 	}
+}
+
+int CallPhrasing( ChewingData *pgdata )
+{
+	SetBreakpoints( pgdata );
 
 #ifdef ENABLE_DEBUG
 	ShowChewingData(pgdata);
@@ -1314,6 +1359,7 @@ int OpenSymbolChoice( ChewingData *pgdata )
 {
 	int i, symbol_buf_len = ARRAY_SIZE( symbol_buf );
 	char **pBuf;
+	char *str;
 	ChoiceInfo *pci = &( pgdata->choiceInfo );
 	pci->oldChiSymbolCursor = pgdata->chiSymbolCursor;
 
@@ -1338,8 +1384,9 @@ int OpenSymbolChoice( ChewingData *pgdata )
 	}
 	pci->nTotalChoice = 0;
 	for ( i = 1; pBuf[ i ]; i++ ) {
-		ueStrNCpy( pci->totalChoiceStr[ pci->nTotalChoice ], 
-				pBuf[ i ], ueStrLen( pBuf[i] ), 1 );
+		if ( ! ( str = ChoiceInfoAppend( pci ) ) )
+			break;
+		ueStrNCpy( str, pBuf[ i ], ueStrLen( pBuf[i] ), 1 );
 		pci->nTotalChoice++; 
 	}
 
@@ -1356,8 +1403,44 @@ int OpenSymbolChoice( ChewingData *pgdata )
 	return 0;
 }
 
-int InitSymbolTable( ChewingData *pgdata, const char *prefix )
+int InitSymbolTable( ChewingData *pgdata, const char *prefix UNUSED )
 {
+#ifdef USE_BINARY_DATA
+	const char *section;
+	SymbolEntry *entry;
+	size_t size, offset;
+	int32_t nEntry, nSymbols;
+	int i;
+
+	pgdata->static_data->n_symbol_entry = 0;
+	pgdata->static_data->symbol_table = NULL;
+
+	section = GetDataSection( pgdata, SECTION_SYMBOL_TABLE, &size );
+	if ( !section || size < 4 )
+		return -1;
+	nEntry = (int32_t) GetUint32LE( section );
+	if ( nEntry < 0 || (size_t) nEntry >= size / 4 )
+		return -1;
+
+	/* the entries stay in the section, only the table of them is allocated */
+	pgdata->static_data->symbol_table = ALC( SymbolEntry *, nEntry + 1 );
+	if ( !pgdata->static_data->symbol_table )
+		return -1;
+	for ( i = 0; i < nEntry; i++ ) {
+		offset = GetUint32LE( section + 4 * ( i + 1 ) );
+		if ( offset % 4 || offset > size ||
+				size - offset < offsetof( SymbolEntry, symbols ) )
+			return -1;
+		entry = (SymbolEntry *) ( section + offset );
+		nSymbols = SymbolCount( entry );
+		if ( nSymbols < 0 || (size_t) nSymbols > ( size - offset -
+				offsetof( SymbolEntry, symbols ) ) / sizeof( entry->symbols[ 0 ] ) )
+			return -1;
+		pgdata->static_data->symbol_table[ i ] = entry;
+	}
+	pgdata->static_data->n_symbol_entry = nEntry;
+	return 0;
+#else
 	static const int MAX_SYMBOL_ENTRY = 100;
 	static const size_t LINE_LEN = 512; // shall be long enough?
 
@@ -1367,8 +1450,8 @@ int InitSymbolTable( ChewingData *pgdata, const char *prefix )
 	SymbolEntry **entry = NULL;
 	int ret = -1;
 
-	pgdata->static_data.n_symbol_entry = 0;
-	pgdata->static_data.symbol_table = NULL;
+	pgdata->static_data->n_symbol_entry = 0;
+	pgdata->static_data->symbol_table = NULL;
 
 	ret = asprintf( &filename, "%s" PLAT_SEPARATOR "%s",
 		prefix, SYMBOL_TABLE_FILE );
@@ -1388,7 +1471,7 @@ int InitSymbolTable( ChewingData *pgdata, const char *prefix )
 		goto end;
 
 	while ( fgets( line, LINE_LEN, file ) &&
-		pgdata->static_data.n_symbol_entry < MAX_SYMBOL_ENTRY ) {
+		pgdata->static_data->n_symbol_entry < MAX_SYMBOL_ENTRY ) {
 
 		char *category_end = strpbrk( line, "=\r\n" );
 		if ( !category_end )
@@ -1399,19 +1482,19 @@ int InitSymbolTable( ChewingData *pgdata, const char *prefix )
 		if ( symbols_end ) {
 			int len = ueStrLen( symbols );
 
-			entry[ pgdata->static_data.n_symbol_entry ] =
+			entry[ pgdata->static_data->n_symbol_entry ] =
 				( SymbolEntry* ) malloc( sizeof ( entry[0][0] ) +
 					sizeof( entry[0][0].symbols[0] ) * len);
-			if ( !entry[ pgdata->static_data.n_symbol_entry ] )
+			if ( !entry[ pgdata->static_data->n_symbol_entry ] )
 				goto end;
-			entry[ pgdata->static_data.n_symbol_entry ]
+			entry[ pgdata->static_data->n_symbol_entry ]
 				->nSymbols = len;
 
 			char *symbol = symbols;
 
 			for ( int i = 0; i < len; ++i ) {
 				ueStrNCpy(
-					entry[ pgdata->static_data.n_symbol_entry ]->symbols[ i ],
+					entry[ pgdata->static_data->n_symbol_entry ]->symbols[ i ],
 					symbol, 1, 1 );
 				// FIXME: What if symbol is combining sequences.
 				symbol += ueBytesFromChar( symbol[0] );
@@ -1419,29 +1502,29 @@ int InitSymbolTable( ChewingData *pgdata, const char *prefix )
 
 
 		} else {
-			entry[ pgdata->static_data.n_symbol_entry ] =
+			entry[ pgdata->static_data->n_symbol_entry ] =
 				( SymbolEntry* ) malloc( sizeof ( entry[0][0] ) );
-			if ( !entry[ pgdata->static_data.n_symbol_entry ] )
+			if ( !entry[ pgdata->static_data->n_symbol_entry ] )
 				goto end;
 
-			entry[ pgdata->static_data.n_symbol_entry ]
+			entry[ pgdata->static_data->n_symbol_entry ]
 				->nSymbols = 0;
 		}
 
 		*category_end = 0;
 		ueStrNCpy(
-			entry[pgdata->static_data.n_symbol_entry]->category,
+			entry[pgdata->static_data->n_symbol_entry]->category,
 			line, MAX_PHRASE_LEN, 1);
 
-		++pgdata->static_data.n_symbol_entry;
+		++pgdata->static_data->n_symbol_entry;
 	}
 
-	size_t size = sizeof( *pgdata->static_data.symbol_table ) *
-		pgdata->static_data.n_symbol_entry;
-	pgdata->static_data.symbol_table = ( SymbolEntry ** ) malloc( size );
-	if ( !pgdata->static_data.symbol_table )
+	size_t size = sizeof( *pgdata->static_data->symbol_table ) *
+		pgdata->static_data->n_symbol_entry;
+	pgdata->static_data->symbol_table = ( SymbolEntry ** ) malloc( size );
+	if ( !pgdata->static_data->symbol_table )
 		goto end;
-	memcpy( pgdata->static_data.symbol_table, entry, size );
+	memcpy( pgdata->static_data->symbol_table, entry, size );
 
 	ret = 0;
 end:
@@ -1450,23 +1533,73 @@ end:
 	fclose( file );
 	free ( filename );
 	return ret;
+#endif
 }
 
 void TerminateSymbolTable( ChewingData *pgdata )
 {
+#ifndef USE_BINARY_DATA
 	unsigned int i;
-	if ( pgdata->static_data.symbol_table ) {
-		for ( i = 0; i < pgdata->static_data.n_symbol_entry; ++i )
-			free( pgdata->static_data.symbol_table[ i ] );
-		free( pgdata->static_data.symbol_table );
-		pgdata->static_data.n_symbol_entry = 0;
-		pgdata->static_data.symbol_table = NULL;
+#endif
+	if ( pgdata->static_data->symbol_table ) {
+#ifndef USE_BINARY_DATA
+		for ( i = 0; i < pgdata->static_data->n_symbol_entry; ++i )
+			free( pgdata->static_data->symbol_table[ i ] );
+#endif
+		free( pgdata->static_data->symbol_table );
+		pgdata->static_data->n_symbol_entry = 0;
+		pgdata->static_data->symbol_table = NULL;
 	}
 }
 
-int InitEasySymbolInput( ChewingData *pgdata, const char *prefix )
+/* heap bytes of the symbol tables, the symbols themselves are mapped */
+size_t SymbolTableBytes( ChewingData *pgdata )
 {
-	static const int MAX_EASY_SYMBOL_LEN = 10;
+	size_t size = 0;
+	unsigned int i;
+
+	if ( pgdata->static_data->symbol_table )
+		size += ( pgdata->static_data->n_symbol_entry + 1 ) * sizeof( SymbolEntry * );
+#ifndef USE_BINARY_DATA
+	/* read from the text files onto the heap */
+	for ( i = 0; i < pgdata->static_data->n_symbol_entry; i++ )
+		size += sizeof( SymbolEntry ) + pgdata->static_data->symbol_table[ i ]->nSymbols *
+			sizeof( pgdata->static_data->symbol_table[ i ]->symbols[ 0 ] );
+	for ( i = 0; i < EASY_SYMBOL_KEY_TAB_LEN; i++ ) {
+		if ( pgdata->static_data->g_easy_symbol_value[ i ] )
+			size += strlen( pgdata->static_data->g_easy_symbol_value[ i ] ) + 1;
+	}
+#else
+	(void) i;
+#endif
+	return size;
+}
+
+int InitEasySymbolInput( ChewingData *pgdata, const char *prefix UNUSED )
+{
+#ifdef USE_BINARY_DATA
+	EasySymbolRecord *record;
+	int32_t nSymbols;
+	size_t size;
+	int i;
+	STATIC_ASSERT( sizeof( EasySymbolRecord ) == 4 + sizeof( record->symbols ),
+		easy_symbol_record_is_packed );
+
+	record = GetDataSection( pgdata, SECTION_EASY_SYMBOL, &size );
+	if ( !record || size != EASY_SYMBOL_KEY_TAB_LEN * sizeof( EasySymbolRecord ) )
+		return -1;
+	for ( i = 0; i < EASY_SYMBOL_KEY_TAB_LEN; i++ ) {
+		nSymbols = (int32_t) GetUint32LE( &record[ i ].nSymbols );
+		if ( nSymbols <= 0 )
+			continue;
+		if ( nSymbols > MAX_EASY_SYMBOL_LEN ||
+				!memchr( record[ i ].symbols, '\0', sizeof( record[ i ].symbols ) ) )
+			return -1;
+		pgdata->static_data->g_easy_symbol_value[ i ] = record[ i ].symbols;
+		pgdata->static_data->g_easy_symbol_num[ i ] = nSymbols;
+	}
+	return 0;
+#else
 	static const size_t LINE_LEN = 512; // shall be long enough?
 
 	FILE *file = NULL;
@@ -1510,9 +1643,9 @@ int InitEasySymbolInput( ChewingData *pgdata, const char *prefix )
 
 		ueStrNCpy( symbol, &line[ 2 ], len, 1 );
 
-		free( pgdata->static_data.g_easy_symbol_value[ _index ] );
-		pgdata->static_data.g_easy_symbol_value[ _index ] = symbol;
-		pgdata->static_data.g_easy_symbol_num[ _index ] = len;
+		free( pgdata->static_data->g_easy_symbol_value[ _index ] );
+		pgdata->static_data->g_easy_symbol_value[ _index ] = symbol;
+		pgdata->static_data->g_easy_symbol_num[ _index ] = len;
 	}
 	ret = 0;
 end:
@@ -1520,17 +1653,20 @@ end:
 	fclose( file );
 	free ( filename );
 	return ret;
+#endif
 }
 
 void TerminateEasySymbolTable( ChewingData *pgdata )
 {
 	unsigned int i;
 	for ( i = 0; i < EASY_SYMBOL_KEY_TAB_LEN / sizeof( char ); ++i ) {
-		if ( NULL != pgdata->static_data.g_easy_symbol_value[ i ] ) {
-			free( pgdata->static_data.g_easy_symbol_value[ i ] );
-			pgdata->static_data.g_easy_symbol_value[ i ] = NULL;
+		if ( NULL != pgdata->static_data->g_easy_symbol_value[ i ] ) {
+#ifndef USE_BINARY_DATA
+			free( pgdata->static_data->g_easy_symbol_value[ i ] );
+#endif
+			pgdata->static_data->g_easy_symbol_value[ i ] = NULL;
 		}
-		pgdata->static_data.g_easy_symbol_num[ i ] = 0;
+		pgdata->static_data->g_easy_symbol_num[ i ] = 0;
 	}
 }
 
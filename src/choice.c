@@ -18,6 +18,7 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 
 #include "chewing-definition.h"
@@ -28,12 +29,23 @@
 #include "chewingutil.h"
 #include "tree-private.h"
 #include "userphrase-private.h"
+#include "hash-private.h"
 #include "choice-private.h"
 #include "private.h"
 #include "zuin-private.h"
 
 #define CEIL_DIV( a, b ) 	( ( a + b - 1 ) / b )
 
+/* slots of ChoiceSet, a power of 2 above twice MAX_CHOICE */
+#define CHOICE_SET_SIZE 2048
+
+/* the candidates of the list being filled, by the hash of their string */
+typedef struct {
+	uint16_t slot[ CHOICE_SET_SIZE ];	/* index + 1 in totalChoiceStr, 0 if free */
+} ChoiceSet;
+
+STATIC_ASSERT( CHOICE_SET_SIZE >= 2 * MAX_CHOICE, choice_set_at_most_half_full );
+
 static void ChangeSelectIntervalAndBreakpoint(
 		ChewingData *pgdata,
 		int from,
@@ -73,16 +85,16 @@ static void ChangeSelectIntervalAndBreakpoint(
 }
 
 /** @brief Loading all possible phrases after the cursor from long to short into AvailInfo structure.*/
-static void SetAvailInfo( ChewingData *pgdata, int begin, int end)
+static void SetAvailInfo( ChewingData *pgdata, AvailInfo *pai, int begin, int end)
 {
-	AvailInfo *pai = &( pgdata->availInfo );
 	const uint16_t *phoneSeq = pgdata->phoneSeq;
 	int nPhoneSeq = pgdata->nPhoneSeq;
 	const int *bSymbolArrBrkpt = pgdata->bSymbolArrBrkpt;
 
-	int pho_id;
 	int diff;
-	uint16_t userPhoneSeq[ MAX_PHONE_SEQ_LEN ];
+	TreeCursor cur;
+	int cur_end;
+	SpanInfo info;
 
 	int i, head, head_tmp;
 	int tail, tail_tmp;
@@ -113,23 +125,29 @@ static void SetAvailInfo( ChewingData *pgdata, int begin, int end)
 		tail_tmp = begin;
 	}
 
+	/* spans grow to the right in forward mode, so the tree cursor can be
+	 * extended one phone at a time */
+	TreeCursorInit( pgdata, &cur );
+	cur_end = head_tmp - 1;
 	while ( head <= head_tmp && tail_tmp <= tail ) {
 		diff = tail_tmp - head_tmp;
-		pho_id = TreeFindPhrase( pgdata, head_tmp, tail_tmp, phoneSeq );
+		if ( pgdata->config.bPhraseChoiceRearward ) {
+			GetSpanInfo( pgdata, &phoneSeq[ head_tmp ], diff + 1, &info );
+		} else if ( ! FindSpanInfo( pgdata, &phoneSeq[ head_tmp ], diff + 1, &info ) ) {
+			while ( cur_end < tail_tmp )
+				TreeCursorAdvance( pgdata, &cur, phoneSeq[ ++cur_end ] );
+			AddSpanInfo( pgdata, &phoneSeq[ head_tmp ], diff + 1,
+				TreeCursorPhraseId( pgdata, &cur ), &info );
+		}
 
-		if ( pho_id != -1 ) {
+		if ( info.pho_id != -1 ) {
 			/* save it! */
 			pai->avail[ pai->nAvail ].len = diff + 1;
-			pai->avail[ pai->nAvail ].id = pho_id;
+			pai->avail[ pai->nAvail ].id = info.pho_id;
 			pai->nAvail++;
 		}
 		else {
-			memcpy(
-				userPhoneSeq, 
-				&phoneSeq[ head_tmp ],
-				sizeof( uint16_t ) * ( diff + 1 ) ) ;
-			userPhoneSeq[ diff + 1 ] = 0;
-			if ( UserGetPhraseFirst( pgdata, userPhoneSeq ) ) {
+			if ( info.bUserPhrase ) {
 				/* save it! */
 				pai->avail[ pai->nAvail ].len = diff + 1;
 				pai->avail[ pai->nAvail ].id = -1;
@@ -148,32 +166,194 @@ static void SetAvailInfo( ChewingData *pgdata, int begin, int end)
 	}
 }
 
-/* FIXME: Improper use of len parameter */
-static int ChoiceTheSame( ChoiceInfo *pci, char *str, int len )
+/**
+ * @brief room for one more candidate, at totalChoiceStr[ nTotalChoice ]
+ *
+ * The list grows as it is filled, and is freed when the choice ends, so
+ * that a context without a choice list open keeps no room for one.
+ *
+ * @return NULL if the list has MAX_CHOICE candidates, or if out of memory
+ */
+char *ChoiceInfoAppend( ChoiceInfo *pci )
+{
+	int nAlloc;
+	void *grown;
+
+	if ( pci->nTotalChoice == pci->nChoiceAlloc ) {
+		if ( pci->nChoiceAlloc == MAX_CHOICE )
+			return NULL;
+		nAlloc = pci->nChoiceAlloc ? min( pci->nChoiceAlloc * 2, MAX_CHOICE ) : 16;
+		grown = realloc( pci->totalChoiceStr, nAlloc * sizeof( pci->totalChoiceStr[ 0 ] ) );
+		if ( ! grown )
+			return NULL;
+		pci->totalChoiceStr = grown;
+		grown = realloc( pci->choiceScore, nAlloc * sizeof( pci->choiceScore[ 0 ] ) );
+		if ( ! grown )
+			return NULL;
+		pci->choiceScore = grown;
+		pci->nChoiceAlloc = nAlloc;
+	}
+	return pci->totalChoiceStr[ pci->nTotalChoice ];
+}
+
+/* free the candidates, the list is empty after */
+void TerminateChoice( ChewingData *pgdata )
 {
+	free( pgdata->choiceInfo.totalChoiceStr );
+	pgdata->choiceInfo.totalChoiceStr = NULL;
+	free( pgdata->choiceInfo.choiceScore );
+	pgdata->choiceInfo.choiceScore = NULL;
+	pgdata->choiceInfo.nChoiceAlloc = 0;
+	pgdata->choiceInfo.nTotalChoice = 0;
+}
+
+static unsigned int ChoiceHash( const char *str, int len )
+{
+	unsigned int hash = 2166136261u;
 	int i;
 
-	for ( i = 0; i < pci->nTotalChoice; i++ )
-		if ( ! memcmp( pci->totalChoiceStr[ i ], str, len ) ) 
-			return 1;
+	/* FNV-1a */
+	for ( i = 0; i < len; i++ )
+		hash = ( hash ^ (unsigned char) str[ i ] ) * 16777619u;
+	return hash;
+}
+
+/**
+ * @brief append the len bytes of str to the list, unless it is there already
+ *
+ * A phrase both in the dictionary and of the user keeps the higher of its
+ * two frequencies.
+ *
+ * @return 0 if appended or already there, -1 if the list is full
+ */
+static int ChoiceInfoAdd( ChoiceInfo *pci, ChoiceSet *set, const char *str, int len, int freq )
+{
+	unsigned int h;
+	const char *other;
+	char *dst;
+	ChoiceScore *score;
+
+	for ( h = ChoiceHash( str, len ) & ( CHOICE_SET_SIZE - 1 ); set->slot[ h ];
+			h = ( h + 1 ) & ( CHOICE_SET_SIZE - 1 ) ) {
+		other = pci->totalChoiceStr[ set->slot[ h ] - 1 ];
+		if ( ! memcmp( other, str, len ) && other[ len ] == '\0' ) {
+			score = &pci->choiceScore[ set->slot[ h ] - 1 ];
+			if ( score->freq < freq )
+				score->freq = freq;
+			return 0;
+		}
+	}
+	dst = ChoiceInfoAppend( pci );
+	if ( ! dst )
+		return -1;
+	memcpy( dst, str, len );
+	dst[ len ] = '\0';
+	pci->choiceScore[ pci->nTotalChoice ].freq = freq;
+	pci->choiceScore[ pci->nTotalChoice ].order = pci->nTotalChoice;
+	set->slot[ h ] = ++pci->nTotalChoice;
 	return 0;
 }
 
-static void ChoiceInfoAppendChi( ChewingData *pgdata,  ChoiceInfo *pci, uint16_t phone )
+/* candidate a is shown before b: the more frequent, then the one found first */
+static int ChoiceBefore( const ChoiceScore *a, const ChoiceScore *b )
+{
+	if ( a->freq != b->freq )
+		return a->freq > b->freq;
+	return a->order < b->order;
+}
+
+/* heap of n candidates, the one shown last of them on top */
+static void ChoiceHeapDown( const ChoiceScore *score, int *heap, int n, int i )
+{
+	int top = heap[ i ];
+	int child;
+
+	while ( ( child = 2 * i + 1 ) < n ) {
+		if ( child + 1 < n &&
+				ChoiceBefore( &score[ heap[ child ] ], &score[ heap[ child + 1 ] ] ) )
+			child++;
+		if ( ! ChoiceBefore( &score[ top ], &score[ heap[ child ] ] ) )
+			break;
+		heap[ i ] = heap[ child ];
+		i = child;
+	}
+	heap[ i ] = top;
+}
+
+static void ChoiceSwap( ChoiceInfo *pci, int i, int j )
+{
+	char str[ sizeof( pci->totalChoiceStr[ 0 ] ) ];
+	ChoiceScore score;
+
+	memcpy( str, pci->totalChoiceStr[ i ], sizeof( str ) );
+	memcpy( pci->totalChoiceStr[ i ], pci->totalChoiceStr[ j ], sizeof( str ) );
+	memcpy( pci->totalChoiceStr[ j ], str, sizeof( str ) );
+	score = pci->choiceScore[ i ];
+	pci->choiceScore[ i ] = pci->choiceScore[ j ];
+	pci->choiceScore[ j ] = score;
+}
+
+/**
+ * @brief put the candidates up to index, and the rest of its page, in order
+ *
+ * A ranked list is filled unordered, and ranked a page at a time when a
+ * page is read: a heap of the page picks it out of the candidates not
+ * ranked yet, so that showing a page costs O( n log candPerPage ), and the
+ * pages nobody turns to are never sorted.
+ */
+void ChoiceRank( ChoiceInfo *pci, int index )
+{
+	int heap[ MAX_SELKEY ], best[ MAX_SELKEY ];
+	const ChoiceScore *score = pci->choiceScore;
+	int from, n, i, j;
+
+	if ( pci->isSymbol )
+		return;
+	while ( pci->nChoiceRanked <= index && pci->nChoiceRanked < pci->nTotalChoice ) {
+		from = pci->nChoiceRanked;
+		n = min( min( pci->nChoicePerPage, MAX_SELKEY ), pci->nTotalChoice - from );
+		if ( n <= 0 )
+			return;
+
+		/* the best n of the candidates after from */
+		for ( i = 0; i < n; i++ )
+			heap[ i ] = from + i;
+		for ( i = n / 2 - 1; i >= 0; i-- )
+			ChoiceHeapDown( score, heap, n, i );
+		for ( i = from + n; i < pci->nTotalChoice; i++ ) {
+			if ( ChoiceBefore( &score[ i ], &score[ heap[ 0 ] ] ) ) {
+				heap[ 0 ] = i;
+				ChoiceHeapDown( score, heap, n, 0 );
+			}
+		}
+		for ( i = n; i > 0; i-- ) {
+			best[ i - 1 ] = heap[ 0 ];
+			heap[ 0 ] = heap[ i - 1 ];
+			ChoiceHeapDown( score, heap, i - 1, 0 );
+		}
+
+		/* move them to the front, in order */
+		for ( i = 0; i < n; i++ ) {
+			if ( best[ i ] == from + i )
+				continue;
+			ChoiceSwap( pci, from + i, best[ i ] );
+			for ( j = i + 1; j < n; j++ ) {
+				if ( best[ j ] == from + i )
+					best[ j ] = best[ i ];
+			}
+		}
+		pci->nChoiceRanked = from + n;
+	}
+}
+
+static void ChoiceInfoAppendChi( ChewingData *pgdata, ChoiceInfo *pci, ChoiceSet *set, uint16_t phone )
 {
 	Word tempWord;
+
 	GetCharFirst( pgdata, &tempWord, phone );
 	do {
-		if ( ChoiceTheSame( pci, tempWord.word,
-		                    ueBytesFromChar( tempWord.word[ 0 ] ) * sizeof( char ) ) )
-			continue;
-		memcpy( 
-			pci->totalChoiceStr[ pci->nTotalChoice ],
-			tempWord.word, ueBytesFromChar( tempWord.word[ 0 ] ) * sizeof( char ) );
-		assert( pci->nTotalChoice <= MAX_CHOICE );
-		pci->totalChoiceStr[ pci->nTotalChoice ]
-		                   [ ueBytesFromChar( tempWord.word[ 0 ] ) ] = '\0';
-		pci->nTotalChoice++;
+		if ( ChoiceInfoAdd( pci, set, tempWord.word, ueBytesFromChar( tempWord.word[ 0 ] ), 0 ) )
+			break;
 	} while ( GetCharNext( pgdata, &tempWord ) );
 }
 
@@ -183,91 +363,90 @@ static void ChoiceInfoAppendChi( ChewingData *pgdata,  ChoiceInfo *pci, uint16_t
  * from static and dynamic dictionaries, including number of total pages and
  * the number of current page.
  */
-static void SetChoiceInfo( ChewingData *pgdata )
+static void FillChoiceInfo( ChewingData *pgdata, ChoiceInfo *pci, const AvailInfo *pai, int cursor )
 {
 	Phrase tempPhrase;
 	int len;
+	int size;
+	ChoiceSet set;
 	UserPhraseData *pUserPhraseData;
+	UserPhraseIter iter;
 	uint16_t userPhoneSeq[ MAX_PHONE_SEQ_LEN ];
+	SpanInfo info;
 
-	ChoiceInfo *pci = &( pgdata->choiceInfo );
-	AvailInfo *pai = &( pgdata->availInfo );
 	uint16_t *phoneSeq = pgdata->phoneSeq;
-	int cursor = PhoneSeqCursor( pgdata );
 	int candPerPage = pgdata->config.candPerPage;
 
 	/* Clears previous candidates. */
-	memset( pci->totalChoiceStr, '\0',
-		sizeof(char) * MAX_CHOICE * MAX_PHRASE_LEN * MAX_UTF8_SIZE + 1);
-
 	pci->nTotalChoice = 0;
+	memset( &set, 0, sizeof( set ) );
 	len = pai->avail[ pai->currentAvail ].len;
 	assert(len);
 
 	/* secondly, read tree phrase */
 	if ( len == 1 ) { /* single character */
-		ChoiceInfoAppendChi( pgdata, pci, phoneSeq[cursor] );
+		ChoiceInfoAppendChi( pgdata, pci, &set, phoneSeq[cursor] );
 		if ( pgdata->zuinData.kbtype == KB_HSU ||
 		     pgdata->zuinData.kbtype == KB_DVORAK_HSU ) {
 			switch ( phoneSeq[ cursor ] ) {
 				case 0x2800:	/* 'ㄘ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x30 );		/* 'ㄟ' */
 					break;
 				case 0x80:	/* 'ㄧ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x20 );		/* 'ㄝ' */
 					break;
 				case 0x2A00:	/* 'ㄙ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x1 );		/* '˙' */
 					break;
 				case 0xA00:	/* 'ㄉ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x2 );		/* 'ˊ' */
 					break;
 				case 0x800:	/* 'ㄈ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x3 ); 		/* 'ˇ' */
 					break;
 				case 0x18:	/* 'ㄜ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x1200 );	/* 'ㄍ' */
 					break;
 				case 0x10:	/* 'ㄛ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x1600 );	/* 'ㄏ' */
 					break;
 				case 0x1E00:	/* 'ㄓ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x1800 );	/* 'ㄐ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x4 );		/* 'ˋ' */
 					break;
 				case 0x58:	/* 'ㄤ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x1400 );	/* 'ㄎ' */
 					break;
 				case 0x68:	/* 'ㄦ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x1000 );	/* 'ㄌ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x60 );		/* 'ㄥ' */
 					break;
 				case 0x2200:	/* 'ㄕ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x1C00 );	/* 'ㄒ' */
 					break;
 				case 0x2000:	/* 'ㄔ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x1A00 );	/* 'ㄑ' */
 					break;
 				case 0x50:	/* 'ㄣ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0xE00 );	/* 'ㄋ' */
 					break;
 				case 0x48:	/* 'ㄢ' */
-					ChoiceInfoAppendChi( pgdata, pci,
+					ChoiceInfoAppendChi( pgdata, pci, &set,
 						0x600 );	/* 'ㄇ' */
 					break;
 				default:
@@ -278,40 +457,31 @@ static void SetChoiceInfo( ChewingData *pgdata )
 	/* phrase */
 	else {
 		if ( pai->avail[ pai->currentAvail ].id != -1 ) {
-			GetPhraseFirst( pgdata, &tempPhrase, pai->avail[ pai->currentAvail ].id );
+			/* the dictionary knows the bytes of each phrase */
+			size = GetPhraseFirst( pgdata, &tempPhrase, pai->avail[ pai->currentAvail ].id );
 			do {
-				if ( ChoiceTheSame( 
-					pci, 
-					tempPhrase.phrase, 
-					len * ueBytesFromChar( tempPhrase.phrase[0] ) * sizeof( char ) ) ) {
-					continue;
-				}
-				ueStrNCpy( pci->totalChoiceStr[ pci->nTotalChoice ],
-						tempPhrase.phrase, len, 1);
-				pci->nTotalChoice++;
-			} while( GetPhraseNext( pgdata, &tempPhrase ) );
+				if ( ChoiceInfoAdd( pci, &set, tempPhrase.phrase, size, tempPhrase.freq ) )
+					break;
+			} while( ( size = GetPhraseNext( pgdata, &tempPhrase ) ) );
 		}
 
 		memcpy( userPhoneSeq, &phoneSeq[ cursor ], sizeof( uint16_t ) * len );
 		userPhoneSeq[ len ] = 0;
-		pUserPhraseData = UserGetPhraseFirst( pgdata, userPhoneSeq );
+		GetSpanInfo( pgdata, userPhoneSeq, len, &info );
+		HashReadBegin( pgdata );
+		pUserPhraseData = info.bUserPhrase ?
+			UserGetPhraseFirst( pgdata, &iter, userPhoneSeq ) : NULL;
 		if ( pUserPhraseData ) {
 			do {
-				/* check if the phrase is already in the choice list */
-				if ( ChoiceTheSame( 
-					pci, 
-					pUserPhraseData->wordSeq, 
-					len * ueBytesFromChar( pUserPhraseData->wordSeq[0] ) * sizeof( char ) ) )
-					continue;
-				/* otherwise store it */
-				ueStrNCpy(
-						pci->totalChoiceStr[ pci->nTotalChoice ],
-						pUserPhraseData->wordSeq,
-						len, 1);
-				pci->nTotalChoice++;
+				/* unless the dictionary has it too */
+				if ( ChoiceInfoAdd( pci, &set, pUserPhraseData->wordSeq,
+						ueStrNBytes( pUserPhraseData->wordSeq, len ),
+						pUserPhraseData->userfreq ) )
+					break;
 			} while ( ( pUserPhraseData = 
-				    UserGetPhraseNext( pgdata, userPhoneSeq ) ) != NULL );
+				    UserGetPhraseNext( pgdata, &iter ) ) != NULL );
 		}
+		HashReadEnd( pgdata );
 
 	}
 
@@ -319,6 +489,31 @@ static void SetChoiceInfo( ChewingData *pgdata )
 	pci->nChoicePerPage = candPerPage;
 	pci->nPage = CEIL_DIV( pci->nTotalChoice, pci->nChoicePerPage );
 	pci->pageNo = 0;
+
+	/* characters have no frequency, they keep the order of the dictionary */
+	pci->nChoiceRanked = ( pgdata->bRankCandidates && len > 1 ) ? 0 : pci->nTotalChoice;
+	ChoiceRank( pci, 0 );
+}
+
+/* the candidate list of pgdata is open */
+static void CountChoiceInfo( ChewingData *pgdata )
+{
+	ChoiceInfo *pci = &( pgdata->choiceInfo );
+
+	TRACE_EVENT( pgdata, .type = CHEWING_TRACE_CANDIDATE_OPEN,
+		.nPhone = pgdata->availInfo.avail[ pgdata->availInfo.currentAvail ].len,
+		.nCandidate = pci->nTotalChoice );
+	pgdata->stats.nCandList++;
+	pgdata->stats.nCandidate += pci->nTotalChoice;
+	if ( pgdata->stats.maxCandidate < (unsigned long) pci->nTotalChoice )
+		pgdata->stats.maxCandidate = pci->nTotalChoice;
+}
+
+static void SetChoiceInfo( ChewingData *pgdata )
+{
+	FillChoiceInfo( pgdata, &( pgdata->choiceInfo ), &( pgdata->availInfo ),
+		PhoneSeqCursor( pgdata ) );
+	CountChoiceInfo( pgdata );
 }
 
 /*
@@ -337,30 +532,147 @@ static int SeekPhraseHead( ChewingData *pgdata )
 	return 0;
 }
 
-/** @brief Enter choice mode and relating initialisations. */
-int ChoiceFirstAvail( ChewingData *pgdata )
+/* move the cursor to where ChoiceFirstAvail() opens the choice, and find its span */
+static void ChoiceSpan( ChewingData *pgdata, int *begin, int *end )
 {
-	int end, begin;
-
-	/* save old cursor position */
-	pgdata->choiceInfo.oldChiSymbolCursor = pgdata->chiSymbolCursor;
-
 	/* see if there is some word in the cursor position */
 	if ( pgdata->chiSymbolBufLen == pgdata->chiSymbolCursor ) {
 		pgdata->chiSymbolCursor--;
 	}
 
-	end = PhoneSeqCursor( pgdata );
+	*end = PhoneSeqCursor( pgdata );
 
 	if ( pgdata->config.bPhraseChoiceRearward ) {
 		pgdata->chiSymbolCursor = SeekPhraseHead( pgdata ) +
 			CountSymbols( pgdata, pgdata->chiSymbolCursor );
 	}
-	begin = PhoneSeqCursor( pgdata );
+	*begin = PhoneSeqCursor( pgdata );
+}
+
+/* whether prepared is for the span, as the input and settings are now */
+static int PreparedMatch( ChewingData *pgdata, int begin, int end )
+{
+	const PreparedChoice *prepared = &( pgdata->prepared );
+
+	return prepared->stage != PREPARED_NONE &&
+		prepared->begin == begin && prepared->end == end &&
+		prepared->nPhoneSeq == pgdata->nPhoneSeq &&
+		! memcmp( prepared->phoneSeq, pgdata->phoneSeq,
+			sizeof( uint16_t ) * pgdata->nPhoneSeq ) &&
+		! memcmp( prepared->bSymbolArrBrkpt, pgdata->bSymbolArrBrkpt,
+			sizeof( int ) * ( pgdata->nPhoneSeq + 1 ) ) &&
+		prepared->kbtype == pgdata->zuinData.kbtype &&
+		prepared->bPhraseChoiceRearward == pgdata->config.bPhraseChoiceRearward &&
+		prepared->candPerPage == pgdata->config.candPerPage &&
+		prepared->bRankCandidates == pgdata->bRankCandidates &&
+		prepared->hashGeneration == HashGeneration( pgdata );
+}
+
+/* free the candidates prepared, nothing is prepared after */
+void ChoiceDropPrepared( ChewingData *pgdata )
+{
+	free( pgdata->prepared.choiceInfo.totalChoiceStr );
+	free( pgdata->prepared.choiceInfo.choiceScore );
+	memset( &( pgdata->prepared.choiceInfo ), 0, sizeof( ChoiceInfo ) );
+	pgdata->prepared.stage = PREPARED_NONE;
+}
+
+/**
+ * @brief prepare what ChoiceFirstAvail() would open at the cursor
+ *
+ * The lengths of phrases are found first, then the candidates of the
+ * longest, each step only if deadline, of PLAT_CLOCK_NSEC(), has not
+ * passed. What is prepared is kept until the input or a setting it
+ * depends on changes.
+ *
+ * @return 1 if there is more to prepare, 0 if not
+ */
+int ChoicePrepare( ChewingData *pgdata, unsigned long long deadline )
+{
+	PreparedChoice *prepared = &( pgdata->prepared );
+	int cursor = pgdata->chiSymbolCursor;
+	int begin, end;
+
+	if ( pgdata->bSelect || pgdata->chiSymbolBufLen == 0 )
+		return 0;
+	if ( ! ChewingIsChiAt( cursor == pgdata->chiSymbolBufLen ? cursor - 1 : cursor, pgdata ) )
+		return 0;
+	ChoiceSpan( pgdata, &begin, &end );
+	pgdata->chiSymbolCursor = cursor;
+
+	if ( ! PreparedMatch( pgdata, begin, end ) ) {
+		prepared->stage = PREPARED_NONE;
+		prepared->begin = begin;
+		prepared->end = end;
+		prepared->nPhoneSeq = pgdata->nPhoneSeq;
+		memcpy( prepared->phoneSeq, pgdata->phoneSeq,
+			sizeof( uint16_t ) * pgdata->nPhoneSeq );
+		memcpy( prepared->bSymbolArrBrkpt, pgdata->bSymbolArrBrkpt,
+			sizeof( int ) * ( pgdata->nPhoneSeq + 1 ) );
+		prepared->kbtype = pgdata->zuinData.kbtype;
+		prepared->bPhraseChoiceRearward = pgdata->config.bPhraseChoiceRearward;
+		prepared->candPerPage = pgdata->config.candPerPage;
+		prepared->bRankCandidates = pgdata->bRankCandidates;
+		prepared->hashGeneration = HashGeneration( pgdata );
+	}
+
+	if ( prepared->stage == PREPARED_NONE ) {
+		if ( PLAT_CLOCK_NSEC() >= deadline )
+			return 1;
+		SetAvailInfo( pgdata, &( prepared->availInfo ), begin, end );
+		prepared->availInfo.currentAvail = prepared->availInfo.nAvail - 1;
+		prepared->stage = PREPARED_AVAIL;
+	}
+	if ( prepared->stage == PREPARED_AVAIL && prepared->availInfo.nAvail ) {
+		if ( PLAT_CLOCK_NSEC() >= deadline )
+			return 1;
+		FillChoiceInfo( pgdata, &( prepared->choiceInfo ), &( prepared->availInfo ), begin );
+		prepared->stage = PREPARED_CHOICE;
+	}
+	return 0;
+}
+
+/** @brief Enter choice mode and relating initialisations. */
+int ChoiceFirstAvail( ChewingData *pgdata )
+{
+	PreparedChoice *prepared = &( pgdata->prepared );
+	ChoiceInfo *pci = &( pgdata->choiceInfo );
+	int end, begin;
+
+	/* save old cursor position */
+	pci->oldChiSymbolCursor = pgdata->chiSymbolCursor;
+
+	ChoiceSpan( pgdata, &begin, &end );
 
 	pgdata->bSelect = 1;
 
-	SetAvailInfo( pgdata, begin, end );
+	/* what chewing_idle() prepared, if the span is still the same */
+	if ( PreparedMatch( pgdata, begin, end ) ) {
+		pgdata->availInfo = prepared->availInfo;
+		if ( ! pgdata->availInfo.nAvail ) {
+			ChoiceDropPrepared( pgdata );
+			return ChoiceEndChoice( pgdata );
+		}
+		if ( prepared->stage == PREPARED_CHOICE ) {
+			TerminateChoice( pgdata );
+			pci->totalChoiceStr = prepared->choiceInfo.totalChoiceStr;
+			pci->choiceScore = prepared->choiceInfo.choiceScore;
+			pci->nChoiceAlloc = prepared->choiceInfo.nChoiceAlloc;
+			pci->nTotalChoice = prepared->choiceInfo.nTotalChoice;
+			pci->nChoiceRanked = prepared->choiceInfo.nChoiceRanked;
+			pci->nChoicePerPage = prepared->choiceInfo.nChoicePerPage;
+			pci->nPage = prepared->choiceInfo.nPage;
+			pci->pageNo = 0;
+			memset( &( prepared->choiceInfo ), 0, sizeof( ChoiceInfo ) );
+			CountChoiceInfo( pgdata );
+		} else {
+			SetChoiceInfo( pgdata );
+		}
+		ChoiceDropPrepared( pgdata );
+		return 0;
+	}
+
+	SetAvailInfo( pgdata, &( pgdata->availInfo ), begin, end );
 
 	if ( ! pgdata->availInfo.nAvail )
 		return ChoiceEndChoice( pgdata );
@@ -393,7 +705,7 @@ int ChoiceNextAvail( ChewingData *pgdata )
 int ChoiceEndChoice( ChewingData *pgdata )
 {
 	pgdata->bSelect = 0;
-	pgdata->choiceInfo.nTotalChoice = 0;
+	TerminateChoice( pgdata );
 	pgdata->choiceInfo.nPage = 0;
 
 	if ( pgdata->choiceInfo.isSymbol != 1 || pgdata->choiceInfo.isSymbol != 2 ) {
@@ -9,9 +9,14 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include "chewing-utf8-util.h"
 
+/* the low and the high bit of every byte of a word */
+#define LOW_BITS	( ~(uint64_t) 0 / 0xff )
+#define HIGH_BITS	( LOW_BITS * 0x80 )
+
 /* Table of UTF-8 length */
 static char utf8len_tab[256] =
 {
@@ -25,15 +30,32 @@ static char utf8len_tab[256] =
 	3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,4,4,4,4,4,4,4,4,5,5,5,5,6,6,1,1,
 };
 
-/* Return length of UTF-8 string */
+/*
+ * Return length of UTF-8 string
+ *
+ * Every byte but the continuation ones, 10xxxxxx, starts a character, so
+ * the characters are counted eight bytes at a time; the bytes of a word
+ * are summed by the multiplication, in whatever order they are. A stray
+ * continuation byte is no character, and a truncated one at the end is.
+ * strlen() of the C library is already the fastest the machine has, and
+ * bounds the words, so nothing after the terminator is read.
+ */
 int ueStrLen( const char *str )
 {
+	size_t nByte = strlen( str );
+	size_t i;
+	uint64_t word, cont;
 	int length = 0;
-	const char *strptr = str;
 
-	while ( strptr[ 0 ] != '\0' ) {
-		strptr += ueBytesFromChar( strptr[0] );
-		++length;
+	for ( i = 0; i + sizeof( word ) <= nByte; i += sizeof( word ) ) {
+		memcpy( &word, str + i, sizeof( word ) );
+		/* bit 7 set and bit 6, shifted up to it, clear */
+		cont = word & ~( word << 1 ) & HIGH_BITS;
+		length += sizeof( word ) - (int) ( ( ( cont >> 7 ) * LOW_BITS ) >> 56 );
+	}
+	for ( ; i < nByte; i++ ) {
+		if ( ( str[ i ] & 0xc0 ) != 0x80 )
+			++length;
 	}
 	return length;
 }
@@ -48,9 +70,9 @@ int ueBytesFromChar( unsigned char b )
 int ueStrNBytes( const char *str, int n )
 {
 	int i = 0, len = 0;
-	char *iter = (char *) str;
+	const unsigned char *iter = (const unsigned char *) str;
 	for ( i = 0; i < n; i++ ) {
-		len += ueBytesFromChar( iter[ len ] );
+		len += utf8len_tab[ iter[ len ] ];
 	}
 	return len;
 }
@@ -71,7 +93,7 @@ char *ueStrSeek( char *src, size_t n )
 	size_t i = 0;
 	char *iter = src;
 	for ( i = 0; i < n; i++ ) {
-		iter += ueBytesFromChar( iter[0] );
+		iter += utf8len_tab[ (unsigned char) iter[0] ];
 	}
 	return iter;
 }
@@ -0,0 +1,114 @@
+/**
+ * container.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file container.c
+ * @brief static data container, shared by the library and the data tools
+ */
+
+#include <string.h>
+
+#include "container-private.h"
+
+/* CRC-32 as used by zlib, polynomial 0xedb88320 */
+uint32_t ContainerChecksum( const void *data, size_t size )
+{
+	const unsigned char *b = data;
+	uint32_t table[ 256 ];
+	uint32_t crc;
+	size_t i;
+	int k;
+
+	for ( i = 0; i < 256; i++ ) {
+		crc = i;
+		for ( k = 0; k < 8; k++ )
+			crc = ( crc & 1 ) ? 0xedb88320 ^ ( crc >> 1 ) : crc >> 1;
+		table[ i ] = crc;
+	}
+
+	crc = 0xffffffff;
+	for ( i = 0; i < size; i++ )
+		crc = table[ ( crc ^ b[ i ] ) & 0xff ] ^ ( crc >> 8 );
+	return crc ^ 0xffffffff;
+}
+
+static const unsigned char *GetEntry( const void *base, uint32_t i )
+{
+	return (const unsigned char *) base +
+		CONTAINER_HEADER_SIZE + i * CONTAINER_ENTRY_SIZE;
+}
+
+int ContainerCheck( const void *base, size_t size )
+{
+	const unsigned char *entry;
+	uint32_t nSection, offset, section_size;
+	uint32_t i;
+
+	if ( size < CONTAINER_HEADER_SIZE )
+		return -1;
+	if ( memcmp( base, CONTAINER_MAGIC, CONTAINER_MAGIC_LEN ) )
+		return -1;
+	if ( GetUint32LE( (const char *) base + 8 ) != CONTAINER_VERSION )
+		return -1;
+
+	nSection = GetUint32LE( (const char *) base + 12 );
+	if ( nSection > ( size - CONTAINER_HEADER_SIZE ) / CONTAINER_ENTRY_SIZE )
+		return -1;
+
+	for ( i = 0; i < nSection; i++ ) {
+		entry = GetEntry( base, i );
+		offset = GetUint32LE( entry + 4 );
+		section_size = GetUint32LE( entry + 8 );
+		if ( offset % CONTAINER_ALIGN )
+			return -1;
+		if ( offset < CONTAINER_HEADER_SIZE + nSection * CONTAINER_ENTRY_SIZE )
+			return -1;
+		if ( offset > size || section_size > size - offset )
+			return -1;
+	}
+	return 0;
+}
+
+const void *ContainerGetSection( const void *base, uint32_t id, size_t *section_size )
+{
+	const unsigned char *entry;
+	uint32_t nSection;
+	uint32_t i;
+
+	nSection = GetUint32LE( (const char *) base + 12 );
+	for ( i = 0; i < nSection; i++ ) {
+		entry = GetEntry( base, i );
+		if ( GetUint32LE( entry ) == id ) {
+			*section_size = GetUint32LE( entry + 8 );
+			return (const char *) base + GetUint32LE( entry + 4 );
+		}
+	}
+	return NULL;
+}
+
+int ContainerVerify( const void *base, size_t size )
+{
+	const unsigned char *entry;
+	uint32_t nSection;
+	uint32_t i;
+
+	if ( ContainerCheck( base, size ) )
+		return -1;
+
+	nSection = GetUint32LE( (const char *) base + 12 );
+	for ( i = 0; i < nSection; i++ ) {
+		entry = GetEntry( base, i );
+		if ( ContainerChecksum(
+				(const char *) base + GetUint32LE( entry + 4 ),
+				GetUint32LE( entry + 8 ) ) != GetUint32LE( entry + 12 ) )
+			return -1;
+	}
+	return 0;
+}
@@ -179,6 +179,51 @@ int PhoneInxFromKey( int key, int type, int kbtype, int searchTimes )
 	return zhuin_tab_num[type] - ueStrLen(p);
 }
 
+/**
+ * @brief compile key_str[ kbtype ] into table
+ *
+ * @return 0 on success, -1 if there is no such layout
+ */
+int InitKeyTable( KeyTable *table, int kbtype )
+{
+	const char *keys;
+	uint8_t *reading;
+	int index, type, inx, n;
+
+	memset( table, 0, sizeof( KeyTable ) );
+	if ( kbtype < 0 || kbtype >= MAX_KBTYPE || ! key_str[ kbtype ] )
+		return -1;
+
+	keys = key_str[ kbtype ];
+	for ( index = 0; keys[ index ]; index++ ) {
+		if ( (unsigned char) keys[ index ] >= KEY_TABLE_SIZE )
+			continue;
+		reading = table->reading[ (unsigned char) keys[ index ] ];
+		/* PhoneInxFromKey() searches no further than the third place */
+		for ( n = 0; n < MAX_KEY_READING && reading[ n ]; n++ )
+			;
+		if ( n == MAX_KEY_READING )
+			continue;
+		/* ph_str lists the components of zhuin_tab in turn */
+		for ( type = 0, inx = index; inx >= zhuin_tab_num[ type ] - 1; type++ )
+			inx -= zhuin_tab_num[ type ] - 1;
+		reading[ n ] = KEY_READING( type, inx + 1 );
+	}
+	return 0;
+}
+
+/* the number of zhuins in phone, one per component that is set */
+int ComponentCountFromUint( uint16_t phone )
+{
+	int i, n = 0;
+
+	for ( i = 0; i < ZUIN_SIZE; i++ ) {
+		if ( ( phone >> shift[ i ] ) & sb[ i ] )
+			n++;
+	}
+	return n;
+}
+
 uint16_t UintFromPhoneInx( const int ph_inx[] )
 {
 	int i;
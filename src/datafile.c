@@ -0,0 +1,121 @@
+/**
+ * datafile.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file datafile.c
+ * @brief the mapping of STATIC_DATA_FILE
+ *
+ * The container is mapped once, or given by the caller through
+ * InitDataBuffer(); InitChar(), InitDict() and InitTree() take their
+ * tables from it as views, without copying. The checksums are left
+ * to "packdata -v" at deploy time, startup only checks the header.
+ *
+ * Each Init function gives the access advice of its sections through
+ * AdviseDataSection(), so that the pages every key stroke needs are read
+ * in while the context is created instead of by the first key strokes.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "global-private.h"
+#include "datafile-private.h"
+#include "private.h"
+#include "plat_mmap.h"
+
+#ifdef USE_EMBEDDED_DATA
+int InitDataFile( ChewingData *pgdata, const char *prefix UNUSED )
+{
+	/* in the read-only pages of the library, nothing to map */
+	plat_mmap_set_invalid( &pgdata->static_data->data_mmap );
+	pgdata->static_data->data = (void *) embedded_data;
+	pgdata->static_data->dataSize = embedded_data_size;
+	if ( ContainerCheck( pgdata->static_data->data, embedded_data_size ) ) {
+		pgdata->static_data->data = NULL;
+		return -1;
+	}
+	return 0;
+}
+#elif defined( USE_BINARY_DATA )
+int InitDataFile( ChewingData *pgdata, const char *prefix )
+{
+	char filename[ PATH_MAX ];
+	size_t len;
+	size_t offset;
+	size_t file_size;
+	size_t csize;
+
+	len = snprintf( filename, sizeof( filename ), "%s" PLAT_SEPARATOR "%s", prefix, STATIC_DATA_FILE );
+	if ( len + 1 > sizeof( filename ) )
+		return -1;
+
+	plat_mmap_set_invalid( &pgdata->static_data->data_mmap );
+	file_size = plat_mmap_create( &pgdata->static_data->data_mmap, filename, FLAG_ATTRIBUTE_READ );
+	if ( file_size <= 0 )
+		return -1;
+
+	offset = 0;
+	csize = file_size;
+	pgdata->static_data->data = plat_mmap_set_view( &pgdata->static_data->data_mmap, &offset, &csize );
+	if ( !pgdata->static_data->data )
+		return -1;
+
+	pgdata->static_data->dataSize = file_size;
+
+	if ( ContainerCheck( pgdata->static_data->data, file_size ) ) {
+		pgdata->static_data->data = NULL;
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+#ifdef USE_BINARY_DATA
+int InitDataBuffer( ChewingData *pgdata, const void *data, size_t size )
+{
+	/* nothing to map, the sections are read where the caller keeps them */
+	plat_mmap_set_invalid( &pgdata->static_data->data_mmap );
+	if ( !data || (uintptr_t) data % CONTAINER_ALIGN || ContainerCheck( data, size ) )
+		return -1;
+	pgdata->static_data->data = (void *) data;
+	pgdata->static_data->dataSize = size;
+	pgdata->static_data->buffer = data;
+	return 0;
+}
+
+void TerminateDataFile( ChewingData *pgdata )
+{
+	pgdata->static_data->data = NULL;
+	pgdata->static_data->dataSize = 0;
+	pgdata->static_data->buffer = NULL;
+	plat_mmap_close( &pgdata->static_data->data_mmap );
+}
+
+void AdviseDataSection( ChewingData *pgdata, const void *section, size_t size, int advice )
+{
+	if ( !pgdata->static_data->data || !section )
+		return;
+	/* only a hint, a platform without it works all the same */
+	plat_mmap_advise( &pgdata->static_data->data_mmap,
+		(const char *) section - (const char *) pgdata->static_data->data,
+		size, advice );
+}
+
+void *GetDataSection( ChewingData *pgdata, uint32_t id, size_t *size )
+{
+	if ( !pgdata->static_data->data )
+		return NULL;
+	return (void *) ContainerGetSection( pgdata->static_data->data, id, size );
+}
+#endif
@@ -18,9 +18,11 @@
 #include <stdlib.h>
 
 #include "global-private.h"
+#include "chewing-utf8-util.h"
 #include "private.h"
-#include "plat_mmap.h"
+#include "datafile-private.h"
 #include "dict-private.h"
+#include "overlay-private.h"
 
 #if ! defined(USE_BINARY_DATA)
 static char *fgettab( char *buf, int maxlen, FILE *fp )
@@ -44,56 +46,67 @@ static char *fgettab( char *buf, int maxlen, FILE *fp )
 void TerminateDict( ChewingData *pgdata )
 {
 #ifdef USE_BINARY_DATA
-	plat_mmap_close( &pgdata->static_data.index_mmap );
-	plat_mmap_close( &pgdata->static_data.dict_mmap );
+	/* views of STATIC_DATA_FILE, unmapped by TerminateDataFile() */
+	pgdata->static_data->dict_begin = NULL;
+	pgdata->static_data->dict_record = NULL;
+	pgdata->static_data->dict_chars = NULL;
+	pgdata->static_data->dict = NULL;
 #else
-	if ( pgdata->static_data.dictfile ) {
-		fclose( pgdata->static_data.dictfile );
-		pgdata->static_data.dictfile = NULL;
+	if ( pgdata->static_data->dictfile ) {
+		fclose( pgdata->static_data->dictfile );
+		pgdata->static_data->dictfile = NULL;
 	}
-	free( pgdata->static_data.dict_begin );
-	pgdata->static_data.dict_begin = NULL;
+	free( pgdata->static_data->dict_begin );
+	pgdata->static_data->dict_begin = NULL;
 #endif
 }
 
-int InitDict( ChewingData *pgdata, const char *prefix )
+/* the first phrase of phone_phr_id, a record or a byte of the dictionary */
+static int PhraseBegin( ChewingData *pgdata, int phone_phr_id )
 {
 #ifdef USE_BINARY_DATA
-	char filename[ PATH_MAX ];
-	size_t len;
-	size_t offset;
-	size_t file_size;
-	size_t csize;
-
-	len = snprintf( filename, sizeof( filename ), "%s" PLAT_SEPARATOR "%s", prefix, DICT_FILE );
-	if ( len + 1 > sizeof( filename ) )
-		return -1;
+	return (int32_t) GetUint32LE( &pgdata->static_data->dict_begin[ phone_phr_id ] );
+#else
+	return pgdata->static_data->dict_begin[ phone_phr_id ];
+#endif
+}
 
-	plat_mmap_set_invalid( &pgdata->static_data.dict_mmap );
-	file_size = plat_mmap_create( &pgdata->static_data.dict_mmap, filename, FLAG_ATTRIBUTE_READ );
-	if ( file_size <= 0 )
-		return -1;
+int InitDict( ChewingData *pgdata, const char *prefix UNUSED )
+{
+#ifdef USE_BINARY_DATA
+	size_t size;
+	size_t end;
+	STATIC_ASSERT( sizeof( DictRecord ) == 12, dict_record_is_packed );
 
-	offset = 0;
-	csize = file_size;
-	pgdata->static_data.dict = plat_mmap_set_view( &pgdata->static_data.dict_mmap, &offset, &csize );
-	if ( !pgdata->static_data.dict )
-		return -1;
+	pgdata->static_data->dict = GetDataSection( pgdata, SECTION_DICT_COMPRESSED, &size );
+	if ( pgdata->static_data->dict ) {
+		end = size;
+		AdviseDataSection( pgdata, pgdata->static_data->dict, size, FLAG_ADVICE_RANDOM );
+		pgdata->static_data->dict_chars = GetDataSection( pgdata, SECTION_DICT_CHARS, &size );
+		if ( !pgdata->static_data->dict_chars || size % DICT_CHAR_SIZE )
+			return -1;
+	}
+	else {
+		pgdata->static_data->dict = GetDataSection( pgdata, SECTION_DICT, &size );
+		if ( !pgdata->static_data->dict )
+			return -1;
+		AdviseDataSection( pgdata, pgdata->static_data->dict, size, FLAG_ADVICE_RANDOM );
 
-	len = snprintf( filename, sizeof( filename ), "%s" PLAT_SEPARATOR "%s", prefix, PH_INDEX_FILE );
-	if ( len + 1 > sizeof( filename ) )
-		return -1;
+		pgdata->static_data->dict_record = GetDataSection( pgdata, SECTION_DICT_RECORD, &size );
+		if ( !pgdata->static_data->dict_record || size % sizeof( DictRecord ) )
+			return -1;
+		end = size / sizeof( DictRecord );
+		AdviseDataSection( pgdata, pgdata->static_data->dict_record, size, FLAG_ADVICE_RANDOM );
+	}
 
-	plat_mmap_set_invalid( &pgdata->static_data.index_mmap );
-	file_size = plat_mmap_create( &pgdata->static_data.index_mmap, filename, FLAG_ATTRIBUTE_READ );
-	if ( file_size <= 0 )
+	pgdata->static_data->dict_begin = GetDataSection( pgdata, SECTION_PH_INDEX, &size );
+	if ( !pgdata->static_data->dict_begin || size < sizeof( int32_t ) )
 		return -1;
-
-	offset = 0;
-	csize = file_size;
-	pgdata->static_data.dict_begin = plat_mmap_set_view( &pgdata->static_data.index_mmap, &offset, &csize );
-	if ( !pgdata->static_data.dict_begin )
+	/* the last entry ends the phrases of the last phrase id */
+	if ( (size_t) PhraseBegin( pgdata, size / sizeof( int32_t ) - 1 ) != end )
 		return -1;
+	/* only the buckets of the phrases found in the tree are read */
+	AdviseDataSection( pgdata, pgdata->static_data->dict_begin, size, FLAG_ADVICE_RANDOM );
 
 	return 0;
 #else
@@ -102,7 +115,7 @@ int InitDict( ChewingData *pgdata, const char *prefix )
 	int len;
 	int i;
 
-	pgdata->dict_begin = ALC( int, PHONE_PHRASE_NUM + 1 );
+	pgdata->dict_begin = ALC( int32_t, PHONE_PHRASE_NUM + 1 );
 	if ( !pgdata->dict_begin )
 		return -1;
 
@@ -132,48 +145,347 @@ int InitDict( ChewingData *pgdata, const char *prefix )
 #endif
 }
 
-static void Str2Phrase( ChewingData *pgdata, Phrase *phr_ptr )
+#ifdef USE_BINARY_DATA
+static int Record2Phrase( ChewingData *pgdata, const DictRecord *record, Phrase *phr_ptr )
+{
+	memcpy( phr_ptr->phrase, (const char *) pgdata->static_data->dict +
+		GetUint32LE( &record->pos ), record->size );
+	phr_ptr->phrase[ record->size ] = '\0';
+	phr_ptr->freq = (int32_t) GetUint32LE( &record->freq );
+	return record->size;
+}
+
+static int DecodeFreq( const unsigned char **pos )
+{
+	const unsigned char *p = *pos;
+	int freq = 0;
+	int shift;
+
+	for ( shift = 0; *p & 0x80; shift += 7 )
+		freq |= ( *p++ & 0x7f ) << shift;
+	freq |= *p++ << shift;
+	*pos = p;
+	return freq;
+}
+
+/* the phrase after *pos in a compressed dictionary, see dict-private.h */
+static const unsigned char *SkipCompressed( const unsigned char *p )
+{
+	int nSuffix = *p++ & 0x0f;
+
+	DecodeFreq( &p );
+	while ( nSuffix-- > 0 )
+		p += ( *p & 0x80 ) ? 2 : 1;
+	return p;
+}
+
+/**
+ * @brief decode the phrase at *pos of a compressed dictionary
+ *
+ * last is the previous phrase of the same phrase id, it shall not be
+ * phr_ptr->phrase. Returns the bytes of the phrase.
+ */
+static int DecodeCompressed( ChewingData *pgdata, const unsigned char **pos,
+		const char *last, Phrase *phr_ptr )
+{
+	const unsigned char *p = *pos;
+	const char *ch;
+	int nPrefix = *p >> 4;
+	int nSuffix = *p & 0x0f;
+	int size = 0;
+	int code;
+	int k;
+
+	p++;
+	phr_ptr->freq = DecodeFreq( &p );
+
+	if ( nPrefix ) {
+		size = ueStrNBytes( last, nPrefix );
+		memcpy( phr_ptr->phrase, last, size );
+	}
+	while ( nSuffix-- > 0 ) {
+		code = *p++;
+		if ( code & 0x80 )
+			code = 0x80 + ( ( code & 0x7f ) << 8 | *p++ );
+		ch = pgdata->static_data->dict_chars + code * DICT_CHAR_SIZE;
+		for ( k = 0; k < DICT_CHAR_SIZE && ch[ k ]; k++ )
+			phr_ptr->phrase[ size++ ] = ch[ k ];
+	}
+	phr_ptr->phrase[ size ] = '\0';
+	*pos = p;
+	return size;
+}
+#endif
+
+/* the phrases of an overlay phrase id, kept whole in memory */
+static const Phrase *OverlayPhrase( ChewingData *pgdata, int phone_phr_id, const Phrase **end )
+{
+	const DictOverlay *overlay = pgdata->static_data->overlay;
+	const OverlayEntry *entry;
+
+	assert( overlay && phone_phr_id - PHONE_PHRASE_NUM < overlay->nEntry );
+	entry = &overlay->entry[ phone_phr_id - PHONE_PHRASE_NUM ];
+	*end = overlay->phrase + entry->end;
+	return overlay->phrase + entry->begin;
+}
+
+/* returns the bytes of the phrase */
+static int Str2Phrase( ChewingData *pgdata, Phrase *phr_ptr )
 {
 #ifndef USE_BINARY_DATA
 	char buf[ 1000 ];
+#else
+	const DictRecord *record;
+	const unsigned char *pos;
+	int size;
+#endif
 
-	fgettab( buf, 1000, pgdata->static_data.dictfile );
+	if ( pgdata->session.overlay_cur ) {
+		*phr_ptr = *(const Phrase *) pgdata->session.overlay_cur;
+		pgdata->session.overlay_cur = (Phrase *) pgdata->session.overlay_cur + 1;
+		return strlen( phr_ptr->phrase );
+	}
+#ifndef USE_BINARY_DATA
+	fgettab( buf, 1000, pgdata->static_data->dictfile );
 	sscanf( buf, "%[^ ] %d", phr_ptr->phrase, &( phr_ptr->freq ) );
+	return strlen( phr_ptr->phrase );
 #else
-	unsigned char size;
-	size = *(unsigned char *) pgdata->static_data.dict_cur_pos;
-	pgdata->static_data.dict_cur_pos = (unsigned char *)pgdata->static_data.dict_cur_pos + sizeof(unsigned char);
-	memcpy( phr_ptr->phrase, pgdata->static_data.dict_cur_pos, size );
-	pgdata->static_data.dict_cur_pos = (unsigned char *)pgdata->static_data.dict_cur_pos + size;
-	phr_ptr->freq = *(int *) pgdata->static_data.dict_cur_pos;
-	pgdata->static_data.dict_cur_pos = (unsigned char *)pgdata->static_data.dict_cur_pos + sizeof(int);
-	phr_ptr->phrase[ size ] = '\0';
+	if ( pgdata->static_data->dict_record ) {
+		record = pgdata->session.dict_cur_pos;
+		pgdata->session.dict_cur_pos = (DictRecord *) record + 1;
+		return Record2Phrase( pgdata, record, phr_ptr );
+	}
+
+	pos = pgdata->session.dict_cur_pos;
+	size = DecodeCompressed( pgdata, &pos, pgdata->session.dict_last, phr_ptr );
+	pgdata->session.dict_cur_pos = (unsigned char *) pos;
+	memcpy( pgdata->session.dict_last, phr_ptr->phrase, size + 1 );
+	return size;
 #endif
 }
 
-int GetPhraseFirst( ChewingData *pgdata, Phrase *phr_ptr, int phone_phr_id )
+/* the view of the next phrase, see Str2Phrase() */
+static int Str2PhraseView( ChewingData *pgdata, PhraseView *view )
 {
+	Phrase phrase;
+	const Phrase *cur = pgdata->session.overlay_cur;
+
+#ifdef USE_BINARY_DATA
+	const DictRecord *record;
+#endif
+
+	if ( cur ) {
+		pgdata->session.overlay_cur = (Phrase *) cur + 1;
+		view->phrase = cur->phrase;
+		view->len = strlen( cur->phrase );
+		view->freq = cur->freq;
+		return view->len;
+	}
+#ifdef USE_BINARY_DATA
+	if ( pgdata->static_data->dict_record ) {
+		record = pgdata->session.dict_cur_pos;
+		pgdata->session.dict_cur_pos = (DictRecord *) record + 1;
+		view->phrase = (const char *) pgdata->static_data->dict + GetUint32LE( &record->pos );
+		view->len = record->size;
+		view->freq = (int32_t) GetUint32LE( &record->freq );
+		return view->len;
+	}
+#endif
+	/* decoded into dict_last, the next phrase is decoded from there */
+	view->len = Str2Phrase( pgdata, &phrase );
+#ifndef USE_BINARY_DATA
+	memcpy( pgdata->session.dict_last, phrase.phrase, view->len + 1 );
+#endif
+	view->phrase = pgdata->session.dict_last;
+	view->freq = phrase.freq;
+	return view->len;
+}
+
+static void SeekPhrase( ChewingData *pgdata, int phone_phr_id )
+{
+	const Phrase *end;
+
+	if ( IS_OVERLAY_PHRASE_ID( phone_phr_id ) ) {
+		pgdata->session.overlay_cur = (Phrase *) OverlayPhrase( pgdata, phone_phr_id, &end );
+		pgdata->session.overlay_end = (Phrase *) end;
+		return;
+	}
+	pgdata->session.overlay_cur = NULL;
 	assert( ( 0 <= phone_phr_id ) && ( phone_phr_id < PHONE_PHRASE_NUM ) );
 
 #ifndef USE_BINARY_DATA
-	fseek( pgdata->static_data.dictfile, pgdata->static_data.dict_begin[ phone_phr_id ], SEEK_SET );
+	fseek( pgdata->static_data->dictfile, PhraseBegin( pgdata, phone_phr_id ), SEEK_SET );
 #else
-	pgdata->static_data.dict_cur_pos = (unsigned char *)pgdata->static_data.dict + pgdata->static_data.dict_begin[ phone_phr_id ];
+	if ( pgdata->static_data->dict_record )
+		pgdata->session.dict_cur_pos = pgdata->static_data->dict_record + PhraseBegin( pgdata, phone_phr_id );
+	else {
+		pgdata->session.dict_cur_pos = (unsigned char *) pgdata->static_data->dict + PhraseBegin( pgdata, phone_phr_id );
+		pgdata->session.dict_last[ 0 ] = '\0';
+	}
 #endif
-	pgdata->static_data.dict_end_pos = pgdata->static_data.dict_begin[ phone_phr_id + 1 ];
-	Str2Phrase( pgdata, phr_ptr );
-	return 1;
+	pgdata->session.dict_end_pos = PhraseBegin( pgdata, phone_phr_id + 1 );
 }
 
-int GetPhraseNext( ChewingData *pgdata, Phrase *phr_ptr )
+/* the phrases of the phrase id of the cursor are all read */
+static int PhraseEnd( ChewingData *pgdata )
 {
+	if ( pgdata->session.overlay_cur )
+		return pgdata->session.overlay_cur >= pgdata->session.overlay_end;
 #ifndef USE_BINARY_DATA
-	if ( ftell( pgdata->dictfile ) >= pgdata->dict_end_pos )
+	return ftell( pgdata->dictfile ) >= pgdata->dict_end_pos;
+#else
+	if ( pgdata->static_data->dict_record )
+		return (DictRecord *) pgdata->session.dict_cur_pos >= pgdata->static_data->dict_record + pgdata->session.dict_end_pos;
+	return (unsigned char *) pgdata->session.dict_cur_pos >= (unsigned char *) pgdata->static_data->dict + pgdata->session.dict_end_pos;
+#endif
+}
+
+int GetPhraseFirst( ChewingData *pgdata, Phrase *phr_ptr, int phone_phr_id )
+{
+	SeekPhrase( pgdata, phone_phr_id );
+	return Str2Phrase( pgdata, phr_ptr );
+}
+
+int GetPhraseNext( ChewingData *pgdata, Phrase *phr_ptr )
+{
+	if ( PhraseEnd( pgdata ) )
 		return 0;
+	return Str2Phrase( pgdata, phr_ptr );
+}
+
+int GetPhraseViewFirst( ChewingData *pgdata, PhraseView *view, int phone_phr_id )
+{
+	SeekPhrase( pgdata, phone_phr_id );
+	return Str2PhraseView( pgdata, view );
+}
+
+int GetPhraseViewNext( ChewingData *pgdata, PhraseView *view )
+{
+	if ( PhraseEnd( pgdata ) )
+		return 0;
+	return Str2PhraseView( pgdata, view );
+}
+
+/**
+ * @brief Frequency of the most frequent phrase of phone_phr_id.
+ *
+ * sort_dic writes the phrases of a phrase id by decreasing frequency, so
+ * this is the frequency of the first one and no candidate is scanned.
+ */
+int GetPhraseMaxFreq( ChewingData *pgdata, int phone_phr_id )
+{
+	const Phrase *end;
+#ifdef USE_BINARY_DATA
+	const unsigned char *pos;
+#endif
+
+	/* sorted again when the overlay is read */
+	if ( IS_OVERLAY_PHRASE_ID( phone_phr_id ) )
+		return OverlayPhrase( pgdata, phone_phr_id, &end )->freq;
+#ifdef USE_BINARY_DATA
+
+	assert( ( 0 <= phone_phr_id ) && ( phone_phr_id < PHONE_PHRASE_NUM ) );
+
+	if ( pgdata->static_data->dict_record )
+		return (int32_t) GetUint32LE( &pgdata->static_data->dict_record[ PhraseBegin( pgdata, phone_phr_id ) ].freq );
+
+	/* skip the character counts */
+	pos = (const unsigned char *) pgdata->static_data->dict + PhraseBegin( pgdata, phone_phr_id ) + 1;
+	return DecodeFreq( &pos );
 #else
-	if ( (unsigned char *)pgdata->static_data.dict_cur_pos >= (unsigned char *)pgdata->static_data.dict + pgdata->static_data.dict_end_pos )
+	Phrase phrase;
+
+	GetPhraseFirst( pgdata, &phrase, phone_phr_id );
+	return phrase.freq;
+#endif
+}
+
+/**
+ * @brief Number of phrases of phone_phr_id.
+ */
+int GetPhraseCount( ChewingData *pgdata, int phone_phr_id )
+{
+	const Phrase *first, *last;
+#ifdef USE_BINARY_DATA
+	const unsigned char *pos, *end;
+	int n = 0;
+#endif
+
+	if ( IS_OVERLAY_PHRASE_ID( phone_phr_id ) ) {
+		first = OverlayPhrase( pgdata, phone_phr_id, &last );
+		return last - first;
+	}
+#ifdef USE_BINARY_DATA
+
+	assert( ( 0 <= phone_phr_id ) && ( phone_phr_id < PHONE_PHRASE_NUM ) );
+
+	if ( pgdata->static_data->dict_record )
+		return PhraseBegin( pgdata, phone_phr_id + 1 ) -
+			PhraseBegin( pgdata, phone_phr_id );
+
+	pos = (const unsigned char *) pgdata->static_data->dict + PhraseBegin( pgdata, phone_phr_id );
+	end = (const unsigned char *) pgdata->static_data->dict + PhraseBegin( pgdata, phone_phr_id + 1 );
+	for ( ; pos < end; pos = SkipCompressed( pos ) )
+		n++;
+	return n;
+#else
+	Phrase phrase;
+	int n = 0;
+
+	if ( GetPhraseFirst( pgdata, &phrase, phone_phr_id ) ) {
+		do {
+			n++;
+		} while ( GetPhraseNext( pgdata, &phrase ) );
+	}
+	return n;
+#endif
+}
+
+/**
+ * @brief The n-th phrase of phone_phr_id, in the order of GetPhraseFirst()
+ * and GetPhraseNext().
+ *
+ * @return the bytes of the phrase, 0 if phone_phr_id has no n-th phrase
+ */
+int GetPhraseNth( ChewingData *pgdata, Phrase *phr_ptr, int phone_phr_id, int n )
+{
+	const Phrase *end;
+#ifdef USE_BINARY_DATA
+	const unsigned char *pos;
+	char last[ MAX_PHRASE_LEN * MAX_UTF8_SIZE + 1 ] = "";
+	int size;
+#endif
+
+	if ( IS_OVERLAY_PHRASE_ID( phone_phr_id ) ) {
+		if ( n < 0 || n >= GetPhraseCount( pgdata, phone_phr_id ) )
+			return 0;
+		*phr_ptr = OverlayPhrase( pgdata, phone_phr_id, &end )[ n ];
+		return strlen( phr_ptr->phrase );
+	}
+#ifdef USE_BINARY_DATA
+	if ( n < 0 || n >= GetPhraseCount( pgdata, phone_phr_id ) )
+		return 0;
+	if ( pgdata->static_data->dict_record )
+		return Record2Phrase( pgdata,
+			pgdata->static_data->dict_record + PhraseBegin( pgdata, phone_phr_id ) + n,
+			phr_ptr );
+
+	/* without touching the cursor of GetPhraseNext() */
+	pos = (const unsigned char *) pgdata->static_data->dict + PhraseBegin( pgdata, phone_phr_id );
+	for ( ; ; ) {
+		size = DecodeCompressed( pgdata, &pos, last, phr_ptr );
+		if ( n-- == 0 )
+			return size;
+		memcpy( last, phr_ptr->phrase, size + 1 );
+	}
+#else
+	int size;
+
+	if ( n < 0 )
 		return 0;
+	size = GetPhraseFirst( pgdata, phr_ptr, phone_phr_id );
+	while ( size && n-- > 0 )
+		size = GetPhraseNext( pgdata, phr_ptr );
+	return size;
 #endif
-	Str2Phrase( pgdata, phr_ptr );
-	return 1;
 }
@@ -20,11 +20,34 @@
 #include "hanyupinyin-private.h"
 #include "hash-private.h"
 #include "private.h"
+#include "datafile-private.h"
+
+/* heap bytes of the tries, and of the keymaps unless they are mapped */
+size_t HanyuPinYinBytes( ChewingData *pgdata )
+{
+	ChewingStaticData *static_data = pgdata->static_data;
+	size_t size;
+
+	size = ( static_data->hanyuInitialsTrie.nNode + static_data->hanyuFinalsTrie.nNode ) *
+		sizeof( PinYinTrieNode );
+#ifndef USE_BINARY_DATA
+	size += ( static_data->HANYU_INITIALS + static_data->HANYU_FINALS ) * sizeof( keymap );
+#endif
+	return size;
+}
 
 void TerminateHanyuPinyin( ChewingData *pgdata )
 { 
-	free( pgdata->static_data.hanyuInitialsMap );
-	free( pgdata->static_data.hanyuFinalsMap );
+	free( pgdata->static_data->hanyuInitialsTrie.node );
+	free( pgdata->static_data->hanyuFinalsTrie.node );
+	memset( &pgdata->static_data->hanyuInitialsTrie, 0, sizeof( PinYinTrie ) );
+	memset( &pgdata->static_data->hanyuFinalsTrie, 0, sizeof( PinYinTrie ) );
+#ifndef USE_BINARY_DATA
+	free( pgdata->static_data->hanyuInitialsMap );
+	free( pgdata->static_data->hanyuFinalsMap );
+#endif
+	pgdata->static_data->hanyuInitialsMap = NULL;
+	pgdata->static_data->hanyuFinalsMap = NULL;
 }
 
 #if 0
@@ -36,8 +59,113 @@ static int compkey( const void *k1, const void *k2 )
 }
 #endif
 
-int InitHanyuPinYin( ChewingData *pgdata, const char *prefix )
+/**
+ * @brief build the trie of the nMap pinyin of map
+ *
+ * Every node has a child for each letter that follows its prefix in some
+ * pinyin. A node ending more than one pinyin keeps the first keymap, the
+ * one a search of the table in turn would find.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int BuildPinYinTrie( PinYinTrie *trie, const keymap *map, int nMap )
 {
+	const char *pinyin;
+	int nAlloc = 1, node, child;
+	int i;
+
+	for ( i = 0; i < nMap; i++ )
+		nAlloc += strlen( map[ i ].pinyin );
+	if ( nAlloc > INT16_MAX )
+		return -1;
+	trie->node = ALC( PinYinTrieNode, nAlloc );
+	if ( ! trie->node )
+		return -1;
+	trie->node[ 0 ].entry = -1;
+	trie->nNode = 1;
+
+	for ( i = 0; i < nMap; i++ ) {
+		node = 0;
+		for ( pinyin = map[ i ].pinyin; *pinyin; pinyin++ ) {
+			for ( child = trie->node[ node ].child; child; child = trie->node[ child ].next )
+				if ( trie->node[ child ].key == *pinyin )
+					break;
+			if ( ! child ) {
+				child = trie->nNode++;
+				trie->node[ child ].key = *pinyin;
+				trie->node[ child ].entry = -1;
+				trie->node[ child ].next = trie->node[ node ].child;
+				trie->node[ node ].child = child;
+			}
+			node = child;
+		}
+		if ( trie->node[ node ].entry == -1 )
+			trie->node[ node ].entry = i;
+	}
+	return 0;
+}
+
+/**
+ * @brief the first keymap whose pinyin begins seq
+ *
+ * @return the index of the keymap, -1 if none
+ */
+static int FindPinYinPrefix( const PinYinTrie *trie, const char *seq )
+{
+	int node = 0, child, entry;
+
+	entry = trie->node[ 0 ].entry;
+	for ( ; *seq; seq++ ) {
+		for ( child = trie->node[ node ].child; child; child = trie->node[ child ].next )
+			if ( trie->node[ child ].key == *seq )
+				break;
+		if ( ! child )
+			break;
+		node = child;
+		if ( trie->node[ node ].entry != -1 &&
+				( entry == -1 || trie->node[ node ].entry < entry ) )
+			entry = trie->node[ node ].entry;
+	}
+	return entry;
+}
+
+static int InitPinYinTrie( ChewingData *pgdata )
+{
+	ChewingStaticData *static_data = pgdata->static_data;
+
+	if ( BuildPinYinTrie( &static_data->hanyuInitialsTrie,
+			static_data->hanyuInitialsMap, static_data->HANYU_INITIALS ) )
+		return -1;
+	if ( BuildPinYinTrie( &static_data->hanyuFinalsTrie,
+			static_data->hanyuFinalsMap, static_data->HANYU_FINALS ) )
+		return -1;
+	return 0;
+}
+
+int InitHanyuPinYin( ChewingData *pgdata, const char *prefix UNUSED )
+{
+#ifdef USE_BINARY_DATA
+	const char *header;
+	int32_t nInitials, nFinals;
+	size_t size;
+	STATIC_ASSERT( sizeof( keymap ) == 12, keymap_is_packed );
+
+	header = GetDataSection( pgdata, SECTION_PINYIN, &size );
+	if ( !header || size < 8 )
+		return 0;
+	nInitials = (int32_t) GetUint32LE( header );
+	nFinals = (int32_t) GetUint32LE( header + 4 );
+	/* both end with an empty keymap */
+	if ( nInitials < 1 || nFinals < 1 ||
+			( (size_t) nInitials + nFinals ) * sizeof( keymap ) != size - 8 )
+		return 0;
+	pgdata->static_data->HANYU_INITIALS = nInitials;
+	pgdata->static_data->HANYU_FINALS = nFinals;
+	pgdata->static_data->hanyuInitialsMap = (keymap *) ( header + 8 );
+	pgdata->static_data->hanyuFinalsMap =
+		pgdata->static_data->hanyuInitialsMap + nInitials;
+	return InitPinYinTrie( pgdata ) == 0;
+#else
 	char filename[PATH_MAX];
 	int i;
 	FILE *fd;
@@ -52,31 +180,31 @@ int InitHanyuPinYin( ChewingData *pgdata, const char *prefix )
 	if ( ! fd )
 		return 0;
 
-	ret = fscanf( fd, "%d", &pgdata->static_data.HANYU_INITIALS );
+	ret = fscanf( fd, "%d", &pgdata->static_data->HANYU_INITIALS );
 	if ( ret != 1 ) {
 		return 0;
 	}
-	++pgdata->static_data.HANYU_INITIALS;
-	pgdata->static_data.hanyuInitialsMap = ALC( keymap, pgdata->static_data.HANYU_INITIALS );
-	for ( i = 0; i < pgdata->static_data.HANYU_INITIALS - 1; i++ ) {
+	++pgdata->static_data->HANYU_INITIALS;
+	pgdata->static_data->hanyuInitialsMap = ALC( keymap, pgdata->static_data->HANYU_INITIALS );
+	for ( i = 0; i < pgdata->static_data->HANYU_INITIALS - 1; i++ ) {
 		ret = fscanf( fd, "%s %s",
-			pgdata->static_data.hanyuInitialsMap[ i ].pinyin,
-			pgdata->static_data.hanyuInitialsMap[ i ].zuin );
+			pgdata->static_data->hanyuInitialsMap[ i ].pinyin,
+			pgdata->static_data->hanyuInitialsMap[ i ].zuin );
 		if ( ret != 2 ) {
 			return 0;
 		}
 	}
 
-	ret = fscanf( fd, "%d", &pgdata->static_data.HANYU_FINALS );
+	ret = fscanf( fd, "%d", &pgdata->static_data->HANYU_FINALS );
 	if ( ret != 1 ) {
 		return 0;
 	}
-	++pgdata->static_data.HANYU_FINALS;
-	pgdata->static_data.hanyuFinalsMap = ALC( keymap, pgdata->static_data.HANYU_FINALS );
-	for ( i = 0; i < pgdata->static_data.HANYU_FINALS - 1; i++ ) {
+	++pgdata->static_data->HANYU_FINALS;
+	pgdata->static_data->hanyuFinalsMap = ALC( keymap, pgdata->static_data->HANYU_FINALS );
+	for ( i = 0; i < pgdata->static_data->HANYU_FINALS - 1; i++ ) {
 		ret = fscanf( fd, "%s %s",
-			pgdata->static_data.hanyuFinalsMap[ i ].pinyin,
-			pgdata->static_data.hanyuFinalsMap[ i ].zuin );
+			pgdata->static_data->hanyuFinalsMap[ i ].pinyin,
+			pgdata->static_data->hanyuFinalsMap[ i ].zuin );
 		if ( ret != 2 ) {
 			return 0;
 		}
@@ -84,7 +212,8 @@ int InitHanyuPinYin( ChewingData *pgdata, const char *prefix )
 
 	fclose( fd );
 
-	return 1;
+	return InitPinYinTrie( pgdata ) == 0;
+#endif
 }
 
 /**
@@ -97,21 +226,12 @@ int InitHanyuPinYin( ChewingData *pgdata, const char *prefix )
  */
 int HanyuPinYinToZuin( ChewingData *pgdata, char *pinyinKeySeq, char *zuinKeySeq )
 {
-	char *p, *cursor = NULL;
-	char *initial = 0;
-	char *final = 0;
+	const keymap *initial, *final;
+	const char *zuinFinal;
 	int i;
 
-	for ( i = 0; i < pgdata->static_data.HANYU_INITIALS; i++ ) {
-		p = strstr( pinyinKeySeq, pgdata->static_data.hanyuInitialsMap[ i ].pinyin );
-		if ( p == pinyinKeySeq ) {
-			initial = pgdata->static_data.hanyuInitialsMap[ i ].zuin;
-			cursor = pinyinKeySeq +
-				strlen( pgdata->static_data.hanyuInitialsMap[ i ].pinyin );
-			break;
-		}
-	}
-	if ( i == pgdata->static_data.HANYU_INITIALS ) {
+	i = FindPinYinPrefix( &pgdata->static_data->hanyuInitialsTrie, pinyinKeySeq );
+	if ( i == -1 ) {
 		/* No initials. might be ㄧㄨㄩ */
 		/* XXX: I NEED Implementation
 		   if(finalsKeySeq[0] != ) {
@@ -119,29 +239,25 @@ int HanyuPinYinToZuin( ChewingData *pgdata, char *pinyinKeySeq, char *zuinKeySeq
 		   */
 		return 1;
 	}
+	initial = &pgdata->static_data->hanyuInitialsMap[ i ];
 
-	if ( cursor ) {
-		for ( i = 0; i < pgdata->static_data.HANYU_FINALS; i++ ) {
-			p = strstr( cursor, pgdata->static_data.hanyuFinalsMap[ i ].pinyin );
-			if ( p == cursor ) {
-				final = pgdata->static_data.hanyuFinalsMap[ i ].zuin;
-				break;
-			}
-		}
-		if ( i == pgdata->static_data.HANYU_FINALS ){
-			return 2;
-		}
-	}
-	
-	if ( ! strcmp( final, "j0" ) ) {
+	i = FindPinYinPrefix( &pgdata->static_data->hanyuFinalsTrie,
+		pinyinKeySeq + strlen( initial->pinyin ) );
+	if ( i == -1 )
+		return 2;
+	final = &pgdata->static_data->hanyuFinalsMap[ i ];
+	zuinFinal = final->zuin;
+
+	if ( ! strcmp( zuinFinal, "j0" ) ) {
 		if (
-			! strcmp( initial, "f" ) || 
-			! strcmp( initial, "r" ) ||
-			! strcmp( initial, "v" ) ) {
-			final = "m0";
+			! strcmp( initial->zuin, "f" ) || 
+			! strcmp( initial->zuin, "r" ) ||
+			! strcmp( initial->zuin, "v" ) ) {
+			zuinFinal = "m0";
 		}
 	}
 	
-	sprintf( zuinKeySeq, "%s%s", initial, final );
+	strcpy( zuinKeySeq, initial->zuin );
+	strcat( zuinKeySeq, zuinFinal );
 	return 0;
 }
@@ -24,22 +24,14 @@
 #include "hash-private.h"
 #include "private.h"
 #include "global.h"
+#include "container-private.h"
+#include "arena-private.h"
 
-int AlcUserPhraseSeq( UserPhraseData *pData, int phonelen, int wordlen )
+/* point the sequences of pItem into pItem */
+static void SetItemSeq( HASH_ITEM *pItem )
 {
-	pData->phoneSeq = ALC( uint16_t, phonelen + 1 );
-	if ( !pData->phoneSeq )
-		goto error;
-	pData->wordSeq = ALC( char, wordlen + 1 );
-	if ( !pData->wordSeq )
-		goto error;
-
-	return 1;
-
-error:
-	free( pData->phoneSeq );
-	free( pData->wordSeq );
-	return 0;
+	pItem->data.phoneSeq = pItem->phoneSeq;
+	pItem->data.wordSeq = pItem->wordSeq;
 }
 
 static int PhoneSeqTheSame( const uint16_t p1[], const uint16_t p2[] )
@@ -57,66 +49,306 @@ static int PhoneSeqTheSame( const uint16_t p1[], const uint16_t p2[] )
 	return 1;
 }
 
+/*
+ * FNV-1a over the phones, so that the order of the syllables counts, with
+ * the final mix of MurmurHash3 so that the low bits, which pick the slot,
+ * depend on all of them.
+ */
 static unsigned int HashFunc( const uint16_t phoneSeq[] )
 {
-	int i, value = 0;
+	uint32_t value = 2166136261u;
+	int i;
 
-	for ( i = 0; phoneSeq[ i ] != 0; i++ )
+	for ( i = 0; phoneSeq[ i ] != 0; i++ ) {
 		value ^= phoneSeq[ i ];
-	return ( value & ( HASH_TABLE_SIZE - 1 ) );
+		value *= 16777619u;
+	}
+	value ^= value >> 16;
+	value *= 0x85ebca6bu;
+	value ^= value >> 13;
+	value *= 0xc2b2ae35u;
+	value ^= value >> 16;
+	return value;
 }
 
-HASH_ITEM *HashFindPhonePhrase( ChewingData *pgdata, const uint16_t phoneSeq[], HASH_ITEM *pItemLast )
+/*
+ * Most spans phrasing looks up have no user phrase. Each hash sets two
+ * bits of one word of the filter, so that a miss is mostly told by that
+ * word alone, without touching the table and the items. The word comes
+ * from the high bits of a second mix of the hash, the slot from the low
+ * bits of the hash. The filter has 8 bits for each slot, at least 16 for
+ * each item, and is built again whenever the table grows.
+ */
+#define HASH_FILTER_BITS_PER_SLOT (8)
+
+static uint64_t *HashFilterWord( const HASH_TABLE *table, unsigned int hash, uint64_t *pMask )
 {
-	HASH_ITEM *pNow = pItemLast ?
-			pItemLast->next :
-			pgdata->static_data.hashtable[ HashFunc( phoneSeq ) ];
-	
-	for ( ; pNow; pNow = pNow->next ) 
-		if ( PhoneSeqTheSame( pNow->data.phoneSeq, phoneSeq ) )
-			return pNow;
-	return NULL;
+	uint32_t f = hash * 0x9e3779b1u;
+
+	*pMask = (uint64_t) 1 << ( f & 63 ) | (uint64_t) 1 << ( ( f >> 6 ) & 63 );
+	return &table->filter[ f >> table->nFilterShift ];
 }
 
-HASH_ITEM *HashFindEntry( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[] )
+/* 0 if there is no item of hash in table */
+static int HashFilterTest( const HASH_TABLE *table, unsigned int hash )
 {
+	uint64_t mask;
+	uint64_t *word = HashFilterWord( table, hash, &mask );
+
+	return ( PLAT_ATOMIC_LOAD_U64( word ) & mask ) == mask;
+}
+
+/* the first item of phoneSeq at or after the slot of cursor in probe order */
+static HASH_ITEM *ProbePhonePhrase( ChewingData *pgdata,
+		const uint16_t phoneSeq[], HashCursor *cursor )
+{
+	HASH_TABLE *table = cursor->table;
+	unsigned int mask = table->nSlot - 1;
 	HASH_ITEM *pItem;
-	int hashvalue;
 
-	hashvalue = HashFunc( phoneSeq );
+	for ( ; ; cursor->slot = ( cursor->slot + 1 ) & mask ) {
+		pItem = PLAT_ATOMIC_LOAD_PTR( &table->slot[ cursor->slot ] );
+		pgdata->session.nHashProbe++;
+		if ( ! pItem ) {
+			cursor->table = NULL;
+			return NULL;
+		}
+		if ( pItem->hash == cursor->hash && PhoneSeqTheSame( pItem->data.phoneSeq, phoneSeq ) )
+			return pItem;
+	}
+}
+
+/* the first user phrase of phoneSeq, cursor is for HashFindNextPhrase() */
+HASH_ITEM *HashFindPhonePhrase( ChewingData *pgdata, const uint16_t phoneSeq[], HashCursor *cursor )
+{
+	cursor->table = PLAT_ATOMIC_LOAD_PTR( &pgdata->session.hashStore->table );
+	if ( ! cursor->table )
+		return NULL;
+
+	pgdata->session.nHashLookup++;
+	cursor->hash = HashFunc( phoneSeq );
+	if ( ! HashFilterTest( cursor->table, cursor->hash ) ) {
+		cursor->table = NULL;
+		return NULL;
+	}
+	cursor->slot = cursor->hash & ( cursor->table->nSlot - 1 );
+	return ProbePhonePhrase( pgdata, phoneSeq, cursor );
+}
+
+/* the user phrase of phoneSeq after the one cursor is at, in the same table */
+HASH_ITEM *HashFindNextPhrase( ChewingData *pgdata, const uint16_t phoneSeq[], HashCursor *cursor )
+{
+	if ( ! cursor->table )
+		return NULL;
+	cursor->slot = ( cursor->slot + 1 ) & ( cursor->table->nSlot - 1 );
+	return ProbePhonePhrase( pgdata, phoneSeq, cursor );
+}
+
+HASH_ITEM *HashFindEntry( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[] )
+{
+	HashCursor cursor;
+	HASH_ITEM *pItem;
 
-	for ( pItem = pgdata->static_data.hashtable[ hashvalue ]; pItem ; pItem = pItem->next ) {
-		if ( 
-			! strcmp( pItem->data.wordSeq, wordSeq ) && 
-			PhoneSeqTheSame( pItem->data.phoneSeq, phoneSeq ) ) {
+	for ( pItem = HashFindPhonePhrase( pgdata, phoneSeq, &cursor ); pItem;
+			pItem = HashFindNextPhrase( pgdata, phoneSeq, &cursor ) ) {
+		if ( ! strcmp( pItem->data.wordSeq, wordSeq ) )
 			return pItem;
-		}
 	}
 	return NULL;
 }
 
+/*
+ * Lookups made without HashLock() go between these two, which nest. The
+ * epoch is stored before the table is loaded, so that a writer replacing
+ * the table after that load is sure to find the epoch, and keeps the
+ * table until it is gone.
+ */
+void HashReadBegin( ChewingData *pgdata )
+{
+	HashReader *reader = &pgdata->session.hashReader;
+
+	if ( reader->depth++ == 0 )
+		PLAT_ATOMIC_STORE_UINT( &reader->epoch,
+			PLAT_ATOMIC_LOAD_UINT( &pgdata->session.hashStore->epoch ) );
+}
+
+void HashReadEnd( ChewingData *pgdata )
+{
+	HashReader *reader = &pgdata->session.hashReader;
+
+	if ( --reader->depth == 0 )
+		PLAT_ATOMIC_STORE_UINT( &reader->epoch, 0 );
+}
+
+static void FreeTable( HASH_TABLE *table )
+{
+	if ( table ) {
+		free( table->slot );
+		free( table->filter );
+		free( table );
+	}
+}
+
+/* free the replaced tables that no reader may be in any more */
+static void HashReclaim( HASH_STORE *store )
+{
+	HashReader *reader;
+	HASH_TABLE **pp, *table;
+	unsigned int oldest = UINT_MAX, epoch;
+
+	for ( reader = store->readers; reader; reader = reader->next ) {
+		epoch = PLAT_ATOMIC_LOAD_UINT( &reader->epoch );
+		if ( epoch && epoch < oldest )
+			oldest = epoch;
+	}
+	for ( pp = &store->retired; ( table = *pp ); ) {
+		if ( table->retiredEpoch < oldest ) {
+			*pp = table->nextRetired;
+			FreeTable( table );
+		}
+		else
+			pp = &table->nextRetired;
+	}
+}
+
+/*
+ * Changes to the user phrases are made with the lock of their store
+ * held. The functions of this file that change them without taking it
+ * leave that to the caller.
+ */
+void HashLock( ChewingData *pgdata )
+{
+	PLAT_MUTEX_LOCK( &pgdata->session.hashStore->lock );
+}
+
+void HashUnlock( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+
+	if ( store->retired )
+		HashReclaim( store );
+	PLAT_MUTEX_UNLOCK( &store->lock );
+}
+
+/* changes whenever a user phrase is added or changed, see HashChanged() */
+unsigned int HashGeneration( ChewingData *pgdata )
+{
+	return PLAT_ATOMIC_LOAD_UINT( &pgdata->session.hashStore->hash_generation );
+}
+
+/* with the lock held, tell the caches of lookups that a phrase changed */
+void HashChanged( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+
+	PLAT_ATOMIC_STORE_UINT( &store->hash_generation, store->hash_generation + 1 );
+}
+
+/* one more key stroke, by which the ages of the user phrases go */
+void HashTick( ChewingData *pgdata )
+{
+	HashLock( pgdata );
+	pgdata->session.hashStore->chewing_lifetime++;
+	HashUnlock( pgdata );
+}
+
+/* an empty table of nSlot slots, NULL if out of memory */
+static HASH_TABLE *NewTable( unsigned int nSlot )
+{
+	HASH_TABLE *table = ALC( HASH_TABLE, 1 );
+	unsigned int nWord = nSlot * HASH_FILTER_BITS_PER_SLOT / 64;
+
+	if ( ! table )
+		return NULL;
+	table->slot = ALC( HASH_ITEM *, nSlot );
+	table->filter = ALC( uint64_t, nWord );
+	if ( ! table->slot || ! table->filter ) {
+		FreeTable( table );
+		return NULL;
+	}
+	table->nSlot = nSlot;
+	for ( table->nFilterShift = 32; nWord > 1; nWord >>= 1 )
+		table->nFilterShift--;
+	return table;
+}
+
+/* put pItem, its hash set, into the first free slot of its probe */
+static void HashPut( HASH_TABLE *table, HASH_ITEM *pItem )
+{
+	unsigned int mask = table->nSlot - 1;
+	unsigned int slot;
+	uint64_t bits, *word = HashFilterWord( table, pItem->hash, &bits );
+
+	PLAT_ATOMIC_OR_U64( word, bits );
+	for ( slot = pItem->hash & mask; table->slot[ slot ];
+			slot = ( slot + 1 ) & mask )
+		;
+	PLAT_ATOMIC_STORE_PTR( &table->slot[ slot ], pItem );
+}
+
+/* grow the table so that nItem items fill at most half of it, 0 on success */
+static int HashReserve( HASH_STORE *store, unsigned int nItem )
+{
+	HASH_TABLE *old = store->table, *table;
+	unsigned int nOld = old ? old->nSlot : 0;
+	unsigned int nSlot = nOld ? nOld : HASH_TABLE_MIN_SIZE;
+	unsigned int i;
+
+	while ( nItem > nSlot / 2 )
+		nSlot *= 2;
+	if ( nSlot == nOld )
+		return 0;
+
+	table = NewTable( nSlot );
+	if ( ! table )
+		return -1;
+	for ( i = 0; i < nOld; i++ ) {
+		if ( old->slot[ i ] )
+			HashPut( table, old->slot[ i ] );
+	}
+
+	/* readers find the new table whole, those still in the old one keep it */
+	PLAT_ATOMIC_STORE_PTR( &store->table, table );
+	if ( old ) {
+		old->retiredEpoch = store->epoch;
+		old->nextRetired = store->retired;
+		store->retired = old;
+		PLAT_ATOMIC_STORE_UINT( &store->epoch, store->epoch + 1 );
+		HashReclaim( store );
+	}
+	return 0;
+}
+
+/* the sequences of pData are copied, and need not outlive the call */
 HASH_ITEM *HashInsert( ChewingData *pgdata, UserPhraseData *pData )
 {
-	int hashvalue;
+	HASH_STORE *store = pgdata->session.hashStore;
 	HASH_ITEM *pItem;
+	int len;
 
 	pItem = HashFindEntry( pgdata, pData->phoneSeq, pData->wordSeq );
 	if ( pItem != NULL )
 		return pItem;
 
-	pItem = ALC( HASH_ITEM, 1 );
+	for ( len = 0; pData->phoneSeq[ len ] != 0; len++ )
+		;
+	if ( len > MAX_PHRASE_LEN || strlen( pData->wordSeq ) >= sizeof( pItem->wordSeq ) )
+		return NULL;
+	if ( HashReserve( store, store->nHashItem + 1 ) )
+		return NULL;
+	/* learned items live as long as the store, and are freed with it */
+	pItem = ARENA_ALC( &store->hashArena, HASH_ITEM, 1 );
 	if ( ! pItem )
 		return NULL;  /* Error occurs */
 
-	hashvalue = HashFunc( pData->phoneSeq );
-	/* set the new element */
-	pItem->next = pgdata->static_data.hashtable[ hashvalue ];
-
 	memcpy( &( pItem->data ), pData, sizeof( pItem->data ) );
+	SetItemSeq( pItem );
+	memcpy( pItem->phoneSeq, pData->phoneSeq, ( len + 1 ) * sizeof( pItem->phoneSeq[ 0 ] ) );
+	strcpy( pItem->wordSeq, pData->wordSeq );
 	pItem->item_index = -1;
-
-	/* set link to the new element */
-	pgdata->static_data.hashtable[ hashvalue ] = pItem;
+	pItem->hash = HashFunc( pData->phoneSeq );
+	HashPut( store->table, pItem );
+	store->nHashItem++;
 
 	return pItem;
 }
@@ -147,76 +379,34 @@ static void HashItem2String( char *str, HASH_ITEM *pItem )
 void HashItem2Binary( char *str, HASH_ITEM *pItem )
 {
 	int i, phraselen;
-	uint16_t *pshort;
 	unsigned char *puc;
 
 	memset( str, 0, FIELD_SIZE );
-	if ( sizeof(int) * 4 + ueStrLen( pItem->data.wordSeq ) * 2 +
+	if ( 4 * 4 + ueStrLen( pItem->data.wordSeq ) * 2 +
 	     strlen( pItem->data.wordSeq ) >= FIELD_SIZE ) {
 		/* exceed buffer size */
 		return;
 	}
 
-	/* freq info */
-	*(int*) &str[ 0 ] = pItem->data.userfreq;
-	*(int*) &str[ 4 ] = pItem->data.recentTime;
-	*(int*) &str[ 8 ] = pItem->data.maxfreq;
-	*(int*) &str[ 12 ] = pItem->data.origfreq;
+	/* freq info, little-endian */
+	PutUint32LE( &str[ 0 ], pItem->data.userfreq );
+	PutUint32LE( &str[ 4 ], pItem->data.recentTime );
+	PutUint32LE( &str[ 8 ], pItem->data.maxfreq );
+	PutUint32LE( &str[ 12 ], pItem->data.origfreq );
 
 	/* phone seq*/
 	phraselen = ueStrLen( pItem->data.wordSeq );
 	str[ 16 ] = phraselen;
-	pshort = (uint16_t *) &str[ 17 ];
-	for ( i = 0; i < phraselen; i++ ) {
-		*pshort = pItem->data.phoneSeq[ i ];
-		pshort++;
-	}
+	for ( i = 0; i < phraselen; i++ )
+		PutUint16LE( &str[ 17 + i * 2 ], pItem->data.phoneSeq[ i ] );
 
 	/* phrase */
-	puc = (unsigned char *) pshort;
+	puc = (unsigned char *) &str[ 17 + phraselen * 2 ];
 	*puc = strlen( pItem->data.wordSeq );
 	strcpy( (char *) (puc + 1), pItem->data.wordSeq );
 	pItem->data.wordSeq[ (int) *puc ] = '\0';
 }
 
-void HashModify( ChewingData *pgdata, HASH_ITEM *pItem )
-{
-	FILE *outfile;
-	char str[ FIELD_SIZE + 1 ];
-
-	outfile = fopen( pgdata->static_data.hashfilename, "r+b" );
-
-	/* update "lifetime" */
-	fseek( outfile, strlen( BIN_HASH_SIG ), SEEK_SET );
-	fwrite( &pgdata->static_data.chewing_lifetime, 1, 4, outfile );
-#ifdef ENABLE_DEBUG
-	sprintf( str, "%d", pgdata->static_data.chewing_lifetime );
-	DEBUG_OUT( "HashModify-1: '%-75s'\n", str );
-	DEBUG_FLUSH;
-#endif
-
-	/* update record */
-	if ( pItem->item_index < 0 ) {
-		fseek( outfile, 0, SEEK_END );
-		pItem->item_index =
-			( ftell( outfile ) - 4 - strlen( BIN_HASH_SIG ) ) / FIELD_SIZE;
-	}
-	else {
-		fseek( outfile,
-			pItem->item_index * FIELD_SIZE + 4 + strlen( BIN_HASH_SIG ),
-			SEEK_SET );
-	}
-#ifdef ENABLE_DEBUG
-	HashItem2String( str, pItem );
-	DEBUG_OUT( "HashModify-2: '%-75s'\n", str );
-	DEBUG_FLUSH;
-#endif
-	HashItem2Binary( str, pItem );
-	fwrite( str, 1, FIELD_SIZE, outfile );
-	fflush( outfile );
-	fclose( outfile );
-}
-
 static int isValidChineseString( char *str )
 {
 	if ( str == NULL || *str == '\0' ) {
@@ -232,13 +422,6 @@ static int isValidChineseString( char *str )
 	return 1;
 }
 
-static int ReadInt(unsigned char *addr)
-{
-	/* TODO: Use bit-wise operation to read */
-	int *p = (void*)addr;
-	return *p;
-}
-
 /**
  * @return 1, 0 or -1
  * retval 0	end of file
@@ -247,61 +430,44 @@ static int ReadInt(unsigned char *addr)
  */
 int ReadHashItem_bin( const char *srcbuf, HASH_ITEM *pItem, int item_index )
 {
-	int len, i;
-	uint16_t *pshort;
-	unsigned char recbuf[ FIELD_SIZE ], *puc;
+	int len, word_len, i;
+	const unsigned char *recbuf = (const unsigned char *) srcbuf;
 
-	memcpy( recbuf, srcbuf, FIELD_SIZE );
 	memset( pItem, 0, sizeof(HASH_ITEM) );
+	SetItemSeq( pItem );
 
 	/* freq info */
-	pItem->data.userfreq	= ReadInt(&recbuf[ 0 ]);
-	pItem->data.recentTime	= ReadInt(&recbuf[ 4 ]);
-	pItem->data.maxfreq	= ReadInt(&recbuf[ 8 ]);
-	pItem->data.origfreq	= ReadInt(&recbuf[ 12 ]);
+	pItem->data.userfreq	= (int32_t) GetUint32LE( &recbuf[ 0 ] );
+	pItem->data.recentTime	= (int32_t) GetUint32LE( &recbuf[ 4 ] );
+	pItem->data.maxfreq	= (int32_t) GetUint32LE( &recbuf[ 8 ] );
+	pItem->data.origfreq	= (int32_t) GetUint32LE( &recbuf[ 12 ] );
 
 	/* phone seq, length in num of chi words */
 	len = (int) recbuf[ 16 ];
-	pItem->data.phoneSeq = ALC( uint16_t, len + 1 );
-	pshort = (uint16_t *) &recbuf[ 17 ];
-	for ( i = 0; i < len; i++ ) {
-		pItem->data.phoneSeq[ i ] = *pshort;
-		++pshort;
-	}
-	pItem->data.phoneSeq[ i ] = 0;
+	if ( len > MAX_PHRASE_LEN )
+		return -1;
+	for ( i = 0; i < len; i++ )
+		pItem->phoneSeq[ i ] = GetUint16LE( &recbuf[ 17 + i * 2 ] );
+	pItem->phoneSeq[ i ] = 0;
 
 	/* phrase, length in num of bytes */
-	puc = (unsigned char *) pshort;
-	pItem->data.wordSeq = ALC( char, (*puc) + 1 );
-	strcpy( pItem->data.wordSeq, (char *) (puc + 1) );
-	pItem->data.wordSeq[ (int) *puc ] = '\0';
+	word_len = recbuf[ 17 + len * 2 ];
+	if ( word_len >= (int) sizeof( pItem->wordSeq ) ||
+			18 + len * 2 + word_len > FIELD_SIZE )
+		return -1;
+	memcpy( pItem->wordSeq, &recbuf[ 18 + len * 2 ], word_len );
+	pItem->wordSeq[ word_len ] = '\0';
 
 	/* Invalid UTF-8 Chinese characters found */
-	if ( ! isValidChineseString( pItem->data.wordSeq ) ) {
-		goto ignore_corrupted_record;
-	}
+	if ( ! isValidChineseString( pItem->wordSeq ) )
+		return -1; /* ignore */
 
 	/* set item_index */
 	pItem->item_index = item_index;
 
 	return 1; /* continue */
-
-ignore_corrupted_record:
-	if ( pItem->data.phoneSeq != NULL ) {
-		free( pItem->data.phoneSeq );
-		pItem->data.phoneSeq = NULL;
-	}
-	if ( pItem->data.wordSeq != NULL ) {
-		free( pItem->data.wordSeq );
-		pItem->data.wordSeq = NULL;
-	}
-	return -1; /* ignore */
 }
 
-/**
- * @return 1, 0 or -1
- * retval -1 Ignore bad data item
- */
 int ReadHashItem_txt( FILE *infile, HASH_ITEM *pItem, int item_index )
 {
 	int len, i, word_len;
@@ -318,12 +484,15 @@ int ReadHashItem_txt( FILE *infile, HASH_ITEM *pItem, int item_index )
 	}
 
 	word_len = strlen( wordbuf );
-	pItem->data.wordSeq = ALC( char, word_len + 1 );
+	len = ueStrLen( wordbuf );
+	if ( word_len >= (int) sizeof( pItem->wordSeq ) || len > MAX_PHRASE_LEN ) {
+		fseek( infile, FIELD_SIZE - strlen( wordbuf ) - 1, SEEK_CUR );
+		return -1;
+	}
+	SetItemSeq( pItem );
 	strcpy( pItem->data.wordSeq, wordbuf );
 
 	/* read phoneSeq */
-	len = ueStrLen( pItem->data.wordSeq );
-	pItem->data.phoneSeq = ALC( uint16_t, len + 1 );
 	for ( i = 0; i < len; i++ )
 		if ( fscanf( infile, "%hu", &( pItem->data.phoneSeq[ i ] ) ) != 1 )
 			return 0;
@@ -343,6 +512,620 @@ int ReadHashItem_txt( FILE *infile, HASH_ITEM *pItem, int item_index )
 	return 1;
 }
 
+/* offset of the record item_index in HASH_FILE */
+static long RecordOffset( int item_index )
+{
+	return (long) item_index * FIELD_SIZE + 4 + strlen( BIN_HASH_SIG );
+}
+
+/* the number of whole records in fp */
+static int CountRecords( FILE *fp )
+{
+	long size;
+
+	if ( fseek( fp, 0, SEEK_END ) || ( size = ftell( fp ) ) < RecordOffset( 0 ) )
+		return 0;
+	return ( size - RecordOffset( 0 ) ) / FIELD_SIZE;
+}
+
+static void JournalFileName( ChewingData *pgdata, int slot, char *filename, size_t size )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	snprintf( filename, size, "%s" HASH_JOURNAL_SUFFIX ".%d",
+		store->hashfilename, slot );
+}
+
+/* record pItem in the journal, 0 once it is out of the process */
+static int AppendJournal( ChewingData *pgdata, HASH_ITEM *pItem )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	char entry[ HASH_JOURNAL_ENTRY_SIZE + 1 ];
+
+	if ( ! store->journal )
+		return -1;
+	PutUint32LE( &entry[ 0 ], store->chewing_lifetime );
+	PutUint32LE( &entry[ 4 ], pItem->item_index );
+	HashItem2Binary( &entry[ 8 ], pItem );
+	if ( fwrite( entry, HASH_JOURNAL_ENTRY_SIZE, 1, store->journal ) != 1 )
+		return -1;
+	pgdata->stats.nHashWriteBytes += HASH_JOURNAL_ENTRY_SIZE;
+	return fflush( store->journal ) ? -1 : 0;
+}
+
+/* the hash file, opened once and kept; the caller locks it */
+static FILE *OpenHashFile( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	if ( ! store->hashfile )
+		store->hashfile = fopen( store->hashfilename, "r+b" );
+	return store->hashfile;
+}
+
+/* which also drops the lock of the file */
+static void CloseHashFile( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	if ( store->hashfile )
+		fclose( store->hashfile );
+	store->hashfile = NULL;
+}
+
+/*
+ * Take in the records other processes appended since this one last
+ * looked, with the hash file locked. A phrase learned here too, but not
+ * yet written, takes over their record instead of adding another.
+ */
+static void MergeRecords( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	FILE *fp = store->hashfile;
+	char record[ FIELD_SIZE ];
+	HASH_ITEM item, *pItem;
+	int nRecord, item_index;
+
+	nRecord = CountRecords( fp );
+	if ( nRecord <= store->nHashRecord )
+		return;
+
+	fseek( fp, RecordOffset( store->nHashRecord ), SEEK_SET );
+	for ( item_index = store->nHashRecord; item_index < nRecord; item_index++ ) {
+		if ( fread( record, FIELD_SIZE, 1, fp ) != 1 )
+			break;
+		if ( ReadHashItem_bin( record, &item, item_index ) != 1 )
+			continue;
+
+		pItem = HashFindEntry( pgdata, item.data.phoneSeq, item.data.wordSeq );
+		if ( ! pItem ) {
+			pItem = HashInsert( pgdata, &item.data );
+			if ( pItem )
+				pItem->item_index = item_index;
+		}
+		else {
+			if ( pItem->item_index < 0 )
+				pItem->item_index = item_index;
+			if ( pItem->dirty || pItem->pending )
+				continue;
+			pItem->data.userfreq = item.data.userfreq;
+			pItem->data.recentTime = item.data.recentTime;
+			pItem->data.maxfreq = item.data.maxfreq;
+			pItem->data.origfreq = item.data.origfreq;
+		}
+	}
+	/* even past a short read, so that no record here gets their index */
+	store->nHashRecord = nRecord;
+	HashChanged( pgdata );
+}
+
+/*
+ * The hash file was replaced by HashCompact(), which moves records. Take
+ * the lifetime of the new file, and let MergeRecords() give the items
+ * their new indices; one that is gone stays in memory only.
+ */
+static void ForgetRecords( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	FILE *fp = store->hashfile;
+	char buf[ 4 ];
+	HASH_ITEM *pItem;
+	int lifetime, shift;
+	unsigned int i;
+
+	if ( fseek( fp, strlen( BIN_HASH_SIG ), SEEK_SET ) || fread( buf, 4, 1, fp ) != 1 )
+		return;
+	lifetime = (int32_t) GetUint32LE( buf );
+	shift = store->chewing_lifetime - lifetime;
+	for ( i = 0; store->table && i < store->table->nSlot; i++ ) {
+		if ( ( pItem = store->table->slot[ i ] ) ) {
+			pItem->item_index = -1;
+			pItem->data.recentTime -= shift;
+		}
+	}
+	store->chewing_lifetime = lifetime;
+	store->nHashRecord = 0;
+}
+
+/*
+ * Lock the hash file and take in what others wrote. A file that carries
+ * STALE_HASH_SIG was replaced after it was opened, the one at the path
+ * now is used instead.
+ */
+static FILE *LockHashFile( ChewingData *pgdata, int exclusive )
+{
+	FILE *fp;
+	char sig[ sizeof( BIN_HASH_SIG ) ];
+	int stale = 0;
+
+	while ( ( fp = OpenHashFile( pgdata ) ) ) {
+		if ( exclusive ? PLAT_LOCK_EXCLUSIVE( fileno( fp ) ) : PLAT_LOCK_SHARED( fileno( fp ) ) )
+			return NULL;
+		if ( fseek( fp, 0, SEEK_SET ) ||
+				fread( sig, strlen( STALE_HASH_SIG ), 1, fp ) != 1 ||
+				memcmp( sig, STALE_HASH_SIG, strlen( STALE_HASH_SIG ) ) )
+			break;
+		PLAT_UNLOCK( fileno( fp ) );
+		CloseHashFile( pgdata );
+		stale = 1;
+	}
+	if ( ! fp )
+		return NULL;
+	if ( stale )
+		ForgetRecords( pgdata );
+	MergeRecords( pgdata );
+	return fp;
+}
+
+/* HashSync() with the lock held */
+static int SyncRecords( ChewingData *pgdata )
+{
+	FILE *fp = LockHashFile( pgdata, 0 );
+
+	if ( ! fp )
+		return -1;
+	PLAT_UNLOCK( fileno( fp ) );
+	return 0;
+}
+
+/**
+ * @brief take in the user phrases other processes wrote back since
+ *
+ * @return 0 on success, -1 if the hash file cannot be read
+ */
+int HashSync( ChewingData *pgdata )
+{
+	int ret;
+
+	HashLock( pgdata );
+	ret = SyncRecords( pgdata );
+	HashUnlock( pgdata );
+	return ret;
+}
+
+/* write pItem at its record, or at the end for a new one; *pPos tracks fp */
+static void WriteItem( ChewingData *pgdata, FILE *fp, HASH_ITEM *pItem, long *pPos )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	char str[ FIELD_SIZE + 1 ];
+
+	if ( pItem->item_index < 0 )
+		pItem->item_index = store->nHashRecord++;
+	/* a seek flushes the buffer, records in a row are written at once */
+	if ( *pPos != RecordOffset( pItem->item_index ) ) {
+		*pPos = RecordOffset( pItem->item_index );
+		fseek( fp, *pPos, SEEK_SET );
+	}
+#ifdef ENABLE_DEBUG
+	HashItem2String( str, pItem );
+	DEBUG_OUT( "HashFlush-2: '%-75s'\n", str );
+	DEBUG_FLUSH;
+#endif
+	HashItem2Binary( str, pItem );
+	fwrite( str, 1, FIELD_SIZE, fp );
+	*pPos += FIELD_SIZE;
+	pgdata->stats.nHashWriteBytes += FIELD_SIZE;
+	pItem->dirty = 0;
+}
+
+/* HashFlush() with the lock held */
+static int FlushDirty( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	FILE *fp;
+	char str[ FIELD_SIZE + 1 ];
+	HASH_ITEM *pItem;
+	long pos = -1;
+	unsigned int i;
+	int ret = 0;
+
+	if ( store->nHashDirty == 0 && store->nHashUnlisted == 0 )
+		return 0;
+
+	fp = LockHashFile( pgdata, 1 );
+	if ( ! fp )
+		return -1;
+
+	/* update "lifetime" */
+	fseek( fp, strlen( BIN_HASH_SIG ), SEEK_SET );
+	PutUint32LE( str, store->chewing_lifetime );
+	fwrite( str, 1, 4, fp );
+#ifdef ENABLE_DEBUG
+	sprintf( str, "%d", store->chewing_lifetime );
+	DEBUG_OUT( "HashFlush-1: '%-75s'\n", str );
+	DEBUG_FLUSH;
+#endif
+
+	/* update records, new ones at the end */
+	for ( i = 0; i < (unsigned int) store->nHashDirty; i++ )
+		WriteItem( pgdata, fp, store->hash_dirty[ i ], &pos );
+	store->nHashDirty = 0;
+	/* then those of HashModifyBulk(), found in the table */
+	for ( i = 0; store->nHashUnlisted > 0 && i < store->table->nSlot; i++ ) {
+		pItem = store->table->slot[ i ];
+		if ( pItem && pItem->dirty ) {
+			WriteItem( pgdata, fp, pItem, &pos );
+			store->nHashUnlisted--;
+		}
+	}
+	store->nHashUnlisted = 0;
+	if ( fflush( fp ) || ferror( fp ) )
+		ret = -1;
+	PLAT_UNLOCK( fileno( fp ) );
+	if ( ret )
+		return -1;
+
+	if ( store->journal &&
+			PLAT_FTRUNCATE( fileno( store->journal ), 0 ) )
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief write the dirty user phrases into the hash file
+ *
+ * The records other processes appended are taken in first, so that new
+ * phrases go after them. The journal, all in the file by then, is emptied.
+ *
+ * @return 0 on success, -1 if the file cannot be written
+ */
+int HashFlush( ChewingData *pgdata )
+{
+	int ret;
+
+	HashLock( pgdata );
+	ret = FlushDirty( pgdata );
+	HashUnlock( pgdata );
+	return ret;
+}
+
+/* remember a changed user phrase, and write it back with others later */
+void HashModify( ChewingData *pgdata, HASH_ITEM *pItem )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	time_t now = time( NULL );
+
+	pgdata->stats.nHashWrite++;
+	/* with the lock held, the callback must not come back in */
+	TRACE_EVENT( pgdata, .type = CHEWING_TRACE_USERPHRASE_WRITE,
+		.nPhone = ueStrLen( pItem->data.wordSeq ),
+		.phrase = pItem->data.wordSeq );
+	if ( ! pItem->dirty ) {
+		if ( store->nHashDirty == HASH_DIRTY_MAX &&
+				FlushDirty( pgdata ) ) {
+			/* the list is still full, the next flush finds it in the table */
+			store->nHashUnlisted++;
+		} else {
+			if ( store->nHashDirty == 0 )
+				store->hash_dirty_since = now;
+			store->hash_dirty[ store->nHashDirty++ ] = pItem;
+		}
+		pItem->dirty = 1;
+	}
+
+	/* without a journal the change is only safe in the file */
+	if ( AppendJournal( pgdata, pItem ) ||
+			now - store->hash_dirty_since >= HASH_FLUSH_INTERVAL )
+		FlushDirty( pgdata );
+}
+
+/*
+ * Mark a changed user phrase for the next HashFlush(), without the
+ * journal; meant for more changes at a time than HASH_DIRTY_MAX, written
+ * back by the caller as soon as they are done.
+ */
+void HashModifyBulk( ChewingData *pgdata, HASH_ITEM *pItem )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+
+	if ( ! pItem->dirty ) {
+		pItem->dirty = 1;
+		store->nHashUnlisted++;
+	}
+}
+
+/* HashWritePending() with the lock held */
+static int WritePending( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	HASH_ITEM *pItem;
+	int i, nPending = store->nHashPending;
+
+	/* HashModify() may flush, which must not find them listed */
+	store->nHashPending = 0;
+	for ( i = 0; i < nPending; i++ ) {
+		pItem = store->hash_pending[ i ];
+		pItem->pending = 0;
+		HashModify( pgdata, pItem );
+	}
+	return nPending;
+}
+
+/**
+ * @brief give the changes of HashModifyDeferred() to HashModify()
+ *
+ * @return the number of user phrases journaled
+ */
+int HashWritePending( ChewingData *pgdata )
+{
+	int ret;
+
+	HashLock( pgdata );
+	ret = WritePending( pgdata );
+	HashUnlock( pgdata );
+	return ret;
+}
+
+/*
+ * Remember a changed user phrase for HashWritePending(), with nothing
+ * written on the way; the item is up to date in memory already.
+ */
+void HashModifyDeferred( ChewingData *pgdata, HASH_ITEM *pItem )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+
+	if ( pItem->pending )
+		return;
+	if ( store->nHashPending == HASH_DIRTY_MAX )
+		WritePending( pgdata );
+	store->hash_pending[ store->nHashPending++ ] = pItem;
+	pItem->pending = 1;
+}
+
+/**
+ * @brief rewrite the hash file with only the records in use
+ *
+ * Illegal records are dropped, and with evict the phrases that have
+ * decayed to their dictionary frequency too. Lifetimes start again from
+ * the oldest record left. The new file replaces the old one at once; the
+ * old one is marked with STALE_HASH_SIG for whoever still has it open.
+ *
+ * @return 0 on success, -1 if the file cannot be rewritten
+ */
+int HashCompact( ChewingData *pgdata, int evict )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	char tmpname[ sizeof( store->hashfilename ) + sizeof( HASH_COMPACT_SUFFIX ) ];
+	char header[ sizeof( BIN_HASH_SIG ) + 4 ];
+	char *records = NULL, *rec;
+	FILE *fp, *outfile;
+	HASH_ITEM item;
+	int nRecord, nKept = 0, item_index, lifetime, oldest, ret = -1;
+
+	HashLock( pgdata );
+	WritePending( pgdata );
+	if ( FlushDirty( pgdata ) || ! ( fp = LockHashFile( pgdata, 1 ) ) ) {
+		HashUnlock( pgdata );
+		return -1;
+	}
+
+	fseek( fp, 0, SEEK_SET );
+	if ( fread( header, strlen( BIN_HASH_SIG ) + 4, 1, fp ) != 1 ||
+			memcmp( header, BIN_HASH_SIG, strlen( BIN_HASH_SIG ) ) )
+		goto end;
+	lifetime = (int32_t) GetUint32LE( &header[ strlen( BIN_HASH_SIG ) ] );
+	oldest = lifetime;
+
+	nRecord = CountRecords( fp );
+	if ( nRecord > 0 && ! ( records = ALC( char, nRecord * FIELD_SIZE ) ) )
+		goto end;
+	fseek( fp, RecordOffset( 0 ), SEEK_SET );
+	for ( item_index = 0; item_index < nRecord; item_index++ ) {
+		rec = &records[ nKept * FIELD_SIZE ];
+		if ( fread( rec, FIELD_SIZE, 1, fp ) != 1 )
+			break;
+		if ( ReadHashItem_bin( rec, &item, item_index ) != 1 )
+			continue;
+		if ( evict && UserPhraseDecayed( pgdata, &item.data ) )
+			continue;
+		/* written by processes that each started their lifetime anew */
+		if ( item.data.recentTime > lifetime )
+			item.data.recentTime = lifetime;
+		if ( oldest > item.data.recentTime )
+			oldest = item.data.recentTime;
+		PutUint32LE( &rec[ 4 ], item.data.recentTime );
+		nKept++;
+	}
+	for ( item_index = 0; item_index < nKept; item_index++ ) {
+		rec = &records[ item_index * FIELD_SIZE ];
+		PutUint32LE( &rec[ 4 ], (int32_t) GetUint32LE( &rec[ 4 ] ) - oldest );
+	}
+	PutUint32LE( &header[ strlen( BIN_HASH_SIG ) ], lifetime - oldest );
+
+	sprintf( tmpname, "%s" HASH_COMPACT_SUFFIX, store->hashfilename );
+	outfile = fopen( tmpname, "wb" );
+	if ( ! outfile )
+		goto end;
+	if ( fwrite( header, strlen( BIN_HASH_SIG ) + 4, 1, outfile ) != 1 ||
+			( nKept > 0 && fwrite( records, FIELD_SIZE, nKept, outfile ) != (size_t) nKept ) ) {
+		fclose( outfile );
+		PLAT_UNLINK( tmpname );
+		goto end;
+	}
+	if ( fclose( outfile ) || PLAT_REPLACE( tmpname, store->hashfilename ) ) {
+		PLAT_UNLINK( tmpname );
+		goto end;
+	}
+
+	/* nobody writes the old file from here on, nor takes it for a text one */
+	fseek( fp, 0, SEEK_SET );
+	fwrite( STALE_HASH_SIG, 1, strlen( STALE_HASH_SIG ), fp );
+	fflush( fp );
+	ret = 0;
+end:
+	free( records );
+	PLAT_UNLOCK( fileno( fp ) );
+	/* and this context moves over to the new file */
+	if ( ret == 0 && ( fp = LockHashFile( pgdata, 0 ) ) )
+		PLAT_UNLOCK( fileno( fp ) );
+	HashUnlock( pgdata );
+	return ret;
+}
+
+/* the part of a record that tells phrases apart, past the frequencies */
+#define RECORD_KEY_OFFSET (16)
+#define RECORD_KEY_SIZE ( FIELD_SIZE - RECORD_KEY_OFFSET )
+
+/* whether the record item_index of fp is of the phrase key */
+static int RecordHasKey( FILE *fp, int item_index, const char *key )
+{
+	char buf[ RECORD_KEY_SIZE ];
+
+	return fseek( fp, RecordOffset( item_index ) + RECORD_KEY_OFFSET, SEEK_SET ) == 0 &&
+		fread( buf, RECORD_KEY_SIZE, 1, fp ) == 1 &&
+		! memcmp( buf, key, RECORD_KEY_SIZE );
+}
+
+/* the first record of fp of the phrase key, -1 if there is none */
+static int FindRecord( FILE *fp, int nRecord, const char *key )
+{
+	char record[ FIELD_SIZE ];
+	int item_index;
+
+	fseek( fp, RecordOffset( 0 ), SEEK_SET );
+	for ( item_index = 0; item_index < nRecord; item_index++ ) {
+		if ( fread( record, FIELD_SIZE, 1, fp ) != 1 )
+			break;
+		if ( ! memcmp( &record[ RECORD_KEY_OFFSET ], key, RECORD_KEY_SIZE ) )
+			return item_index;
+	}
+	return -1;
+}
+
+/*
+ * Write what a crashed process left in journal into the hash file. The
+ * index of an entry is checked against the phrase of the record, since
+ * the file may have been compacted after the entry was written.
+ */
+static void ReplayJournal( ChewingData *pgdata, FILE *journal )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	char entry[ HASH_JOURNAL_ENTRY_SIZE ];
+	char sig[ sizeof( BIN_HASH_SIG ) ];
+	char (*appended)[ RECORD_KEY_SIZE ] = NULL, (*grown)[ RECORD_KEY_SIZE ];
+	const char *key;
+	FILE *outfile;
+	int nRecord, nAppend = 0, nKey = 0;
+	int item_index, i;
+
+reopen:
+	outfile = fopen( store->hashfilename, "r+b" );
+	if ( ! outfile )
+		return;
+	if ( PLAT_LOCK_EXCLUSIVE( fileno( outfile ) ) ) {
+		fclose( outfile );
+		return;
+	}
+	if ( fread( sig, strlen( BIN_HASH_SIG ), 1, outfile ) != 1 )
+		goto end;
+	if ( ! memcmp( sig, STALE_HASH_SIG, strlen( STALE_HASH_SIG ) ) ) {
+		PLAT_UNLOCK( fileno( outfile ) );
+		fclose( outfile );
+		goto reopen;
+	}
+	if ( memcmp( sig, BIN_HASH_SIG, strlen( BIN_HASH_SIG ) ) )
+		goto end;
+	nRecord = CountRecords( outfile );
+
+	/* a torn entry at the end was never done */
+	fseek( journal, 0, SEEK_SET );
+	while ( fread( entry, HASH_JOURNAL_ENTRY_SIZE, 1, journal ) == 1 ) {
+		key = &entry[ 8 + RECORD_KEY_OFFSET ];
+		item_index = (int32_t) GetUint32LE( &entry[ 4 ] );
+		if ( item_index < 0 || item_index >= nRecord ||
+				! RecordHasKey( outfile, item_index, key ) ) {
+			/* a new phrase, appended once and then written in place */
+			for ( i = 0; i < nAppend; i++ ) {
+				if ( ! memcmp( appended[ i ], key, RECORD_KEY_SIZE ) )
+					break;
+			}
+			if ( i < nAppend )
+				item_index = nRecord + i;
+			else if ( ( item_index = FindRecord( outfile, nRecord, key ) ) < 0 ) {
+				if ( nAppend == nKey ) {
+					nKey = nKey ? nKey * 2 : 16;
+					grown = realloc( appended, nKey * sizeof( appended[ 0 ] ) );
+					if ( ! grown )
+						break;
+					appended = grown;
+				}
+				memcpy( appended[ nAppend ], key, RECORD_KEY_SIZE );
+				item_index = nRecord + nAppend++;
+			}
+		}
+
+		fseek( outfile, strlen( BIN_HASH_SIG ), SEEK_SET );
+		fwrite( &entry[ 0 ], 1, 4, outfile );
+		fseek( outfile, RecordOffset( item_index ), SEEK_SET );
+		fwrite( &entry[ 8 ], 1, FIELD_SIZE, outfile );
+	}
+	fflush( outfile );
+end:
+	PLAT_UNLOCK( fileno( outfile ) );
+	fclose( outfile );
+	free( appended );
+}
+
+/*
+ * Take the first journal that no other context holds a lock on. One that
+ * nobody holds but that has entries was left by a crash, and goes into
+ * the hash file first.
+ */
+static void ClaimJournal( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore;
+	char filename[ sizeof( store->hashfilename ) + sizeof( HASH_JOURNAL_SUFFIX ) + 8 ];
+	FILE *journal;
+	int slot;
+
+	store->journal = NULL;
+	for ( slot = 0; slot < HASH_JOURNAL_SLOTS; slot++ ) {
+		JournalFileName( pgdata, slot, filename, sizeof( filename ) );
+		/* create no more than the one this context takes */
+		if ( store->journal && access( filename, F_OK ) != 0 )
+			continue;
+		journal = fopen( filename, "a+b" );
+		if ( ! journal )
+			continue;
+		if ( PLAT_TRYLOCK_EXCLUSIVE( fileno( journal ) ) ) {
+			fclose( journal );
+			continue;
+		}
+
+		fseek( journal, 0, SEEK_END );
+		if ( ftell( journal ) > 0 ) {
+			ReplayJournal( pgdata, journal );
+			if ( PLAT_FTRUNCATE( fileno( journal ), 0 ) ) {
+				/* replayed again next time, which does no harm */
+				fclose( journal );
+				continue;
+			}
+		}
+
+		if ( ! store->journal )
+			store->journal = journal;
+		else
+			fclose( journal );
+	}
+}
+
 static FILE *open_file_get_length(
 		const char *filename, 
 		const char *otype, int *size)
@@ -359,39 +1142,10 @@ static FILE *open_file_get_length(
 	return tf;
 }
 
-char *_load_hash_file( const char *filename, int *size )
-{
-	int flen;
-	char *pd = NULL;
-	FILE *tf;
-
-	tf = open_file_get_length( filename, "rb", &flen );
-	if ( tf == NULL ) {
-		goto err_load_file;
-	}
-	pd = ALC( char, flen );
-	if ( pd == NULL ) {
-		goto err_load_file;
-	}
-	if ( fread( pd, flen, 1, tf ) != 1 ) {
-		goto err_load_file;
-	}
-	fclose( tf );
-	if ( size != NULL )
-		*size = flen;
-	return pd;
-
-err_load_file:
-	if ( pd != NULL )
-		free( pd );
-	if ( tf != NULL )
-		fclose( tf );
-	return NULL;
-}
-
 // FIXME: Remove ofliename
 static int migrate_hash_to_bin( ChewingData *pgdata, const char *ofilename )
 {
+	HASH_STORE *store = pgdata->session.hashStore;
 	FILE *txtfile;
 	char oldname[ 256 ], *dump, *seekdump;
 	HASH_ITEM item;
@@ -408,7 +1162,7 @@ static int migrate_hash_to_bin( ChewingData *pgdata, const char *ofilename )
 		fclose( txtfile );
 		return 0;
 	}
-	ret = fscanf( txtfile, "%d", &pgdata->static_data.chewing_lifetime );
+	ret = fscanf( txtfile, "%d", &store->chewing_lifetime );
 	if ( ret != 1 ) {
 		return 0;
 	}
@@ -416,10 +1170,8 @@ static int migrate_hash_to_bin( ChewingData *pgdata, const char *ofilename )
 	/* prepare the bin file */
 	seekdump = dump;
 	memcpy( seekdump, BIN_HASH_SIG, strlen( BIN_HASH_SIG ) );
-	memcpy( seekdump + strlen( BIN_HASH_SIG ),
-	        &pgdata->static_data.chewing_lifetime,
-		sizeof(pgdata->static_data.chewing_lifetime) );
-	seekdump += strlen( BIN_HASH_SIG ) + sizeof(pgdata->static_data.chewing_lifetime);
+	PutUint32LE( seekdump + strlen( BIN_HASH_SIG ), store->chewing_lifetime );
+	seekdump += strlen( BIN_HASH_SIG ) + 4;
 
 	/* migrate */
 	item_index = 0;
@@ -435,8 +1187,6 @@ static int migrate_hash_to_bin( ChewingData *pgdata, const char *ofilename )
 
 		HashItem2Binary( seekdump, &item );
 		seekdump += FIELD_SIZE;
-		free( item.data.phoneSeq );
-		free( item.data.wordSeq );
 	};
 	fclose( txtfile );
 
@@ -498,127 +1248,398 @@ static int ComputeChewingLifeTime()
 }
 #endif
 
-static void FreeHashItem( HASH_ITEM *aItem )
+/* heap bytes taken by the user phrases of pgdata, shared or not */
+size_t HashBytes( ChewingData *pgdata )
 {
-	if ( aItem ) {
-		HASH_ITEM *pItem = aItem->next;
-		free( aItem->data.phoneSeq );
-		free( aItem->data.wordSeq );
-		free( aItem );
-		if ( pItem ) {
-			FreeHashItem( pItem );
-		}
+	HASH_STORE *store = pgdata->session.hashStore;
+	size_t nSlot = store && store->table ? store->table->nSlot : 0;
+
+	if ( ! store )
+		return 0;
+	return nSlot * ( sizeof( HASH_ITEM * ) + HASH_FILTER_BITS_PER_SLOT / 8 ) +
+		store->nHashPool * sizeof( HASH_ITEM ) +
+		store->hashArena.total;
+}
+
+/* the stores of HashShare(), one for each hash file, and their references */
+static HASH_STORE *hash_store_list;
+static plat_mutex hash_store_lock = PLAT_MUTEX_INITIALIZER;
+
+/* a store of nothing yet for hashfilename, NULL if out of memory */
+static HASH_STORE *NewStore( const char *hashfilename )
+{
+	HASH_STORE *store = ALC( HASH_STORE, 1 );
+
+	if ( ! store )
+		return NULL;
+	snprintf( store->hashfilename, sizeof( store->hashfilename ), "%s", hashfilename );
+	PLAT_MUTEX_INIT( &store->lock );
+	store->refcount = 1;
+	/* 0 tells a context that reads nothing */
+	store->epoch = 1;
+	return store;
+}
+
+/* the items are in the pool and the arena, nothing to walk */
+static void FreeStore( HASH_STORE *store )
+{
+	HASH_TABLE *table;
+
+	if ( store->hashfile )
+		fclose( store->hashfile );
+	/* the lock goes, the empty journal stays for whoever comes next */
+	if ( store->journal )
+		fclose( store->journal );
+	FreeTable( store->table );
+	while ( ( table = store->retired ) ) {
+		store->retired = table->nextRetired;
+		FreeTable( table );
 	}
+	free( store->hash_pool );
+	TerminateArena( &store->hashArena );
+	PLAT_MUTEX_DESTROY( &store->lock );
+	free( store );
+}
+
+/* let pgdata hold store, of which it has a reference; -1 if store is NULL */
+static int AttachStore( ChewingData *pgdata, HASH_STORE *store )
+{
+	HashReader *reader = &pgdata->session.hashReader;
+
+	if ( ! store )
+		return -1;
+	PLAT_MUTEX_LOCK( &store->lock );
+	reader->epoch = 0;
+	reader->depth = 0;
+	reader->next = store->readers;
+	store->readers = reader;
+	PLAT_MUTEX_UNLOCK( &store->lock );
+	pgdata->session.hashStore = store;
+	return 0;
+}
+
+/*
+ * Write back what pgdata changed and drop its store, the last one frees it.
+ * The reference goes last, once pgdata is done with the store: until then
+ * no other context can free it.
+ */
+static void ReleaseStore( ChewingData *pgdata )
+{
+	HASH_STORE *store = pgdata->session.hashStore, **pp;
+	HashReader **ppReader;
+	int bLast;
+
+	HashLock( pgdata );
+	WritePending( pgdata );
+	FlushDirty( pgdata );
+	for ( ppReader = &store->readers; *ppReader != &pgdata->session.hashReader;
+			ppReader = &( *ppReader )->next )
+		;
+	*ppReader = pgdata->session.hashReader.next;
+	HashUnlock( pgdata );
+	pgdata->session.hashStore = NULL;
+
+	PLAT_MUTEX_LOCK( &hash_store_lock );
+	bLast = --store->refcount == 0;
+	if ( bLast && store->bShared ) {
+		for ( pp = &hash_store_list; *pp != store; pp = &( *pp )->next )
+			;
+		*pp = store->next;
+	}
+	PLAT_MUTEX_UNLOCK( &hash_store_lock );
+
+	if ( bLast )
+		FreeStore( store );
 }
 
 void TerminateHash( ChewingData *pgdata )
+{
+	if ( pgdata->session.hashStore )
+		ReleaseStore( pgdata );
+}
+
+/*
+ * The items of from copied into to, which has none yet. The caller holds
+ * the lock of from, and has flushed it so that its items match their
+ * records.
+ */
+static int CopyItems( HASH_STORE *to, HASH_STORE *from )
 {
 	HASH_ITEM *pItem;
-	int i;
-	for ( i = 0; i < HASH_TABLE_SIZE; ++i ) {
-		pItem = pgdata->static_data.hashtable[ i ];
-		DEBUG_CHECKPOINT();
-		FreeHashItem( pItem );
+	unsigned int i, nItem = 0;
+
+	to->chewing_lifetime = from->chewing_lifetime;
+	to->nHashRecord = from->nHashRecord;
+	if ( from->nHashItem == 0 )
+		return 0;
+
+	to->hash_pool = ALC( HASH_ITEM, from->nHashItem );
+	if ( to->hash_pool )
+		to->nHashPool = from->nHashItem;
+	if ( ! to->hash_pool || HashReserve( to, from->nHashItem ) )
+		return -1;
+	for ( i = 0; i < from->table->nSlot; i++ ) {
+		if ( ! from->table->slot[ i ] )
+			continue;
+		pItem = &to->hash_pool[ nItem++ ];
+		memcpy( pItem, from->table->slot[ i ], sizeof( *pItem ) );
+		SetItemSeq( pItem );
+		pItem->dirty = 0;
+		pItem->pending = 0;
+		HashPut( to->table, pItem );
+	}
+	to->nHashItem = nItem;
+	return 0;
+}
+
+/* take another reference to store if it is shared, 1 if so */
+static int AttachShared( ChewingData *pgdata, HASH_STORE *store )
+{
+	int bShared;
+
+	PLAT_MUTEX_LOCK( &hash_store_lock );
+	bShared = store->bShared;
+	if ( bShared )
+		++store->refcount;
+	PLAT_MUTEX_UNLOCK( &hash_store_lock );
+	if ( bShared )
+		AttachStore( pgdata, store );
+	return bShared;
+}
+
+/**
+ * @brief start the user phrases of pgdata as those of from
+ *
+ * A store from shares is held by pgdata too. Otherwise the hash file is
+ * not read again: from is flushed, so that its items match their records,
+ * and copied. What others wrote since is taken in by the next lock of the
+ * file, as for any context.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+int HashClone( ChewingData *pgdata, ChewingData *from )
+{
+	int ret;
+
+	if ( AttachShared( pgdata, from->session.hashStore ) )
+		return 0;
+	if ( AttachStore( pgdata, NewStore( from->session.hashStore->hashfilename ) ) )
+		return -1;
+
+	HashLock( from );
+	WritePending( from );
+	FlushDirty( from );
+	ClaimJournal( pgdata );
+	ret = CopyItems( pgdata->session.hashStore, from->session.hashStore );
+	HashUnlock( from );
+	return ret;
+}
+
+/**
+ * @brief hold the user phrases of pgdata together with other contexts or alone
+ *
+ * Shared, the contexts of the process using the same hash file hold one
+ * store, and see at once what any of them learns. The first context to
+ * share lends its store to the others. A later one writes back what it
+ * learned and moves over to that store, in which its phrases are then
+ * found as those of another process would be, see SyncRecords(). No
+ * longer shared, pgdata takes a copy of the store.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+int HashShare( ChewingData *pgdata, int bShare )
+{
+	HASH_STORE *store = pgdata->session.hashStore, *other, *copy, **pp;
+	int ret;
+
+	PLAT_MUTEX_LOCK( &hash_store_lock );
+	if ( ( bShare != 0 ) == store->bShared ) {
+		PLAT_MUTEX_UNLOCK( &hash_store_lock );
+		return 0;
+	}
+	if ( bShare ) {
+		for ( other = hash_store_list; other; other = other->next ) {
+			if ( ! strcmp( other->hashfilename, store->hashfilename ) )
+				break;
+		}
+		if ( ! other ) {
+			store->bShared = 1;
+			store->next = hash_store_list;
+			hash_store_list = store;
+			PLAT_MUTEX_UNLOCK( &hash_store_lock );
+			return 0;
+		}
+		++other->refcount;
+		PLAT_MUTEX_UNLOCK( &hash_store_lock );
+
+		ReleaseStore( pgdata );
+		AttachStore( pgdata, other );
+		HashSync( pgdata );
+		return 0;
 	}
+
+	if ( store->refcount == 1 ) {
+		for ( pp = &hash_store_list; *pp != store; pp = &( *pp )->next )
+			;
+		*pp = store->next;
+		store->bShared = 0;
+		PLAT_MUTEX_UNLOCK( &hash_store_lock );
+		return 0;
+	}
+	PLAT_MUTEX_UNLOCK( &hash_store_lock );
+
+	copy = NewStore( store->hashfilename );
+	if ( ! copy )
+		return -1;
+	HashLock( pgdata );
+	WritePending( pgdata );
+	FlushDirty( pgdata );
+	ret = CopyItems( copy, store );
+	HashUnlock( pgdata );
+	if ( ret ) {
+		FreeStore( copy );
+		return -1;
+	}
+	ReleaseStore( pgdata );
+	AttachStore( pgdata, copy );
+	ClaimJournal( pgdata );
+	return 0;
+}
+
+/* whether the user phrases of pgdata are shared, see HashShare() */
+int HashShared( ChewingData *pgdata )
+{
+	int bShared;
+
+	PLAT_MUTEX_LOCK( &hash_store_lock );
+	bShared = pgdata->session.hashStore->bShared;
+	PLAT_MUTEX_UNLOCK( &hash_store_lock );
+	return bShared;
 }
 
 int InitHash( ChewingData *pgdata )
 {
-	HASH_ITEM item, *pItem, *pPool = NULL;
-	int item_index, hashvalue, iret, fsize, hdrlen, oldest = INT_MAX;
-	char *dump, *seekdump;
+	HASH_STORE *store;
+	HASH_ITEM *pItem;
+	int item_index, nItem, iret, hdrlen, oldest = INT_MAX;
+	plat_mmap hash_mmap;
+	size_t fsize, offset, csize;
+	const char *dump, *seekdump;
+	char hashfilename[ sizeof( store->hashfilename ) ];
 
 	const char *path = getenv( "CHEWING_USER_PATH" );
 
 	/* make sure of write permission */
 	if ( path && access( path, W_OK ) == 0 ) {
-		sprintf( pgdata->static_data.hashfilename, "%s" PLAT_SEPARATOR "%s", path, HASH_FILE );
+		sprintf( hashfilename, "%s" PLAT_SEPARATOR "%s", path, HASH_FILE );
 	} else {
 		if ( getenv( "HOME" ) ) {
 			sprintf(
-				pgdata->static_data.hashfilename, "%s%s",
+				hashfilename, "%s%s",
 				getenv( "HOME" ), CHEWING_HASH_PATH );
 		}
 		else {
 			sprintf(
-				pgdata->static_data.hashfilename, "%s%s",
+				hashfilename, "%s%s",
 				PLAT_TMPDIR, CHEWING_HASH_PATH );
 		}
-		PLAT_MKDIR( pgdata->static_data.hashfilename );
-		strcat( pgdata->static_data.hashfilename, PLAT_SEPARATOR );
-		strcat( pgdata->static_data.hashfilename, HASH_FILE );
+		PLAT_MKDIR( hashfilename );
+		strcat( hashfilename, PLAT_SEPARATOR );
+		strcat( hashfilename, HASH_FILE );
 	}
-	memset( pgdata->static_data.hashtable, 0, sizeof( pgdata->static_data.hashtable ) );
+	if ( AttachStore( pgdata, NewStore( hashfilename ) ) )
+		return 0;
+	store = pgdata->session.hashStore;
+	ClaimJournal( pgdata );
 
 open_hash_file:
-	dump = _load_hash_file( pgdata->static_data.hashfilename, &fsize );
-	hdrlen = strlen( BIN_HASH_SIG ) + sizeof(pgdata->static_data.chewing_lifetime);
-	item_index = 0;
-	if ( dump == NULL || fsize < hdrlen ) {
+	/* no other process writes while the records are read */
+	if ( OpenHashFile( pgdata ) )
+		PLAT_LOCK_SHARED( fileno( store->hashfile ) );
+
+	/* the file is only read through once, to decode every record */
+	plat_mmap_set_invalid( &hash_mmap );
+	fsize = plat_mmap_create( &hash_mmap, store->hashfilename, FLAG_ATTRIBUTE_READ );
+	dump = NULL;
+	if ( fsize > 0 ) {
+		offset = 0;
+		csize = fsize;
+		dump = plat_mmap_set_view( &hash_mmap, &offset, &csize );
+		plat_mmap_advise( &hash_mmap, 0, fsize, FLAG_ADVICE_SEQUENTIAL );
+	}
+	/* the signature and the lifetime, little-endian */
+	hdrlen = strlen( BIN_HASH_SIG ) + 4;
+	if ( dump == NULL || fsize < (size_t) hdrlen ) {
 		FILE *outfile;
-		outfile = fopen( pgdata->static_data.hashfilename, "w+b" );
-		if ( ! outfile ) {
-			if ( dump ) {
-				free( dump );
-			}
+		plat_mmap_close( &hash_mmap );
+		CloseHashFile( pgdata );
+		outfile = fopen( store->hashfilename, "w+b" );
+		if ( ! outfile )
 			return 0;
-		}
-		pgdata->static_data.chewing_lifetime = 0;
+		store->chewing_lifetime = 0;
+		store->nHashRecord = 0;
 		fwrite( BIN_HASH_SIG, 1, strlen( BIN_HASH_SIG ), outfile );
-		fwrite( &pgdata->static_data.chewing_lifetime, 1,
-		                sizeof(pgdata->static_data.chewing_lifetime), outfile );
+		fwrite( "\0\0\0\0", 1, 4, outfile );	/* the lifetime */
 		fclose( outfile );
 	}
 	else {
+		if ( memcmp( dump, STALE_HASH_SIG, strlen( STALE_HASH_SIG ) ) == 0 ) {
+			/* replaced by HashCompact() since it was opened */
+			plat_mmap_close( &hash_mmap );
+			CloseHashFile( pgdata );
+			goto open_hash_file;
+		}
 		if ( memcmp(dump, BIN_HASH_SIG, strlen(BIN_HASH_SIG)) != 0 ) {
 			/* perform migrate from text-based to binary form */
-			free( dump );
-			if ( ! migrate_hash_to_bin( pgdata, pgdata->static_data.hashfilename ) ) {
+			plat_mmap_close( &hash_mmap );
+			CloseHashFile( pgdata );
+			if ( ! migrate_hash_to_bin( pgdata, store->hashfilename ) ) {
 				return  0;
 			}
 			goto open_hash_file;
 		}
 
-		pgdata->static_data.chewing_lifetime = *(int *) (dump + strlen( BIN_HASH_SIG ));
-		seekdump = dump + hdrlen;
-		fsize -= hdrlen;
+		store->chewing_lifetime = (int32_t) GetUint32LE( dump + strlen( BIN_HASH_SIG ) );
+		store->nHashRecord = ( fsize - hdrlen ) / FIELD_SIZE;
+		if ( store->nHashRecord > 0 ) {
+			store->hash_pool = ALC( HASH_ITEM, store->nHashRecord );
+			if ( store->hash_pool )
+				store->nHashPool = store->nHashRecord;
+			if ( ! store->hash_pool ||
+					HashReserve( store, store->nHashRecord ) ) {
+				plat_mmap_close( &hash_mmap );
+				CloseHashFile( pgdata );
+				return 0;
+			}
+		}
 
-		while ( fsize >= FIELD_SIZE ) {
-			iret = ReadHashItem_bin( seekdump, &item, item_index++ );
+		/* the index of an item is the position of its record */
+		nItem = 0;
+		seekdump = dump + hdrlen;
+		for ( item_index = 0; item_index < store->nHashRecord; item_index++ ) {
+			pItem = &store->hash_pool[ nItem ];
+			iret = ReadHashItem_bin( seekdump, pItem, item_index );
+			seekdump += FIELD_SIZE;
 			/* Ignore illegal data */
-			if ( iret == -1 ) {
-				seekdump += FIELD_SIZE;
-				fsize -= FIELD_SIZE;
-				--item_index;
+			if ( iret != 1 )
 				continue;
-			}
-			else if ( iret == 0 )
-				break;
 
-			pItem = ALC( HASH_ITEM, 1 );
-			memcpy( pItem, &item, sizeof( HASH_ITEM ) );
-			pItem->next = pPool;
-			pPool = pItem;
+			pItem->hash = HashFunc( pItem->data.phoneSeq );
+			HashPut( store->table, pItem );
+			nItem++;
 
 			if ( oldest > pItem->data.recentTime ) {
 				oldest = pItem->data.recentTime;
 			}
-
-			seekdump += FIELD_SIZE;
-			fsize -= FIELD_SIZE;
-		}
-		free( dump );
-
-		while ( pPool ) {
-			pItem = pPool;
-			pPool = pItem->next;
-
-			hashvalue = HashFunc( pItem->data.phoneSeq );
-			pItem->next = pgdata->static_data.hashtable[ hashvalue ];
-			pgdata->static_data.hashtable[ hashvalue ] = pItem;
-			pItem->data.recentTime -= oldest;
 		}
-		pgdata->static_data.chewing_lifetime -= oldest;
+		plat_mmap_close( &hash_mmap );
+		if ( store->hashfile )
+			PLAT_UNLOCK( fileno( store->hashfile ) );
+		store->nHashItem = nItem;
+
+		for ( item_index = 0; item_index < nItem; item_index++ )
+			store->hash_pool[ item_index ].data.recentTime -= oldest;
+		store->chewing_lifetime -= oldest;
 	}
 	return 1;
 }
@@ -19,9 +19,57 @@
 #include "global.h"
 #include "chewing-private.h"
 #include "zuin-private.h"
+#include "choice-private.h"
 #include "chewingio.h"
 #include "private.h"
 
+/*
+ * Concatenate the non-empty strings of wch[ 0 .. n - 1 ] into buf of size
+ * bytes. Only whole characters are copied, and buf is always terminated
+ * when size > 0. Returns the length of the whole string, like snprintf().
+ */
+static int CopyWchString( char *buf, int size, const wch_t wch[], int n,
+		int *pCount )
+{
+	int i, l;
+	int len = 0, end = 0, count = 0;
+
+	for ( i = 0; i < n; i++ ) {
+		l = strlen( (const char *) wch[ i ].s );
+		if ( l == 0 )
+			continue;
+		if ( len == end && len + l < size ) {
+			memcpy( buf + end, wch[ i ].s, l );
+			end += l;
+		}
+		len += l;
+		count++;
+	}
+	if ( size > 0 )
+		buf[ end ] = '\0';
+	if ( pCount )
+		*pCount = count;
+	return len;
+}
+
+static int CopyString( char *buf, int size, const char *str )
+{
+	int len = strlen( str );
+	int end = len;
+
+	if ( size > 0 ) {
+		/* as many whole characters as fit */
+		if ( end >= size ) {
+			end = size - 1;
+			while ( end > 0 && ( str[ end ] & 0xc0 ) == 0x80 )
+				end--;
+		}
+		memcpy( buf, str, end );
+		buf[ end ] = '\0';
+	}
+	return len;
+}
+
 /**
  * @param ctx handle to Chewing IM context
  * @retval TRUE if it currnet input state is at the "end-of-a-char"
@@ -39,16 +87,29 @@ CHEWING_API int chewing_commit_Check( ChewingContext *ctx )
  */
 CHEWING_API char *chewing_commit_String( ChewingContext *ctx )
 {
-	int i;
-	char *s = (char *) calloc(
-		1 + ctx->output->nCommitStr,
-		sizeof(char) * MAX_UTF8_SIZE );
-	for ( i = 0; i < ctx->output->nCommitStr; i++ ) {
-		strcat( s, (char *) (ctx->output->commitStr[ i ].s) );
-	}
+	int size = ( 1 + ctx->output->nCommitStr ) * MAX_UTF8_SIZE;
+	char *s = (char *) calloc( size, sizeof(char) );
+	if ( s )
+		CopyWchString( s, size, ctx->output->commitStr,
+			ctx->output->nCommitStr, NULL );
 	return s;
 }
 
+/**
+ * @param ctx handle to Chewing IM context
+ * @param buf buffer to receive the string, may be NULL if size is 0
+ * @param size size of buf in bytes
+ *
+ * Copies the current commit string into buf, truncated at a character
+ * boundary if it does not fit. Returns the length of the whole string.
+ */
+CHEWING_API int chewing_commit_String_copy( ChewingContext *ctx,
+		char *buf, int size )
+{
+	return CopyWchString( buf, size, ctx->output->commitStr,
+		ctx->output->nCommitStr, NULL );
+}
+
 CHEWING_API int chewing_buffer_Check( ChewingContext *ctx )
 {
 	return (ctx->output->chiSymbolBufLen != 0);
@@ -61,16 +122,21 @@ CHEWING_API int chewing_buffer_Len( ChewingContext *ctx )
 
 CHEWING_API char *chewing_buffer_String( ChewingContext *ctx )
 {
-	int i;
-	char *s = (char *) calloc(
-		1 + ctx->output->chiSymbolBufLen,
-		sizeof(char) * MAX_UTF8_SIZE );
-	for ( i = 0; i < ctx->output->chiSymbolBufLen; i++ ) {
-		strcat( s, (char *) (ctx->output->chiSymbolBuf[ i ].s) );
-	}
+	int size = ( 1 + ctx->output->chiSymbolBufLen ) * MAX_UTF8_SIZE;
+	char *s = (char *) calloc( size, sizeof(char) );
+	if ( s )
+		CopyWchString( s, size, ctx->output->chiSymbolBuf,
+			ctx->output->chiSymbolBufLen, NULL );
 	return s;
 }
 
+CHEWING_API int chewing_buffer_String_copy( ChewingContext *ctx,
+		char *buf, int size )
+{
+	return CopyWchString( buf, size, ctx->output->chiSymbolBuf,
+		ctx->output->chiSymbolBufLen, NULL );
+}
+
 /**
  * @param ctx handle to Chewing IM context
  * @param zuin_count pointer to the integer of available Zuin preedit string
@@ -79,23 +145,23 @@ CHEWING_API char *chewing_buffer_String( ChewingContext *ctx )
  */
 CHEWING_API char *chewing_zuin_String( ChewingContext *ctx, int *zuin_count )
 {
-	char *s;
-	int i;
+	int size = ( 1 + ZUIN_SIZE ) * sizeof(ctx->output->zuinBuf[ 0 ].s);
+	char *s = (char*) calloc( size, sizeof(char) );
 	if ( zuin_count )
 		*zuin_count = 0;
-	s = (char*) calloc(
-		1 + ZUIN_SIZE,
-		sizeof(ctx->output->zuinBuf[ 0 ].s) );
-	for ( i = 0; i < ZUIN_SIZE; i++ ) {
-		if ( ctx->output->zuinBuf[ i ].s[ 0 ] != '\0' ) {
-			strcat( s, (char *) (ctx->output->zuinBuf[ i ].s) );
-			if ( zuin_count )
-				(*zuin_count)++;
-		}
-	}
+	if ( s )
+		CopyWchString( s, size, ctx->output->zuinBuf, ZUIN_SIZE,
+			zuin_count );
 	return s;
 }
 
+CHEWING_API int chewing_zuin_String_copy( ChewingContext *ctx,
+		char *buf, int size )
+{
+	return CopyWchString( buf, size, ctx->output->zuinBuf, ZUIN_SIZE,
+		NULL );
+}
+
 CHEWING_API int chewing_zuin_Check( ChewingContext *ctx )
 {
 	int ret = 0;
@@ -149,6 +215,7 @@ CHEWING_API char *chewing_cand_String( ChewingContext *ctx )
 {
 	char *s;
 	if ( chewing_cand_hasNext( ctx ) ) {
+		ChoiceRank( ctx->output->pci, ctx->cand_no );
 		s = strdup( ctx->output->pci->totalChoiceStr[ ctx->cand_no ] );
 		ctx->cand_no++;
 	} else {
@@ -157,6 +224,26 @@ CHEWING_API char *chewing_cand_String( ChewingContext *ctx )
 	return s;
 }
 
+/**
+ * Unlike chewing_cand_String(), the enumeration only moves on to the next
+ * candidate when this one fits in buf, so that the caller can retry with a
+ * larger buffer.
+ */
+CHEWING_API int chewing_cand_String_copy( ChewingContext *ctx,
+		char *buf, int size )
+{
+	int len;
+
+	if ( ! chewing_cand_hasNext( ctx ) )
+		return CopyString( buf, size, "" );
+	ChoiceRank( ctx->output->pci, ctx->cand_no );
+	len = CopyString( buf, size,
+		ctx->output->pci->totalChoiceStr[ ctx->cand_no ] );
+	if ( len < size )
+		ctx->cand_no++;
+	return len;
+}
+
 CHEWING_API void chewing_interval_Enumerate( ChewingContext *ctx )
 {
 	ctx->it_no = 0;
@@ -190,14 +277,19 @@ CHEWING_API int chewing_aux_Length( ChewingContext *ctx )
 
 CHEWING_API char *chewing_aux_String( ChewingContext *ctx )
 {
-	int i;
-	char *msg = (char *) calloc(
-		1 + ctx->output->showMsgLen,
-		sizeof(char) * MAX_UTF8_SIZE );
-	for ( i = 0; i < ctx->output->showMsgLen; ++i )
-		strcat( msg, (char *)(ctx->output->showMsg[ i ].s) );
+	int size = ( 1 + ctx->output->showMsgLen ) * MAX_UTF8_SIZE;
+	char *msg = (char *) calloc( size, sizeof(char) );
+	if ( msg )
+		CopyWchString( msg, size, ctx->output->showMsg,
+			ctx->output->showMsgLen, NULL );
 	return msg;
+}
 
+CHEWING_API int chewing_aux_String_copy( ChewingContext *ctx,
+		char *buf, int size )
+{
+	return CopyWchString( buf, size, ctx->output->showMsg,
+		ctx->output->showMsgLen, NULL );
 }
 
 CHEWING_API int chewing_keystroke_CheckIgnore( ChewingContext *ctx )
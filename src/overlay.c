@@ -0,0 +1,368 @@
+/**
+ * overlay.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file overlay.c
+ * @brief the changes DICT_OVERLAY_FILE makes to the dictionary
+ *
+ * The lines are read into changes, sorted by phone sequence, and each
+ * sequence gets the phrases of the dictionary with its changes applied,
+ * see overlay-private.h. The sequences are searched along with the phone
+ * tree, by the TreeCursor, and their phrases are read by the functions of
+ * dict.c like the ones of the dictionary.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global-private.h"
+#include "chewing-utf8-util.h"
+#include "key2pho-private.h"
+#include "dict-private.h"
+#include "tree-private.h"
+#include "overlay-private.h"
+#include "private.h"
+
+#define OVERLAY_LINE_LEN 512
+
+/** @brief a line of DICT_OVERLAY_FILE */
+typedef struct {
+	uint16_t phoneSeq[ MAX_PHRASE_LEN ];
+	int len;
+	int bRemove;
+	int order;	/* line number, the later change wins */
+	Phrase phrase;
+} OverlayChange;
+
+static int CompareSeq( const uint16_t *a, int lenA, const uint16_t *b, int lenB )
+{
+	int i;
+
+	for ( i = 0; i < lenA && i < lenB; i++ ) {
+		if ( a[ i ] != b[ i ] )
+			return a[ i ] < b[ i ] ? -1 : 1;
+	}
+	return ( lenA > lenB ) - ( lenA < lenB );
+}
+
+static int CompareChange( const void *x, const void *y )
+{
+	const OverlayChange *a = x;
+	const OverlayChange *b = y;
+	int cmp;
+
+	cmp = CompareSeq( a->phoneSeq, a->len, b->phoneSeq, b->len );
+	if ( cmp )
+		return cmp;
+	return ( a->order > b->order ) - ( a->order < b->order );
+}
+
+/* the next word from *pos on, NULL at the end of the line */
+static char *NextWord( char **pos )
+{
+	char *p = *pos + strspn( *pos, " \t\r\n" );
+
+	if ( !*p )
+		return NULL;
+	*pos = p + strcspn( p, " \t\r\n" );
+	if ( **pos )
+		*( *pos )++ = '\0';
+	return p;
+}
+
+/**
+ * @brief parse a line, as sort_dic reads the ones of tsi.src
+ *
+ * @return 1 for a change, 0 for a blank or malformed line
+ */
+static int ParseChange( char *line, OverlayChange *change )
+{
+	char *pos = line;
+	char *p, *phrase;
+	int nChar;
+
+	p = strchr( line, '#' );
+	if ( p )
+		*p = '\0';
+	p = NextWord( &pos );
+	if ( !p )
+		return 0;
+	if ( !strcmp( p, "+" ) )
+		change->bRemove = 0;
+	else if ( !strcmp( p, "-" ) )
+		change->bRemove = 1;
+	else
+		return 0;
+
+	phrase = NextWord( &pos );
+	if ( !phrase )
+		return 0;
+	change->phrase.freq = 0;
+	if ( !change->bRemove ) {
+		p = NextWord( &pos );
+		if ( !p || p[ strspn( p, "0123456789" ) ] )
+			return 0;
+		change->phrase.freq = atoi( p );
+	}
+
+	change->len = 0;
+	while ( ( p = NextWord( &pos ) ) ) {
+		if ( change->len == MAX_PHRASE_LEN )
+			return 0;
+		change->phoneSeq[ change->len ] = UintFromPhone( p );
+		if ( !change->phoneSeq[ change->len ] )
+			return 0;
+		change->len++;
+	}
+
+	/* cut to its syllables, as sort_dic stores it */
+	nChar = ueStrLen( phrase );
+	if ( change->len == 0 || nChar < change->len || nChar > MAX_PHRASE_LEN )
+		return 0;
+	snprintf( change->phrase.phrase, sizeof( change->phrase.phrase ), "%.*s",
+		ueStrNBytes( phrase, change->len ), phrase );
+	return 1;
+}
+
+/* the changes of the file, sorted, NULL and *nChange 0 if there is none */
+static OverlayChange *ReadChanges( FILE *fp, int *nChange )
+{
+	char line[ OVERLAY_LINE_LEN ];
+	OverlayChange *change = NULL;
+	OverlayChange *grown;
+	int nAlloc = 0;
+	int nLine = 0;
+
+	*nChange = 0;
+	while ( fgets( line, sizeof( line ), fp ) ) {
+		nLine++;
+		if ( *nChange == nAlloc ) {
+			nAlloc = nAlloc ? nAlloc * 2 : 64;
+			grown = realloc( change, nAlloc * sizeof( change[ 0 ] ) );
+			if ( !grown ) {
+				free( change );
+				*nChange = -1;
+				return NULL;
+			}
+			change = grown;
+		}
+		if ( !ParseChange( line, &change[ *nChange ] ) ) {
+			DEBUG_OUT( "%s:%d: not a change, skipped\n", DICT_OVERLAY_FILE, nLine );
+			continue;
+		}
+		change[ *nChange ].order = nLine;
+		( *nChange )++;
+	}
+	if ( *nChange > 0 )
+		qsort( change, *nChange, sizeof( change[ 0 ] ), CompareChange );
+	return change;
+}
+
+/* room for one more phrase in overlay */
+static int ReservePhrase( DictOverlay *overlay, int *nAlloc )
+{
+	Phrase *grown;
+
+	if ( overlay->nPhrase < *nAlloc )
+		return 0;
+	*nAlloc = *nAlloc ? *nAlloc * 2 : 64;
+	grown = realloc( overlay->phrase, *nAlloc * sizeof( overlay->phrase[ 0 ] ) );
+	if ( !grown )
+		return -1;
+	overlay->phrase = grown;
+	return 0;
+}
+
+/* apply change to the phrases from begin on, the last ones of overlay */
+static int ApplyChange( DictOverlay *overlay, int *nAlloc, int begin, const OverlayChange *change )
+{
+	int bFound = 0;
+	int i, k;
+
+	for ( i = k = begin; i < overlay->nPhrase; i++ ) {
+		if ( strcmp( overlay->phrase[ i ].phrase, change->phrase.phrase ) ) {
+			overlay->phrase[ k++ ] = overlay->phrase[ i ];
+		} else if ( !change->bRemove && !bFound ) {
+			/* the first one takes the frequency, the others go */
+			overlay->phrase[ k ] = overlay->phrase[ i ];
+			overlay->phrase[ k++ ].freq = change->phrase.freq;
+			bFound = 1;
+		}
+	}
+	overlay->nPhrase = k;
+
+	if ( change->bRemove || bFound )
+		return 0;
+	if ( ReservePhrase( overlay, nAlloc ) )
+		return -1;
+	overlay->phrase[ overlay->nPhrase++ ] = change->phrase;
+	return 0;
+}
+
+/* by decreasing frequency, as sort_dic writes them; equal ones keep their order */
+static void SortPhrases( Phrase *phrase, int n )
+{
+	Phrase key;
+	int i, j;
+
+	for ( i = 1; i < n; i++ ) {
+		key = phrase[ i ];
+		for ( j = i; j > 0 && phrase[ j - 1 ].freq < key.freq; j-- )
+			phrase[ j ] = phrase[ j - 1 ];
+		phrase[ j ] = key;
+	}
+}
+
+/* the entry of the changes to one sequence, change[ 0 ] to [ nChange - 1 ] */
+static int AddEntry( ChewingData *pgdata, DictOverlay *overlay, int *nAlloc,
+		const OverlayChange *change, int nChange )
+{
+	OverlayEntry *entry = &overlay->entry[ overlay->nEntry ];
+	Phrase phrase;
+	int pho_id;
+	int i;
+
+	memcpy( entry->phoneSeq, change->phoneSeq, sizeof( change->phoneSeq ) );
+	entry->len = change->len;
+	entry->begin = overlay->nPhrase;
+
+	/* the overlay is not in place yet, this is the dictionary alone */
+	pho_id = TreeFindPhrase( pgdata, 0, change->len - 1, change->phoneSeq );
+	if ( pho_id != -1 && GetPhraseFirst( pgdata, &phrase, pho_id ) ) {
+		do {
+			if ( ReservePhrase( overlay, nAlloc ) )
+				return -1;
+			overlay->phrase[ overlay->nPhrase++ ] = phrase;
+		} while ( GetPhraseNext( pgdata, &phrase ) );
+	}
+	for ( i = 0; i < nChange; i++ ) {
+		if ( ApplyChange( overlay, nAlloc, entry->begin, &change[ i ] ) )
+			return -1;
+	}
+	SortPhrases( &overlay->phrase[ entry->begin ], overlay->nPhrase - entry->begin );
+
+	entry->end = overlay->nPhrase;
+	overlay->nEntry++;
+	return 0;
+}
+
+void TerminateOverlay( ChewingData *pgdata )
+{
+	DictOverlay *overlay = pgdata->static_data->overlay;
+
+	if ( !overlay )
+		return;
+	free( overlay->entry );
+	free( overlay->phrase );
+	free( overlay );
+	pgdata->static_data->overlay = NULL;
+}
+
+int InitOverlay( ChewingData *pgdata, const char *prefix )
+{
+	char filename[ PATH_MAX ];
+	DictOverlay *overlay;
+	OverlayChange *change;
+	FILE *fp;
+	int nChange, nPhraseAlloc = 0;
+	int ret = -1;
+	int i, j;
+	size_t len;
+
+	len = snprintf( filename, sizeof( filename ), "%s" PLAT_SEPARATOR "%s", prefix, DICT_OVERLAY_FILE );
+	if ( len + 1 > sizeof( filename ) )
+		return -1;
+	fp = fopen( filename, "r" );
+	if ( !fp )
+		return -1;
+	change = ReadChanges( fp, &nChange );
+	fclose( fp );
+	if ( nChange <= 0 ) {
+		free( change );
+		return nChange;
+	}
+
+	overlay = ALC( DictOverlay, 1 );
+	if ( !overlay )
+		goto end;
+	/* no more sequences than changes */
+	overlay->entry = ALC( OverlayEntry, nChange );
+	if ( !overlay->entry )
+		goto end;
+
+	for ( i = 0; i < nChange; i = j ) {
+		for ( j = i + 1; j < nChange && !CompareSeq( change[ i ].phoneSeq, change[ i ].len,
+				change[ j ].phoneSeq, change[ j ].len ); j++ )
+			;
+		if ( AddEntry( pgdata, overlay, &nPhraseAlloc, &change[ i ], j - i ) )
+			goto end;
+	}
+	pgdata->static_data->overlay = overlay;
+	overlay = NULL;
+	ret = 0;
+end:
+	if ( overlay ) {
+		free( overlay->entry );
+		free( overlay->phrase );
+		free( overlay );
+	}
+	free( change );
+	return ret;
+}
+
+size_t OverlayBytes( ChewingData *pgdata )
+{
+	const DictOverlay *overlay = pgdata->static_data->overlay;
+
+	if ( !overlay )
+		return 0;
+	return sizeof( DictOverlay ) + overlay->nEntry * sizeof( OverlayEntry ) +
+		overlay->nPhrase * sizeof( Phrase );
+}
+
+void OverlayAdvance( ChewingData *pgdata, int *pLow, int *pHigh, int depth, uint16_t phone )
+{
+	const OverlayEntry *entry = pgdata->static_data->overlay->entry;
+	int low = *pLow, high = *pHigh, mid;
+
+	/* the range shares depth phones; the ones that end there come first,
+	 * the others go by their next phone */
+	while ( low < high ) {
+		mid = low + ( high - low ) / 2;
+		if ( entry[ mid ].len <= depth || entry[ mid ].phoneSeq[ depth ] < phone )
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	*pLow = low;
+	high = *pHigh;
+	while ( low < high ) {
+		mid = low + ( high - low ) / 2;
+		if ( entry[ mid ].phoneSeq[ depth ] == phone )
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	*pHigh = low;
+}
+
+const OverlayEntry *OverlayExact( ChewingData *pgdata, int low, int high, int depth )
+{
+	const OverlayEntry *entry = pgdata->static_data->overlay->entry;
+
+	if ( low < high && entry[ low ].len == depth )
+		return &entry[ low ];
+	return NULL;
+}
@@ -22,6 +22,16 @@ extern "C"
 #define FLAG_ATTRIBUTE_READ	0x00000001
 #define FLAG_ATTRIBUTE_WRITE	0x00000002
 
+/* options of plat_mmap_set_view_options(), hints the platform may ignore */
+#define FLAG_MAP_POPULATE	0x00000001	/* fault the whole view in before returning */
+#define FLAG_MAP_HUGEPAGE	0x00000002	/* back the view with huge pages */
+
+/* advice of plat_mmap_advise(), a hint as well */
+#define FLAG_ADVICE_NORMAL	0
+#define FLAG_ADVICE_RANDOM	1	/* no read-ahead */
+#define FLAG_ADVICE_SEQUENTIAL	2	/* aggressive read-ahead */
+#define FLAG_ADVICE_WILLNEED	3	/* start reading the range in now */
+
 /* Set the mmap handle to be invalid */
 void plat_mmap_set_invalid( plat_mmap *handle );
 
@@ -34,6 +44,15 @@ size_t plat_mmap_create( plat_mmap *handle, const char *file, int fileAttr );
 /* Obtain a view of the mapped file, return the page aligned offset & size */
 void *plat_mmap_set_view( plat_mmap *handle, size_t *offset, size_t *size );
 
+/* plat_mmap_set_view() with FLAG_MAP_* options */
+void *plat_mmap_set_view_options( plat_mmap *handle, size_t *offset, size_t *size, int options );
+
+/* Give FLAG_ADVICE_* for size bytes at offset of the view, return 0 on success */
+int plat_mmap_advise( plat_mmap *handle, size_t offset, size_t size, int advice );
+
+/* Return the bytes of the view in memory, (size_t) -1 if the platform cannot tell */
+size_t plat_mmap_resident( plat_mmap *handle );
+
 /* Delete the mmap handle */
 void plat_mmap_close( plat_mmap *handle );
 
@@ -18,6 +18,9 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <sys/file.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <sys/types.h>
 
@@ -29,6 +32,53 @@
 	rename(oldpath, newpath)
 #define PLAT_UNLINK(path) \
 	unlink(path)
+/* rename over an existing newpath in one step; 0 on success */
+#define PLAT_REPLACE(oldpath, newpath) \
+	rename(oldpath, newpath)
+/* advisory locks of a whole file, held by the open file; 0 on success */
+#define PLAT_LOCK_SHARED(fd) \
+	flock(fd, LOCK_SH)
+#define PLAT_LOCK_EXCLUSIVE(fd) \
+	flock(fd, LOCK_EX)
+#define PLAT_TRYLOCK_EXCLUSIVE(fd) \
+	flock(fd, LOCK_EX | LOCK_NB)
+#define PLAT_UNLOCK(fd) \
+	flock(fd, LOCK_UN)
+#define PLAT_FTRUNCATE(fd, size) \
+	ftruncate(fd, size)
+/* a lock among the threads of the process, initialized statically */
+typedef pthread_mutex_t plat_mutex;
+#define PLAT_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define PLAT_MUTEX_LOCK(m) \
+	pthread_mutex_lock(m)
+#define PLAT_MUTEX_UNLOCK(m) \
+	pthread_mutex_unlock(m)
+/* or at run time */
+#define PLAT_MUTEX_INIT(m) \
+	pthread_mutex_init(m, NULL)
+#define PLAT_MUTEX_DESTROY(m) \
+	pthread_mutex_destroy(m)
+/* threads run a function PLAT_THREAD_FUNC(name, arg) returning 0 */
+typedef pthread_t plat_thread;
+#define PLAT_THREAD_FUNC(name, arg) \
+	void *name( void *arg )
+#define PLAT_THREAD_CREATE(thread, func, arg) \
+	pthread_create(thread, NULL, func, arg)
+#define PLAT_THREAD_JOIN(thread) \
+	pthread_join(thread, NULL)
+/* sequentially consistent accesses of words other threads read unlocked */
+#define PLAT_ATOMIC_LOAD_PTR(p) \
+	__atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define PLAT_ATOMIC_STORE_PTR(p, v) \
+	__atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#define PLAT_ATOMIC_LOAD_UINT(p) \
+	__atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define PLAT_ATOMIC_STORE_UINT(p, v) \
+	__atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#define PLAT_ATOMIC_LOAD_U64(p) \
+	__atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define PLAT_ATOMIC_OR_U64(p, v) \
+	((void) __atomic_fetch_or(p, v, __ATOMIC_SEQ_CST))
 
 /* GNU Hurd doesn't define PATH_MAX */
 #ifndef PATH_MAX
@@ -48,6 +98,17 @@ typedef struct plat_mmap {
 	int fAccessAttr;
 } plat_mmap;
 
+/* a monotonic clock in nanoseconds */
+static inline unsigned long long plat_clock_nsec( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#define PLAT_CLOCK_NSEC() \
+	plat_clock_nsec()
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
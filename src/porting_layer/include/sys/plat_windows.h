@@ -16,6 +16,7 @@
 #include <windows.h>
 #include <stdio.h>
 #include <io.h>
+#include <string.h>
 
 #if _MSC_VER > 1000
 #include <direct.h>
@@ -40,6 +41,52 @@
 	MoveFile(oldpath, newpath)
 #define PLAT_UNLINK(path) \
 	_unlink(path)
+/* rename over an existing newpath in one step; 0 on success */
+#define PLAT_REPLACE(oldpath, newpath) \
+	(MoveFileEx(oldpath, newpath, MOVEFILE_REPLACE_EXISTING) ? 0 : -1)
+/* advisory locks of a whole file, held by the open file; 0 on success */
+#define PLAT_LOCK_SHARED(fd) \
+	plat_lock_file(fd, 0)
+#define PLAT_LOCK_EXCLUSIVE(fd) \
+	plat_lock_file(fd, LOCKFILE_EXCLUSIVE_LOCK)
+#define PLAT_TRYLOCK_EXCLUSIVE(fd) \
+	plat_lock_file(fd, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY)
+#define PLAT_UNLOCK(fd) \
+	plat_unlock_file(fd)
+#define PLAT_FTRUNCATE(fd, size) \
+	_chsize(fd, size)
+/* a lock among the threads of the process, initialized statically */
+typedef SRWLOCK plat_mutex;
+#define PLAT_MUTEX_INITIALIZER SRWLOCK_INIT
+#define PLAT_MUTEX_LOCK(m) \
+	AcquireSRWLockExclusive(m)
+#define PLAT_MUTEX_UNLOCK(m) \
+	ReleaseSRWLockExclusive(m)
+/* or at run time */
+#define PLAT_MUTEX_INIT(m) \
+	InitializeSRWLock(m)
+#define PLAT_MUTEX_DESTROY(m)
+/* threads run a function PLAT_THREAD_FUNC(name, arg) returning 0 */
+typedef HANDLE plat_thread;
+#define PLAT_THREAD_FUNC(name, arg) \
+	DWORD WINAPI name( LPVOID arg )
+#define PLAT_THREAD_CREATE(thread, func, arg) \
+	((*(thread) = CreateThread(NULL, 0, func, arg, 0, NULL)) ? 0 : -1)
+#define PLAT_THREAD_JOIN(thread) \
+	(WaitForSingleObject(thread, INFINITE), CloseHandle(thread))
+/* sequentially consistent accesses of words other threads read unlocked */
+#define PLAT_ATOMIC_LOAD_PTR(p) \
+	InterlockedCompareExchangePointer((PVOID volatile *)(p), NULL, NULL)
+#define PLAT_ATOMIC_STORE_PTR(p, v) \
+	((void) InterlockedExchangePointer((PVOID volatile *)(p), (PVOID)(v)))
+#define PLAT_ATOMIC_LOAD_UINT(p) \
+	((unsigned int) InterlockedCompareExchange((LONG volatile *)(p), 0, 0))
+#define PLAT_ATOMIC_STORE_UINT(p, v) \
+	((void) InterlockedExchange((LONG volatile *)(p), (LONG)(v)))
+#define PLAT_ATOMIC_LOAD_U64(p) \
+	((unsigned __int64) InterlockedCompareExchange64((LONG64 volatile *)(p), 0, 0))
+#define PLAT_ATOMIC_OR_U64(p, v) \
+	((void) InterlockedOr64((LONG64 volatile *)(p), (LONG64)(v)))
 
 #ifdef __cplusplus
 extern "C"
@@ -51,9 +98,42 @@ typedef struct plat_mmap
 {
 	HANDLE fd_file, fd_map;
 	void *address;
+	size_t sizet;
 	int fAccessAttr;
 } plat_mmap;
 
+static __inline int plat_lock_file( int fd, DWORD flags )
+{
+	OVERLAPPED overlapped;
+
+	memset( &overlapped, 0, sizeof( overlapped ) );
+	return LockFileEx( (HANDLE) _get_osfhandle( fd ), flags, 0,
+		MAXDWORD, MAXDWORD, &overlapped ) ? 0 : -1;
+}
+
+static __inline int plat_unlock_file( int fd )
+{
+	OVERLAPPED overlapped;
+
+	memset( &overlapped, 0, sizeof( overlapped ) );
+	return UnlockFileEx( (HANDLE) _get_osfhandle( fd ), 0,
+		MAXDWORD, MAXDWORD, &overlapped ) ? 0 : -1;
+}
+
+/* a monotonic clock in nanoseconds */
+static __inline unsigned long long plat_clock_nsec( void )
+{
+	LARGE_INTEGER count, freq;
+
+	QueryPerformanceCounter( &count );
+	QueryPerformanceFrequency( &freq );
+	return (unsigned long long) ( count.QuadPart / freq.QuadPart ) * 1000000000ULL +
+		(unsigned long long) ( count.QuadPart % freq.QuadPart ) * 1000000000ULL /
+		freq.QuadPart;
+}
+#define PLAT_CLOCK_NSEC() \
+	plat_clock_nsec()
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
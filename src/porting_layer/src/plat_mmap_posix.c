@@ -17,6 +17,7 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include "plat_mmap.h"
@@ -71,9 +72,15 @@ size_t plat_mmap_create( plat_mmap *handle, const char *file, int fileAccessAttr
 
 /* obtain a view of the mapped file, return the adjusted offset & size */
 void *plat_mmap_set_view( plat_mmap *handle, size_t *offset, size_t *sizet )
+{
+	return plat_mmap_set_view_options( handle, offset, sizet, 0 );
+}
+
+void *plat_mmap_set_view_options( plat_mmap *handle, size_t *offset, size_t *sizet, int options )
 {
 	size_t pagesize = getpagesize();
 	size_t edge;
+	int flags = MAP_SHARED;
 
 	/* check error(s) */
 	if ( ! handle )
@@ -85,17 +92,97 @@ void *plat_mmap_set_view( plat_mmap *handle, size_t *offset, size_t *sizet )
 	edge = (*sizet) + (*offset);
 	(*offset) = ((size_t)((*offset) / pagesize)) * pagesize;
 	handle->sizet = (*sizet) = edge - (*offset);
+#ifdef MAP_POPULATE
+	if ( options & FLAG_MAP_POPULATE )
+		flags |= MAP_POPULATE;
+#endif
 	handle->address = mmap(
 			0,
 			*sizet,
 			PROT_READ,
-			MAP_SHARED,
+			flags,
 			handle->fd,
 			*offset );
+	if ( handle->address == MAP_FAILED ) {
+		handle->address = NULL;
+		return NULL;
+	}
+
+	/* huge pages of a file need the file system to support them */
+#ifdef MADV_HUGEPAGE
+	if ( options & FLAG_MAP_HUGEPAGE )
+		madvise( handle->address, handle->sizet, MADV_HUGEPAGE );
+#endif
+#ifndef MAP_POPULATE
+	if ( options & FLAG_MAP_POPULATE )
+		plat_mmap_advise( handle, 0, handle->sizet, FLAG_ADVICE_WILLNEED );
+#endif
 
 	return handle->address;
 }
 
+int plat_mmap_advise( plat_mmap *handle, size_t offset, size_t sizet, int advice )
+{
+	size_t pagesize = getpagesize();
+	size_t edge;
+	int native;
+
+	/* check error(s) */
+	if ( ! handle || ! handle->address || offset > handle->sizet )
+		return -1;
+
+	switch ( advice ) {
+		case FLAG_ADVICE_RANDOM:
+			native = POSIX_MADV_RANDOM;
+			break;
+		case FLAG_ADVICE_SEQUENTIAL:
+			native = POSIX_MADV_SEQUENTIAL;
+			break;
+		case FLAG_ADVICE_WILLNEED:
+			native = POSIX_MADV_WILLNEED;
+			break;
+		default:
+			native = POSIX_MADV_NORMAL;
+			break;
+	}
+
+	/* the advice applies to whole pages */
+	edge = offset + sizet;
+	if ( edge > handle->sizet )
+		edge = handle->sizet;
+	offset = ( offset / pagesize ) * pagesize;
+	return posix_madvise( (char *) handle->address + offset, edge - offset, native ) ? -1 : 0;
+}
+
+size_t plat_mmap_resident( plat_mmap *handle )
+{
+#ifdef HAVE_MINCORE
+	size_t pagesize = getpagesize();
+	size_t nPage, nResident = 0, i;
+	unsigned char *vec;
+
+	/* check error(s) */
+	if ( ! handle || ! handle->address )
+		return 0;
+
+	nPage = ( handle->sizet + pagesize - 1 ) / pagesize;
+	vec = malloc( nPage );
+	if ( ! vec )
+		return (size_t) -1;
+	/* vec is char * on some systems, unsigned char * on others */
+	if ( mincore( handle->address, handle->sizet, (void *) vec ) ) {
+		free( vec );
+		return (size_t) -1;
+	}
+	for ( i = 0; i < nPage; i++ )
+		nResident += vec[ i ] & 1;
+	free( vec );
+	return nResident * pagesize < handle->sizet ? nResident * pagesize : handle->sizet;
+#else
+	return (size_t) -1;
+#endif
+}
+
 /* close the mmap */
 void plat_mmap_close( plat_mmap *handle )
 {
@@ -152,6 +152,11 @@ size_t plat_mmap_create( plat_mmap *handle, const char *file, int fileAccessAttr
 
 /* obtain the a view of the mapped file */
 void *plat_mmap_set_view( plat_mmap *handle, size_t *offset, size_t *sizet )
+{
+	return plat_mmap_set_view_options( handle, offset, sizet, 0 );
+}
+
+void *plat_mmap_set_view_options( plat_mmap *handle, size_t *offset, size_t *sizet, int options )
 {
 	LARGE_INTEGER t_offset;
 	LARGE_INTEGER t_sizet;
@@ -191,10 +196,46 @@ void *plat_mmap_set_view( plat_mmap *handle, size_t *offset, size_t *sizet )
 				t_offset.LowPart,
 				t_sizet.LowPart );
 	}
+	handle->sizet = *sizet;
+
+	/* large pages cannot back a view of a file */
+	if ( handle->address && ( options & FLAG_MAP_POPULATE ) )
+		plat_mmap_advise( handle, 0, handle->sizet, FLAG_ADVICE_WILLNEED );
 
 	return handle->address;
 }
 
+int plat_mmap_advise( plat_mmap *handle, size_t offset, size_t sizet, int advice )
+{
+	volatile const char *p;
+	size_t pagesize;
+	size_t edge;
+
+	/* check error(s) */
+	if ( ! handle || ! handle->address || offset > handle->sizet )
+		return -1;
+
+	/* read-ahead follows FILE_FLAG_RANDOM_ACCESS given at creation, only
+	 * WILLNEED has something to do: touch every page of the range */
+	if ( advice != FLAG_ADVICE_WILLNEED )
+		return 0;
+
+	pagesize = plat_mmap_get_page_size();
+	edge = offset + sizet;
+	if ( edge > handle->sizet )
+		edge = handle->sizet;
+	for ( p = (const char *) handle->address + offset;
+			p < (const char *) handle->address + edge; p += pagesize )
+		(void) *p;
+	return 0;
+}
+
+/* the working set of the view would take QueryWorkingSetEx() of psapi */
+size_t plat_mmap_resident( plat_mmap *handle )
+{
+	return (size_t) -1;
+}
+
 /* close the mmap */
 void plat_mmap_close( plat_mmap *handle )
 {
@@ -0,0 +1,389 @@
+/**
+ * snapshot.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file snapshot.c
+ * @brief Snapshot of the input state, see chewing_snapshot()
+ *
+ * The snapshot is the part of ChewingData a key stroke builds up, the
+ * rest (the sentence, the prefer intervals, the breakpoints of symbols)
+ * is phrased again from it. Little-endian, one byte for a count or
+ * position, since none goes above MAX_PHONE_SEQ_LEN:
+ *
+ *	char magic[ 4 ];	SNAPSHOT_MAGIC
+ *	uint8 version;		SNAPSHOT_VERSION
+ *	uint8 kbtype, bChiSym, bFullShape;
+ *	uint8 pho_inx[ ZUIN_SIZE ];
+ *	uint16 phone;
+ *	uint8 pinyin type, pinyin length; char keySeq[ length ];
+ *	uint8 chiSymbolBufLen;
+ *	{ uint8 length; char symbol[ length ]; } [ chiSymbolBufLen ], 0 for Chinese
+ *	char symbolKeyBuf[ chiSymbolBufLen ];
+ *	uint8 chiSymbolCursor; int8 PointStart, PointEnd;
+ *	uint8 nPhoneSeq; uint16 phoneSeq[ nPhoneSeq ];
+ *	bits bUserArrBrkpt[ nPhoneSeq + 1 ], bUserArrCnnct[ nPhoneSeq + 1 ];
+ *	uint8 nSelect;
+ *	{ uint8 from, to, length; char selectStr[ length ]; } [ nSelect ]
+ */
+
+#include <string.h>
+
+#include "chewing-utf8-util.h"
+#include "global.h"
+#include "chewing-private.h"
+#include "chewingutil.h"
+#include "zuin-private.h"
+#include "container-private.h"
+#include "chewingio.h"
+#include "private.h"
+
+#define SNAPSHOT_MAGIC		"CHWS"
+#define SNAPSHOT_MAGIC_LEN	4
+#define SNAPSHOT_VERSION	1
+/* bytes of a bit for each of MAX_PHONE_SEQ_LEN + 1 positions */
+#define BITS_SIZE( n )		( ( ( n ) + 8 ) / 8 )
+
+extern const char *zhuin_tab[];
+
+/* the input state, read in full before any of it is restored */
+typedef struct {
+	ZuinData zuinData;
+	int bChiSym, bFullShape;
+	wch_t chiSymbolBuf[ MAX_PHONE_SEQ_LEN ];
+	int chiSymbolBufLen;
+	char symbolKeyBuf[ MAX_PHONE_SEQ_LEN ];
+	int chiSymbolCursor, PointStart, PointEnd;
+	uint16_t phoneSeq[ MAX_PHONE_SEQ_LEN ];
+	int nPhoneSeq;
+	int bUserArrBrkpt[ MAX_PHONE_SEQ_LEN + 1 ];
+	int bUserArrCnnct[ MAX_PHONE_SEQ_LEN + 1 ];
+	char selectStr[ MAX_PHONE_SEQ_LEN ][ MAX_SELECT_STR_SIZE ];
+	IntervalType selectInterval[ MAX_PHONE_SEQ_LEN ];
+	int nSelect;
+} Snapshot;
+
+/* writes as much as fits, and counts the bytes of all of it */
+typedef struct {
+	unsigned char *buf;
+	int size;
+	int len;
+} SnapshotWriter;
+
+typedef struct {
+	const unsigned char *buf;
+	int size;
+	int pos;
+	int error;
+} SnapshotReader;
+
+static void PutBytes( SnapshotWriter *w, const void *data, int n )
+{
+	if ( w->len + n <= w->size )
+		memcpy( w->buf + w->len, data, n );
+	w->len += n;
+}
+
+static void PutByte( SnapshotWriter *w, int value )
+{
+	unsigned char byte = value;
+
+	PutBytes( w, &byte, 1 );
+}
+
+static void PutPhone( SnapshotWriter *w, uint16_t phone )
+{
+	unsigned char le[ 2 ];
+
+	PutUint16LE( le, phone );
+	PutBytes( w, le, 2 );
+}
+
+static void PutString( SnapshotWriter *w, const char *str )
+{
+	int n = strlen( str );
+
+	PutByte( w, n );
+	PutBytes( w, str, n );
+}
+
+static void PutBits( SnapshotWriter *w, const int *flag, int n )
+{
+	unsigned char bits[ BITS_SIZE( MAX_PHONE_SEQ_LEN ) ];
+	int i;
+
+	memset( bits, 0, sizeof( bits ) );
+	for ( i = 0; i <= n; i++ ) {
+		if ( flag[ i ] )
+			bits[ i / 8 ] |= 1 << ( i % 8 );
+	}
+	PutBytes( w, bits, BITS_SIZE( n ) );
+}
+
+static const unsigned char *GetBytes( SnapshotReader *r, int n )
+{
+	const unsigned char *p = r->buf + r->pos;
+
+	if ( r->error || n > r->size - r->pos ) {
+		r->error = 1;
+		return NULL;
+	}
+	r->pos += n;
+	return p;
+}
+
+static int GetByte( SnapshotReader *r )
+{
+	const unsigned char *p = GetBytes( r, 1 );
+
+	return p ? *p : 0;
+}
+
+/* a count or position up to max, or sets error and gives 0, safe to loop on */
+static int GetCount( SnapshotReader *r, int max )
+{
+	int value = GetByte( r );
+
+	if ( value > max ) {
+		r->error = 1;
+		return 0;
+	}
+	return value;
+}
+
+/* a NUL-terminated string of at most size - 1 bytes, none of them NUL */
+static void GetString( SnapshotReader *r, char *str, int size )
+{
+	int n = GetCount( r, size - 1 );
+	const unsigned char *p = GetBytes( r, n );
+
+	if ( ! p || memchr( p, '\0', n ) ) {
+		r->error = 1;
+		n = 0;
+	} else {
+		memcpy( str, p, n );
+	}
+	str[ n ] = '\0';
+}
+
+static void GetBits( SnapshotReader *r, int *flag, int n )
+{
+	const unsigned char *bits = GetBytes( r, BITS_SIZE( n ) );
+	int i;
+
+	for ( i = 0; i <= n; i++ )
+		flag[ i ] = bits ? ( bits[ i / 8 ] >> ( i % 8 ) ) & 1 : 0;
+}
+
+static void WriteSnapshot( SnapshotWriter *w, ChewingData *pgdata )
+{
+	int i;
+	int cursor;
+
+	/* a choice open moves the cursor, the one typed at is kept */
+	cursor = pgdata->bSelect ?
+		pgdata->choiceInfo.oldChiSymbolCursor : pgdata->chiSymbolCursor;
+
+	PutBytes( w, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN );
+	PutByte( w, SNAPSHOT_VERSION );
+	PutByte( w, pgdata->zuinData.kbtype );
+	PutByte( w, pgdata->bChiSym );
+	PutByte( w, pgdata->bFullShape );
+	for ( i = 0; i < ZUIN_SIZE; i++ )
+		PutByte( w, pgdata->zuinData.pho_inx[ i ] );
+	PutPhone( w, pgdata->zuinData.phone );
+	PutByte( w, pgdata->zuinData.pinYinData.type );
+	PutString( w, pgdata->zuinData.pinYinData.keySeq );
+
+	PutByte( w, pgdata->chiSymbolBufLen );
+	for ( i = 0; i < pgdata->chiSymbolBufLen; i++ ) {
+		if ( ChewingIsChiAt( i, pgdata ) )
+			PutByte( w, 0 );
+		else
+			PutString( w, (const char *) pgdata->chiSymbolBuf[ i ].s );
+	}
+	PutBytes( w, pgdata->symbolKeyBuf, pgdata->chiSymbolBufLen );
+	PutByte( w, cursor );
+	PutByte( w, pgdata->PointStart );
+	PutByte( w, pgdata->PointEnd );
+
+	PutByte( w, pgdata->nPhoneSeq );
+	for ( i = 0; i < pgdata->nPhoneSeq; i++ )
+		PutPhone( w, pgdata->phoneSeq[ i ] );
+	PutBits( w, pgdata->bUserArrBrkpt, pgdata->nPhoneSeq );
+	PutBits( w, pgdata->bUserArrCnnct, pgdata->nPhoneSeq );
+
+	PutByte( w, pgdata->nSelect );
+	for ( i = 0; i < pgdata->nSelect; i++ ) {
+		PutByte( w, pgdata->selectInterval[ i ].from );
+		PutByte( w, pgdata->selectInterval[ i ].to );
+		PutString( w, pgdata->selectStr[ i ] );
+	}
+}
+
+/* 0 if the whole of r is a snapshot this version can restore */
+static int ReadSnapshot( SnapshotReader *r, Snapshot *snap )
+{
+	const unsigned char *p;
+	int i, nChi;
+	uint64_t covered = 0, span;
+
+	p = GetBytes( r, SNAPSHOT_MAGIC_LEN + 1 );
+	if ( ! p || memcmp( p, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN ) ||
+			p[ SNAPSHOT_MAGIC_LEN ] != SNAPSHOT_VERSION )
+		return -1;
+
+	snap->zuinData.kbtype = GetCount( r, KB_TYPE_NUM - 1 );
+	snap->bChiSym = GetCount( r, 1 );
+	snap->bFullShape = GetCount( r, 1 );
+	/* zhuin_tab[ i ] has two spaces in front of the symbols, from index 1 */
+	for ( i = 0; i < ZUIN_SIZE; i++ )
+		snap->zuinData.pho_inx[ i ] = GetCount( r, ueStrLen( zhuin_tab[ i ] ) - 2 );
+	p = GetBytes( r, 2 );
+	snap->zuinData.phone = p ? GetUint16LE( p ) : 0;
+	/* no other type of pinyin in this version */
+	snap->zuinData.pinYinData.type = GetCount( r, 0 );
+	GetString( r, snap->zuinData.pinYinData.keySeq, PINYIN_SIZE );
+
+	snap->chiSymbolBufLen = GetCount( r, MAX_PHONE_SEQ_LEN );
+	nChi = 0;
+	for ( i = 0; i < snap->chiSymbolBufLen; i++ ) {
+		GetString( r, (char *) snap->chiSymbolBuf[ i ].s, MAX_UTF8_SIZE + 1 );
+		if ( snap->chiSymbolBuf[ i ].s[ 0 ] == '\0' ) {
+			snap->chiSymbolBuf[ i ].wch = 0;
+			nChi++;
+		}
+	}
+	p = GetBytes( r, snap->chiSymbolBufLen );
+	if ( p )
+		memcpy( snap->symbolKeyBuf, p, snap->chiSymbolBufLen );
+	snap->chiSymbolCursor = GetCount( r, snap->chiSymbolBufLen );
+	snap->PointStart = (signed char) GetByte( r );
+	snap->PointEnd = (signed char) GetByte( r );
+	if ( snap->PointStart < -1 || snap->PointStart > snap->chiSymbolBufLen ||
+			snap->PointEnd < -MAX_PHONE_SEQ_LEN || snap->PointEnd > MAX_PHONE_SEQ_LEN )
+		return -1;
+
+	/* a phone for each Chinese character of the buffer */
+	snap->nPhoneSeq = GetCount( r, MAX_PHONE_SEQ_LEN );
+	if ( snap->nPhoneSeq != nChi )
+		return -1;
+	for ( i = 0; i < snap->nPhoneSeq; i++ ) {
+		p = GetBytes( r, 2 );
+		snap->phoneSeq[ i ] = p ? GetUint16LE( p ) : 0;
+		if ( snap->phoneSeq[ i ] == 0 )
+			return -1;
+	}
+	GetBits( r, snap->bUserArrBrkpt, snap->nPhoneSeq );
+	GetBits( r, snap->bUserArrCnnct, snap->nPhoneSeq );
+
+	/* selections of a character a phone, which do not overlap */
+	snap->nSelect = GetCount( r, snap->nPhoneSeq );
+	for ( i = 0; i < snap->nSelect; i++ ) {
+		snap->selectInterval[ i ].from = GetCount( r, snap->nPhoneSeq );
+		snap->selectInterval[ i ].to = GetCount( r, snap->nPhoneSeq );
+		GetString( r, snap->selectStr[ i ], MAX_SELECT_STR_SIZE );
+		if ( r->error )
+			return -1;
+		if ( snap->selectInterval[ i ].from >= snap->selectInterval[ i ].to ||
+				ueStrLen( snap->selectStr[ i ] ) !=
+				snap->selectInterval[ i ].to - snap->selectInterval[ i ].from )
+			return -1;
+		span = ( ( (uint64_t) 1 << snap->selectInterval[ i ].to ) - 1 ) &
+			~( ( (uint64_t) 1 << snap->selectInterval[ i ].from ) - 1 );
+		if ( covered & span )
+			return -1;
+		covered |= span;
+	}
+
+	if ( r->error || r->pos != r->size )
+		return -1;
+	return 0;
+}
+
+/* whether a syllable is being typed in pzd */
+static int ZuinTyped( const ZuinData *pzd )
+{
+	int i;
+
+	for ( i = 0; i < ZUIN_SIZE; i++ ) {
+		if ( pzd->pho_inx[ i ] )
+			return 1;
+	}
+	return pzd->pinYinData.keySeq[ 0 ] != '\0';
+}
+
+CHEWING_API int chewing_snapshot( ChewingContext *ctx, void *buf, int size )
+{
+	SnapshotWriter w;
+
+	if ( ! ctx || size < 0 || ( size > 0 && ! buf ) )
+		return -1;
+	w.buf = buf;
+	w.size = size;
+	w.len = 0;
+	WriteSnapshot( &w, ctx->data );
+	return w.len;
+}
+
+CHEWING_API int chewing_restore( ChewingContext *ctx, const void *buf, int size )
+{
+	ChewingData *pgdata;
+	SnapshotReader r;
+	Snapshot snap;
+	int i, len;
+
+	if ( ! ctx || ! buf || size < 0 )
+		return -1;
+	memset( &snap, 0, sizeof( snap ) );
+	r.buf = buf;
+	r.size = size;
+	r.pos = 0;
+	r.error = 0;
+	if ( ReadSnapshot( &r, &snap ) )
+		return -1;
+
+	/* the layout is a setting of ctx, a syllable typed on another one is lost */
+	pgdata = ctx->data;
+	if ( ZuinTyped( &snap.zuinData ) && ( snap.zuinData.kbtype != pgdata->zuinData.kbtype ||
+			snap.zuinData.pinYinData.type != pgdata->zuinData.pinYinData.type ) )
+		return -1;
+	snap.zuinData.kbtype = pgdata->zuinData.kbtype;
+	snap.zuinData.pinYinData.type = pgdata->zuinData.pinYinData.type;
+
+	chewing_Reset( ctx );
+	len = snap.chiSymbolBufLen;
+
+	pgdata->zuinData = snap.zuinData;
+	pgdata->bChiSym = snap.bChiSym;
+	pgdata->bFullShape = snap.bFullShape;
+	memcpy( pgdata->chiSymbolBuf, snap.chiSymbolBuf, sizeof( wch_t ) * len );
+	memcpy( pgdata->symbolKeyBuf, snap.symbolKeyBuf, len );
+	pgdata->chiSymbolBufLen = len;
+	pgdata->chiSymbolBufUsed = len;
+	pgdata->chiSymbolCursor = snap.chiSymbolCursor;
+	pgdata->PointStart = snap.PointStart;
+	pgdata->PointEnd = snap.PointEnd;
+
+	memcpy( pgdata->phoneSeq, snap.phoneSeq, sizeof( uint16_t ) * snap.nPhoneSeq );
+	pgdata->nPhoneSeq = snap.nPhoneSeq;
+	memcpy( pgdata->bUserArrBrkpt, snap.bUserArrBrkpt, sizeof( int ) * ( snap.nPhoneSeq + 1 ) );
+	memcpy( pgdata->bUserArrCnnct, snap.bUserArrCnnct, sizeof( int ) * ( snap.nPhoneSeq + 1 ) );
+	for ( i = 0; i < snap.nSelect; i++ ) {
+		strcpy( pgdata->selectStr[ i ], snap.selectStr[ i ] );
+		pgdata->selectInterval[ i ] = snap.selectInterval[ i ];
+	}
+	pgdata->nSelect = snap.nSelect;
+
+	/* one phrasing for the whole buffer, instead of one a key */
+	CallPhrasing( pgdata );
+	MakeOutputWithRtn( ctx->output, pgdata, KEYSTROKE_ABSORB );
+	ctx->output->nCommitStr = 0;
+	return 0;
+}
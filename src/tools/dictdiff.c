@@ -0,0 +1,226 @@
+/**
+ * dictdiff.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file dictdiff.c
+ *
+ * @brief Dictionary overlay generator.\n
+ *
+ *	  This program compares two versions of tsi.src and writes the
+ *	  phrases that differ as DICT_OVERLAY_FILE, see overlay-private.h:
+ *	  "+" lines for the ones added or with another frequency, "-" lines
+ *	  for the ones removed. The library applies the file over the
+ *	  dictionary it has, so a change of tsi.src can be shipped without
+ *	  running sort_word, sort_dic and packdata again.
+ *
+ *	  A phrase is its characters and its syllables, read as sort_dic
+ *	  reads them; of the same phrase listed twice, the most frequent
+ *	  one counts.
+ *
+ * usage: dictdiff <old tsi.src> <new tsi.src> > DICT_OVERLAY_FILE
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global-private.h"
+#include "chewing-utf8-util.h"
+#include "config.h"
+
+#define MAXLEN		512
+#define MAXZUIN		9
+
+typedef struct {
+	char *phrase;
+	char *zuin;	/* the syllables, one space between them */
+	int freq;
+} Entry;
+
+typedef struct {
+	Entry *entry;
+	long nEntry;
+	long nAlloc;
+} Dict;
+
+static void *Alloc( void *buf, size_t size )
+{
+	buf = realloc( buf, size ? size : 1 );
+	if ( !buf ) {
+		fprintf( stderr, "Out of memory!\n" );
+		exit( 1 );
+	}
+	return buf;
+}
+
+static char *Duplicate( const char *str, size_t len )
+{
+	char *copy = Alloc( NULL, len + 1 );
+
+	memcpy( copy, str, len );
+	copy[ len ] = '\0';
+	return copy;
+}
+
+/* the entry of a line of tsi.src, 0 if the line has none */
+static int ParseLine( char *line, Entry *entry )
+{
+	const char *delim = " \t\r\n";
+	char zuin[ MAXLEN ];
+	char *phrase, *freq, *p;
+	size_t len = 0;
+	int nZuin = 0;
+
+	p = strchr( line, '#' );
+	if ( p )
+		*p = '\0';
+	phrase = strtok( line, delim );
+	freq = strtok( NULL, delim );
+	if ( !phrase || !freq )
+		return 0;
+	while ( ( p = strtok( NULL, delim ) ) && nZuin < MAXZUIN ) {
+		len += snprintf( zuin + len, sizeof( zuin ) - len, "%s%s", nZuin ? " " : "", p );
+		if ( len >= sizeof( zuin ) )
+			return 0;
+		nZuin++;
+	}
+	if ( nZuin == 0 )
+		return 0;
+
+	/* cut to its syllables, as sort_dic stores it */
+	entry->phrase = Duplicate( phrase, ueStrLen( phrase ) > nZuin ?
+		(size_t) ueStrNBytes( phrase, nZuin ) : strlen( phrase ) );
+	entry->zuin = Duplicate( zuin, len );
+	entry->freq = atoi( freq );
+	return 1;
+}
+
+static int CompareEntry( const void *x, const void *y )
+{
+	const Entry *a = x;
+	const Entry *b = y;
+	int cmp;
+
+	cmp = strcmp( a->zuin, b->zuin );
+	if ( cmp )
+		return cmp;
+	cmp = strcmp( a->phrase, b->phrase );
+	if ( cmp )
+		return cmp;
+	return ( a->freq < b->freq ) - ( a->freq > b->freq );
+}
+
+/* the entries of filename, sorted, each phrase once */
+static int ReadDict( const char *filename, Dict *dict )
+{
+	char line[ MAXLEN ];
+	FILE *fp;
+	long i, k;
+
+	fp = fopen( filename, "r" );
+	if ( !fp ) {
+		fprintf( stderr, "Cannot open %s\n", filename );
+		return -1;
+	}
+	while ( fgets( line, sizeof( line ), fp ) ) {
+		if ( dict->nEntry == dict->nAlloc ) {
+			dict->nAlloc = dict->nAlloc ? dict->nAlloc * 2 : 4096;
+			dict->entry = Alloc( dict->entry, dict->nAlloc * sizeof( Entry ) );
+		}
+		if ( ParseLine( line, &dict->entry[ dict->nEntry ] ) )
+			dict->nEntry++;
+	}
+	fclose( fp );
+
+	qsort( dict->entry, dict->nEntry, sizeof( Entry ), CompareEntry );
+	for ( i = k = 0; i < dict->nEntry; i++ ) {
+		if ( k > 0 && !strcmp( dict->entry[ k - 1 ].zuin, dict->entry[ i ].zuin ) &&
+				!strcmp( dict->entry[ k - 1 ].phrase, dict->entry[ i ].phrase ) ) {
+			free( dict->entry[ i ].phrase );
+			free( dict->entry[ i ].zuin );
+			continue;
+		}
+		dict->entry[ k++ ] = dict->entry[ i ];
+	}
+	dict->nEntry = k;
+	return 0;
+}
+
+static void FreeDict( Dict *dict )
+{
+	long i;
+
+	for ( i = 0; i < dict->nEntry; i++ ) {
+		free( dict->entry[ i ].phrase );
+		free( dict->entry[ i ].zuin );
+	}
+	free( dict->entry );
+}
+
+/* the lines that turn old into new, by syllables then phrase */
+static long WriteDiff( FILE *fp, const Dict *old, const Dict *new )
+{
+	long i = 0, j = 0;
+	long nLine = 0;
+	int cmp;
+
+	while ( i < old->nEntry || j < new->nEntry ) {
+		if ( i == old->nEntry )
+			cmp = 1;
+		else if ( j == new->nEntry )
+			cmp = -1;
+		else if ( !( cmp = strcmp( old->entry[ i ].zuin, new->entry[ j ].zuin ) ) )
+			cmp = strcmp( old->entry[ i ].phrase, new->entry[ j ].phrase );
+
+		if ( cmp < 0 ) {
+			fprintf( fp, "- %s %s\n", old->entry[ i ].phrase, old->entry[ i ].zuin );
+			i++;
+			nLine++;
+		} else if ( cmp > 0 || old->entry[ i ].freq != new->entry[ j ].freq ) {
+			fprintf( fp, "+ %s %d %s\n", new->entry[ j ].phrase,
+				new->entry[ j ].freq, new->entry[ j ].zuin );
+			if ( cmp == 0 )
+				i++;
+			j++;
+			nLine++;
+		} else {
+			i++;
+			j++;
+		}
+	}
+	return nLine;
+}
+
+int main( int argc, char *argv[] )
+{
+	Dict old = { NULL, 0, 0 };
+	Dict new = { NULL, 0, 0 };
+	long nLine;
+	int ret = 1;
+
+	if ( argc != 3 ) {
+		fprintf( stderr, "usage: %s <old tsi.src> <new tsi.src> > %s\n",
+			argv[ 0 ], DICT_OVERLAY_FILE );
+		return 1;
+	}
+	if ( !ReadDict( argv[ 1 ], &old ) && !ReadDict( argv[ 2 ], &new ) ) {
+		printf( "# %s from %s to %s\n", DICT_OVERLAY_FILE, argv[ 1 ], argv[ 2 ] );
+		nLine = WriteDiff( stdout, &old, &new );
+		if ( fflush( stdout ) || ferror( stdout ) )
+			fprintf( stderr, "Cannot write %s\n", DICT_OVERLAY_FILE );
+		else {
+			fprintf( stderr, "%ld phrases changed\n", nLine );
+			ret = 0;
+		}
+	}
+	FreeDict( &old );
+	FreeDict( &new );
+	return ret;
+}
@@ -0,0 +1,127 @@
+/**
+ * embeddata.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file embeddata.c
+ *
+ * @brief Static data compiler.\n
+ *
+ *	  This program writes STATIC_DATA_FILE, as packdata made it, as a C
+ *	  source defining embedded_data and embedded_data_size, for
+ *	  --enable-embedded-data to link into the library. The container is
+ *	  checked first, so that a broken one fails the build rather than
+ *	  every chewing_new().
+ *
+ * usage: embeddata <STATIC_DATA_FILE> <output.c>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "global-private.h"
+#include "container-private.h"
+#include "config.h"
+
+#define BYTES_PER_LINE 16
+
+/* read a whole file into a new buffer, NULL on failure */
+static unsigned char *ReadFile( const char *filename, size_t *size )
+{
+	FILE *fp;
+	unsigned char *buf;
+	long len;
+
+	fp = fopen( filename, "rb" );
+	if ( !fp )
+		return NULL;
+	if ( fseek( fp, 0, SEEK_END ) || ( len = ftell( fp ) ) < 0 ||
+			fseek( fp, 0, SEEK_SET ) ) {
+		fclose( fp );
+		return NULL;
+	}
+	buf = malloc( len ? len : 1 );
+	if ( buf && fread( buf, 1, len, fp ) != (size_t) len ) {
+		free( buf );
+		buf = NULL;
+	}
+	fclose( fp );
+	*size = len;
+	return buf;
+}
+
+static int WriteSource( FILE *fp, const char *filename, const unsigned char *data, size_t size )
+{
+	size_t i;
+
+	fprintf( fp,
+		"/* %s compiled by embeddata, do not edit */\n"
+		"\n"
+		"#include <stddef.h>\n"
+		"\n"
+		"/* the sections are read in place, align as a mapping would be */\n"
+		"#if defined( __GNUC__ )\n"
+		"__attribute__ (( aligned ( 64 ) ))\n"
+		"#elif defined( _MSC_VER )\n"
+		"__declspec( align( 64 ) )\n"
+		"#endif\n"
+		"const unsigned char embedded_data[] = {\n",
+		filename );
+	for ( i = 0; i < size; i++ ) {
+		fprintf( fp, "%s0x%02x,", i % BYTES_PER_LINE ? "" : "\t", data[ i ] );
+		if ( i % BYTES_PER_LINE == BYTES_PER_LINE - 1 || i == size - 1 )
+			fputc( '\n', fp );
+	}
+	fprintf( fp,
+		"};\n"
+		"\n"
+		"const size_t embedded_data_size = %lu;\n",
+		(unsigned long) size );
+	return ferror( fp ) ? -1 : 0;
+}
+
+int main( int argc, char *argv[] )
+{
+	unsigned char *data;
+	size_t size;
+	FILE *fp;
+	int ret;
+
+	if ( argc != 3 ) {
+		fprintf( stderr, "usage: %s <%s> <output.c>\n", argv[ 0 ], STATIC_DATA_FILE );
+		return 1;
+	}
+
+	data = ReadFile( argv[ 1 ], &size );
+	if ( !data ) {
+		fprintf( stderr, "Cannot read %s\n", argv[ 1 ] );
+		return 1;
+	}
+	if ( ContainerVerify( data, size ) ) {
+		fprintf( stderr, "%s is not a valid container\n", argv[ 1 ] );
+		free( data );
+		return 1;
+	}
+
+	fp = fopen( argv[ 2 ], "w" );
+	if ( !fp ) {
+		fprintf( stderr, "Cannot open %s\n", argv[ 2 ] );
+		free( data );
+		return 1;
+	}
+	ret = WriteSource( fp, STATIC_DATA_FILE, data, size );
+	if ( fclose( fp ) || ret ) {
+		fprintf( stderr, "Cannot write %s\n", argv[ 2 ] );
+		remove( argv[ 2 ] );
+		free( data );
+		return 1;
+	}
+	free( data );
+	return 0;
+}
@@ -0,0 +1,267 @@
+/**
+ * maketables.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file maketables.c
+ *
+ * @brief Symbol and pinyin table compiler.\n
+ *
+ *	  This program reads \b symbols.dat, \b swkb.dat and \b pinyin.tab of
+ *	  a data directory and writes \b symbol_table.dat, \b easy_symbol.dat
+ *	  and \b pinyin_table.dat, which packdata puts into STATIC_DATA_FILE.
+ *	  The formats are described in chewingutil.h and
+ *	  hanyupinyin-private.h.  The text tables are read the way the text
+ *	  data build of the library reads them.
+ *
+ * usage: maketables <data directory>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global-private.h"
+#include "chewing-private.h"
+#include "chewingutil.h"
+#include "hanyupinyin-private.h"
+#include "chewing-utf8-util.h"
+#include "container-private.h"
+#include "config.h"
+
+#define LINE_LEN	512
+#define MAX_SYMBOL_ENTRY	100
+
+static FILE *OpenTable( const char *dir, const char *name )
+{
+	char filename[ PATH_MAX ];
+	FILE *fp;
+
+	snprintf( filename, sizeof( filename ), "%s" PLAT_SEPARATOR "%s", dir, name );
+	fp = fopen( filename, "r" );
+	if ( ! fp )
+		fprintf( stderr, "Error opening the file %s\n", filename );
+	return fp;
+}
+
+static FILE *CreateTable( const char *name )
+{
+	FILE *fp = fopen( name, "wb" );
+
+	if ( ! fp )
+		fprintf( stderr, "Error opening the file %s\n", name );
+	return fp;
+}
+
+static int CloseTable( FILE *fp, const char *name )
+{
+	if ( ferror( fp ) | fclose( fp ) ) {
+		fprintf( stderr, "Error writing the file %s\n", name );
+		return 1;
+	}
+	return 0;
+}
+
+/* the tables are little-endian, see container-private.h */
+static void WriteInt32( int32_t value, FILE *fp )
+{
+	unsigned char b[ 4 ];
+
+	PutUint32LE( b, value );
+	fwrite( b, sizeof( b ), 1, fp );
+}
+
+static size_t EntryLen( const SymbolEntry *entry )
+{
+	return offsetof( SymbolEntry, symbols ) + entry->nSymbols * sizeof( entry->symbols[ 0 ] );
+}
+
+static size_t EntrySize( const SymbolEntry *entry )
+{
+	return ( EntryLen( entry ) + 3 ) / 4 * 4;
+}
+
+static int MakeSymbolTable( const char *dir )
+{
+	static const char padding[ 4 ];
+	SymbolEntry *entry[ MAX_SYMBOL_ENTRY ];
+	char line[ LINE_LEN ];
+	char *category_end, *symbols, *symbol;
+	int nEntry = 0;
+	size_t offset;
+	int len, i;
+	FILE *in, *out;
+	int ret = 1;
+
+	in = OpenTable( dir, SYMBOL_TABLE_FILE );
+	if ( ! in )
+		return 1;
+
+	while ( fgets( line, LINE_LEN, in ) && nEntry < MAX_SYMBOL_ENTRY ) {
+		category_end = strpbrk( line, "=\r\n" );
+		if ( ! category_end ) {
+			fprintf( stderr, "%s: a line is too long\n", SYMBOL_TABLE_FILE );
+			goto end;
+		}
+
+		symbols = category_end + 1;
+		len = strpbrk( symbols, "\r\n" ) ? ueStrLen( symbols ) : 0;
+		entry[ nEntry ] = calloc( 1, sizeof( SymbolEntry ) +
+			len * sizeof( entry[ 0 ]->symbols[ 0 ] ) );
+		if ( ! entry[ nEntry ] ) {
+			fprintf( stderr, "Out of memory!\n" );
+			goto end;
+		}
+		entry[ nEntry ]->nSymbols = len;
+		for ( i = 0, symbol = symbols; i < len; i++ ) {
+			ueStrNCpy( entry[ nEntry ]->symbols[ i ], symbol, 1, 1 );
+			symbol += ueBytesFromChar( symbol[ 0 ] );
+		}
+
+		*category_end = 0;
+		ueStrNCpy( entry[ nEntry ]->category, line, MAX_PHRASE_LEN, 1 );
+		nEntry++;
+	}
+
+	out = CreateTable( SYMBOL_TABLE_BIN_FILE );
+	if ( ! out )
+		goto end;
+	WriteInt32( nEntry, out );
+	offset = ( nEntry + 1 ) * 4;
+	for ( i = 0; i < nEntry; i++ ) {
+		WriteInt32( offset, out );
+		offset += EntrySize( entry[ i ] );
+	}
+	for ( i = 0; i < nEntry; i++ ) {
+		len = EntryLen( entry[ i ] );
+		WriteInt32( entry[ i ]->nSymbols, out );
+		fwrite( entry[ i ]->category, len - offsetof( SymbolEntry, category ), 1, out );
+		fwrite( padding, EntrySize( entry[ i ] ) - len, 1, out );
+	}
+	ret = CloseTable( out, SYMBOL_TABLE_BIN_FILE );
+end:
+	for ( i = 0; i < nEntry; i++ )
+		free( entry[ i ] );
+	fclose( in );
+	return ret;
+}
+
+/* the keys of the easy symbol input are 0-9 and A-Z, in this order */
+static int EasySymbolIndex( char ch )
+{
+	if ( ch >= '0' && ch <= '9' )
+		return ch - '0';
+	if ( ch >= 'A' && ch <= 'Z' )
+		return ch - 'A' + 10;
+	return -1;
+}
+
+static int MakeEasySymbol( const char *dir )
+{
+	EasySymbolRecord record[ EASY_SYMBOL_KEY_TAB_LEN ];
+	char line[ LINE_LEN ];
+	int _index, len;
+	FILE *in, *out;
+
+	in = OpenTable( dir, SOFTKBD_TABLE_FILE );
+	if ( ! in )
+		return 1;
+
+	memset( record, 0, sizeof( record ) );
+	while ( fgets( line, LINE_LEN, in ) ) {
+		if ( ' ' != line[ 1 ] )
+			continue;
+		line[ strcspn( line, "\r\n" ) ] = '\0';
+
+		_index = EasySymbolIndex( line[ 0 ] );
+		if ( -1 == _index )
+			continue;
+
+		len = ueStrLen( &line[ 2 ] );
+		if ( 0 == len || len > MAX_EASY_SYMBOL_LEN )
+			continue;
+
+		memset( &record[ _index ], 0, sizeof( record[ _index ] ) );
+		ueStrNCpy( record[ _index ].symbols, &line[ 2 ], len, 1 );
+		PutUint32LE( &record[ _index ].nSymbols, len );
+	}
+	fclose( in );
+
+	out = CreateTable( EASY_SYMBOL_BIN_FILE );
+	if ( ! out )
+		return 1;
+	fwrite( record, sizeof( record ), 1, out );
+	return CloseTable( out, EASY_SYMBOL_BIN_FILE );
+}
+
+/* n keymaps and the empty one after them, NULL on failure */
+static keymap *ReadKeymap( FILE *in, int *n )
+{
+	keymap *map;
+	int i;
+
+	if ( fscanf( in, "%d", n ) != 1 || *n < 0 )
+		return NULL;
+	map = calloc( *n + 1, sizeof( keymap ) );
+	if ( ! map )
+		return NULL;
+	for ( i = 0; i < *n; i++ ) {
+		if ( fscanf( in, "%6s %3s", map[ i ].pinyin, map[ i ].zuin ) != 2 ) {
+			free( map );
+			return NULL;
+		}
+	}
+	++*n;
+	return map;
+}
+
+static int MakePinyin( const char *dir )
+{
+	keymap *initials = NULL, *finals = NULL;
+	int n[ 2 ];
+	FILE *in, *out;
+	int ret = 1;
+
+	in = OpenTable( dir, PINYIN_TAB_NAME );
+	if ( ! in )
+		return 1;
+
+	initials = ReadKeymap( in, &n[ 0 ] );
+	if ( initials )
+		finals = ReadKeymap( in, &n[ 1 ] );
+	if ( ! finals ) {
+		fprintf( stderr, "%s is corrupted!\n", PINYIN_TAB_NAME );
+		goto end;
+	}
+
+	out = CreateTable( PINYIN_BIN_FILE );
+	if ( ! out )
+		goto end;
+	WriteInt32( n[ 0 ], out );
+	WriteInt32( n[ 1 ], out );
+	fwrite( initials, sizeof( keymap ), n[ 0 ], out );
+	fwrite( finals, sizeof( keymap ), n[ 1 ], out );
+	ret = CloseTable( out, PINYIN_BIN_FILE );
+end:
+	free( initials );
+	free( finals );
+	fclose( in );
+	return ret;
+}
+
+int main( int argc, char *argv[] )
+{
+	if ( argc != 2 ) {
+		fprintf( stderr, "Usage: maketables <data directory>\n" );
+		return 1;
+	}
+	if ( MakeSymbolTable( argv[ 1 ] ) || MakeEasySymbol( argv[ 1 ] ) || MakePinyin( argv[ 1 ] ) )
+		return 1;
+	return 0;
+}
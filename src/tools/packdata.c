@@ -0,0 +1,198 @@
+/**
+ * packdata.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file packdata.c
+ *
+ * @brief Static data container generator.\n
+ *
+ *	  This program packs the binary files written by sort_word, sort_dic
+ *	  and maketables into STATIC_DATA_FILE, see container-private.h.
+ *	  The dictionary comes either plain or compressed, whichever
+ *	  sort_dic wrote, so those sections are optional.\n
+ *	  With -v it checks the header and every checksum of a container
+ *	  instead, and exits non-zero if any of them is wrong.
+ *
+ * usage: packdata [-v <file>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "global-private.h"
+#include "container-private.h"
+#include "config.h"
+
+static const struct {
+	uint32_t id;
+	const char *file;
+	int optional;
+} SECTION_FILE[] = {
+	{ SECTION_CHAR, CHAR_FILE, 0 },
+	{ SECTION_CHAR_INDEX_BEGIN, CHAR_INDEX_BEGIN_FILE, 0 },
+	{ SECTION_CHAR_INDEX_PHONE, CHAR_INDEX_PHONE_FILE, 0 },
+	{ SECTION_DICT, DICT_FILE, 1 },
+	{ SECTION_PH_INDEX, PH_INDEX_FILE, 0 },
+	{ SECTION_PHONE_TREE, PHONE_TREE_FILE, 0 },
+	{ SECTION_CHAR_INDEX_DIRECT, CHAR_INDEX_DIRECT_FILE, 0 },
+	{ SECTION_DICT_RECORD, DICT_RECORD_FILE, 1 },
+	{ SECTION_DICT_COMPRESSED, DICT_COMPRESSED_FILE, 1 },
+	{ SECTION_DICT_CHARS, DICT_CHARS_FILE, 1 },
+	{ SECTION_SYMBOL_TABLE, SYMBOL_TABLE_BIN_FILE, 0 },
+	{ SECTION_EASY_SYMBOL, EASY_SYMBOL_BIN_FILE, 0 },
+	{ SECTION_PINYIN, PINYIN_BIN_FILE, 0 },
+};
+
+#define SECTION_FILE_NUM ( sizeof( SECTION_FILE ) / sizeof( SECTION_FILE[ 0 ] ) )
+
+/* read a whole file into a new buffer, NULL on failure */
+static char *ReadFile( const char *filename, size_t *size )
+{
+	FILE *fp;
+	char *buf;
+	long len;
+
+	fp = fopen( filename, "rb" );
+	if ( ! fp ) {
+		fprintf( stderr, "Error opening the file %s\n", filename );
+		return NULL;
+	}
+	if ( fseek( fp, 0, SEEK_END ) || ( len = ftell( fp ) ) < 0 ||
+			fseek( fp, 0, SEEK_SET ) ) {
+		fprintf( stderr, "Cannot get the size of %s\n", filename );
+		fclose( fp );
+		return NULL;
+	}
+	/* one more byte, so that an empty file still gets a buffer */
+	buf = malloc( len + 1 );
+	if ( ! buf || fread( buf, 1, len, fp ) != (size_t) len ) {
+		fprintf( stderr, "Error reading the file %s\n", filename );
+		free( buf );
+		fclose( fp );
+		return NULL;
+	}
+	fclose( fp );
+	*size = len;
+	return buf;
+}
+
+static size_t Align( size_t offset )
+{
+	return ( offset + CONTAINER_ALIGN - 1 ) / CONTAINER_ALIGN * CONTAINER_ALIGN;
+}
+
+static int Pack( const char *output )
+{
+	char *data[ SECTION_FILE_NUM ];
+	size_t size[ SECTION_FILE_NUM ];
+	size_t offset[ SECTION_FILE_NUM ];
+	unsigned char header[ CONTAINER_HEADER_SIZE + SECTION_FILE_NUM * CONTAINER_ENTRY_SIZE ];
+	unsigned char *entry;
+	static const char padding[ CONTAINER_ALIGN ];
+	size_t header_size;
+	size_t nSection = 0;
+	size_t pos;
+	size_t i;
+	FILE *fp;
+	int ret = 1;
+
+	memset( data, 0, sizeof( data ) );
+	for ( i = 0; i < SECTION_FILE_NUM; i++ ) {
+		if ( SECTION_FILE[ i ].optional && access( SECTION_FILE[ i ].file, F_OK ) )
+			continue;
+		data[ i ] = ReadFile( SECTION_FILE[ i ].file, &size[ i ] );
+		if ( ! data[ i ] )
+			goto end;
+		nSection++;
+	}
+
+	header_size = CONTAINER_HEADER_SIZE + nSection * CONTAINER_ENTRY_SIZE;
+	pos = header_size;
+	for ( i = 0; i < SECTION_FILE_NUM; i++ ) {
+		if ( ! data[ i ] )
+			continue;
+		offset[ i ] = Align( pos );
+		pos = offset[ i ] + size[ i ];
+		if ( pos > 0xffffffff ) {
+			fprintf( stderr, "%s does not fit in a container\n", SECTION_FILE[ i ].file );
+			goto end;
+		}
+	}
+
+	memset( header, 0, sizeof( header ) );
+	memcpy( header, CONTAINER_MAGIC, CONTAINER_MAGIC_LEN );
+	PutUint32LE( header + 8, CONTAINER_VERSION );
+	PutUint32LE( header + 12, nSection );
+	entry = header + CONTAINER_HEADER_SIZE;
+	for ( i = 0; i < SECTION_FILE_NUM; i++ ) {
+		if ( ! data[ i ] )
+			continue;
+		PutUint32LE( entry, SECTION_FILE[ i ].id );
+		PutUint32LE( entry + 4, offset[ i ] );
+		PutUint32LE( entry + 8, size[ i ] );
+		PutUint32LE( entry + 12, ContainerChecksum( data[ i ], size[ i ] ) );
+		entry += CONTAINER_ENTRY_SIZE;
+	}
+
+	fp = fopen( output, "wb" );
+	if ( ! fp ) {
+		fprintf( stderr, "Error opening the file %s\n", output );
+		goto end;
+	}
+	fwrite( header, header_size, 1, fp );
+	pos = header_size;
+	for ( i = 0; i < SECTION_FILE_NUM; i++ ) {
+		if ( ! data[ i ] )
+			continue;
+		fwrite( padding, offset[ i ] - pos, 1, fp );
+		fwrite( data[ i ], size[ i ], 1, fp );
+		pos = offset[ i ] + size[ i ];
+	}
+	if ( ferror( fp ) | fclose( fp ) ) {
+		fprintf( stderr, "Error writing the file %s\n", output );
+		goto end;
+	}
+	ret = 0;
+end:
+	for ( i = 0; i < SECTION_FILE_NUM; i++ )
+		free( data[ i ] );
+	return ret;
+}
+
+static int Verify( const char *filename )
+{
+	char *data;
+	size_t size;
+	int ret;
+
+	data = ReadFile( filename, &size );
+	if ( ! data )
+		return 1;
+	ret = ContainerVerify( data, size );
+	free( data );
+	if ( ret ) {
+		fprintf( stderr, "The file %s is corrupted!\n", filename );
+		return 1;
+	}
+	return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+	if ( argc == 3 && ! strcmp( argv[ 1 ], "-v" ) )
+		return Verify( argv[ 2 ] );
+	if ( argc != 1 ) {
+		fprintf( stderr, "Usage: packdata [-v <file>]\n" );
+		return 1;
+	}
+	return Pack( STATIC_DATA_FILE );
+}
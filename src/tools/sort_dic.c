@@ -15,13 +15,28 @@
 /**
  * @file  sort_dic.c
  * @brief Sort and Index dictionary.\n
- *        Generate \b ph_index.dat (dictionary index) and \b dict.dat (content of dictionary) from
- *	  \b tsi.src (dictionary file in libtabe standard).
+ *        Generate \b ph_index.dat (dictionary index), \b dict.dat (content of dictionary)
+ *	  and \b fonetree.dat (phone phrase tree) from \b tsi.src (dictionary file in
+ *	  libtabe standard).
  *
  *	  Read dictionary format :
  *  	  phrase   frequency   zuin1 zuin2 zuin3 ... \n
  *  	  Output format : ( Sorted by zuin's uint16_t number )
  *  	  phrase   frequency   zuin1 zuin2 zuin3 ... \n
+ *
+ *	  Phrases of the same zuin sequence are written by decreasing
+ *	  frequency, so the first phrase of a phrase id is its most frequent
+ *	  one.  GetPhraseMaxFreq() depends on this order.
+ *
+ *	  The binary data has a DictRecord for every phrase in \b dict_record.dat,
+ *	  \b ph_index.dat holds the first record of each phrase id and
+ *	  \b dict.dat the bare phrases.  With -c they are replaced by
+ *	  \b dict_compressed.dat and \b dict_chars.dat, see dict-private.h.
+ *
+ *	  tsi.src is read line by line into compact records, the phrases
+ *	  themselves go to one string pool.  After sorting, the distinct
+ *	  zuin sequences are the phrase ids, and the phone phrase tree is
+ *	  built from them level by level, see BuildTree().
  */
 
 #include <stdio.h>
@@ -31,49 +46,94 @@
 #include "global.h"
 #include "global-private.h"
 #include "key2pho-private.h"
+#include "dict-private.h"
+#include "container-private.h"
+#include "chewing-utf8-util.h"
 #include "config.h"
 
 #define MAXLEN		149
 #define MAXZUIN		9
 #define MAX_FILE_NAME	(256)
 
-#define IN_FILE		"phoneid.dic"
-
 typedef struct {
-	char str[ MAXLEN ];
+	long str;		/* offset of the phrase in pool */
+	long order;		/* line number, equal phrases keep it */
 	int freq;
 	uint16_t num[ MAXZUIN ];
 } RECORD;
 
-RECORD data[ 420000L ];
-long nData;
+RECORD *data;
+long nData, nDataAlloc;
+
+char *pool;
+long nPool, nPoolAlloc;
+
+#define PHRASE( _index ) ( pool + data[ _index ].str )
+
+#ifdef USE_BINARY_DATA
+/* the binary files are little-endian, see container-private.h */
+void WriteInt32( int32_t value, FILE *fp )
+{
+	unsigned char b[ 4 ];
+
+	PutUint32LE( b, value );
+	fwrite( b, sizeof( b ), 1, fp );
+}
+#endif
+
+/* grow *buf of *nAlloc elements to hold need elements */
+void *Reserve( void *buf, long *nAlloc, long need, size_t size )
+{
+	if ( need <= *nAlloc )
+		return buf;
+	while ( *nAlloc < need )
+		*nAlloc = *nAlloc ? *nAlloc * 2 : 4096;
+	buf = realloc( buf, *nAlloc * size );
+	if ( !buf ) {
+		fprintf( stderr, "Out of memory!\n" );
+		exit( -1 );
+	}
+	return buf;
+}
+
+#ifdef USE_BINARY_DATA
+typedef struct {
+	char ch[ DICT_CHAR_SIZE + 1 ];
+	long count;
+	int code;
+} CHAR_CODE;
+
+CHAR_CODE *chars;
+long nChars;
+#endif
 
 const char user_msg[] = 
 	"sort_dic -- read chinese phrase input and generate data file for chewing\n" \
 	"usage: \n" \
-		"\tsort_dic <tsi file name> or \n" \
-		"\tsort_dic (default name is tsi.src) \n" \
+		"\tsort_dic [-c] <tsi file name> or \n" \
+		"\tsort_dic [-c] (default name is tsi.src) \n" \
+		"-c writes a compressed dictionary, binary data only. \n" \
 		"This program creates three new files. \n" \
 		"1." DICT_FILE " \t-- main dictionary file \n" \
 		"2." PH_INDEX_FILE " \t-- index file of phrase \n" \
-		"3." IN_FILE " \t-- intermediate file for make_tree \n";
+		"3." PHONE_TREE_FILE " \t-- phone phrase tree \n";
 
 extern const char *ph_pho[];
 /*extern uint16_t PhoneBg2Uint( const char *phone );*/
 
-void DataSetNum( long _index )
+void DataSetNum( const char *str, RECORD *rec )
 {
 	char buf[ MAXLEN ], *p;
 	int i = 0;
 
-	strcpy( buf, data[ _index ].str );
+	strcpy( buf, str );
 	strtok( buf, " \n\t" );
-	data[ _index ].freq = atoi( strtok( NULL, " \n\t" ) );
-	for ( p = strtok( NULL, " \n\t" ); p; p = strtok( NULL, " \n\t" ) ) 
-		data[ _index ].num[ i++ ] = UintFromPhone( p );
+	rec->freq = atoi( strtok( NULL, " \n\t" ) );
+	for ( p = strtok( NULL, " \n\t" ); p && i < MAXZUIN; p = strtok( NULL, " \n\t" ) )
+		rec->num[ i++ ] = UintFromPhone( p );
 }
 
-void DataStripSpace( long _index )
+void DataStripSpace( char *str )
 {
 	long i, k = 0;
 	char old[ MAXLEN ], last = ' ';
@@ -81,7 +141,7 @@ void DataStripSpace( long _index )
 		 * then it should be ignore? 
 		 */
 
-	strcpy( old, data[ _index ].str );
+	strcpy( old, str );
 	for ( i = 0; old[ i ]; i++ ) {
 		/* trans '\t' to ' ' , easy for process. */
 		if ( old[ i ] == '\t' )
@@ -90,24 +150,66 @@ void DataStripSpace( long _index )
 			continue;
 		/* Ignore '#' comment in tsi.src */
 		if ( old[ i ] == '#') {
-			data[ _index ].str[ k++ ] = '\n';
+			str[ k++ ] = '\n';
 			break;
 		}
-		data[ _index ].str[ k++ ] = old[ i ];
+		str[ k++ ] = old[ i ];
 		last = old[ i ];
 	}
-	data[ _index ].str[ k ] = '\0';
+	str[ k ] = '\0';
 }
 
-void DataStripAll( long _index )
+void DataStripAll( char *str )
 {
 	char *p;
 
-	p = strchr( data[ _index ].str, ' ' );
+	p = strchr( str, ' ' );
 	if ( p )
 		*p = '\0';
 }
 
+/* A few phrases of tsi.src have more characters than syllables; the
+ * library has always shown them cut to their syllables, so store them so. */
+void DataTruncate( char *str, const RECORD *rec )
+{
+	char *p = str;
+	int i;
+
+	for ( i = 0; i < MAXZUIN && rec->num[ i ] && *p; i++ )
+		p += ueBytesFromChar( *p );
+	*p = '\0';
+}
+
+/* read tsi.src, one line at a time */
+void ReadData( FILE *infile )
+{
+	char str[ MAXLEN ];
+	RECORD *rec;
+	long len;
+
+	while ( fgets( str, MAXLEN, infile ) ) {
+		DataStripSpace( str );
+		/* Ignore '#' comment for tsi.src */
+		if ( str[0] == '\n' )
+			continue;
+
+		data = Reserve( data, &nDataAlloc, nData + 1, sizeof( RECORD ) );
+		rec = &data[ nData ];
+		memset( rec, 0, sizeof( RECORD ) );
+		DataSetNum( str, rec );
+		DataStripAll( str );
+		DataTruncate( str, rec );
+
+		len = strlen( str ) + 1;
+		pool = Reserve( pool, &nPoolAlloc, nPool + len, 1 );
+		memcpy( pool + nPool, str, len );
+		rec->str = nPool;
+		rec->order = nData;
+		nPool += len;
+		nData++;
+	}
+}
+
 int CompRecord( const void *a, const void *b )
 {
 	long i;
@@ -118,7 +220,11 @@ int CompRecord( const void *a, const void *b )
 		if ( cmp )
 			return cmp;
 	}
-	return ( ((RECORD *) b)->freq - ((RECORD *) a)->freq );
+	cmp = ((RECORD *) b)->freq - ((RECORD *) a)->freq;
+	if ( cmp )
+		return cmp;
+	return ( ((RECORD *) a)->order > ((RECORD *) b)->order ) -
+		( ((RECORD *) a)->order < ((RECORD *) b)->order );
 }
 
 int CompUint( long a, long b )
@@ -132,21 +238,265 @@ int CompUint( long a, long b )
 	return 0;
 }
 
+int SeqLen( long a )
+{
+	int k;
+
+	for ( k = 0; k < MAXZUIN && data[ a ].num[ k ]; k++ )
+		;
+	return k;
+}
+
+/* the number of leading syllables a and b share */
+int SeqCommon( long a, long b )
+{
+	int k;
+
+	for ( k = 0; k < MAXZUIN && data[ a ].num[ k ] &&
+			data[ a ].num[ k ] == data[ b ].num[ k ]; k++ )
+		;
+	return k;
+}
+
+/**
+ * Write the phone phrase tree of the sorted data, a TreeType for
+ * every node in level order (see tree.c).
+ *
+ * A node at depth d is a distinct d-syllable prefix of the phrase ids.
+ * In sorted order the prefixes of one depth are met in level order, and
+ * a phrase id adds a node at each depth beyond what it shares with the
+ * phrase id before it, so one pass counts the nodes of each depth and a
+ * second one fills them in, without building a linked tree.
+ */
+void BuildTree( FILE *output, FILE *config )
+{
+	long count[ MAXZUIN + 1 ], next[ MAXZUIN + 1 ], parent[ MAXZUIN + 1 ];
+	TreeType *tree;
+	long tree_size;
+	long i, prev, node;
+	int phrase_id;
+	int d, len, common;
+
+	memset( count, 0, sizeof( count ) );
+	count[ 0 ] = 1;
+	for ( i = 0, prev = -1; i < nData; i++ ) {
+		if ( ( i > 0 ) && ( CompUint( i, i - 1 ) == 0 ) )
+			continue;
+		len = SeqLen( i );
+		common = ( prev == -1 ) ? 0 : SeqCommon( i, prev );
+		for ( d = common + 1; d <= len; d++ )
+			count[ d ]++;
+		prev = i;
+	}
+
+	next[ 0 ] = 0;
+	for ( d = 1; d <= MAXZUIN; d++ )
+		next[ d ] = next[ d - 1 ] + count[ d - 1 ];
+	tree_size = next[ MAXZUIN ] + count[ MAXZUIN ];
+
+	tree = calloc( tree_size, sizeof( TreeType ) );
+	if ( !tree ) {
+		fprintf( stderr, "Out of memory!\n" );
+		exit( -1 );
+	}
+	for ( node = 0; node < tree_size; node++ ) {
+		tree[ node ].phrase_id = -1;
+		tree[ node ].child_begin = -1;
+		tree[ node ].child_end = -1;
+	}
+
+	/* root has special key value 0 */
+	parent[ 0 ] = next[ 0 ]++;
+	for ( i = 0, prev = -1, phrase_id = 0; i < nData; i++ ) {
+		if ( ( i > 0 ) && ( CompUint( i, i - 1 ) == 0 ) )
+			continue;
+		len = SeqLen( i );
+		common = ( prev == -1 ) ? 0 : SeqCommon( i, prev );
+		for ( d = common + 1; d <= len; d++ ) {
+			node = next[ d ]++;
+			tree[ node ].phone_id = data[ i ].num[ d - 1 ];
+			if ( tree[ parent[ d - 1 ] ].child_begin == -1 )
+				tree[ parent[ d - 1 ] ].child_begin = node;
+			tree[ parent[ d - 1 ] ].child_end = node;
+			parent[ d ] = node;
+		}
+		tree[ parent[ len ] ].phrase_id = phrase_id++;
+		prev = i;
+	}
+
+#ifdef USE_BINARY_DATA
+	for ( node = 0; node < tree_size; node++ ) {
+		PutUint16LE( &tree[ node ].phone_id, tree[ node ].phone_id );
+		PutUint32LE( &tree[ node ].phrase_id, tree[ node ].phrase_id );
+		PutUint32LE( &tree[ node ].child_begin, tree[ node ].child_begin );
+		PutUint32LE( &tree[ node ].child_end, tree[ node ].child_end );
+	}
+	fwrite( tree, sizeof( TreeType ), tree_size, output );
+#else
+	for ( node = 0; node < tree_size; node++ )
+		fprintf( output, "%hu %d %d %d\n",
+				tree[ node ].phone_id, tree[ node ].phrase_id,
+				tree[ node ].child_begin, tree[ node ].child_end );
+#endif
+	fprintf( config, "#define TREE_SIZE (%ld)\n", tree_size );
+	free( tree );
+}
+
+#ifdef USE_BINARY_DATA
+int CompCharBytes( const void *a, const void *b )
+{
+	return strcmp( ((CHAR_CODE *) a)->ch, ((CHAR_CODE *) b)->ch );
+}
+
+int CompCharCount( const void *a, const void *b )
+{
+	long cmp = ((CHAR_CODE *) b)->count - ((CHAR_CODE *) a)->count;
+
+	if ( cmp )
+		return cmp > 0 ? 1 : -1;
+	return CompCharBytes( a, b );
+}
+
+/* a power of 2, four times DICT_CHAR_CODE_NUM at least */
+#define CHAR_HASH_SIZE ( 1 << 17 )
+
+/* count ch, of len bytes, in the hash table chars */
+void CountChar( const char *ch, int len )
+{
+	unsigned long h = 2166136261UL;
+	long i;
+	int k;
+
+	for ( k = 0; k < len; k++ )
+		h = ( h ^ (unsigned char) ch[ k ] ) * 16777619UL;
+	for ( i = h & ( CHAR_HASH_SIZE - 1 ); chars[ i ].ch[ 0 ];
+			i = ( i + 1 ) & ( CHAR_HASH_SIZE - 1 ) ) {
+		if ( ! strncmp( chars[ i ].ch, ch, len ) && ! chars[ i ].ch[ len ] ) {
+			chars[ i ].count++;
+			return;
+		}
+	}
+	if ( ++nChars > DICT_CHAR_CODE_NUM ) {
+		fprintf( stderr, "Too many characters for the compressed dictionary!\n" );
+		exit( -1 );
+	}
+	memcpy( chars[ i ].ch, ch, len );
+	chars[ i ].count = 1;
+}
+
+/* the distinct characters of all phrases by bytes, the most used ones
+ * with the smallest codes */
+void BuildCharCode( FILE *charsfile )
+{
+	char pad[ DICT_CHAR_SIZE ];
+	const char *p;
+	long i, k;
+	int len;
+
+	chars = calloc( CHAR_HASH_SIZE, sizeof( CHAR_CODE ) );
+	if ( !chars ) {
+		fprintf( stderr, "Out of memory!\n" );
+		exit( -1 );
+	}
+	for ( i = 0; i < nData; i++ ) {
+		for ( p = PHRASE( i ); *p; p += len ) {
+			len = ueBytesFromChar( *p );
+			if ( len > DICT_CHAR_SIZE ) {
+				fprintf( stderr, "%s has a character of %d bytes\n", PHRASE( i ), len );
+				exit( -1 );
+			}
+			CountChar( p, len );
+		}
+	}
+	for ( i = 0, k = 0; i < CHAR_HASH_SIZE; i++ ) {
+		if ( chars[ i ].ch[ 0 ] )
+			chars[ k++ ] = chars[ i ];
+	}
+
+	qsort( chars, nChars, sizeof( CHAR_CODE ), CompCharCount );
+	for ( i = 0; i < nChars; i++ ) {
+		chars[ i ].code = i;
+		memset( pad, 0, sizeof( pad ) );
+		memcpy( pad, chars[ i ].ch, strlen( chars[ i ].ch ) );
+		fwrite( pad, sizeof( pad ), 1, charsfile );
+	}
+	/* by bytes again, for FindCharCode() */
+	qsort( chars, nChars, sizeof( CHAR_CODE ), CompCharBytes );
+}
+
+int FindCharCode( const char *p )
+{
+	CHAR_CODE key, *found;
+	int len = ueBytesFromChar( *p );
+
+	memcpy( key.ch, p, len );
+	key.ch[ len ] = '\0';
+	found = bsearch( &key, chars, nChars, sizeof( CHAR_CODE ), CompCharBytes );
+	return found->code;
+}
+
+void WriteCompressed( long _index, FILE *dictfile )
+{
+	const char *p = PHRASE( _index );
+	const char *last = ( _index > 0 && CompUint( _index, _index - 1 ) == 0 ) ?
+		PHRASE( _index - 1 ) : "";
+	unsigned int freq = data[ _index ].freq;
+	int nPrefix = 0;
+	int len, code;
+
+	/* a nibble each */
+	while ( nPrefix < 15 && *p && *last ) {
+		len = ueBytesFromChar( *p );
+		if ( strncmp( p, last, len ) )
+			break;
+		p += len;
+		last += len;
+		nPrefix++;
+	}
+	fputc( nPrefix << 4 | ueStrLen( p ), dictfile );
+
+	for ( ; freq >= 0x80; freq >>= 7 )
+		fputc( ( freq & 0x7f ) | 0x80, dictfile );
+	fputc( freq, dictfile );
+
+	for ( ; *p; p += ueBytesFromChar( *p ) ) {
+		code = FindCharCode( p );
+		if ( code < 0x80 )
+			fputc( code, dictfile );
+		else {
+			code -= 0x80;
+			fputc( 0x80 | code >> 8, dictfile );
+			fputc( code & 0xff, dictfile );
+		}
+	}
+}
+#endif
+
 int main( int argc, char *argv[] )
 {
 	FILE *infile;
-	FILE *dictfile, *treedata, *ph_index;
+	FILE *dictfile, *treedata, *ph_index, *config;
 	char in_file[ MAX_FILE_NAME ] = "tsi.src";
-	long i, k;
-	int tmp;
+	long i;
+	int argi = 1;
+	int compressed = 0;
 #ifdef USE_BINARY_DATA
-	unsigned char size;
+	FILE *recordfile = NULL, *charsfile = NULL;
+	DictRecord record;
 #endif
 
-	if ( argc < 2 ) 
+	if ( argi < argc && ! strcmp( argv[ argi ], "-c" ) ) {
+#ifndef USE_BINARY_DATA
+		fprintf( stderr, "-c needs binary data!\n" );
+		exit( -1 );
+#endif
+		compressed = 1;
+		argi++;
+	}
+	if ( argi >= argc )
 		printf( user_msg );
-	else 
-		strcpy( in_file, argv[ 1 ] );
+	else
+		strcpy( in_file, argv[ argi ] );
 
 	infile = fopen( in_file, "r" );
 
@@ -156,75 +506,89 @@ int main( int argc, char *argv[] )
 	}
 
 #ifdef USE_BINARY_DATA
-	dictfile = fopen( DICT_FILE, "wb" );
+	/* packdata takes whichever dictionary is there */
+	if ( compressed ) {
+		remove( DICT_FILE );
+		remove( DICT_RECORD_FILE );
+		dictfile = fopen( DICT_COMPRESSED_FILE, "wb" );
+		charsfile = fopen( DICT_CHARS_FILE, "wb" );
+	}
+	else {
+		remove( DICT_COMPRESSED_FILE );
+		remove( DICT_CHARS_FILE );
+		dictfile = fopen( DICT_FILE, "wb" );
+		recordfile = fopen( DICT_RECORD_FILE, "wb" );
+	}
 	ph_index = fopen( PH_INDEX_FILE, "wb" );
+	if ( !recordfile && !charsfile ) {
+		fprintf( stderr, "Error opening output file!\n" );
+		exit( -1 );
+	}
 #else
 	dictfile = fopen( DICT_FILE, "w" );
 	ph_index = fopen( PH_INDEX_FILE, "w" );
 #endif
-	treedata = fopen( IN_FILE, "w" );
+#ifdef USE_BINARY_DATA
+	treedata = fopen( PHONE_TREE_FILE, "wb" );
+#else
+	treedata = fopen( PHONE_TREE_FILE, "w" );
+#endif
+	config = fopen( CHEWING_DEFINITION_FILE, "a" );
 
-	if ( !dictfile || !treedata || !ph_index ) {
+	if ( !dictfile || !treedata || !ph_index || !config ) {
 		fprintf( stderr, "Error opening output file!\n" );
 		exit( -1 );
 	}
 
-	while ( fgets( data[ nData ].str, MAXLEN, infile ) ) {
-		DataStripSpace( nData );
-		/* Ignore '#' comment for tsi.src */
-		if ( data[ nData ].str[0] == '\n' )
-			continue;
-		DataSetNum( nData );
-		DataStripAll( nData );
-		nData++;
-	}
+	ReadData( infile );
 	qsort( data, nData, sizeof( RECORD ), CompRecord );
 
-	for ( i = 0; i < nData - 1; i++ ) {
-		if ( ( i == 0 ) || ( CompUint( i, i - 1 ) != 0 ) )  {
 #ifdef USE_BINARY_DATA
-			tmp = ftell( dictfile );
-			fwrite( &tmp, sizeof( tmp ), 1, ph_index );
-#else
-			fprintf( ph_index, "%ld\n", ftell( dictfile ) );
-#endif
+	if ( compressed ) {
+		BuildCharCode( charsfile );
+		fclose( charsfile );
+		for ( i = 0; i < nData; i++ ) {
+			if ( ( i == 0 ) || ( CompUint( i, i - 1 ) != 0 ) )
+				WriteInt32( ftell( dictfile ), ph_index );
+			WriteCompressed( i, dictfile );
 		}
-#ifdef USE_BINARY_DATA
-		size = sizeof( char ) * strlen( data[ i ].str );
-		fwrite( &size, sizeof( unsigned char ), 1, dictfile );
-		fwrite( data[ i ].str, size, 1, dictfile );
-		fwrite( &data[ i ].freq, sizeof( int ), 1, dictfile );
-#else
-		fprintf( dictfile, "%s %d\t", data[ i ].str, data[ i ].freq );
-#endif
+		WriteInt32( ftell( dictfile ), ph_index );
+	}
+	else {
+		memset( &record, 0, sizeof( record ) );
+		for ( i = 0; i < nData; i++ ) {
+			if ( ( i == 0 ) || ( CompUint( i, i - 1 ) != 0 ) )
+				WriteInt32( i, ph_index );
+			PutUint32LE( &record.freq, data[ i ].freq );
+			PutUint32LE( &record.pos, ftell( dictfile ) );
+			record.size = strlen( PHRASE( i ) );
+			record.nChar = ueStrLen( PHRASE( i ) );
+			fwrite( &record, sizeof( record ), 1, recordfile );
+			fwrite( PHRASE( i ), record.size, 1, dictfile );
+		}
+		WriteInt32( nData, ph_index );
+		fclose( recordfile );
 	}
-#ifdef USE_BINARY_DATA
-	tmp = ftell( dictfile );
-	fwrite( &tmp, sizeof( tmp ), 1, ph_index );
-	size = sizeof( char ) * strlen( data[ nData - 1 ].str );
-	fwrite( &size, sizeof( unsigned char ), 1, dictfile );
-	fwrite( data[ nData - 1 ].str, size, 1, dictfile );
-	fwrite( &data[ nData - 1 ].freq, sizeof( int ), 1, dictfile );
-	tmp = ftell( dictfile );
-	fwrite( &tmp, sizeof( tmp ), 1, ph_index );
 #else
+	for ( i = 0; i < nData - 1; i++ ) {
+		if ( ( i == 0 ) || ( CompUint( i, i - 1 ) != 0 ) )
+			fprintf( ph_index, "%ld\n", ftell( dictfile ) );
+		fprintf( dictfile, "%s %d\t", PHRASE( i ), data[ i ].freq );
+	}
 	fprintf( ph_index, "%ld\n", ftell( dictfile ) ); 
-	fprintf( dictfile, "%s %d", data[ nData - 1 ].str, data[ nData - 1 ].freq );
+	fprintf( dictfile, "%s %d", PHRASE( nData - 1 ), data[ nData - 1 ].freq );
 	fprintf( ph_index, "%ld\n", ftell( dictfile ) );
 #endif
 
-	for ( i = 0; i < nData; i++ ) {
-		if ( ( i > 0 ) && ( CompUint( i, i - 1 ) == 0 ) )
-			continue;
+	BuildTree( treedata, config );
 
-		for ( k = 0; data[ i ].num[ k ]; k++ )
-			fprintf (treedata, "%hu ", data[ i ].num[ k ] );
-		fprintf( treedata, "0\n" );
-	}
 	fclose( infile );
 	fclose( ph_index );
 	fclose( dictfile );
 	fclose( treedata );
+	fclose( config );
+	free( data );
+	free( pool );
 	return 0;
 }
 
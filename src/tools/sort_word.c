@@ -21,6 +21,7 @@
 #include "chewing-private.h"
 #include "key2pho-private.h"
 #include "zuin-private.h"
+#include "container-private.h"
 #include "config.h"
 
 #define CHARDEF_BEGIN	"%chardef  begin"
@@ -38,6 +39,27 @@ typedef struct {
 WORD_DATA word_data[ MAX_WORD ];
 int nWord;
 int phone_num;
+#ifdef USE_BINARY_DATA
+/* index + 1 of every phone in CHAR_INDEX_PHONE_FILE, 0 if it has no word,
+ * as uint16 like the files below, see container-private.h */
+unsigned char direct_index[ ( 1 << 16 ) * 2 ];
+
+void WriteUint16( uint16_t value, FILE *fp )
+{
+	unsigned char b[ 2 ];
+
+	PutUint16LE( b, value );
+	fwrite( b, sizeof( b ), 1, fp );
+}
+
+void WriteInt32( int32_t value, FILE *fp )
+{
+	unsigned char b[ 4 ];
+
+	PutUint32LE( b, value );
+	fwrite( b, sizeof( b ), 1, fp );
+}
+#endif
 
 int SortWord( const WORD_DATA *a, const WORD_DATA *b )
 {
@@ -67,12 +89,16 @@ void Output()
 	uint16_t previous;
 
 #ifdef USE_BINARY_DATA
-	int tmp;
 	unsigned char size;
-	FILE *indexfile2;
+	FILE *indexfile2, *indexfile3;
 	indexfile = fopen( CHAR_INDEX_BEGIN_FILE, "wb" );
 	indexfile2 = fopen( CHAR_INDEX_PHONE_FILE, "wb" );
+	indexfile3 = fopen( CHAR_INDEX_DIRECT_FILE, "wb" );
 	datafile = fopen( CHAR_FILE, "wb" );
+	if ( ! indexfile2 || ! indexfile3 ) {
+		fprintf( stderr, "File Write Error\n" );
+		exit( 1 );
+	}
 #else
 	indexfile = fopen( CHAR_INDEX_FILE, "w" );
 	datafile = fopen( CHAR_FILE, "w" );
@@ -89,9 +115,9 @@ void Output()
 		if ( word_data[ i ].num != previous ) {
 			previous = word_data[ i ].num;
 #ifdef USE_BINARY_DATA
-			tmp = ftell( datafile );
-			fwrite( &tmp, sizeof(int), 1, indexfile );
-			fwrite( &previous, sizeof(uint16_t), 1, indexfile2 );
+			WriteInt32( ftell( datafile ), indexfile );
+			WriteUint16( previous, indexfile2 );
+			PutUint16LE( &direct_index[ previous * 2 ], phone_num + 1 );
 #else
 			fprintf( indexfile, "%hu %ld\n", previous, ftell( datafile ) );
 #endif
@@ -106,10 +132,9 @@ void Output()
 #endif
 	}
 #ifdef USE_BINARY_DATA
-	tmp = ftell( datafile );
-	fwrite( &tmp, sizeof(int), 1, indexfile );
-	previous = 0;
-	fwrite( &previous, sizeof(uint16_t), 1, indexfile2 );
+	WriteInt32( ftell( datafile ), indexfile );
+	WriteUint16( 0, indexfile2 );
+	fwrite( direct_index, sizeof( direct_index ), 1, indexfile3 );
 #else
 	fprintf( indexfile, "0 %ld\n", ftell( datafile ) );
 #endif
@@ -117,6 +142,7 @@ void Output()
 	fclose( indexfile );
 #ifdef USE_BINARY_DATA  
 	fclose( indexfile2 );  
+	fclose( indexfile3 );
 #endif
 	fclose( datafile );
 	fclose( configfile );
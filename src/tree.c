@@ -24,13 +24,17 @@
 #include "chewing-utf8-util.h"
 #include "chewing-definition.h"
 #include "userphrase-private.h"
+#include "hash-private.h"
 #include "global.h"
 #include "global-private.h"
 #include "dict-private.h"
 #include "char-private.h"
 #include "tree-private.h"
+#include "overlay-private.h"
+#include "arena-private.h"
 #include "private.h"
-#include "plat_mmap.h"
+#include "datafile-private.h"
+#include "plat_types.h"
 
 #define INTERVAL_SIZE ( ( MAX_PHONE_SEQ_LEN + 1 ) * MAX_PHONE_SEQ_LEN / 2 )
 
@@ -46,23 +50,33 @@ typedef struct tagRecordNode {
 	int nMatchCnnct;	/* match how many Cnnct. */
 } RecordNode;
 
+/* positions and boundaries of the input fit in one 64-bit word */
+#if MAX_PHONE_SEQ_LEN >= 64
+#error "MAX_PHONE_SEQ_LEN does not fit in the bitset of TreeDataType"
+#endif
+
+typedef uint64_t PositionSet;
+
 typedef struct {
 	int leftmost[ MAX_PHONE_SEQ_LEN + 1 ] ;
-	char graph[ MAX_PHONE_SEQ_LEN + 1 ][ MAX_PHONE_SEQ_LEN + 1 ];
+	/* graph[ a ] is the set of boundaries joined to a by an interval */
+	PositionSet graph[ MAX_PHONE_SEQ_LEN + 1 ];
 	PhraseIntervalType interval[ MAX_INTERVAL ];
 	int nInterval;
 	RecordNode *phList;
 	int nPhListLen;
+	Arena *arena;	/* all temporaries of the Phrasing call */
 } TreeDataType;
 
-static int IsContain( IntervalType in1, IntervalType in2 )
+int IsIntersect( IntervalType in1, IntervalType in2 )
 {
-	return ( in1.from <= in2.from && in1.to >= in2.to );
+	return ( max( in1.from, in2.from ) < min( in1.to, in2.to ) );
 }
 
-int IsIntersect( IntervalType in1, IntervalType in2 )
+/* the set of positions from, ..., to - 1 */
+static PositionSet SpanSet( int from, int to )
 {
-	return ( max( in1.from, in2.from ) < min( in1.to, in2.to ) );
+	return ( ( (PositionSet) 1 << ( to - from ) ) - 1 ) << from;
 }
 
 static int PhraseIntervalContain(PhraseIntervalType in1, PhraseIntervalType in2)
@@ -90,35 +104,32 @@ static int GetIntersection( IntervalType in1, IntervalType in2, IntervalType *in
 void TerminateTree( ChewingData *pgdata )
 {
 #ifdef USE_BINARY_DATA
-		pgdata->static_data.tree = NULL;
-		plat_mmap_close( &pgdata->static_data.tree_mmap );
+		/* a view of STATIC_DATA_FILE, unmapped by TerminateDataFile() */
+		pgdata->static_data->tree = NULL;
+		pgdata->static_data->tree_size = 0;
 #else
-		free( pgdata->static_data.tree );
-		pgdata->static_data.tree = NULL;
+		free( pgdata->static_data->tree );
+		pgdata->static_data->tree = NULL;
 #endif
 }
 
 
-int InitTree( ChewingData *pgdata, const char * prefix )
+int InitTree( ChewingData *pgdata, const char *prefix UNUSED )
 {
 #ifdef USE_BINARY_DATA
-	char filename[ PATH_MAX ];
-	size_t len;
-	size_t offset;
-
-	len = snprintf( filename, sizeof( filename ), "%s" PLAT_SEPARATOR "%s", prefix, PHONE_TREE_FILE );
-	if ( len + 1 > sizeof( filename ) )
-		return -1;
+	/* mapped as it is, so it must have the same layout everywhere */
+	STATIC_ASSERT( sizeof( TreeType ) == 16, tree_type_is_packed );
 
-	plat_mmap_set_invalid( &pgdata->static_data.tree_mmap );
-	pgdata->static_data.tree_size = plat_mmap_create( &pgdata->static_data.tree_mmap, filename, FLAG_ATTRIBUTE_READ );
-	if ( pgdata->static_data.tree_size <= 0 )
-		return -1;
-
-	offset = 0;
-	pgdata->static_data.tree = (TreeType *) plat_mmap_set_view( &pgdata->static_data.tree_mmap, &offset, &pgdata->static_data.tree_size );
-	if ( !pgdata->static_data.tree )
+	pgdata->static_data->tree = GetDataSection( pgdata, SECTION_PHONE_TREE,
+		&pgdata->static_data->tree_size );
+	if ( !pgdata->static_data->tree )
 		return -1;
+	/* searched from the root on every key stroke: no read-ahead around
+	 * the nodes touched, but read it all in while the context starts */
+	AdviseDataSection( pgdata, pgdata->static_data->tree,
+		pgdata->static_data->tree_size, FLAG_ADVICE_RANDOM );
+	AdviseDataSection( pgdata, pgdata->static_data->tree,
+		pgdata->static_data->tree_size, FLAG_ADVICE_WILLNEED );
 
 	return 0;
 #else
@@ -165,79 +176,119 @@ static int CheckBreakpoint( int from, int to, int bArrBrkpt[] )
 	return 1;
 }
 
+/*
+ * The selections of a Phrasing() call, by position, so that a span is
+ * checked against them in time of its length rather than of their number.
+ */
+typedef struct {
+	/* the selected character at a position, NULL where there is none */
+	const char *forced[ MAX_PHONE_SEQ_LEN ];
+	PositionSet covered;	/* positions inside a selection */
+	PositionSet crossed;	/* boundaries strictly inside a selection */
+} SelectIndex;
+
+static void InitSelectIndex(
+		SelectIndex *psel,
+		char selectStr[][ MAX_SELECT_STR_SIZE ],
+		IntervalType selectInterval[], int nSelect )
+{
+	const char *str;
+	int chno, i;
+
+	memset( psel, 0, sizeof( *psel ) );
+	for ( chno = 0; chno < nSelect; chno++ ) {
+		IntervalType c = selectInterval[ chno ];
+
+		if ( c.to <= c.from )
+			continue;
+		psel->covered |= SpanSet( c.from, c.to );
+		if ( c.to - c.from > 1 )
+			psel->crossed |= SpanSet( c.from + 1, c.to );
+		str = selectStr[ chno ];
+		for ( i = c.from; i < c.to && *str; i++ ) {
+			psel->forced[ i ] = str;
+			str += ueBytesFromChar( (unsigned char) *str );
+		}
+	}
+}
+
+/*
+ * Whether a phrase on from .. to - 1 may be taken: a selection it meets
+ * but does not contain crosses one of its ends.
+ */
+static int SpanFitsSelection( const SelectIndex *psel, int from, int to )
+{
+	return ! ( ( psel->crossed >> from ) & 1 ) && ! ( ( psel->crossed >> to ) & 1 );
+}
+
+/* whether phrase, on from .. to - 1, has the selected characters there */
+static int PhraseMatchSelection( const SelectIndex *psel, const char *phrase, int from, int to )
+{
+	int i, bytes;
+
+	for ( i = from; i < to; i++ ) {
+		bytes = *phrase ? ueBytesFromChar( (unsigned char) *phrase ) : 0;
+		if ( psel->forced[ i ] && ( bytes == 0 ||
+				bytes != ueBytesFromChar( (unsigned char) *psel->forced[ i ] ) ||
+				memcmp( phrase, psel->forced[ i ], bytes ) ) )
+			return 0;
+		phrase += bytes;
+	}
+	return 1;
+}
+
 static int CheckUserChoose( 
 		ChewingData *pgdata,
 		uint16_t *new_phoneSeq, int from , int to,
-		Phrase **pp_phr, 
-		char selectStr[][ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ], 
-		IntervalType selectInterval[], int nSelect )
+		Phrase **pp_phr, const SelectIndex *psel )
 {
-	IntervalType inte, c;
-	int chno, len;
 	int user_alloc;
+	int bSelected;
 	UserPhraseData *pUserPhraseData;
-	Phrase *p_phr = ALC( Phrase, 1 );
+	UserPhraseIter iter;
+	Phrase phr;
 
-	assert( p_phr );
-	inte.from = from;
-	inte.to = to;
 	*pp_phr = NULL;
 
 	/* pass 1
 	 * if these exist one selected interval which is not contained by inte
 	 * but has intersection with inte, then inte is an unacceptable interval
 	 */
-	for ( chno = 0; chno < nSelect; chno++ ) {
-		c = selectInterval[ chno ];
-		if ( IsIntersect( inte, c ) && ! IsContain( inte, c ) ) {
-			free( p_phr );
-			return 0;
-		}
-	}
+	if ( ! SpanFitsSelection( psel, from, to ) )
+		return 0;
+	bSelected = ( psel->covered & SpanSet( from, to ) ) != 0;
 
 	/* pass 2
 	 * if there exist one phrase satisfied all selectStr then return 1, else return 0.
 	 * also store the phrase with highest freq
 	 */
-	pUserPhraseData = UserGetPhraseFirst( pgdata, new_phoneSeq );
-	p_phr->freq = -1;
+	HashReadBegin( pgdata );
+	pUserPhraseData = UserGetPhraseFirst( pgdata, &iter, new_phoneSeq );
+	phr.freq = -1;
 	do {
-		for ( chno = 0; chno < nSelect; chno++ ) {
-			c = selectInterval[ chno ];
-
-			if ( IsContain( inte, c ) ) {
-				/* 
-				 * find a phrase of ph_id where the text contains 
-				 * 'selectStr[chno]' test if not ok then return 0, 
-				 * if ok then continue to test. */
-				len = c.to - c.from;
-				if ( memcmp(
-					ueStrSeek( pUserPhraseData->wordSeq, c.from - from ),
-					selectStr[ chno ],
-					ueStrNBytes( selectStr[ chno ], len ) ) )
-					break;
-			}
-
-		}
-		if ( chno == nSelect ) {
+		/* the phrase shall have the selected characters inside it */
+		if ( ! bSelected ||
+				PhraseMatchSelection( psel, pUserPhraseData->wordSeq, from, to ) ) {
 			/* save phrase data to "pp_phr" */
-			if ( pUserPhraseData->userfreq > p_phr->freq ) {
+			if ( pUserPhraseData->userfreq > phr.freq ) {
 				if ( ( user_alloc = ( to - from ) ) > 0 ) {
-					ueStrNCpy( p_phr->phrase,
+					ueStrNCpy( phr.phrase,
 							pUserPhraseData->wordSeq,
 							user_alloc, 1);
 				}
-				p_phr->freq = pUserPhraseData->userfreq;
-				*pp_phr = p_phr;
+				phr.freq = pUserPhraseData->userfreq;
 			}
 		}
-	} while ( ( pUserPhraseData = UserGetPhraseNext( pgdata, new_phoneSeq ) ) != NULL );
+	} while ( ( pUserPhraseData = UserGetPhraseNext( pgdata, &iter ) ) != NULL );
+	HashReadEnd( pgdata );
 
-	if ( p_phr->freq != -1 ) 
-		return 1;
-		
-	free( p_phr );
-	return 0;
+	if ( phr.freq == -1 )
+		return 0;
+
+	*pp_phr = ARENA_ALC( &pgdata->phrasingArena, Phrase, 1 );
+	assert( *pp_phr );
+	**pp_phr = phr;
+	return 1;
 }
 
 /*
@@ -245,79 +296,256 @@ static int CheckUserChoose(
  * their intersections are the same */
 static int CheckChoose(
 		ChewingData *pgdata,
-		int ph_id, int from, int to, Phrase **pp_phr, 
-		char selectStr[][ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ], 
-		IntervalType selectInterval[], int nSelect )
+		const SpanInfo *pinfo, int from, int to, Phrase **pp_phr, 
+		const SelectIndex *psel )
 {
-	IntervalType inte, c;
-	int chno, len;
-	Phrase *phrase = ALC( Phrase, 1 );
+	Phrase phrase;
 
-	assert( phrase );
-	inte.from = from;
-	inte.to = to;
 	*pp_phr = NULL;
 
+	/* without a selection inside, the first phrase is taken as is */
+	if ( ! ( psel->covered & SpanSet( from, to ) ) ) {
+		*pp_phr = ARENA_ALC( &pgdata->phrasingArena, Phrase, 1 );
+		assert( *pp_phr );
+		**pp_phr = pinfo->dictPhrase;
+		return 1;
+	}
+	if ( ! SpanFitsSelection( psel, from, to ) )
+		return 0;
+
 	/* if there exist one phrase satisfied all selectStr then return 1, else return 0. */
-	GetPhraseFirst( pgdata, phrase, ph_id );
+	GetPhraseFirst( pgdata, &phrase, pinfo->pho_id );
 	do {
-		for ( chno = 0; chno < nSelect; chno++ ) {
-			c = selectInterval[ chno ];
-
-			if ( IsContain( inte, c ) ) {
-				/* find a phrase of ph_id where the text contains 
-				 * 'selectStr[chno]' test if not ok then return 0, if ok 
-				 * then continue to test
-				 */
-				len = c.to - c.from;
-				if ( memcmp(
-					ueStrSeek( phrase->phrase, c.from - from ),
-					selectStr[ chno ],
-					ueStrNBytes( selectStr[ chno ], len ) ) )
-					break;
-			}
-			else if ( IsIntersect( inte, selectInterval[ chno ] ) ) {
-				free( phrase );
-				return 0;
-			} 
-		}
-		if ( chno == nSelect ) {
-			*pp_phr = phrase;
+		if ( PhraseMatchSelection( psel, phrase.phrase, from, to ) ) {
+			*pp_phr = ARENA_ALC( &pgdata->phrasingArena, Phrase, 1 );
+			assert( *pp_phr );
+			**pp_phr = phrase;
 			return 1;
 		}
-	} while ( GetPhraseNext( pgdata, phrase ) );
-	free( phrase );
+	} while ( GetPhraseNext( pgdata, &phrase ) );
 	return 0;
 }
 
+/* the nodes are little-endian when they are mapped from STATIC_DATA_FILE */
+#ifdef USE_BINARY_DATA
+#define NodePhoneId( node )	GetUint16LE( &( node )->phone_id )
+#define NodePhraseId( node )	( (int32_t) GetUint32LE( &( node )->phrase_id ) )
+#define NodeChildBegin( node )	( (int32_t) GetUint32LE( &( node )->child_begin ) )
+#define NodeChildEnd( node )	( (int32_t) GetUint32LE( &( node )->child_end ) )
+#else
+#define NodePhoneId( node )	( ( node )->phone_id )
+#define NodePhraseId( node )	( ( node )->phrase_id )
+#define NodeChildBegin( node )	( ( node )->child_begin )
+#define NodeChildEnd( node )	( ( node )->child_end )
+#endif
+
 /** @brief search for the phrases have the same pronunciation.*/
 /* if phoneSeq[a] ~ phoneSeq[b] is a phrase, then add an interval
  * from (a) to (b+1) */
-int TreeFindPhrase( ChewingData *pgdata, int begin, int end, const uint16_t *phoneSeq )
+/**
+ * @brief Find the child of tree node tree_p whose phone_id is key.
+ *
+ * sort_dic writes the children of a node in increasing phone_id order,
+ * so a binary search over child_begin..child_end is used instead of a
+ * linear scan.
+ *
+ * @return index of the child node, or -1 if no such child exists.
+ */
+static int TreeFindChild( const ChewingData *pgdata, int tree_p, uint16_t key )
 {
-	int child, tree_p, i;
+	const TreeType *tree = pgdata->static_data->tree;
+	int low, high, mid;
+	uint16_t phone_id;
 
-	tree_p = 0;
-	for ( i = begin; i <= end; i++ ) {
-		for ( 
-			child = pgdata->static_data.tree[ tree_p ].child_begin;
-			child != -1 && child <= pgdata->static_data.tree[ tree_p ].child_end;
-			child++ ) {
+	low = NodeChildBegin( &tree[ tree_p ] );
+	high = NodeChildEnd( &tree[ tree_p ] );
+	if ( low == -1 )
+		return -1;
 
 #ifdef USE_BINARY_DATA
-			assert(0 <= child && child * sizeof(TreeType) < pgdata->static_data.tree_size);
+	assert( 0 <= low && (size_t) high * sizeof(TreeType) < pgdata->static_data->tree_size );
 #endif
-			if ( pgdata->static_data.tree[ child ].phone_id == phoneSeq[ i ] )
-				break;
-		}
+	while ( low <= high ) {
+		mid = low + ( high - low ) / 2;
+		phone_id = NodePhoneId( &tree[ mid ] );
+		if ( phone_id == key )
+			return mid;
+		if ( phone_id < key )
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return -1;
+}
+
+/**
+ * @brief Reset the cursor to the root of the phone tree.
+ */
+void TreeCursorInit( ChewingData *pgdata, TreeCursor *pcur )
+{
+	pcur->node = 0;
+	pcur->depth = 0;
+	pcur->overlayLow = 0;
+	pcur->overlayHigh = pgdata->static_data->overlay ?
+		pgdata->static_data->overlay->nEntry : 0;
+}
+
+/**
+ * @brief Move the cursor to the child matching phone.
+ *
+ * Once the cursor reaches a dead end it stays there, so callers can keep
+ * advancing it without checking the result of every step.
+ *
+ * @return 0 if the extended prefix exists in the tree, -1 otherwise.
+ */
+int TreeCursorAdvance( ChewingData *pgdata, TreeCursor *pcur, uint16_t phone )
+{
+	if ( pcur->overlayLow < pcur->overlayHigh )
+		OverlayAdvance( pgdata, &pcur->overlayLow, &pcur->overlayHigh, pcur->depth, phone );
+	pcur->depth++;
+	if ( pcur->node != -1 ) {
+		pgdata->stats.nTreeNode++;
+		pcur->node = TreeFindChild( pgdata, pcur->node, phone );
+	}
+	return ( pcur->node == -1 && pcur->overlayLow == pcur->overlayHigh ) ? -1 : 0;
+}
+
+/**
+ * @return phrase id of the prefix under the cursor, or -1 if there is none.
+ * The overlay has the prefix replace the phrases of the tree.
+ */
+int TreeCursorPhraseId( ChewingData *pgdata, const TreeCursor *pcur )
+{
+	const OverlayEntry *entry;
+
+	if ( pcur->overlayLow < pcur->overlayHigh ) {
+		entry = OverlayExact( pgdata, pcur->overlayLow, pcur->overlayHigh, pcur->depth );
+		if ( entry )
+			return entry->begin < entry->end ? OVERLAY_PHRASE_ID(
+				entry - pgdata->static_data->overlay->entry ) : -1;
+	}
+	if ( pcur->node == -1 )
+		return -1;
+	return NodePhraseId( &pgdata->static_data->tree[ pcur->node ] );
+}
+
+int TreeFindPhrase( ChewingData *pgdata, int begin, int end, const uint16_t *phoneSeq )
+{
+	TreeCursor cur;
+	int i;
+
+	TreeCursorInit( pgdata, &cur );
+	for ( i = begin; i <= end; i++ ) {
 		/* if not found any word then fail. */
-		if ( child == -1 || child > pgdata->static_data.tree[ tree_p ].child_end )
+		if ( TreeCursorAdvance( pgdata, &cur, phoneSeq[ i ] ) == -1 )
 			return -1;
-		else {
-			tree_p = child;
-		}
 	}
-	return pgdata->static_data.tree[ tree_p ].phrase_id;
+	return TreeCursorPhraseId( pgdata, &cur );
+}
+
+/*
+ * Spans are looked up by FindInterval, again by SetAvailInfo when the
+ * user opens the candidate list, and once more by SetChoiceInfo.  Results
+ * are kept in a direct-mapped table indexed by a hash of the phones; a
+ * colliding span simply replaces the old slot.  The user phrase bit is
+ * refreshed once the user hash changes.
+ */
+#define SPAN_CACHE_SIZE 512	/* must be a power of 2 */
+
+struct tag_SpanCacheEntry {
+	uint16_t phoneSeq[ MAX_PHRASE_LEN ];
+	int len;	/* 0 for an unused slot */
+	unsigned int hashGeneration;	/* of info.bUserPhrase */
+	SpanInfo info;
+};
+
+static struct tag_SpanCacheEntry *SpanCacheSlot(
+		ChewingData *pgdata, const uint16_t phoneSeq[], int len )
+{
+	unsigned int h = 2166136261u;
+	int i;
+
+	if ( len > MAX_PHRASE_LEN )
+		return NULL;
+	if ( ! pgdata->spanCache.entry ) {
+		pgdata->spanCache.entry = ALC( struct tag_SpanCacheEntry, SPAN_CACHE_SIZE );
+		if ( ! pgdata->spanCache.entry )
+			return NULL;
+	}
+	for ( i = 0; i < len; i++ )
+		h = ( h ^ phoneSeq[ i ] ) * 16777619u;
+	return &pgdata->spanCache.entry[ h & ( SPAN_CACHE_SIZE - 1 ) ];
+}
+
+static int HasUserPhrase( ChewingData *pgdata, const uint16_t phoneSeq[], int len )
+{
+	uint16_t userPhoneSeq[ MAX_PHONE_SEQ_LEN + 1 ];
+	UserPhraseIter iter;
+	int bFound;
+
+	memcpy( userPhoneSeq, phoneSeq, sizeof( uint16_t ) * len );
+	userPhoneSeq[ len ] = 0;
+	HashReadBegin( pgdata );
+	bFound = UserGetPhraseFirst( pgdata, &iter, userPhoneSeq ) != NULL;
+	HashReadEnd( pgdata );
+	return bFound;
+}
+
+/**
+ * @brief Look up a span of phones in the span cache only.
+ *
+ * @return 1 and fill pinfo if the span is cached, 0 otherwise.
+ */
+int FindSpanInfo(
+		ChewingData *pgdata, const uint16_t phoneSeq[], int len,
+		SpanInfo *pinfo )
+{
+	struct tag_SpanCacheEntry *slot = SpanCacheSlot( pgdata, phoneSeq, len );
+
+	if ( ! slot || slot->len != len ||
+		memcmp( slot->phoneSeq, phoneSeq, sizeof( uint16_t ) * len ) )
+		return 0;
+	if ( slot->hashGeneration != HashGeneration( pgdata ) ) {
+		slot->info.bUserPhrase = HasUserPhrase( pgdata, phoneSeq, len );
+		slot->hashGeneration = HashGeneration( pgdata );
+	}
+	*pinfo = slot->info;
+	return 1;
+}
+
+/**
+ * @brief Resolve a span of phones whose phrase id is already known and
+ * put it into the span cache.
+ */
+void AddSpanInfo(
+		ChewingData *pgdata, const uint16_t phoneSeq[], int len, int pho_id,
+		SpanInfo *pinfo )
+{
+	struct tag_SpanCacheEntry *slot;
+
+	pinfo->pho_id = pho_id;
+	if ( pho_id != -1 )
+		GetPhraseFirst( pgdata, &pinfo->dictPhrase, pho_id );
+	pinfo->bUserPhrase = HasUserPhrase( pgdata, phoneSeq, len );
+
+	if ( ( slot = SpanCacheSlot( pgdata, phoneSeq, len ) ) ) {
+		memcpy( slot->phoneSeq, phoneSeq, sizeof( uint16_t ) * len );
+		slot->len = len;
+		slot->hashGeneration = HashGeneration( pgdata );
+		slot->info = *pinfo;
+	}
+}
+
+/**
+ * @brief Resolve a span of phones, through the span cache.
+ */
+void GetSpanInfo(
+		ChewingData *pgdata, const uint16_t phoneSeq[], int len,
+		SpanInfo *pinfo )
+{
+	if ( ! FindSpanInfo( pgdata, phoneSeq, len, pinfo ) )
+		AddSpanInfo( pgdata, phoneSeq, len,
+			TreeFindPhrase( pgdata, 0, len - 1, phoneSeq ), pinfo );
 }
 
 static void AddInterval(
@@ -339,43 +567,264 @@ typedef enum {
 	USED_PHRASE_DICT	/**< Dict phrase */
 } UsedPhraseMode;
 
-static void internal_release_Phrase( UsedPhraseMode mode, Phrase *pUser, Phrase *pDict )
+/*
+ * The intervals found by FindInterval are kept between Phrasing calls.  A
+ * keystroke usually changes the input at a single position, so the next
+ * call compares its input with the previous one and looks up only the
+ * spans touching a changed phone, breakpoint or selection.  Any change to
+ * the user phrases drops the whole cache.
+ */
+#define SPAN_LOOKUP -2	/* the span has to be looked up */
+#define SPAN_MISS -1	/* the span is known to have no phrase */
+
+struct tag_PhrasingCacheEntry {
+	int from, to, pho_id, source;
+	Phrase phr;
+};
+
+/* heap bytes of the temporaries and caches of Phrasing() */
+size_t PhrasingBytes( ChewingData *pgdata )
 {
-	/* we must free unused phrase entry to avoid memory leak. */
-	switch ( mode ) {
-		case USED_PHRASE_USER:
-			if ( pDict != NULL )
-				free( pDict );
-			break;
-		case USED_PHRASE_DICT:
-			if ( pUser != NULL )
-				free( pUser );
-			break;
-		default: /* In fact, it is alwyas 0 */
-			if ( pDict != NULL )
-				free( pDict );
-			if ( pUser != NULL )
-				free( pUser );
-			break;
+	return pgdata->phrasingArena.total +
+		pgdata->phrasingCache.nEntryAlloc * sizeof( struct tag_PhrasingCacheEntry ) +
+		( pgdata->spanCache.entry ? SPAN_CACHE_SIZE * sizeof( struct tag_SpanCacheEntry ) : 0 );
+}
+
+typedef struct {
+	int nPrefix;	/* phones kept at the front */
+	int nSuffix;	/* phones kept at the back */
+	int delta;	/* change of nPhoneSeq */
+} CacheMapping;
+
+/* Position of old position pos in the new input, or -1 if it was edited. */
+static int MapCachedPos( const PhrasingCache *pc, const CacheMapping *pm, int pos )
+{
+	if ( pos < pm->nPrefix )
+		return pos;
+	if ( pos >= pc->nPhoneSeq - pm->nSuffix )
+		return pos + pm->delta;
+	return -1;
+}
+
+/* Mark the positions of [from, to) that survived the edit as dirty. */
+static void MarkCachedDirty(
+		const PhrasingCache *pc, const CacheMapping *pm,
+		int from, int to, char dirty[] )
+{
+	int i, pos;
+
+	for ( i = from; i < to; i++ ) {
+		if ( ( pos = MapCachedPos( pc, pm, i ) ) != -1 )
+			dirty[ pos ] = 1;
 	}
 }
 
+/* Whether the cached input had selection str at new positions [from, to). */
+static int HasCachedSelection(
+		const PhrasingCache *pc, const CacheMapping *pm,
+		int from, int to, const char *str )
+{
+	int i;
+
+	for ( i = 0; i < pc->nSelect; i++ ) {
+		if ( MapCachedPos( pc, pm, pc->selectInterval[ i ].from ) == from &&
+			MapCachedPos( pc, pm, pc->selectInterval[ i ].to - 1 ) == to - 1 &&
+			pc->selectInterval[ i ].to - pc->selectInterval[ i ].from == to - from &&
+			! strcmp( pc->selectStr + pc->selectStrPos[ i ], str ) )
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Fill reuse[ begin ][ end ] with the index of the cached entry for the
+ * span, SPAN_MISS if the cache knows it has no phrase, or SPAN_LOOKUP.
+ */
+static void FindReusableSpans(
+		ChewingData *pgdata,
+		uint16_t *phoneSeq, int nPhoneSeq,
+		char selectStr[][ MAX_SELECT_STR_SIZE ],
+		IntervalType selectInterval[], int nSelect,
+		int bArrBrkpt[], short reuse[][ MAX_PHONE_SEQ_LEN ] )
+{
+	PhrasingCache *pc = &pgdata->phrasingCache;
+	CacheMapping map;
+	char dirty[ MAX_PHONE_SEQ_LEN + 1 ];
+	int nDirty[ MAX_PHONE_SEQ_LEN + 1 ];
+	int begin, end, i, j, mfrom, mto, nShort;
+
+	for ( begin = 0; begin < nPhoneSeq; begin++ ) {
+		for ( end = begin; end < nPhoneSeq; end++ )
+			reuse[ begin ][ end ] = SPAN_LOOKUP;
+	}
+	if ( ! pc->valid || pc->hashGeneration != HashGeneration( pgdata ) )
+		return;
+
+	/* the edit is what lies between the common prefix and suffix */
+	nShort = min( nPhoneSeq, pc->nPhoneSeq );
+	for ( map.nPrefix = 0;
+		map.nPrefix < nShort && phoneSeq[ map.nPrefix ] == pc->phoneSeq[ map.nPrefix ];
+		map.nPrefix++ )
+		;
+	for ( map.nSuffix = 0;
+		map.nPrefix + map.nSuffix < nShort &&
+			phoneSeq[ nPhoneSeq - map.nSuffix - 1 ] ==
+			pc->phoneSeq[ pc->nPhoneSeq - map.nSuffix - 1 ];
+		map.nSuffix++ )
+		;
+	map.delta = nPhoneSeq - pc->nPhoneSeq;
+
+	memset( dirty, 0, sizeof( dirty ) );
+	for ( i = map.nPrefix; i < nPhoneSeq - map.nSuffix; i++ )
+		dirty[ i ] = 1;
+
+	/* a changed breakpoint affects the spans across it */
+	for ( i = 1; i < pc->nPhoneSeq; i++ ) {
+		mfrom = MapCachedPos( pc, &map, i - 1 );
+		mto = MapCachedPos( pc, &map, i );
+		if ( mfrom == -1 || mto != mfrom + 1 )
+			continue;
+		if ( ! pc->bArrBrkpt[ i ] != ! bArrBrkpt[ mto ] )
+			dirty[ mfrom ] = dirty[ mto ] = 1;
+	}
+
+	/* a changed selection affects the spans intersecting it */
+	for ( i = 0; i < nSelect; i++ ) {
+		if ( ! HasCachedSelection( pc, &map,
+				selectInterval[ i ].from, selectInterval[ i ].to, selectStr[ i ] ) )
+			memset( &dirty[ selectInterval[ i ].from ], 1,
+				selectInterval[ i ].to - selectInterval[ i ].from );
+	}
+	for ( i = 0; i < pc->nSelect; i++ ) {
+		mfrom = MapCachedPos( pc, &map, pc->selectInterval[ i ].from );
+		for ( j = 0; j < nSelect; j++ ) {
+			if ( selectInterval[ j ].from == mfrom &&
+				HasCachedSelection( pc, &map,
+					selectInterval[ j ].from, selectInterval[ j ].to, selectStr[ j ] ) &&
+				! strcmp( selectStr[ j ], pc->selectStr + pc->selectStrPos[ i ] ) )
+				break;
+		}
+		if ( j == nSelect )
+			MarkCachedDirty( pc, &map,
+				pc->selectInterval[ i ].from, pc->selectInterval[ i ].to, dirty );
+	}
+
+	/* nDirty[ i ]: dirty positions before i */
+	nDirty[ 0 ] = 0;
+	for ( i = 0; i < nPhoneSeq; i++ )
+		nDirty[ i + 1 ] = nDirty[ i ] + dirty[ i ];
+
+	/* clean spans entirely in the kept front or back are known misses... */
+	for ( begin = 0; begin < nPhoneSeq; begin++ ) {
+		for ( end = begin; end < nPhoneSeq; end++ ) {
+			if ( nDirty[ end + 1 ] != nDirty[ begin ] )
+				continue;
+			if ( end < map.nPrefix || begin >= nPhoneSeq - map.nSuffix )
+				reuse[ begin ][ end ] = SPAN_MISS;
+		}
+	}
+	/* ...unless the previous call found a phrase there */
+	for ( i = 0; i < pc->nEntry; i++ ) {
+		mfrom = MapCachedPos( pc, &map, pc->entry[ i ].from );
+		mto = MapCachedPos( pc, &map, pc->entry[ i ].to - 1 );
+		if ( mfrom == -1 || mto == -1 ||
+			mto - mfrom != pc->entry[ i ].to - pc->entry[ i ].from - 1 )
+			continue;
+		if ( reuse[ mfrom ][ mto ] == SPAN_MISS )
+			reuse[ mfrom ][ mto ] = i;
+	}
+}
+
+/* Remember the input and the intervals of this call for the next one. */
+static void SavePhrasingCache(
+		ChewingData *pgdata,
+		uint16_t *phoneSeq, int nPhoneSeq,
+		char selectStr[][ MAX_SELECT_STR_SIZE ],
+		IntervalType selectInterval[], int nSelect,
+		int bArrBrkpt[], TreeDataType *ptd )
+{
+	PhrasingCache *pc = &pgdata->phrasingCache;
+	struct tag_PhrasingCacheEntry *entry;
+	int i, pos, len;
+
+	pc->valid = 0;
+	if ( ptd->nInterval > pc->nEntryAlloc ) {
+		entry = realloc( pc->entry, ptd->nInterval * sizeof( *entry ) );
+		if ( ! entry )
+			return;
+		pc->entry = entry;
+		pc->nEntryAlloc = ptd->nInterval;
+	}
+
+	for ( i = 0, pos = 0; i < nSelect; i++ ) {
+		len = strlen( selectStr[ i ] ) + 1;
+		if ( pos + len > (int) sizeof( pc->selectStr ) )
+			return;
+		memcpy( pc->selectStr + pos, selectStr[ i ], len );
+		pc->selectStrPos[ i ] = pos;
+		pos += len;
+	}
+	memcpy( pc->selectInterval, selectInterval, nSelect * sizeof( IntervalType ) );
+	pc->nSelect = nSelect;
+
+	for ( i = 0; i < ptd->nInterval; i++ ) {
+		pc->entry[ i ].from = ptd->interval[ i ].from;
+		pc->entry[ i ].to = ptd->interval[ i ].to;
+		pc->entry[ i ].pho_id = ptd->interval[ i ].pho_id;
+		pc->entry[ i ].source = ptd->interval[ i ].source;
+		pc->entry[ i ].phr = *ptd->interval[ i ].p_phr;
+	}
+	pc->nEntry = ptd->nInterval;
+
+	memcpy( pc->phoneSeq, phoneSeq, nPhoneSeq * sizeof( uint16_t ) );
+	pc->nPhoneSeq = nPhoneSeq;
+	memcpy( pc->bArrBrkpt, bArrBrkpt, sizeof( pc->bArrBrkpt ) );
+	pc->hashGeneration = HashGeneration( pgdata );
+	pc->valid = 1;
+}
+
 static void FindInterval(
 		ChewingData *pgdata,
 		uint16_t *phoneSeq, int nPhoneSeq,
-		char selectStr[][ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ], 
+		char selectStr[][ MAX_SELECT_STR_SIZE ], 
 		IntervalType selectInterval[], int nSelect, 
 		int bArrBrkpt[], TreeDataType *ptd )
 {
-	int end, begin, pho_id;
+	int end, begin, pho_id, cur_end;
+	TreeCursor cur;
 	Phrase *p_phrase, *puserphrase, *pdictphrase;
 	UsedPhraseMode i_used_phrase;
-	uint16_t new_phoneSeq[ MAX_PHONE_SEQ_LEN ];
+	/* a span of the whole sequence and its terminator */
+	uint16_t new_phoneSeq[ MAX_PHONE_SEQ_LEN + 1 ];
+	short reuse[ MAX_PHONE_SEQ_LEN ][ MAX_PHONE_SEQ_LEN ];
+	struct tag_PhrasingCacheEntry *entry;
+	SpanInfo info;
+	SelectIndex sel;
+
+	InitSelectIndex( &sel, selectStr, selectInterval, nSelect );
+	FindReusableSpans(
+		pgdata, phoneSeq, nPhoneSeq, selectStr, selectInterval, nSelect,
+		bArrBrkpt, reuse );
 
 	for ( begin = 0; begin < nPhoneSeq; begin++ ) {
+		TreeCursorInit( pgdata, &cur );
+		cur_end = begin - 1;
 		for ( end = begin; end < nPhoneSeq; end++ ) {
+			/* a breakpoint inside this span also splits every longer one */
 			if ( ! CheckBreakpoint( begin, end + 1, bArrBrkpt ) )
+				break;
+
+			if ( reuse[ begin ][ end ] == SPAN_MISS )
+				continue;
+			if ( reuse[ begin ][ end ] != SPAN_LOOKUP ) {
+				entry = &pgdata->phrasingCache.entry[ reuse[ begin ][ end ] ];
+				p_phrase = ARENA_ALC( ptd->arena, Phrase, 1 );
+				assert( p_phrase );
+				*p_phrase = entry->phr;
+				AddInterval( ptd, begin, end, entry->pho_id, p_phrase,
+						entry->source );
 				continue;
+			}
 
 			/* set new_phoneSeq */
 			memcpy( 
@@ -386,22 +835,28 @@ static void FindInterval(
 			puserphrase = pdictphrase = NULL;
 			i_used_phrase = USED_PHRASE_NONE;
 
+			if ( ! FindSpanInfo( pgdata, &phoneSeq[ begin ], end - begin + 1, &info ) ) {
+				while ( cur_end < end )
+					TreeCursorAdvance( pgdata, &cur, phoneSeq[ ++cur_end ] );
+				AddSpanInfo( pgdata, &phoneSeq[ begin ], end - begin + 1,
+					TreeCursorPhraseId( pgdata, &cur ), &info );
+			}
+			pho_id = info.pho_id;
+
 			/* check user phrase */
-			if ( UserGetPhraseFirst( pgdata, new_phoneSeq ) &&
+			if ( info.bUserPhrase &&
 					CheckUserChoose( pgdata, new_phoneSeq, begin, end + 1,
-					&p_phrase, selectStr, selectInterval, nSelect ) ) {
+					&p_phrase, &sel ) ) {
 				puserphrase = p_phrase;
 			}
 
 			/* check dict phrase */
-			pho_id = TreeFindPhrase( pgdata, begin, end, phoneSeq );
 			if ( 
 				( pho_id != -1 ) && 
 				CheckChoose( 
 					pgdata,
-					pho_id, begin, end + 1, 
-					&p_phrase, selectStr, 
-					selectInterval, nSelect ) ) {
+					&info, begin, end + 1, 
+					&p_phrase, &sel ) ) {
 				pdictphrase = p_phrase;
 			}
 
@@ -444,29 +899,32 @@ static void FindInterval(
 				default:
 					break;
 			}
-			internal_release_Phrase(
-				i_used_phrase,
-				puserphrase,
-				pdictphrase );
 		}
 	}
+
+	SavePhrasingCache(
+		pgdata, phoneSeq, nPhoneSeq, selectStr, selectInterval, nSelect,
+		bArrBrkpt, ptd );
 }
 
 static void SetInfo( int len, TreeDataType *ptd )
 {
 	int i, a;
+	PositionSet adjacent;
 
-	for ( i = 0; i <= len; i++ )
+	for ( i = 0; i <= len; i++ ) {
 		ptd->leftmost[ i ] = i;
+		ptd->graph[ i ] = 0;
+	}
 	for ( i = 0; i < ptd->nInterval; i++ ) {
-		ptd->graph[ ptd->interval[ i ].from ][ ptd->interval[ i ].to ] = 1;
-		ptd->graph[ ptd->interval[ i ].to ][ ptd->interval[ i ].from ] = 1;
+		ptd->graph[ ptd->interval[ i ].from ] |= (PositionSet) 1 << ptd->interval[ i ].to;
+		ptd->graph[ ptd->interval[ i ].to ] |= (PositionSet) 1 << ptd->interval[ i ].from;
 	}
 
 	/* set leftmost */
 	for ( a = 0; a <= len; a++ ) {
-		for ( i = 0; i <= len; i++ ) {
-			if ( ! ( ptd->graph[ a ][ i ] ) )
+		for ( adjacent = ptd->graph[ a ], i = 0; adjacent; adjacent >>= 1, i++ ) {
+			if ( ! ( adjacent & 1 ) )
 				continue;
 			if ( ptd->leftmost[ i ] < ptd->leftmost[ a ] )
 				ptd->leftmost[ a ] = ptd->leftmost[ i ];
@@ -508,44 +966,48 @@ static int CompRecord( const RecordNode **pa, const RecordNode **pb )
 }
 
 
+/*
+ * An interval b overlaps interval a without lying inside it exactly when b
+ * crosses one of the two boundaries of a, that is, b covers both sides of
+ * it.  nCross[ k ] counts the remaining intervals crossing boundary k.
+ */
+static void CountCross( const PhraseIntervalType *pin, int nCross[], int delta )
+{
+	int k;
+
+	for ( k = pin->from + 1; k < pin->to; k++ )
+		nCross[ k ] += delta;
+}
+
 static void Discard1( TreeDataType *ptd )
 {
-	int a, b;
+	int a, i;
 	char failflag[ INTERVAL_SIZE ];
+	int nCross[ MAX_PHONE_SEQ_LEN + 1 ];
+	PositionSet span;
 	int nInterval2;
 
 	memset( failflag, 0, sizeof( failflag ) );
+	memset( nCross, 0, sizeof( nCross ) );
+	for ( i = 0; i < ptd->nInterval; i++ )
+		CountCross( &ptd->interval[ i ], nCross, 1 );
+
 	for ( a = 0; a < ptd->nInterval; a++ ) {
 		if ( failflag[ a ] ) 
 			continue;
-		for ( b = 0; b < ptd->nInterval; b++ ) {
-			if ( a == b || failflag[ b ] )
-				continue ;
-			if ( ptd->interval[ b ].from >= ptd->interval[ a ].from && 
-				ptd->interval[ b ].to <= ptd->interval[ a ].to )
-				continue;
-			if ( ptd->interval[ b ].from <= ptd->interval[ a ].from && 
-				ptd->interval[ b ].to <= ptd->interval[ a ].from )
-				continue;
-			if ( ptd->interval[ b ].from >= ptd->interval[ a ].to && 
-				ptd->interval[ b ].to >= ptd->interval[ a ].to )
-				continue;
-			break;
-		}
 		/* if any other interval b is inside or leftside or rightside the 
 		 * interval a */
-		if ( b >= ptd->nInterval ) {
-			/* then kill all the intervals inside the interval a */
-			int i;
-			for ( i = 0; i < ptd->nInterval; i++ )  {
-				if ( 
-					! failflag[ i ] && i != a &&
-					ptd->interval[ i ].from >= 
-						ptd->interval[ a ].from && 
-					ptd->interval[ i ].to <= ptd->interval[ a ].to ) {
-					failflag[ i ] = 1;
-				}
-			}
+		if ( nCross[ ptd->interval[ a ].from ] || nCross[ ptd->interval[ a ].to ] )
+			continue;
+		/* then kill all the intervals inside the interval a */
+		span = SpanSet( ptd->interval[ a ].from, ptd->interval[ a ].to );
+		for ( i = 0; i < ptd->nInterval; i++ )  {
+			if ( failflag[ i ] || i == a )
+				continue;
+			if ( SpanSet( ptd->interval[ i ].from, ptd->interval[ i ].to ) & ~span )
+				continue;
+			failflag[ i ] = 1;
+			CountCross( &ptd->interval[ i ], nCross, -1 );
 		}
 	}
 	/* discard all the intervals whose failflag[a] = 1 */
@@ -554,90 +1016,89 @@ static void Discard1( TreeDataType *ptd )
 		if ( ! failflag[ a ] ) {
 			ptd->interval[ nInterval2++ ] = ptd->interval[ a ];
 		}
-		else {
-			if ( ptd->interval[ a ].p_phr != NULL ) {
-				free( ptd->interval[ a ].p_phr );
-			}
-		}
 	}
 	ptd->nInterval = nInterval2;
 }
 
 static void Discard2( TreeDataType *ptd )
 {
-	int i, j;
-	char overwrite[ MAX_PHONE_SEQ_LEN ], failflag[ MAX_PHONE_SEQ_LEN ];
+	int i;
+	PositionSet covered, overwrite, span;
 	int nInterval2;
 
-	memset( failflag, 0, sizeof( failflag ) );
+	/* positions covered by at least one and by at least two intervals */
+	covered = overwrite = 0;
 	for ( i = 0; i < ptd->nInterval; i++ ) {
-		if ( ptd->leftmost[ ptd->interval[ i ].from ] == 0 )
-			continue;
-		/* test if interval i is overwrited by other intervals */
-		memset( overwrite, 0, sizeof( overwrite ) );
-		for ( j = 0; j < ptd->nInterval; j++ ) {
-			if ( j == i )
-				continue;
-			memset( 
-				&overwrite[ ptd->interval[ j ].from ],
-				1, 
-				ptd->interval[ j ].to - ptd->interval[ j ].from );
-		}
-		if ( memchr( 
-			&overwrite[ ptd->interval[ i ].from ],
-			1,	
-			ptd->interval[ i ].to - ptd->interval[ i ].from ) )
-			failflag[ i ] = 1;
+		span = SpanSet( ptd->interval[ i ].from, ptd->interval[ i ].to );
+		overwrite |= covered & span;
+		covered |= span;
 	}
-	/* discard all the intervals whose failflag[a] = 1 */
+
+	/* discard the intervals overwrited by other intervals */
 	nInterval2 = 0;
-	for ( i = 0; i < ptd->nInterval; i++ )
-		if ( ! failflag[ i ] )
-			ptd->interval[ nInterval2++ ] = ptd->interval[ i ];
+	for ( i = 0; i < ptd->nInterval; i++ ) {
+		span = SpanSet( ptd->interval[ i ].from, ptd->interval[ i ].to );
+		if ( ptd->leftmost[ ptd->interval[ i ].from ] != 0 && ( span & overwrite ) )
+			continue;
+		ptd->interval[ nInterval2++ ] = ptd->interval[ i ];
+	}
 	ptd->nInterval = nInterval2;
 }
 
-static void LoadChar( ChewingData *pgdata, char *buf, int buf_len, uint16_t phoneSeq[], int nPhoneSeq )
+/* point src[ from .. to - 1 ] at the characters of str */
+static void SetCharSource( const char *src[], int from, int to, const char *str )
 {
 	int i;
-	Word word;
 
-	memset(buf, 0, buf_len);
-	for ( i = 0; i < nPhoneSeq; i++ ) {
-		GetCharFirst( pgdata, &word, phoneSeq[ i ] );
-		strncat(buf, word.word, buf_len - strlen(buf) - 1);
+	for ( i = from; i < to && *str; i++ ) {
+		src[ i ] = str;
+		str += ueBytesFromChar( (unsigned char) *str );
 	}
-	buf[ buf_len - 1 ] = '\0';
 }
 
-/* kpchen said, record is the index array of interval */
+/*
+ * kpchen said, record is the index array of interval
+ *
+ * Every phone takes its character from the last of its first character,
+ * the phrase of record over it and the selection over it. The sentence is
+ * then written once from the left, and its characters indexed in
+ * ppo->chiPos as it goes, so that nothing seeks in it from the start.
+ */
 static void OutputRecordStr(
-		ChewingData *pgdata,
-		char *out_buf, int out_buf_len,
+		ChewingData *pgdata, PhrasingOutput *ppo,
 		int *record, int nRecord, 
 		uint16_t phoneSeq[], int nPhoneSeq,
-		char selectStr[][ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ], 
+		char selectStr[][ MAX_SELECT_STR_SIZE ], 
 		IntervalType selectInterval[],
 		int nSelect, TreeDataType *ptd )
 {
+	Word word[ MAX_PHONE_SEQ_LEN ];
+	const char *src[ MAX_PHONE_SEQ_LEN ];
 	PhraseIntervalType inter;
-	int i;
+	int i, pos = 0, bytes;
 
-	LoadChar( pgdata, out_buf, out_buf_len, phoneSeq, nPhoneSeq );
+	for ( i = 0; i < nPhoneSeq; i++ ) {
+		if ( ! GetCharFirst( pgdata, &word[ i ], phoneSeq[ i ] ) )
+			word[ i ].word[ 0 ] = '\0';
+		src[ i ] = word[ i ].word;
+	}
 	for ( i = 0; i < nRecord; i++ ) {
 		inter = ptd->interval[ record[ i ] ];
-		ueStrNCpy(
-				ueStrSeek( out_buf, inter.from ),
-				( inter.p_phr )->phrase,
-				( inter.to - inter.from ), -1);
+		SetCharSource( src, inter.from, inter.to, ( inter.p_phr )->phrase );
 	}
 	for ( i = 0; i < nSelect; i++ ) {
-		inter.from = selectInterval[ i ].from;
-		inter.to = selectInterval[ i ].to ;
-		ueStrNCpy(
-				ueStrSeek( out_buf, inter.from ),
-				selectStr[ i ], ( inter.to - inter.from ), -1);
+		SetCharSource( src, selectInterval[ i ].from, selectInterval[ i ].to,
+			selectStr[ i ] );
+	}
+
+	for ( i = 0; i < nPhoneSeq; i++ ) {
+		ppo->chiPos[ i ] = pos;
+		bytes = *src[ i ] ? ueBytesFromChar( (unsigned char) *src[ i ] ) : 0;
+		memcpy( ppo->chiBuf + pos, src[ i ], bytes );
+		pos += bytes;
 	}
+	ppo->chiPos[ nPhoneSeq ] = pos;
+	ppo->chiBuf[ pos ] = '\0';
 }
 
 static int rule_largest_sum( int *record, int nRecord, TreeDataType *ptd )
@@ -730,9 +1191,14 @@ static int IsRecContain( int *intA, int nA, int *intB, int nB, TreeDataType *ptd
 	return 1;
 }
 
-static void SortListByScore( TreeDataType *ptd )
+/*
+ * Only the first nWanted records are used by NextCut, and usually nWanted
+ * is 1, as Tab has not been pressed.  Then the best record is just moved
+ * to the front instead of sorting the list.
+ */
+static void SortListByScore( TreeDataType *ptd, int nWanted )
 {
-	int i, listLen;
+	int i, best, listLen;
 	RecordNode *p, **arr;
 
 	for ( 
@@ -742,7 +1208,7 @@ static void SortListByScore( TreeDataType *ptd )
 		;
 	ptd->nPhListLen = listLen;
 
-	arr = ALC( RecordNode *, listLen );
+	arr = ARENA_ALC( ptd->arena, RecordNode *, listLen );
 	assert( arr );
 
 	for ( 
@@ -756,15 +1222,26 @@ static void SortListByScore( TreeDataType *ptd )
 			ptd );
 	}
 
-	qsort( arr, listLen, sizeof( RecordNode * ), (CompFuncType) CompRecord );
+	if ( nWanted == 1 ) {
+		/* the first of the best ones, as a stable sort would give */
+		for ( best = 0, i = 1; i < listLen; i++ ) {
+			if ( CompRecord(
+				(const RecordNode **) &arr[ i ],
+				(const RecordNode **) &arr[ best ] ) < 0 )
+				best = i;
+		}
+		p = arr[ best ];
+		memmove( &arr[ 1 ], &arr[ 0 ], sizeof( RecordNode * ) * best );
+		arr[ 0 ] = p;
+	}
+	else
+		qsort( arr, listLen, sizeof( RecordNode * ), (CompFuncType) CompRecord );
 
 	ptd->phList = arr[ 0 ];
 	for ( i = 1; i < listLen; i++ ) {
 		arr[ i - 1 ]->next = arr[ i ];
 	}
 	arr[ listLen - 1 ]->next = NULL;
-
-	free( arr );
 }
 
 /* when record==NULL then output the "link list" */
@@ -781,23 +1258,19 @@ static void SaveRecord( int *record, int nInter, TreeDataType *ptd )
 		/* if 'record' contains 'p', then discard 'p' 
 		 * -- We must deal with the linked list. */
 		if ( IsRecContain( record, nInter, p->arrIndex, p->nInter, ptd ) ) {
-			RecordNode *tp = p;
-
 			if ( pre ) 
 				pre->next = p->next;
 			else
 				ptd->phList = ptd->phList->next;
 			p = p->next;
-			free( tp->arrIndex );			
-			free( tp );
 		}
 		else 
 			pre = p, p = p->next;
 	}
-	now = ALC( RecordNode, 1 );
+	now = ARENA_ALC( ptd->arena, RecordNode, 1 );
 	assert( now );
 	now->next = ptd->phList;
-	now->arrIndex = ALC( int, nInter );
+	now->arrIndex = ARENA_ALC( ptd->arena, int, nInter );
 	assert( now->arrIndex );
 	now->nInter = nInter;
 	memcpy( now->arrIndex, record, nInter * sizeof( int ) );	
@@ -839,9 +1312,24 @@ static void SaveList( TreeDataType *ptd )
 	RecursiveSave( 1, 0, record, ptd );	
 }
 
-static void InitPhrasing( TreeDataType *ptd ) 
+static void InitPhrasing( ChewingData *pgdata, TreeDataType *ptd )
 {
-	memset( ptd, 0, sizeof( TreeDataType ) );
+	/* interval[], graph[] and leftmost[] are filled before being read */
+	ptd->nInterval = 0;
+	ptd->phList = NULL;
+	ptd->nPhListLen = 0;
+	/* nothing from the previous call is referenced any more */
+	ResetArena( &pgdata->phrasingArena );
+	ptd->arena = &pgdata->phrasingArena;
+}
+
+void TerminatePhrasing( ChewingData *pgdata )
+{
+	free( pgdata->phrasingCache.entry );
+	memset( &pgdata->phrasingCache, 0, sizeof( PhrasingCache ) );
+	free( pgdata->spanCache.entry );
+	pgdata->spanCache.entry = NULL;
+	TerminateArena( &pgdata->phrasingArena );
 }
 
 static void SaveDispInterval( PhrasingOutput *ppo, TreeDataType *ptd )
@@ -857,25 +1345,6 @@ static void SaveDispInterval( PhrasingOutput *ppo, TreeDataType *ptd )
 	ppo->nDispInterval = ptd->phList->nInter;
 }
 
-static void CleanUpMem( TreeDataType *ptd )
-{
-	int i;
-	RecordNode *pNode;
-
-	for ( i = 0; i < ptd->nInterval; i++ ) {
-		if ( ptd->interval[ i ].p_phr ) {
-			free( ptd->interval[ i ].p_phr );
-			ptd->interval[ i ].p_phr = NULL;
-		}
-	}
-	while ( ptd->phList != NULL ) {
-		pNode = ptd->phList;
-		ptd->phList = pNode->next;
-		free( pNode->arrIndex );
-		free( pNode );
-	}
-}
-
 static void CountMatchCnnct( TreeDataType *ptd, int *bUserArrCnnct, int nPhoneSeq )
 {
 	RecordNode *p;
@@ -956,27 +1425,444 @@ static RecordNode* NextCut( TreeDataType *tdt, PhrasingOutput *ppo )
 	return tdt->phList;
 }
 
+/*
+ * Dynamic-programming phrasing engine.
+ *
+ * The records built by RecursiveSave are the paths of a DAG over phone
+ * positions: at position p a record continues with the first interval
+ * starting at or after p, or with any interval right after it that
+ * intersects it, and it ends where no interval is left.  Apart from the
+ * frequency sum, every rule of LoadPhraseAndCountScore depends only on
+ * the lengths of the intervals, while nMatchCnnct and the frequency sum
+ * are additive along a path.  A single forward pass keeping the
+ * DP_KBEST best partial paths for every (position, length histogram)
+ * pair therefore finds the best records without enumerating all of them.
+ */
+#define DP_KBEST 4
+#define DP_MAX_RESULT 8
+
+typedef struct {
+	int parent;		/* previous node of the path, -1 for the empty path */
+	int inter;		/* last interval of the path, -1 for the empty path */
+	int nMatchCnnct;
+	int freqsum;
+} DPNode;
+
+typedef struct {
+	/* hist[ l ] is the number of intervals of length l on the path */
+	unsigned char hist[ MAX_PHONE_SEQ_LEN + 1 ];
+	int nNode;
+	int node[ DP_KBEST ];	/* best first */
+} DPState;
+
+typedef struct {
+	DPState *state;
+	int nState, nAlloc;
+} DPColumn;
+
+typedef struct {
+	int *record;	/* indexes of the intervals, from left to right */
+	int nRecord, score, nMatchCnnct;
+} DPCandidate;
+
+typedef struct {
+	TreeDataType *ptd;
+	/* first[ p ]: first interval starting at or after p, -1 if none */
+	int first[ MAX_PHONE_SEQ_LEN + 1 ];
+	DPColumn column[ MAX_PHONE_SEQ_LEN + 1 ];
+	DPNode *node;
+	int nNode, nNodeAlloc;
+} DPData;
+
+static void *DPGrow( Arena *pa, void *buf, int *nAlloc, int need, size_t size )
+{
+	void *grown;
+	int n;
+
+	if ( need <= *nAlloc )
+		return buf;
+	for ( n = ( *nAlloc ? *nAlloc * 2 : 16 ); n < need; n *= 2 )
+		;
+	grown = ArenaAlloc( pa, n * size );
+	assert( grown );
+	if ( buf )
+		memcpy( grown, buf, *nAlloc * size );
+	*nAlloc = n;
+	return grown;
+}
+
+/* Store the intervals of the path ending at node into record. */
+static int DPPathToRecord( const DPData *dp, int node, int *record )
+{
+	int i, k, n = 0;
+
+	for ( i = node; dp->node[ i ].inter != -1; i = dp->node[ i ].parent )
+		n++;
+	for ( k = n, i = node; k > 0; i = dp->node[ i ].parent )
+		record[ --k ] = dp->node[ i ].inter;
+	return n;
+}
+
+/*
+ * Ties are broken the way the enumerating engine breaks them: SaveRecord
+ * prepends records in increasing lexicographic order of their interval
+ * indexes, so the greatest one comes first after sorting.
+ */
+static int DPCompareRecord( const int *ra, int na, const int *rb, int nb )
+{
+	int i;
+
+	for ( i = 0; i < na && i < nb; i++ ) {
+		if ( ra[ i ] != rb[ i ] )
+			return ra[ i ] - rb[ i ];
+	}
+	return na - nb;
+}
+
+static int DPIsBetter( const DPData *dp, const DPNode *a, int b )
+{
+	int ra[ MAX_PHONE_SEQ_LEN ], rb[ MAX_PHONE_SEQ_LEN ];
+	int na, nb;
+
+	if ( a->nMatchCnnct != dp->node[ b ].nMatchCnnct )
+		return a->nMatchCnnct > dp->node[ b ].nMatchCnnct;
+	if ( a->freqsum != dp->node[ b ].freqsum )
+		return a->freqsum > dp->node[ b ].freqsum;
+
+	na = ( a->parent == -1 ) ? 0 : DPPathToRecord( dp, a->parent, ra );
+	ra[ na++ ] = a->inter;
+	nb = DPPathToRecord( dp, b, rb );
+	return DPCompareRecord( ra, na, rb, nb ) > 0;
+}
+
+/* Offer a path ending at pos to the state holding its length histogram. */
+static void DPOffer(
+		DPData *dp, int pos, const unsigned char *hist,
+		int parent, int inter, int nMatchCnnct, int freqsum )
+{
+	DPColumn *col = &dp->column[ pos ];
+	DPState *state;
+	DPNode cand;
+	int i, k;
+
+	for ( i = 0; i < col->nState; i++ ) {
+		if ( ! memcmp( col->state[ i ].hist, hist, sizeof( col->state[ i ].hist ) ) )
+			break;
+	}
+	if ( i == col->nState ) {
+		col->state = DPGrow( dp->ptd->arena, col->state, &col->nAlloc,
+			col->nState + 1, sizeof( DPState ) );
+		memcpy( col->state[ i ].hist, hist, sizeof( col->state[ i ].hist ) );
+		col->state[ i ].nNode = 0;
+		col->nState++;
+	}
+	state = &col->state[ i ];
+
+	cand.parent = parent;
+	cand.inter = inter;
+	cand.nMatchCnnct = nMatchCnnct;
+	cand.freqsum = freqsum;
+	for ( k = 0; k < state->nNode; k++ ) {
+		if ( DPIsBetter( dp, &cand, state->node[ k ] ) )
+			break;
+	}
+	if ( k == DP_KBEST )
+		return;
+
+	dp->node = DPGrow( dp->ptd->arena, dp->node, &dp->nNodeAlloc,
+		dp->nNode + 1, sizeof( DPNode ) );
+	dp->node[ dp->nNode ] = cand;
+
+	if ( state->nNode < DP_KBEST )
+		state->nNode++;
+	memmove( &state->node[ k + 1 ], &state->node[ k ],
+		( state->nNode - k - 1 ) * sizeof( int ) );
+	state->node[ k ] = dp->nNode++;
+}
+
+/* Same rules and weights as LoadPhraseAndCountScore, from a histogram. */
+static int DPCountScore( const unsigned char *hist, int freqsum )
+{
+	int l, m, n = 0, sum = 0, variance = 0;
+
+	for ( l = 1; l <= MAX_PHONE_SEQ_LEN; l++ ) {
+		n += hist[ l ];
+		sum += l * hist[ l ];
+		for ( m = l + 1; m <= MAX_PHONE_SEQ_LEN; m++ )
+			variance += hist[ l ] * hist[ m ] * ( m - l );
+	}
+	if ( n == 0 )
+		return 0;
+	return 1000 * sum + 1000 * ( 6 * sum / n ) - 100 * variance + freqsum;
+}
+
+static int CompDPCandidate( const DPCandidate *pa, const DPCandidate *pb )
+{
+	int diff = pb->nMatchCnnct - pa->nMatchCnnct;
+
+	if ( diff )
+		return diff;
+	if ( pb->score != pa->score )
+		return ( pb->score - pa->score );
+	return DPCompareRecord( pb->record, pb->nRecord, pa->record, pa->nRecord );
+}
+
+typedef struct {
+	DPData *dp;
+	const int *record;
+	int nRecord;
+	char visited[ MAX_PHONE_SEQ_LEN + 1 ][ MAX_PHONE_SEQ_LEN + 1 ][ 2 ];
+} DPDominance;
+
+/*
+ * Search for a path other than the record that contains it in the sense of
+ * IsRecContain, from position pos with the first j intervals of the
+ * record already covered.
+ */
+static int DPFindContainer( DPDominance *pdm, int pos, int j, int differs )
+{
+	TreeDataType *ptd = pdm->dp->ptd;
+	int first = pdm->dp->first[ pos ];
+	int i, k;
+
+	if ( pdm->visited[ pos ][ j ][ differs ] )
+		return 0;
+	pdm->visited[ pos ][ j ][ differs ] = 1;
+
+	if ( first == -1 )
+		return ( j == pdm->nRecord && differs );
+
+	for (
+		i = first;
+		i < ptd->nInterval &&
+			( i == first || PhraseIntervalIntersect(
+				ptd->interval[ first ], ptd->interval[ i ] ) );
+		i++ ) {
+		/* the next interval of the record can no longer be covered */
+		if ( j < pdm->nRecord &&
+			ptd->interval[ i ].from >= ptd->interval[ pdm->record[ j ] ].to )
+			continue;
+		for (
+			k = j;
+			k < pdm->nRecord && PhraseIntervalContain(
+				ptd->interval[ i ], ptd->interval[ pdm->record[ k ] ] );
+			k++ )
+			;
+		if ( DPFindContainer(
+			pdm, ptd->interval[ i ].to, k,
+			differs || j >= pdm->nRecord || pdm->record[ j ] != i ) )
+			return 1;
+	}
+	return 0;
+}
+
+/* SaveRecord keeps only the records not contained in another one. */
+static int DPIsDominated( DPData *dp, const int *record, int nRecord )
+{
+	DPDominance dm;
+
+	memset( &dm, 0, sizeof( dm ) );
+	dm.dp = dp;
+	dm.record = record;
+	dm.nRecord = nRecord;
+	return DPFindContainer( &dm, 0, 0, 0 );
+}
+
+static RecordNode *DPMakeRecord( DPData *dp, const DPCandidate *pc, int bCheckDominated )
+{
+	RecordNode *now;
+
+	if ( bCheckDominated && DPIsDominated( dp, pc->record, pc->nRecord ) )
+		return NULL;
+
+	now = ARENA_ALC( dp->ptd->arena, RecordNode, 1 );
+	assert( now );
+	now->arrIndex = pc->record;
+	now->nInter = pc->nRecord;
+	now->score = pc->score;
+	now->nMatchCnnct = pc->nMatchCnnct;
+	return now;
+}
+
+/*
+ * Replacement for SaveList, CountMatchCnnct and SortListByScore: fill
+ * ptd->phList with the best nWanted records, at most DP_MAX_RESULT.  The
+ * candidates are kept in a heap, so only the records NextCut can reach
+ * are checked and built.
+ */
+static void DPSiftDown( DPCandidate *cand, int nCand, int i )
+{
+	DPCandidate tmp;
+	int child;
+
+	for ( ; ( child = 2 * i + 1 ) < nCand; i = child ) {
+		if ( child + 1 < nCand &&
+			CompDPCandidate( &cand[ child + 1 ], &cand[ child ] ) < 0 )
+			child++;
+		if ( CompDPCandidate( &cand[ child ], &cand[ i ] ) >= 0 )
+			break;
+		tmp = cand[ i ];
+		cand[ i ] = cand[ child ];
+		cand[ child ] = tmp;
+	}
+}
+
+static void DPSaveList(
+		TreeDataType *ptd, int *bUserArrCnnct, int nPhoneSeq, int nWanted )
+{
+	DPData dp;
+	DPColumn *col;
+	DPCandidate *cand = NULL;
+	DPCandidate next, best;
+	RecordNode *now, **tail;
+	unsigned char hist[ MAX_PHONE_SEQ_LEN + 1 ];
+	int pos, i, j, k, s, len, cnnct, freq;
+	int nCand = 0, nCandAlloc = 0;
+
+	memset( &dp, 0, sizeof( dp ) );
+	dp.ptd = ptd;
+	for ( i = 0, pos = 0; pos <= nPhoneSeq; pos++ ) {
+		while ( i < ptd->nInterval && ptd->interval[ i ].from < pos )
+			i++;
+		dp.first[ pos ] = ( i < ptd->nInterval ) ? i : -1;
+	}
+
+	memset( hist, 0, sizeof( hist ) );
+	DPOffer( &dp, 0, hist, -1, -1, 0, 0 );
+
+	for ( pos = 0; pos <= nPhoneSeq; pos++ ) {
+		col = &dp.column[ pos ];
+		if ( dp.first[ pos ] == -1 ) {
+			/* no interval left: every path reaching here is a record */
+			for ( s = 0; s < col->nState; s++ ) {
+				cand = DPGrow( ptd->arena, cand, &nCandAlloc,
+					nCand + col->state[ s ].nNode, sizeof( DPCandidate ) );
+				for ( k = 0; k < col->state[ s ].nNode; k++ ) {
+					DPNode *node = &dp.node[ col->state[ s ].node[ k ] ];
+
+					cand[ nCand ].record = ARENA_ALC( ptd->arena, int, MAX_PHONE_SEQ_LEN );
+					assert( cand[ nCand ].record );
+					cand[ nCand ].nRecord = DPPathToRecord(
+						&dp, col->state[ s ].node[ k ], cand[ nCand ].record );
+					cand[ nCand ].nMatchCnnct = node->nMatchCnnct;
+					cand[ nCand ].score = DPCountScore( col->state[ s ].hist, node->freqsum );
+					nCand++;
+				}
+			}
+			continue;
+		}
+		for (
+			i = dp.first[ pos ];
+			i < ptd->nInterval &&
+				( i == dp.first[ pos ] || PhraseIntervalIntersect(
+					ptd->interval[ dp.first[ pos ] ], ptd->interval[ i ] ) );
+			i++ ) {
+			PhraseIntervalType *inter = &ptd->interval[ i ];
+
+			assert( inter->p_phr );
+			len = inter->to - inter->from;
+			/* same adjustment as rule_largest_freqsum */
+			freq = ( len == 1 ) ? ( inter->p_phr->freq / 512 ) : inter->p_phr->freq;
+			/* same counting as CountMatchCnnct */
+			for ( cnnct = 0, j = inter->from + 1; j < inter->to; j++ ) {
+				if ( bUserArrCnnct[ j ] )
+					cnnct++;
+			}
+			for ( s = 0; s < col->nState; s++ ) {
+				memcpy( hist, col->state[ s ].hist, sizeof( hist ) );
+				hist[ len ]++;
+				for ( k = 0; k < col->state[ s ].nNode; k++ ) {
+					DPNode parent = dp.node[ col->state[ s ].node[ k ] ];
+
+					DPOffer( &dp, inter->to, hist,
+						col->state[ s ].node[ k ], i,
+						parent.nMatchCnnct + cnnct,
+						parent.freqsum + freq );
+				}
+			}
+		}
+	}
+
+	/* take candidates best first until enough records are accepted */
+	for ( i = nCand / 2 - 1; i >= 0; i-- )
+		DPSiftDown( cand, nCand, i );
+	best = cand[ 0 ];
+	nWanted = min( nWanted, DP_MAX_RESULT );
+	ptd->phList = NULL;
+	ptd->nPhListLen = 0;
+	tail = &ptd->phList;
+	while ( nCand > 0 && ptd->nPhListLen < nWanted ) {
+		next = cand[ 0 ];
+		cand[ 0 ] = cand[ --nCand ];
+		DPSiftDown( cand, nCand, 0 );
+		now = DPMakeRecord( &dp, &next, 1 );
+		if ( ! now )
+			continue;
+		*tail = now;
+		tail = &now->next;
+		ptd->nPhListLen++;
+	}
+	if ( ! ptd->phList ) {
+		/* the containers were dropped from the beam, keep the best one */
+		ptd->phList = DPMakeRecord( &dp, &best, 0 );
+		ptd->nPhListLen = 1;
+	}
+}
+
+/* nanoseconds for the timers of ChewingStats, 0 while they are off */
+static unsigned long long StatsClock( const ChewingData *pgdata )
+{
+	return pgdata->bStatsTimer ? PLAT_CLOCK_NSEC() : 0;
+}
+
 int Phrasing(
 		ChewingData *pgdata, /* FIXME: Remove other parameters since they are all in pgdata. */
 		PhrasingOutput *ppo, uint16_t phoneSeq[], int nPhoneSeq,
-		char selectStr[][ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ], 
+		char selectStr[][ MAX_SELECT_STR_SIZE ], 
 		IntervalType selectInterval[], int nSelect, 
 		int bArrBrkpt[], int bUserArrCnnct[] ) 
 {
 	TreeDataType treeData;
+	ChewingStats *pstats = &pgdata->stats;
+	unsigned long long start, last, now;
 
-	InitPhrasing( &treeData );
+	TRACE_EVENT( pgdata, .type = CHEWING_TRACE_PHRASING_BEGIN, .nPhone = nPhoneSeq );
+	start = last = StatsClock( pgdata );
+	InitPhrasing( pgdata, &treeData );
 
 	FindInterval( 
 		pgdata,
 		phoneSeq, nPhoneSeq, selectStr, selectInterval, nSelect, 
 		bArrBrkpt, &treeData );
+	pstats->nInterval += treeData.nInterval;
+	now = StatsClock( pgdata );
+	pstats->timeFindInterval += now - last;
+	last = now;
+
 	SetInfo( nPhoneSeq, &treeData );
 	Discard1( &treeData );
 	Discard2( &treeData );
-	SaveList( &treeData );
-	CountMatchCnnct( &treeData, bUserArrCnnct, nPhoneSeq );
-	SortListByScore( &treeData );
+	now = StatsClock( pgdata );
+	pstats->timeDiscard += now - last;
+	last = now;
+
+	/* the dynamic programming scores while it lists */
+	if ( pgdata->phrasingEngine == PHRASING_ENGINE_DP ) {
+		DPSaveList( &treeData, bUserArrCnnct, nPhoneSeq, ppo->nNumCut + 1 );
+		now = StatsClock( pgdata );
+		pstats->timeSaveList += now - last;
+	}
+	else {
+		SaveList( &treeData );
+		now = StatsClock( pgdata );
+		pstats->timeSaveList += now - last;
+		last = now;
+		CountMatchCnnct( &treeData, bUserArrCnnct, nPhoneSeq );
+		SortListByScore( &treeData, ppo->nNumCut + 1 );
+		now = StatsClock( pgdata );
+		pstats->timeSort += now - last;
+	}
+	pstats->nRecord += treeData.nPhListLen;
 	NextCut( &treeData, ppo );
 
 #ifdef ENABLE_DEBUG
@@ -986,16 +1872,16 @@ int Phrasing(
 
 	/* set phrasing output */
 	OutputRecordStr(
-		pgdata,
-		ppo->chiBuf, sizeof(ppo->chiBuf),
+		pgdata, ppo,
 		( treeData.phList )->arrIndex, 
 		( treeData.phList )->nInter, 
 		phoneSeq, 
 		nPhoneSeq, 
 		selectStr, selectInterval, nSelect, &treeData );
 	SaveDispInterval( ppo, &treeData );
-
-	/* free "phrase" */
-	CleanUpMem( &treeData );
+	pstats->nPhrasing++;
+	pstats->timePhrasing += StatsClock( pgdata ) - start;
+	TRACE_EVENT( pgdata, .type = CHEWING_TRACE_PHRASING_END, .nPhone = nPhoneSeq,
+		.nInterval = treeData.nInterval, .nRecord = treeData.nPhListLen );
 	return 0;
 }
@@ -24,8 +24,6 @@
 #include "userphrase-private.h"
 #include "private.h"
 
-static HASH_ITEM *pItemLast;
-
 #if 0
 static int DeltaFreq( int recentTime )
 {
@@ -43,58 +41,58 @@ static int DeltaFreq( int recentTime )
 }
 #endif
 
-/* load the orginal frequency from the static dict */
-static int LoadOriginalFreq( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[], int len )
+/* the frequency of wordSeq among the phrases of pho_id, -1 if it is not one */
+static int DictPhraseFreq( ChewingData *pgdata, int pho_id, const char wordSeq[] )
 {
-	int pho_id;
-	int retval;
-	Phrase *phrase = ALC( Phrase, 1 );
+	PhraseView view;
+	int wordLen = strlen( wordSeq );
 
-	pho_id = TreeFindPhrase( pgdata, 0, len - 1, phoneSeq );
-	if ( pho_id != -1 ) {
-		GetPhraseFirst( pgdata, phrase, pho_id );
+	if ( pho_id != -1 && GetPhraseViewFirst( pgdata, &view, pho_id ) ) {
 		do {
 			/* find the same phrase */
-			if ( ! strcmp(
-				phrase->phrase, 
-				wordSeq ) ) {
-				retval = phrase->freq;	
-				free( phrase );
-				return retval;
-			}
-		} while ( GetPhraseNext( pgdata, phrase ) );
+			if ( view.len == wordLen && ! memcmp( view.phrase, wordSeq, wordLen ) )
+				return view.freq;
+		} while ( GetPhraseViewNext( pgdata, &view ) );
 	}
-
-	free( phrase );
-	return FREQ_INIT_VALUE;
+	return -1;
 }
 
-/* find the maximum frequency of the same phrase */
-static int LoadMaxFreq( ChewingData *pgdata, const uint16_t phoneSeq[], int len )
+/*
+ * The frequencies a learned phrase starts from.  Phrasing has just looked
+ * up the same span, so the phrase id and the first candidate come from the
+ * span cache: the first candidate is the most frequent one, and the user
+ * hash is only walked when the span has user phrases at all.
+ */
+static void LoadFreq(
+		ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[], int len,
+		int *pOrigFreq, int *pMaxFreq )
 {
-	int pho_id;
-	Phrase *phrase = ALC( Phrase, 1 );
-	int maxFreq = FREQ_INIT_VALUE;
+	SpanInfo info;
 	UserPhraseData *uphrase;
+	UserPhraseIter iter;
+	int maxFreq = FREQ_INIT_VALUE;
 
-	pho_id = TreeFindPhrase( pgdata, 0, len - 1, phoneSeq );
-	if ( pho_id != -1 ) {
-		GetPhraseFirst( pgdata, phrase, pho_id );
-		do {
-			if ( phrase->freq > maxFreq )
-				maxFreq = phrase->freq;
-		} while( GetPhraseNext( pgdata, phrase ) );
-	}
-	free( phrase );
+	GetSpanInfo( pgdata, phoneSeq, len, &info );
 
-	uphrase = UserGetPhraseFirst( pgdata, phoneSeq );
-	while ( uphrase ) {
-		if ( uphrase->userfreq > maxFreq )
-			maxFreq = uphrase->userfreq;
-		uphrase = UserGetPhraseNext( pgdata, phoneSeq );
-	}	  
+	/* load the orginal frequency from the static dict */
+	if ( pOrigFreq ) {
+		*pOrigFreq = DictPhraseFreq( pgdata, info.pho_id, wordSeq );
+		if ( *pOrigFreq == -1 )
+			*pOrigFreq = FREQ_INIT_VALUE;
+	}
 
-	return maxFreq;
+	/* find the maximum frequency of the same phrase */
+	if ( info.pho_id != -1 )
+		maxFreq = max( maxFreq, info.dictPhrase.freq );
+	if ( info.bUserPhrase ) {
+		uphrase = UserGetPhraseFirst( pgdata, &iter, phoneSeq );
+		while ( uphrase ) {
+			if ( uphrase->userfreq > maxFreq )
+				maxFreq = uphrase->userfreq;
+			uphrase = UserGetPhraseNext( pgdata, &iter );
+		}
+	}
+	*pMaxFreq = maxFreq;
 }
 
 /* compute the new updated freqency */
@@ -131,59 +129,182 @@ static int UpdateFreq( int freq, int maxfreq, int origfreq, int deltatime )
 	}
 }
 
-int UserUpdatePhrase( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[] )
+/* a new user phrase, starting from its frequency in the dictionary */
+static HASH_ITEM *NewUserPhrase(
+		ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[], int len )
 {
-	HASH_ITEM *pItem;
 	UserPhraseData data;
+	uint16_t phoneBuf[ MAX_PHRASE_LEN + 1 ];
+
+	if ( len > MAX_PHRASE_LEN )
+		return NULL;
+
+	/* HashInsert() copies the sequences into the new item */
+	memcpy( phoneBuf, phoneSeq, len * sizeof( phoneSeq[ 0 ] ) );
+	phoneBuf[ len ] = 0;
+	data.phoneSeq = phoneBuf;
+	data.wordSeq = (char *) wordSeq;
+
+	/* load initial freq */
+	LoadFreq( pgdata, phoneBuf, wordSeq, len, &data.origfreq, &data.maxfreq );
+
+	data.userfreq = data.origfreq;
+	data.recentTime = pgdata->session.hashStore->chewing_lifetime;
+	return HashInsert( pgdata, &data );
+}
+
+/* journal now, or leave it to chewing_userphrase_pump() */
+static void ModifyUserPhrase( ChewingData *pgdata, HASH_ITEM *pItem )
+{
+	if ( pgdata->bDeferLearning )
+		HashModifyDeferred( pgdata, pItem );
+	else
+		HashModify( pgdata, pItem );
+}
+
+/* UserUpdatePhrase() with the lock held */
+static int UpdatePhrase( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[] )
+{
+	int lifetime = pgdata->session.hashStore->chewing_lifetime;
+	HASH_ITEM *pItem;
 	int len;
 
 	len = ueStrLen( (char *) wordSeq );
+	/* an empty phrase is never learned */
+	if ( len == 0 || ! phoneSeq[ 0 ] )
+		return USER_UPDATE_FAIL;
 	pItem = HashFindEntry( pgdata, phoneSeq, wordSeq );
 	if ( ! pItem ) {
-		if ( ! AlcUserPhraseSeq( &data, len, strlen( wordSeq ) ) ) {
+		pItem = NewUserPhrase( pgdata, phoneSeq, wordSeq, len );
+		if ( ! pItem )
 			return USER_UPDATE_FAIL;
-		}
-
-		memcpy( data.phoneSeq, phoneSeq, len * sizeof( phoneSeq[ 0 ] ) );
-		data.phoneSeq[ len ] = 0;
-		strcpy( data.wordSeq, wordSeq );
-
-		/* load initial freq */
-		data.origfreq = LoadOriginalFreq( pgdata, phoneSeq, wordSeq, len );
-		data.maxfreq = LoadMaxFreq( pgdata, phoneSeq, len );
-
-		data.userfreq = data.origfreq;
-		data.recentTime = pgdata->static_data.chewing_lifetime;
-		pItem = HashInsert( pgdata, &data );
-		HashModify( pgdata, pItem );
+		ModifyUserPhrase( pgdata, pItem );
+		HashChanged( pgdata );
 		return USER_UPDATE_INSERT;
 	}
 	else {
-		pItem->data.maxfreq = LoadMaxFreq( pgdata, phoneSeq, len );
+		LoadFreq( pgdata, pItem->data.phoneSeq, wordSeq, len, NULL, &pItem->data.maxfreq );
 		pItem->data.userfreq = UpdateFreq( 
 			pItem->data.userfreq, 
 			pItem->data.maxfreq, 
 			pItem->data.origfreq, 
-			pgdata->static_data.chewing_lifetime - pItem->data.recentTime );
-		pItem->data.recentTime = pgdata->static_data.chewing_lifetime;
-		HashModify( pgdata, pItem );
+			lifetime - pItem->data.recentTime );
+		pItem->data.recentTime = lifetime;
+		ModifyUserPhrase( pgdata, pItem );
+		HashChanged( pgdata );
 		return USER_UPDATE_MODIFY;
 	}
 }
 
-UserPhraseData *UserGetPhraseFirst( ChewingData *pgdata, const uint16_t phoneSeq[] )
+int UserUpdatePhrase( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[] )
 {
-	pItemLast = HashFindPhonePhrase( pgdata, phoneSeq, NULL );
-	if ( ! pItemLast ) 
+	int ret;
+
+	/* contexts sharing the phrases learn one at a time */
+	HashLock( pgdata );
+	ret = UpdatePhrase( pgdata, phoneSeq, wordSeq );
+	HashUnlock( pgdata );
+	return ret;
+}
+
+/* every character of wordSeq takes more than a byte, as in HASH_FILE */
+static int IsPhraseString( const char wordSeq[] )
+{
+	int i, len;
+
+	if ( ! *wordSeq )
+		return 0;
+	while ( *wordSeq ) {
+		len = ueBytesFromChar( (unsigned char) *wordSeq );
+		if ( len <= 1 )
+			return 0;
+		for ( i = 1; i < len; i++ ) {
+			if ( ! wordSeq[ i ] )
+				return 0;
+		}
+		wordSeq += len;
+	}
+	return 1;
+}
+
+/* UserImportPhrase() with the lock held */
+static int ImportPhrase( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[], int freq )
+{
+	HASH_ITEM *pItem;
+	int len, nPhone;
+	int ret = USER_UPDATE_MODIFY;
+
+	for ( nPhone = 0; nPhone <= MAX_PHRASE_LEN && phoneSeq[ nPhone ]; nPhone++ )
+		;
+	if ( ! IsPhraseString( wordSeq ) )
+		return USER_UPDATE_FAIL;
+	len = ueStrLen( wordSeq );
+	if ( len != nPhone || len > MAX_PHRASE_LEN )
+		return USER_UPDATE_FAIL;
+
+	pItem = HashFindEntry( pgdata, phoneSeq, wordSeq );
+	if ( ! pItem ) {
+		pItem = NewUserPhrase( pgdata, phoneSeq, wordSeq, len );
+		if ( ! pItem )
+			return USER_UPDATE_FAIL;
+		ret = USER_UPDATE_INSERT;
+	}
+	else if ( freq <= 0 )
+		return USER_UPDATE_IGNORE;
+
+	if ( freq > 0 ) {
+		pItem->data.userfreq = min( freq, MAX_ALLOW_FREQ );
+		pItem->data.maxfreq = max( pItem->data.maxfreq, pItem->data.userfreq );
+		pItem->data.recentTime = pgdata->session.hashStore->chewing_lifetime;
+	}
+	HashModifyBulk( pgdata, pItem );
+	HashChanged( pgdata );
+	return ret;
+}
+
+int UserImportPhrase( ChewingData *pgdata, const uint16_t phoneSeq[], const char wordSeq[], int freq )
+{
+	int ret;
+
+	HashLock( pgdata );
+	ret = ImportPhrase( pgdata, phoneSeq, wordSeq, freq );
+	HashUnlock( pgdata );
+	return ret;
+}
+
+int UserPhraseDecayed( ChewingData *pgdata, const UserPhraseData *pData )
+{
+	int len;
+
+	if ( pData->userfreq > pData->origfreq )
+		return 0;
+	for ( len = 0; pData->phoneSeq[ len ] != 0; len++ )
+		;
+	if ( len == 0 )
+		return 0;
+	return DictPhraseFreq( pgdata,
+		TreeFindPhrase( pgdata, 0, len - 1, pData->phoneSeq ),
+		pData->wordSeq ) != -1;
+}
+
+UserPhraseData *UserGetPhraseFirst( ChewingData *pgdata, UserPhraseIter *iter, const uint16_t phoneSeq[] )
+{
+	HASH_ITEM *pItem;
+
+	iter->phoneSeq = phoneSeq;
+	pItem = HashFindPhonePhrase( pgdata, phoneSeq, &iter->cursor );
+	if ( ! pItem ) 
 		return NULL;
-	return &( pItemLast->data );
+	return &( pItem->data );
 }
 
-UserPhraseData *UserGetPhraseNext( ChewingData *pgdata, const uint16_t phoneSeq[] )
+UserPhraseData *UserGetPhraseNext( ChewingData *pgdata, UserPhraseIter *iter )
 {
-	pItemLast = HashFindPhonePhrase( pgdata, phoneSeq, pItemLast );
-	if ( ! pItemLast )
+	HASH_ITEM *pItem;
+
+	pItem = HashFindNextPhrase( pgdata, iter->phoneSeq, &iter->cursor );
+	if ( ! pItem )
 		return NULL;
-	return &( pItemLast->data );
+	return &( pItem->data );
 }
 
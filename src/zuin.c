@@ -31,79 +31,308 @@
 #include "hanyupinyin-private.h"
 #include "private.h"
 
-/*
- * process a key input
- * return value:
- *	ZUIN_ABSORB
- *	ZUIN_COMMIT
- *	ZUIN_KEY_ERROR
- *	ZUIN_ERROR
+/* conditions on a component of ZuinData.pho_inx, see ZuinRule */
+#define PHO_ANY 0
+#define PHO_IS 1
+#define PHO_NOT 2
+
+#define ANY { PHO_ANY, 0 }
+#define IS( inx ) { PHO_IS, inx }
+#define NOT( inx ) { PHO_NOT, inx }
+
+/* a component ZuinRule.set leaves as it is */
+#define KEEP -1
+
+typedef struct {
+	int op;
+	int inx;
+} PhoCond;
+
+/**
+ * @brief a rule of a layout whose keys stand for more than one component
+ *
+ * A rule applies if the component typed, for the skip and typed rules,
+ * and pho_inx[ 0 .. 2 ] meet its conditions. Only the first rule of a set
+ * which applies is taken.
+ */
+typedef struct {
+	/* key rules: the key */
+	int key;
+	/* skip and typed rules: the type of the component typed, -1 for any */
+	int type;
+	PhoCond typed;
+	PhoCond cond[ 3 ];
+	int set[ 3 ];
+} ZuinRule;
+
+typedef struct {
+	const ZuinRule *rule;
+	int nRule;
+} ZuinRuleSet;
+
+#define RULES( rule ) { rule, ARRAY_SIZE( rule ) }
+
+/**
+ * @brief a keyboard layout, as data for LayoutPhoInput()
+ *
+ * key_str of key2pho.c maps the keys to the components, see KeyTable.
  */
-static int IsHsuPhoEndKey( int pho_inx[], int key )
+typedef struct {
+	/*
+	 * keys ending a syllable once a component other than the tone is
+	 * typed, NULL if these are the tones and space, and every key stands
+	 * for one component
+	 */
+	const char *endKey;
+	/* before a key is looked up: the rule taken absorbs the key */
+	ZuinRuleSet keyRule;
+	/* the component typed is passed over for the next one of the key */
+	ZuinRuleSet skipRule;
+	/* after a key is looked up, before its component is filled in */
+	ZuinRuleSet typedRule;
+	/* before the syllable of an end key is looked up */
+	ZuinRuleSet endRule;
+} ZuinLayout;
+
+static const ZuinRule HSU_SKIP_RULE[] = {
+	/* an initial after an initial or a medial is something else */
+	{ 0, 0, ANY, { NOT( 0 ), ANY, ANY }, { KEEP, KEEP, KEEP } },
+	{ 0, 0, ANY, { ANY, NOT( 0 ), ANY }, { KEEP, KEEP, KEEP } },
+	/* so is "ㄧ" after a medial, the "e" of "i e" */
+	{ 0, 1, IS( 1 ), { ANY, NOT( 0 ), ANY }, { KEEP, KEEP, KEEP } },
+};
+
+static const ZuinRule HSU_TYPED_RULE[] = {
+	/* "ㄐㄑㄒ" followed by "ㄨ" are "ㄓㄔㄕ" */
+	{ 0, 1, IS( 2 ), { IS( 12 ), ANY, ANY }, { 15, KEEP, KEEP } },
+	{ 0, 1, IS( 2 ), { IS( 13 ), ANY, ANY }, { 16, KEEP, KEEP } },
+	{ 0, 1, IS( 2 ), { IS( 14 ), ANY, ANY }, { 17, KEEP, KEEP } },
+	/* fuzzy "g e" to "j e" */
+	{ 0, -1, ANY, { IS( 9 ), IS( 1 ), ANY }, { 12, KEEP, KEEP } },
+	{ 0, -1, ANY, { IS( 9 ), IS( 3 ), ANY }, { 12, KEEP, KEEP } },
+	/* "ㄐㄑㄒ" must follow "ㄧㄩ" */
+	{ 0, 2, ANY, { IS( 12 ), IS( 0 ), ANY }, { 15, KEEP, KEEP } },
+	{ 0, 2, ANY, { IS( 13 ), IS( 0 ), ANY }, { 16, KEEP, KEEP } },
+	{ 0, 2, ANY, { IS( 14 ), IS( 0 ), ANY }, { 17, KEEP, KEEP } },
+};
+
+static const ZuinRule HSU_END_RULE[] = {
+	/* convert "ㄐㄑㄒ" to "ㄓㄔㄕ" */
+	{ 0, -1, ANY, { IS( 12 ), IS( 0 ), IS( 0 ) }, { 15, KEEP, KEEP } },
+	{ 0, -1, ANY, { IS( 13 ), IS( 0 ), IS( 0 ) }, { 16, KEEP, KEEP } },
+	{ 0, -1, ANY, { IS( 14 ), IS( 0 ), IS( 0 ) }, { 17, KEEP, KEEP } },
+	/* convert "ㄏ" to "ㄛ" */
+	{ 0, -1, ANY, { IS( 11 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 2 } },
+	/* convert "ㄍ" to "ㄜ" */
+	{ 0, -1, ANY, { IS( 9 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 3 } },
+	/* convert "ㄇ" to "ㄢ" */
+	{ 0, -1, ANY, { IS( 3 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 9 } },
+	/* convert "ㄋ" to "ㄣ" */
+	{ 0, -1, ANY, { IS( 7 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 10 } },
+	/* convert "ㄎ" to "ㄤ" */
+	{ 0, -1, ANY, { IS( 10 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 11 } },
+	/* convert "ㄌ" to "ㄦ" */
+	{ 0, -1, ANY, { IS( 8 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 13 } },
+	/* fuzzy "g e" to "j e" */
+	{ 0, -1, ANY, { IS( 9 ), IS( 1 ), ANY }, { 12, KEEP, KEEP } },
+	{ 0, -1, ANY, { IS( 9 ), IS( 3 ), ANY }, { 12, KEEP, KEEP } },
+};
+
+/* copy the idea from HSU keyboard */
+static const ZuinRule ET26_SKIP_RULE[] = {
+	{ 0, 0, ANY, { NOT( 0 ), ANY, ANY }, { KEEP, KEEP, KEEP } },
+	{ 0, 0, ANY, { ANY, NOT( 0 ), ANY }, { KEEP, KEEP, KEEP } },
+};
+
+static const ZuinRule ET26_TYPED_RULE[] = {
+	/* convert "ㄐㄒ" to "ㄓㄕ" */
+	{ 0, 1, IS( 2 ), { IS( 12 ), ANY, ANY }, { 15, KEEP, KEEP } },
+	{ 0, 1, IS( 2 ), { IS( 14 ), ANY, ANY }, { 17, KEEP, KEEP } },
+	/* convert "ㄍ" to "ㄑ" */
+	{ 0, 1, NOT( 2 ), { IS( 9 ), ANY, ANY }, { 13, KEEP, KEEP } },
+	{ 0, 2, ANY, { IS( 12 ), IS( 0 ), ANY }, { 15, KEEP, KEEP } },
+	{ 0, 2, ANY, { IS( 14 ), IS( 0 ), ANY }, { 17, KEEP, KEEP } },
+};
+
+static const ZuinRule ET26_END_RULE[] = {
+	/* convert "ㄐㄒ" to "ㄓㄕ" */
+	{ 0, -1, ANY, { IS( 12 ), IS( 0 ), IS( 0 ) }, { 15, KEEP, KEEP } },
+	{ 0, -1, ANY, { IS( 14 ), IS( 0 ), IS( 0 ) }, { 17, KEEP, KEEP } },
+	/* convert "ㄆ" to "ㄡ" */
+	{ 0, -1, ANY, { IS( 2 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 8 } },
+	/* convert "ㄇ" to "ㄢ" */
+	{ 0, -1, ANY, { IS( 3 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 9 } },
+	/* convert "ㄋ" to "ㄣ" */
+	{ 0, -1, ANY, { IS( 7 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 10 } },
+	/* convert "ㄊ" to "ㄤ" */
+	{ 0, -1, ANY, { IS( 6 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 11 } },
+	/* convert "ㄌ" to "ㄥ" */
+	{ 0, -1, ANY, { IS( 8 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 12 } },
+	/* convert "ㄏ" to "ㄦ" */
+	{ 0, -1, ANY, { IS( 11 ), IS( 0 ), IS( 0 ) }, { 0, KEEP, 13 } },
+};
+
+static const ZuinRule DACHEN_CP26_KEY_RULE[] = {
+	/* switching between "ㄅ" and "ㄆ" */
+	{ 'q', -1, ANY, { IS( 1 ), ANY, ANY }, { 2, KEEP, KEEP } },
+	{ 'q', -1, ANY, { IS( 2 ), ANY, ANY }, { 1, KEEP, KEEP } },
+	/* switching between "ㄉ" and "ㄊ" */
+	{ 'w', -1, ANY, { IS( 5 ), ANY, ANY }, { 6, KEEP, KEEP } },
+	{ 'w', -1, ANY, { IS( 6 ), ANY, ANY }, { 5, KEEP, KEEP } },
+	/* switching between "ㄓ" and "ㄔ" */
+	{ 't', -1, ANY, { IS( 15 ), ANY, ANY }, { 16, KEEP, KEEP } },
+	{ 't', -1, ANY, { IS( 16 ), ANY, ANY }, { 15, KEEP, KEEP } },
+	/* converting "ㄖ" to "ㄝ" */
+	{ 'b', -1, ANY, { NOT( 0 ), ANY, ANY }, { KEEP, KEEP, 4 } },
+	{ 'b', -1, ANY, { ANY, NOT( 0 ), ANY }, { KEEP, KEEP, 4 } },
+	/* converting "ㄙ" to "ㄣ" */
+	{ 'n', -1, ANY, { NOT( 0 ), ANY, ANY }, { KEEP, KEEP, 12 } },
+	{ 'n', -1, ANY, { ANY, NOT( 0 ), ANY }, { KEEP, KEEP, 12 } },
+	/* switching between "ㄧ", "ㄚ", and "ㄧㄚ" */
+	{ 'u', -1, ANY, { ANY, IS( 1 ), NOT( 1 ) }, { KEEP, 0, 1 } },
+	{ 'u', -1, ANY, { ANY, NOT( 1 ), IS( 1 ) }, { KEEP, 1, KEEP } },
+	{ 'u', -1, ANY, { ANY, IS( 1 ), IS( 1 ) }, { KEEP, 0, 0 } },
+	{ 'u', -1, ANY, { ANY, NOT( 0 ), ANY }, { KEEP, KEEP, 1 } },
+	/* switching between "ㄩ" and "ㄡ" */
+	{ 'm', -1, ANY, { ANY, IS( 3 ), NOT( 8 ) }, { KEEP, 0, 8 } },
+	{ 'm', -1, ANY, { ANY, NOT( 3 ), IS( 8 ) }, { KEEP, 3, 0 } },
+	{ 'm', -1, ANY, { ANY, NOT( 0 ), ANY }, { KEEP, KEEP, 8 } },
+	/* switching between "ㄛ" and "ㄞ" */
+	{ 'i', -1, ANY, { ANY, ANY, IS( 2 ) }, { KEEP, KEEP, 5 } },
+	{ 'i', -1, ANY, { ANY, ANY, IS( 5 ) }, { KEEP, KEEP, 2 } },
+	/* switching between "ㄟ" and "ㄢ" */
+	{ 'o', -1, ANY, { ANY, ANY, IS( 6 ) }, { KEEP, KEEP, 9 } },
+	{ 'o', -1, ANY, { ANY, ANY, IS( 9 ) }, { KEEP, KEEP, 6 } },
+	/* switching between "ㄠ" and "ㄤ" */
+	{ 'l', -1, ANY, { ANY, ANY, IS( 7 ) }, { KEEP, KEEP, 11 } },
+	{ 'l', -1, ANY, { ANY, ANY, IS( 11 ) }, { KEEP, KEEP, 7 } },
+	/* switching between "ㄣ" and "ㄦ" */
+	{ 'p', -1, ANY, { ANY, ANY, IS( 10 ) }, { KEEP, KEEP, 13 } },
+	{ 'p', -1, ANY, { ANY, ANY, IS( 13 ) }, { KEEP, KEEP, 10 } },
+};
+
+static const ZuinLayout STANDARD_LAYOUT = {
+	.endKey = NULL,
+};
+
+static const ZuinLayout HSU_LAYOUT = {
+	.endKey = "sdfj ",
+	.skipRule = RULES( HSU_SKIP_RULE ),
+	.typedRule = RULES( HSU_TYPED_RULE ),
+	.endRule = RULES( HSU_END_RULE ),
+};
+
+static const ZuinLayout ET26_LAYOUT = {
+	.endKey = "dfjk ",
+	.skipRule = RULES( ET26_SKIP_RULE ),
+	.typedRule = RULES( ET26_TYPED_RULE ),
+	.endRule = RULES( ET26_END_RULE ),
+};
+
+static const ZuinLayout DACHEN_CP26_LAYOUT = {
+	.endKey = "erdy ",
+	.keyRule = RULES( DACHEN_CP26_KEY_RULE ),
+};
+
+static const ZuinLayout * const LAYOUT[] = {
+	[ KB_DEFAULT ] = &STANDARD_LAYOUT,
+	[ KB_HSU ] = &HSU_LAYOUT,
+	[ KB_IBM ] = &STANDARD_LAYOUT,
+	[ KB_GIN_YIEH ] = &STANDARD_LAYOUT,
+	[ KB_ET ] = &STANDARD_LAYOUT,
+	[ KB_ET26 ] = &ET26_LAYOUT,
+	[ KB_DVORAK ] = &STANDARD_LAYOUT,
+	/* Dvorak Hsu key has already converted to Hsu */
+	[ KB_DVORAK_HSU ] = &HSU_LAYOUT,
+	[ KB_DACHEN_CP26 ] = &DACHEN_CP26_LAYOUT,
+	[ KB_HANYU_PINYIN ] = &STANDARD_LAYOUT,
+};
+
+STATIC_ASSERT( ARRAY_SIZE( LAYOUT ) == KB_TYPE_NUM, LAYOUT_needs_update );
+
+int InitZuin( ChewingData *pgdata )
 {
-	switch ( key ) {
-		case 's':
-		case 'd':
-		case 'f':
-		case 'j':
-		case ' ':
-			return ( pho_inx[ 0 ] || pho_inx[ 1 ] || pho_inx[ 2 ] );
-		default:
-			return 0;
-	}
+	int kbtype;
+
+	for ( kbtype = 0; kbtype < KB_TYPE_NUM; kbtype++ )
+		InitKeyTable( &pgdata->static_data->keyTable[ kbtype ], kbtype );
+	return 0;
 }
 
-#if 0
-static int IsDvorakHsuPhoEndKey( int pho_inx[], int key )
+/* the components key stands for, in the order of the layout */
+static const uint8_t *KeyReading( ChewingData *pgdata, int kbtype, int key )
 {
-	/* DvorakHsu tone mark should be same with Hsu's mark 
-	 * after conversion.
-	 */
-	return IsHsuPhoEndKey(pho_inx, key);
+	static const uint8_t NO_READING[ MAX_KEY_READING ];
+
+	if ( kbtype < 0 || kbtype >= KB_TYPE_NUM || key < 0 || key >= KEY_TABLE_SIZE )
+		return NO_READING;
+	return pgdata->static_data->keyTable[ kbtype ].reading[ key ];
 }
-#endif
 
-/* copy the idea from HSU keyboard */
-static int IsET26PhoEndKey( int pho_inx[], int key )
+/* the tone key stands for, 0 if none */
+static int KeyTone( const uint8_t reading[] )
 {
-	switch ( key ) {
-		case 'd':
-		case 'f':
-		case 'j':
-		case 'k':
-		case ' ':
-			return ( pho_inx[ 0 ] || pho_inx[ 1 ] || pho_inx[ 2 ] );
+	int n;
+
+	for ( n = 0; n < MAX_KEY_READING && reading[ n ]; n++ )
+		if ( KEY_READING_TYPE( reading[ n ] ) == 3 )
+			return KEY_READING_INX( reading[ n ] );
+	return 0;
+}
+
+static int MatchPhoCond( const PhoCond *cond, int inx )
+{
+	switch ( cond->op ) {
+		case PHO_IS:
+			return inx == cond->inx;
+		case PHO_NOT:
+			return inx != cond->inx;
 		default:
-			return 0;
+			return 1;
 	}
 }
 
-/* copy the idea from HSU keyboard */
-static int IsDACHENCP26PhoEndKey( int pho_inx[], int key )
+/**
+ * @brief the first rule of set which applies, see ZuinRule
+ *
+ * @return the rule, NULL if none applies
+ */
+static const ZuinRule *FindRule( const ZuinRuleSet *set, const ZuinData *pZuin,
+		int key, int type, int inx )
 {
-	switch ( key ) {
-		case 'e':
-		case 'r':
-		case 'd':
-		case 'y':
-		case ' ':
-			return ( pho_inx[ 0 ] || pho_inx[ 1 ] || pho_inx[ 2 ] );
-		default:
-			return 0;
+	const ZuinRule *rule;
+	int i;
+
+	for ( rule = set->rule; rule < set->rule + set->nRule; rule++ ) {
+		if ( rule->key && rule->key != key )
+			continue;
+		if ( rule->type != -1 && rule->type != type )
+			continue;
+		if ( ! MatchPhoCond( &rule->typed, inx ) )
+			continue;
+		for ( i = 0; i < 3; i++ )
+			if ( ! MatchPhoCond( &rule->cond[ i ], pZuin->pho_inx[ i ] ) )
+				break;
+		if ( i == 3 )
+			return rule;
 	}
+	return NULL;
 }
 
-static int IsDefPhoEndKey( int key, int kbtype )
+static int ApplyRule( const ZuinRuleSet *set, ZuinData *pZuin, int key, int type, int inx )
 {
-	if ( PhoneInxFromKey( key, 3, kbtype, 1 )  )
-		return 1;
-	
-	if ( key == ' ' )
-		return 1;
-	return 0;
+	const ZuinRule *rule = FindRule( set, pZuin, key, type, inx );
+	int i;
+
+	if ( ! rule )
+		return 0;
+	for ( i = 0; i < 3; i++ )
+		if ( rule->set[ i ] != KEEP )
+			pZuin->pho_inx[ i ] = rule->set[ i ];
+	return 1;
 }
 
-static int EndKeyProcess( ChewingData *pgdata, ZuinData *pZuin, int key, int searchTimes )
+static int EndKeyProcess( ChewingData *pgdata, ZuinData *pZuin, int key )
 {
 	uint16_t u16Pho;
 	Word tempword;
@@ -123,7 +352,7 @@ static int EndKeyProcess( ChewingData *pgdata, ZuinData *pZuin, int key, int sea
 		return (key == ' ') ? ZUIN_KEY_ERROR : ZUIN_NO_WORD;
 	}
 
-	pho_inx = PhoneInxFromKey( key, 3, pZuin->kbtype, searchTimes );
+	pho_inx = KeyTone( KeyReading( pgdata, pZuin->kbtype, key ) );
 	if ( pZuin->pho_inx[ 3 ] == 0 ) {
 		pZuin->pho_inx[ 3 ] = pho_inx;
 	}
@@ -142,411 +371,72 @@ static int EndKeyProcess( ChewingData *pgdata, ZuinData *pZuin, int key, int sea
 	return ZUIN_COMMIT;
 }
 
-static int DefPhoInput( ChewingData *pgdata, ZuinData *pZuin, int key )
-	/* FIXME: Remove pZuin parameter */
+/*
+ * process a key input of layout
+ * return value:
+ *	ZUIN_ABSORB
+ *	ZUIN_COMMIT
+ *	ZUIN_KEY_ERROR
+ *	ZUIN_ERROR
+ */
+static int LayoutPhoInput( ChewingData *pgdata, ZuinData *pZuin,
+		const ZuinLayout *layout, int key )
 {
-	int type = 0, inx = 0;
+	const uint8_t *reading = KeyReading( pgdata, pZuin->kbtype, key );
+	int type = 0, inx = 0, n = 0;
 	int i;
 
-	if ( IsDefPhoEndKey( key, pZuin->kbtype ) ) {
-		for ( i = 0; i < ZUIN_SIZE; ++i )
-			if ( pZuin->pho_inx[ i ] != 0 )
-				break;
-		if ( i < ZUIN_SIZE )
-			return EndKeyProcess( pgdata, pZuin, key, 1 );
-	}
-	else {
-		pZuin->pho_inx[ 3 ] = 0;
-	}
-		
-	/* decide if the key is a phone */
-	for ( type = 0; type <= 3; type++ ) {
-		inx = PhoneInxFromKey( key, type, pZuin->kbtype, 1 );
-		if ( inx )
-			break;
-	}
-	
-	/* the key is NOT a phone */
-	if ( type > 3 ) {
-		return ZUIN_KEY_ERROR;
-	}
-	
-	/* fill the key into the phone buffer */
-	pZuin->pho_inx[ type ] = inx;
-	return ZUIN_ABSORB;
-}
-
-static int HsuPhoInput( ChewingData *pgdata, ZuinData *pZuin, int key )
-	/* FIXME: Remove pZuin parameter */
-{
-	int type = 0, searchTimes = 0, inx = 0;
-
-	/* Dvorak Hsu key has already converted to Hsu */
-	if ( IsHsuPhoEndKey( pZuin->pho_inx, key ) ) {
-		if ( pZuin->pho_inx[ 1 ] == 0 && pZuin->pho_inx[ 2 ] == 0 ) {
-			/* convert "ㄐㄑㄒ" to "ㄓㄔㄕ" */
-			if ( 12 <= pZuin->pho_inx[ 0 ] && pZuin->pho_inx[ 0 ] <= 14 ) {
-				pZuin->pho_inx[ 0 ] += 3 ;
-			}
-			/* convert "ㄏ" to "ㄛ" */
-			else if ( pZuin->pho_inx[ 0 ] == 11 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 2;
-			}
-			/* convert "ㄍ" to "ㄜ" */
-			else if ( pZuin->pho_inx[ 0 ] == 9 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 3;
-			}
-			/* convert "ㄇ" to "ㄢ" */
-			else if ( pZuin->pho_inx[ 0 ] == 3 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 9;
-			}
-			/* convert "ㄋ" to "ㄣ" */
-			else if ( pZuin->pho_inx[ 0 ] == 7 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 10;
-			}
-			/* convert "ㄎ" to "ㄤ" */
-			else if ( pZuin->pho_inx[ 0 ] == 10 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 11;
-			}
-			/* convert "ㄌ" to "ㄦ" */
-			else if ( pZuin->pho_inx[ 0 ] == 8 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 13;
-			}
-		}
-
-		if (
-			( pZuin->pho_inx[ 0 ] == 9 ) && 
-			( ( pZuin->pho_inx[ 1 ] == 1 ) || 
-				( pZuin->pho_inx[ 1 ] == 3 ) ) ) {
-			pZuin->pho_inx[ 0 ] = 12;
-		}
-
-		searchTimes = ( key == 'j' ) ? 3 : 2;
-
-		return EndKeyProcess( pgdata, pZuin, key, searchTimes );
-	}
-	else {
-		/* decide if the key is a phone */
-		for ( type = 0, searchTimes = 1; type < 3; type++ ) {
-			inx = PhoneInxFromKey( key, type, pZuin->kbtype, searchTimes );
-			if ( ! inx )
-				continue; /* if inx == 0, next type */
-			else if ( type == 0 ) {
-				if ( pZuin->pho_inx[ 0 ] || pZuin->pho_inx[ 1 ] ) {
-					/* if inx !=0 */
-					searchTimes = 2 ; /* possible infinite loop here */
-				}
-				else 
-					break;
-			}
-			else if ( type == 1 && inx == 1 ) { /* handle i and e*/
-				if ( pZuin->pho_inx[ 1 ] ) {
-					searchTimes = 2;
-				}
-				else 
+	if ( ! layout->endKey ) {
+		/* a tone or space ends the syllable, unless nothing is typed */
+		if ( key == ' ' || ( reading[ 0 ] && KEY_READING_TYPE( reading[ 0 ] ) == 3 ) ) {
+			for ( i = 0; i < ZUIN_SIZE; ++i )
+				if ( pZuin->pho_inx[ i ] != 0 )
 					break;
-			}
-			else 
-				break;
+			if ( i < ZUIN_SIZE )
+				return EndKeyProcess( pgdata, pZuin, key );
 		}
-		/* processing very special cases "j v c" */
-		if ( 
-			type == 1 && 
-			inx == 2 && 
-			12 <= pZuin->pho_inx[ 0 ] && 
-			pZuin->pho_inx[ 0 ] <= 14 ) {
-			pZuin->pho_inx[ 0 ] += 3;
+		else {
+			pZuin->pho_inx[ 3 ] = 0;
 		}
 
-		/* Fuzzy "g e" to "j e" */
-		if (
-			( pZuin->pho_inx[ 0 ] == 9 ) && 
-			( ( pZuin->pho_inx[ 1 ] == 1 ) || ( pZuin->pho_inx[ 1 ] == 3 ) ) ) {
-			pZuin->pho_inx[ 0 ] = 12;
-		}
-
-		/* ㄐㄑㄒ must follow ㄧㄩ */
-		if (
-			type == 2 && 
-			pZuin->pho_inx[ 1 ] == 0 && 
-			12 <= pZuin->pho_inx[ 0 ] && 
-			pZuin->pho_inx[ 0 ] <= 14 ) {
-			pZuin->pho_inx[ 0 ] += 3;
-		}
-
-		if ( type == 3 ) { /* the key is NOT a phone */
-			if ( isalpha( key ) )
-				return ZUIN_NO_WORD;
+		/* the key is NOT a phone */
+		if ( ! reading[ 0 ] )
 			return ZUIN_KEY_ERROR;
-		}
+
 		/* fill the key into the phone buffer */
-		pZuin->pho_inx[ type ] = inx;
+		pZuin->pho_inx[ KEY_READING_TYPE( reading[ 0 ] ) ] = KEY_READING_INX( reading[ 0 ] );
 		return ZUIN_ABSORB;
 	}
-}
-
-/* copy the idea from hsu */
-static int ET26PhoInput( ChewingData *pgdata, ZuinData *pZuin, int key )
-	/* FIXME: Remove pZuin parameter */
-{
-	int type = 0, searchTimes = 0, inx = 0;
 
-	if ( IsET26PhoEndKey( pZuin->pho_inx, key ) ) {
-		if ( pZuin->pho_inx[ 1 ] == 0 && pZuin->pho_inx[ 2 ] == 0 ) {
-			/* convert "ㄐㄒ" to "ㄓㄕ" */
-			if ( pZuin->pho_inx[ 0 ] == 12 || pZuin->pho_inx[ 0 ] == 14 ) {
-				pZuin->pho_inx[ 0 ] += 3;
-			}
-			/* convert "ㄆ" to "ㄡ" */
-			else if ( pZuin->pho_inx[ 0 ] == 2 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 8;
-			}
-			/* convert "ㄇ" to "ㄢ" */
-			else if ( pZuin->pho_inx[ 0 ] == 3 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 9;
-			}
-			/* convert "ㄋ" to "ㄣ" */
-			else if ( pZuin->pho_inx[ 0 ] == 7) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 10;
-			}
-			/* convert "ㄊ" to "ㄤ" */
-			else if ( pZuin->pho_inx[ 0 ] == 6 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 11;
-			}
-			/* convert "ㄌ" to "ㄥ" */
-			else if ( pZuin->pho_inx[ 0 ] == 8 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 12;
-			}
-			/* convert "ㄏ" to "ㄦ" */
-			else if ( pZuin->pho_inx[ 0 ] == 11 ) {
-				pZuin->pho_inx[ 0 ] = 0;
-				pZuin->pho_inx[ 2 ] = 13;
-			}
-		}
-		searchTimes = 2;
-		return EndKeyProcess( pgdata, pZuin, key, searchTimes );
+	if ( key && strchr( layout->endKey, key ) &&
+			( pZuin->pho_inx[ 0 ] || pZuin->pho_inx[ 1 ] || pZuin->pho_inx[ 2 ] ) ) {
+		ApplyRule( &layout->endRule, pZuin, key, -1, 0 );
+		return EndKeyProcess( pgdata, pZuin, key );
 	}
-	else {
-		/* decide if the key is a phone */
-		for ( type = 0, searchTimes = 1; type < 3; type++ ) {
-			inx = PhoneInxFromKey( key, type, pZuin->kbtype, searchTimes );
-			if ( ! inx ) 
-				continue; /* if inx == 0, next type */
-			else if ( type == 0 ) {
-				if ( pZuin->pho_inx[ 0 ] || pZuin->pho_inx[ 1 ] ) {
-					/* if inx !=0 */
-					searchTimes = 2 ; /* possible infinite loop here */
-				}
-				else
-					break;
-			}
-			else
-				break;	
-		}
-		/* convert "ㄐㄒ" to "ㄓㄕ" */
-		if ( type == 1 ) {
-			if ( inx == 2 ) {
-				if ( 
-					pZuin->pho_inx[ 0 ] == 12 || 
-					pZuin->pho_inx[ 0 ] == 14 ) {
-					pZuin->pho_inx[ 0 ] += 3;
-				}
-			}
-			else {
-				/* convert "ㄍ" to "ㄑ" */
-				if ( pZuin->pho_inx[ 0 ] == 9 ) {
-					pZuin->pho_inx[ 0 ] = 13;	
-				}
-			}
-		}
 
-		if ( 
-			type == 2 && 
-			pZuin->pho_inx[ 1 ] == 0 && 
-			(pZuin->pho_inx[ 0 ] == 12 || pZuin->pho_inx[ 0 ] == 14 ) ) {
-			pZuin->pho_inx[ 0 ] += 3;
-		}
-
-		if ( type == 3 ) { /* the key is NOT a phone */
-			if ( isalpha( key ) )
-				return ZUIN_NO_WORD;
-			return ZUIN_KEY_ERROR;
-		}
-		/* fill the key into the phone buffer */
-		pZuin->pho_inx[ type ] = inx;
+	if ( ApplyRule( &layout->keyRule, pZuin, key, -1, 0 ) )
 		return ZUIN_ABSORB;
-	}
-}
-
-static int DACHENCP26PhoInput( ChewingData *pgdata, ZuinData *pZuin, int key )
-	/* FIXME: Remove pZuin parameter */
-{
-	int type = 0, searchTimes = 0, inx = 0;
 
-	if ( IsDACHENCP26PhoEndKey( pZuin->pho_inx, key ) ) {
-		searchTimes = 2;
-		return EndKeyProcess( pgdata, pZuin, key, searchTimes );
+	/* decide if the key is a phone, a component of each type in turn */
+	for ( type = 0; type < 3; type++ ) {
+		if ( n >= MAX_KEY_READING || ! reading[ n ] ||
+				KEY_READING_TYPE( reading[ n ] ) != type )
+			continue;
+		inx = KEY_READING_INX( reading[ n ] );
+		if ( ! FindRule( &layout->skipRule, pZuin, key, type, inx ) )
+			break;
+		n++;
 	}
-	else {
-		/* decide if the key is a phone */
-		for ( type = 0, searchTimes = 1; type < 3; type++ ) {
-			inx = PhoneInxFromKey( key, type, pZuin->kbtype, searchTimes );
-			if ( ! inx ) 
-				continue; /* if inx == 0, next type */
-			else if ( type == 0 ) {
-				break;
-				if ( pZuin->pho_inx[ 0 ] || pZuin->pho_inx[ 1 ] ) {
-					/* if inx !=0 */
-					searchTimes = 2 ; /* possible infinite loop here */
-				}
-				else
-					break;
-			}
-			else
-				break;	
-		}
-		/* switching between "ㄅ" and "ㄆ" */
-		if ( key == 'q' ) {
-			if ( pZuin->pho_inx[ 0 ] == 1  ) {
-			 	pZuin->pho_inx[ 0 ] = 2;
-				return ZUIN_ABSORB;
-			} else if ( pZuin->pho_inx[0] == 2) {
-				pZuin->pho_inx[ 0 ] = 1;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* switching between "ㄉ" and "ㄊ" */
-		else if ( key == 'w' ) {
-			if ( pZuin->pho_inx[ 0 ] == 5  ) {
-			 	pZuin->pho_inx[ 0 ] = 6;
-				return ZUIN_ABSORB;
-			} else if ( pZuin->pho_inx[0] == 6) {
-				pZuin->pho_inx[ 0 ] = 5;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* switching between "ㄓ" and "ㄔ" */
-		else if ( key == 't' ) {
-			if ( pZuin->pho_inx[ 0 ] == 15  ) {
-			 	pZuin->pho_inx[ 0 ] = 16;
-				return ZUIN_ABSORB;
-			} else if ( pZuin->pho_inx[0] == 16) {
-				pZuin->pho_inx[ 0 ] = 15;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* converting "ㄖ" to "ㄝ" */
-		else if ( key == 'b' ) {
-			if ( pZuin->pho_inx[ 0 ] != 0 || pZuin->pho_inx[1] != 0 ) {
-			pZuin->pho_inx[ 2 ] = 4;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* converting "ㄙ" to "ㄣ" */
-		else if ( key == 'n' ) {
-			if ( pZuin->pho_inx[ 0 ] != 0 || pZuin->pho_inx[1] != 0 ) {
-				pZuin->pho_inx[ 2 ] = 12;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* switching between "ㄧ", "ㄚ", and "ㄧㄚ" */
-		else if ( key == 'u' ) {
-			if ( pZuin->pho_inx[ 1 ] == 1 && pZuin->pho_inx[ 2 ] != 1 ) {
-				pZuin->pho_inx[1] = 0;
-				pZuin->pho_inx[2] = 1;
-				return ZUIN_ABSORB;
-			}
-			else if (pZuin->pho_inx[ 1 ] != 1 && pZuin->pho_inx[2] == 1) {
-				pZuin->pho_inx[1] = 1;
-				return ZUIN_ABSORB;
-			}
-			else if (pZuin->pho_inx[1] == 1 && pZuin->pho_inx[2]==1) {
-				pZuin->pho_inx[1]=0;
-				pZuin->pho_inx[2]=0;
-				return ZUIN_ABSORB;
-			}
-			else if (pZuin->pho_inx[1] != 0) {
-				pZuin->pho_inx[2] = 1;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* switching between "ㄩ" and "ㄡ" */
-		else if ( key == 'm' ) {
-			if ( pZuin->pho_inx[ 1 ] == 3 && pZuin->pho_inx[ 2 ] != 8 ) {
-				pZuin->pho_inx[1] = 0;
-				pZuin->pho_inx[2] = 8;
-				return ZUIN_ABSORB;
-			}
-			else if (pZuin->pho_inx[ 1 ] != 3 && pZuin->pho_inx[2] == 8) {
-				pZuin->pho_inx[1] = 3;
-				pZuin->pho_inx[2] = 0;
-				return ZUIN_ABSORB;
-			}
-			else if (pZuin->pho_inx[ 1 ] != 0) {
-				pZuin->pho_inx[2] = 8;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* switching between "ㄛ" and "ㄞ" */
-		else if ( key == 'i' ) {
-			if ( pZuin->pho_inx[ 2 ] == 2  ) {
-			 	pZuin->pho_inx[ 2 ] = 5;
-				return ZUIN_ABSORB;
-			} else if ( pZuin->pho_inx[2] == 5) {
-				pZuin->pho_inx[ 2 ] = 2;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* switching between "ㄟ" and "ㄢ" */
-		else if ( key == 'o' ) {
-			if ( pZuin->pho_inx[ 2 ] == 6  ) {
-			 	pZuin->pho_inx[ 2 ] = 9;
-				return ZUIN_ABSORB;
-			} else if ( pZuin->pho_inx[2] == 9) {
-				pZuin->pho_inx[ 2 ] = 6;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* switching between "ㄠ" and "ㄤ" */
-		else if ( key == 'l' ) {
-			if ( pZuin->pho_inx[ 2 ] == 7  ) {
-			 	pZuin->pho_inx[ 2 ] = 11;
-				return ZUIN_ABSORB;
-			} else if ( pZuin->pho_inx[2] == 11) {
-				pZuin->pho_inx[ 2 ] = 7;
-				return ZUIN_ABSORB;
-			}
-		}
-		/* switching between "ㄣ" and "ㄦ" */
-		else if ( key == 'p' ) {
-			if ( pZuin->pho_inx[ 2 ] == 10  ) {
-			 	pZuin->pho_inx[ 2 ] = 13;
-				return ZUIN_ABSORB;
-			} else if ( pZuin->pho_inx[2] == 13) {
-				pZuin->pho_inx[ 2 ] = 10;
-				return ZUIN_ABSORB;
-			}
-		}
-		if ( type == 3 ) { /* the key is NOT a phone */
-			if ( isalpha( key ) )
-				return ZUIN_NO_WORD;
-			return ZUIN_KEY_ERROR;
-		}
-		/* fill the key into the phone buffer */
-		pZuin->pho_inx[ type ] = inx;
-		return ZUIN_ABSORB;
+	ApplyRule( &layout->typedRule, pZuin, key, type, inx );
+
+	if ( type == 3 ) { /* the key is NOT a phone */
+		if ( isalpha( key ) )
+			return ZUIN_NO_WORD;
+		return ZUIN_KEY_ERROR;
 	}
+	/* fill the key into the phone buffer */
+	pZuin->pho_inx[ type ] = inx;
+	return ZUIN_ABSORB;
 }
 
 static int IsPinYinEndKey(int key )
@@ -589,7 +479,7 @@ static int PinYinInput( ChewingData *pgdata, ZuinData *pZuin, int key )
 
 		DEBUG_OUT( "zuinKeySeq: %s\n", zuinKeySeq );
 		for ( i = 0; i < strlen( zuinKeySeq ); i++ ) {
-			status = DefPhoInput( pgdata, pZuin, zuinKeySeq[ i ] );
+			status = LayoutPhoInput( pgdata, pZuin, &STANDARD_LAYOUT, zuinKeySeq[ i ] );
 			if ( status != ZUIN_ABSORB )
 				return ZUIN_KEY_ERROR;
 		}
@@ -604,7 +494,7 @@ static int PinYinInput( ChewingData *pgdata, ZuinData *pZuin, int key )
 				key = '7';
 		}
 		pZuin->pinYinData.keySeq[ 0 ] = '\0';
-		return EndKeyProcess( pgdata, pZuin, key, 1 );
+		return EndKeyProcess( pgdata, pZuin, key );
 	}
 	buf[ 0 ] = key; buf[ 1 ] = '\0';
 	strcat( pZuin->pinYinData.keySeq, buf );
@@ -618,24 +508,11 @@ static int PinYinInput( ChewingData *pgdata, ZuinData *pZuin, int key )
 int ZuinPhoInput( ChewingData *pgdata, ZuinData *pZuin, int key )
 	/* FIXME: Remove pZuin parameter */
 {
-	switch ( pZuin->kbtype ) {
-		case KB_HSU:
-		case KB_DVORAK_HSU:
-			return HsuPhoInput( pgdata, pZuin,key );
-			break;
-		case KB_ET26:
-			return ET26PhoInput( pgdata, pZuin, key );
-			break;
-		case KB_DACHEN_CP26:
-			return DACHENCP26PhoInput( pgdata, pZuin, key );
-			break;
-		case KB_HANYU_PINYIN:
-			return PinYinInput( pgdata, pZuin, key );
-			break;
-		default:
-			return DefPhoInput( pgdata, pZuin, key );
-	}	
-	return ZUIN_ERROR;
+	if ( pZuin->kbtype == KB_HANYU_PINYIN )
+		return PinYinInput( pgdata, pZuin, key );
+	if ( pZuin->kbtype < 0 || pZuin->kbtype >= KB_TYPE_NUM )
+		return LayoutPhoInput( pgdata, pZuin, &STANDARD_LAYOUT, key );
+	return LayoutPhoInput( pgdata, pZuin, LAYOUT[ pZuin->kbtype ], key );
 }
 
 /* remove the latest key */
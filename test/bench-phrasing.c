@@ -0,0 +1,265 @@
+/**
+ * bench-phrasing.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file bench-phrasing.c
+ * @brief Phrasing latency benchmark.
+ *
+ * Replays the key strokes of materials.txt, then synthetic sentences of
+ * every length the buffer can hold, and reports latency percentiles of
+ * every key stroke and of a from-scratch Phrasing() call on the input
+ * left by it, together with the number of allocations made by Phrasing().
+ * The heap bytes of the context before the replay are reported too.
+ *
+ * usage: bench-phrasing [-e enumerate|dp] [-n rounds] [materials.txt]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chewing.h"
+#include "chewing-private.h"
+#include "tree-private.h"
+#include "hash-private.h"
+#include "test.h"
+
+#define MAXLEN 1024
+#define MAX_TOKEN_LEN 16
+
+/* syllables the synthetic sentences are made of */
+static const char *SYLLABLES[] = {
+	"ru.4", "qu/6", "t;6", "rul ", "e; ", "fup6", "xu3", "194", "b4",
+	"y94", "cjo4", "ej/ ", "yji4", "c06", "rm4", "ep ", "vu ", "u;6",
+};
+
+typedef struct {
+	double *sample;
+	int nSample, nAlloc;
+} Samples;
+
+typedef struct {
+	Samples key;	/* usec per key stroke */
+	Samples phrasing;	/* usec per Phrasing() */
+	Samples alloc;	/* arena allocations per Phrasing() */
+	Samples block;	/* heap blocks taken by the arena per Phrasing() */
+} Bench;
+
+static PhrasingOutput phrOut;
+
+static double now_usec()
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void add_sample( Samples *ps, double value )
+{
+	if ( ps->nSample == ps->nAlloc ) {
+		ps->nAlloc = ps->nAlloc ? ps->nAlloc * 2 : 1024;
+		ps->sample = realloc( ps->sample, ps->nAlloc * sizeof( double ) );
+		if ( ! ps->sample ) {
+			fprintf( stderr, "out of memory\n" );
+			exit( 1 );
+		}
+	}
+	ps->sample[ ps->nSample++ ] = value;
+}
+
+static int comp_double( const void *a, const void *b )
+{
+	double diff = *(const double *) a - *(const double *) b;
+
+	return ( diff > 0 ) - ( diff < 0 );
+}
+
+static void report( const char *name, const char *unit, Samples *ps )
+{
+	if ( ps->nSample == 0 ) {
+		printf( "%-18s no samples\n", name );
+		return;
+	}
+	qsort( ps->sample, ps->nSample, sizeof( double ), comp_double );
+	printf( "%-18s n=%-8d p50=%-10.2f p99=%-10.2f max=%-10.2f %s\n",
+		name, ps->nSample,
+		ps->sample[ ps->nSample / 2 ],
+		ps->sample[ ps->nSample * 99 / 100 ],
+		ps->sample[ ps->nSample - 1 ],
+		unit );
+}
+
+/* time Phrasing() on the current input with nothing reused from before */
+static void bench_phrasing( ChewingData *pgdata, Bench *pb )
+{
+	double start;
+
+	if ( pgdata->nPhoneSeq == 0 )
+		return;
+	pgdata->phrasingCache.valid = 0;
+	start = now_usec();
+	Phrasing( pgdata,
+		&phrOut, pgdata->phoneSeq, pgdata->nPhoneSeq,
+		pgdata->selectStr, pgdata->selectInterval, pgdata->nSelect,
+		pgdata->bArrBrkpt, pgdata->bUserArrCnnct );
+	add_sample( &pb->phrasing, now_usec() - start );
+	add_sample( &pb->alloc, pgdata->phrasingArena.nAlloc );
+	add_sample( &pb->block, pgdata->phrasingArena.nBlockAlloc );
+}
+
+/* split keys into key strokes, <X> counts as one */
+static const char *next_token( const char *keys, char *token )
+{
+	const char *end;
+	size_t len = 1;
+
+	if ( *keys == '<' && ( end = strchr( keys, '>' ) ) && end - keys < MAX_TOKEN_LEN )
+		len = end - keys + 1;
+	memcpy( token, keys, len );
+	token[ len ] = '\0';
+	return keys + len;
+}
+
+static void bench_keys( ChewingContext *ctx, const char *keys, Bench *pb )
+{
+	char token[ MAX_TOKEN_LEN + 1 ];
+	double start;
+
+	chewing_Reset( ctx );
+	while ( *keys ) {
+		keys = next_token( keys, token );
+		start = now_usec();
+		type_keystoke_by_string( ctx, token );
+		add_sample( &pb->key, now_usec() - start );
+		bench_phrasing( ctx->data, pb );
+	}
+}
+
+static int bench_materials( ChewingContext *ctx, const char *filename, Bench *pb )
+{
+	FILE *fp = fopen( filename, "r" );
+	char line[ MAXLEN ];
+	char *pos;
+
+	if ( ! fp ) {
+		fprintf( stderr, "cannot open %s\n", filename );
+		return -1;
+	}
+	while ( fgets( line, sizeof( line ), fp ) ) {
+		if ( line[ 0 ] == '#' || line[ 0 ] == ' ' )
+			continue;
+		/* key strokes end with <E>, the expected string follows */
+		pos = strstr( line, "<E>" );
+		if ( ! pos )
+			continue;
+		*pos = '\0';
+		bench_keys( ctx, line, pb );
+	}
+	fclose( fp );
+	return 0;
+}
+
+static void bench_synthetic( ChewingContext *ctx, int maxLen, Bench *pb )
+{
+	char keys[ MAXLEN ];
+	int len, i;
+
+	for ( len = 1; len <= maxLen; len++ ) {
+		keys[ 0 ] = '\0';
+		for ( i = 0; i < len; i++ )
+			strcat( keys, SYLLABLES[ ( len + i ) % ARRAY_SIZE( SYLLABLES ) ] );
+		bench_keys( ctx, keys, pb );
+	}
+}
+
+int main( int argc, char *argv[] )
+{
+	ChewingContext *ctx;
+	const char *materials = "materials.txt";
+	int engine = -1;
+	int rounds = 1;
+	int maxLen;
+	int i;
+	size_t idleBytes, idleHashBytes;
+	Bench bench;
+
+	for ( i = 1; i < argc; i++ ) {
+		if ( ! strcmp( argv[ i ], "-e" ) && i + 1 < argc ) {
+			++i;
+			if ( ! strcmp( argv[ i ], "dp" ) )
+				engine = PHRASING_ENGINE_DP;
+			else if ( ! strcmp( argv[ i ], "enumerate" ) )
+				engine = PHRASING_ENGINE_ENUMERATE;
+			else {
+				fprintf( stderr, "unknown engine %s\n", argv[ i ] );
+				return 1;
+			}
+		}
+		else if ( ! strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			rounds = atoi( argv[ ++i ] );
+		else
+			materials = argv[ i ];
+	}
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	ctx = chewing_new();
+	if ( ! ctx ) {
+		fprintf( stderr, "chewing_new failed\n" );
+		return 1;
+	}
+	/* what a context no key has been typed into keeps */
+	idleHashBytes = HashBytes( ctx->data );
+	idleBytes = sizeof( ChewingContext ) + sizeof( ChewingData ) + sizeof( ChewingOutput ) +
+		idleHashBytes;
+	if ( engine != -1 )
+		chewing_set_phrasingEngine( ctx, engine );
+	/* long enough for every line, but short of a full buffer, on which
+	 * adding a character is known to misbehave */
+	maxLen = MAX_PHONE_SEQ_LEN - 11;
+	chewing_set_maxChiSymbolLen( ctx, maxLen );
+	chewing_set_candPerPage( ctx, 9 );
+
+	memset( &bench, 0, sizeof( bench ) );
+	for ( i = 0; i < rounds; i++ ) {
+		if ( bench_materials( ctx, materials, &bench ) )
+			return 1;
+		bench_synthetic( ctx, maxLen, &bench );
+	}
+
+	printf( "engine: %s\n",
+		chewing_get_phrasingEngine( ctx ) == PHRASING_ENGINE_DP ? "dp" : "enumerate" );
+	report( "key stroke", "usec", &bench.key );
+	report( "Phrasing", "usec", &bench.phrasing );
+	report( "arena allocations", "per Phrasing", &bench.alloc );
+	report( "heap blocks", "per Phrasing", &bench.block );
+	printf( "%-18s n=%-8u %.2f probes per lookup, %u phrases in %u slots\n",
+		"user phrases", ctx->data->session.nHashLookup,
+		ctx->data->session.nHashLookup ?
+			(double) ctx->data->session.nHashProbe / ctx->data->session.nHashLookup : 0.0,
+		ctx->data->session.hashStore->nHashItem,
+		ctx->data->session.hashStore->table ? ctx->data->session.hashStore->table->nSlot : 0 );
+	printf( "%-18s %zu bytes, %zu of them user phrases\n",
+		"idle context", idleBytes, idleHashBytes );
+
+	chewing_delete( ctx );
+	free( bench.key.sample );
+	free( bench.phrasing.sample );
+	free( bench.alloc.sample );
+	free( bench.block.sample );
+	return 0;
+}
@@ -0,0 +1,569 @@
+/**
+ * bench-primitives.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file bench-primitives.c
+ * @brief Microbenchmarks of the dictionary, hash, phrasing and UTF-8 primitives.
+ *
+ * Takes the phone sequences of materials.txt and the phones of the real
+ * dictionary as the input of every primitive, so that a run is the same
+ * from one release to the next. Every benchmark is timed rounds times, and
+ * prints a line of tab separated fields:
+ *
+ *	name	parameter	operations	median ns/op	min ns/op
+ *
+ * Lines starting with '#' are comments.
+ *
+ * usage: bench-primitives [-n rounds] [-u user phrases] [materials.txt]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chewing.h"
+#include "chewing-private.h"
+#include "plat_types.h"
+#include "char-private.h"
+#include "chewing-utf8-util.h"
+#include "container-private.h"
+#include "dict-private.h"
+#include "hash-private.h"
+#include "hanyupinyin-private.h"
+#include "tree-private.h"
+#include "zuin-private.h"
+#include "test.h"
+
+#define USER_DIR	TEST_HASH_DIR PLAT_SEPARATOR "bench"
+#define USER_FILE	USER_DIR PLAT_SEPARATOR HASH_FILE
+#define JOURNAL_FILE	USER_FILE HASH_JOURNAL_SUFFIX ".0"
+#define MAXLEN 1024
+#define MAX_LINE 256
+#define MAX_ROUNDS 64
+#define MAX_SPAN 20000
+#define MAX_USER_PHRASE 100000
+/* the longest buffer Phrasing() is timed on, see bench-phrasing.c */
+#define MAX_SENTENCE ( MAX_PHONE_SEQ_LEN - 11 )
+
+typedef struct {
+	uint16_t phoneSeq[ MAX_PHONE_SEQ_LEN ];
+	int nPhoneSeq;
+} Sentence;
+
+/* a phone sequence and the first phrase of the dictionary on it */
+typedef struct {
+	uint16_t phoneSeq[ MAX_PHRASE_LEN + 1 ];
+	char phrase[ MAX_PHRASE_LEN * MAX_UTF8_SIZE + 1 ];
+	int id;
+} Span;
+
+typedef struct {
+	ChewingContext *ctx;
+	int param;	/* of the benchmark, its own meaning */
+} Arg;
+
+/* returns the number of operations done */
+typedef long (*BenchFunc)( Arg *arg );
+
+static const char *PINYIN[] = {
+	"zhong", "guo", "ren", "min", "jue", "lv", "shi", "xiang", "chuang",
+	"ai", "er", "ying", "wu", "yu", "nv", "qiong", "zhuang", "ba", "hen",
+	"xue", "sheng", "de", "le", "ni", "hao", "peng", "you", "dian", "nao",
+};
+
+static Sentence sentences[ MAX_LINE ];
+static int nSentence;
+/* the sentences one after another */
+static uint16_t stream[ MAX_LINE * MAX_PHONE_SEQ_LEN ];
+static int nStream;
+static Span spans[ MAX_SPAN ];
+static int nSpan;
+static Span userPhrases[ MAX_USER_PHRASE ];
+static int nUserPhrase, nImported;
+static PhrasingOutput phrOut;
+static int rounds = 5;
+
+static double now_nsec()
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int comp_double( const void *a, const void *b )
+{
+	double diff = *(const double *) a - *(const double *) b;
+
+	return ( diff > 0 ) - ( diff < 0 );
+}
+
+/* the same numbers on every run */
+static unsigned int next_random( unsigned int *seed )
+{
+	*seed = *seed * 1103515245 + 12345;
+	return ( *seed >> 16 ) & 0x7fff;
+}
+
+static void run( const char *name, const char *param, BenchFunc func, Arg *arg )
+{
+	double sample[ MAX_ROUNDS ];
+	double start;
+	long nOp = 0;
+	int i;
+
+	/* once to warm the caches up */
+	func( arg );
+	for ( i = 0; i < rounds; i++ ) {
+		start = now_nsec();
+		nOp = func( arg );
+		sample[ i ] = nOp ? ( now_nsec() - start ) / nOp : 0.0;
+	}
+	qsort( sample, rounds, sizeof( double ), comp_double );
+	printf( "%s\t%s\t%ld\t%.1f\t%.1f\n", name, param, nOp, sample[ rounds / 2 ], sample[ 0 ] );
+}
+
+static ChewingContext *new_context()
+{
+	ChewingContext *ctx = chewing_new();
+
+	if ( ! ctx ) {
+		fprintf( stderr, "chewing_new failed\n" );
+		exit( 1 );
+	}
+	/* longer than every line, so that nothing is committed early */
+	chewing_set_maxChiSymbolLen( ctx, MAX_SENTENCE );
+	return ctx;
+}
+
+/* the phone sequences of materials.txt, as typed before <E> */
+static int load_sentences( ChewingContext *ctx, const char *filename )
+{
+	FILE *fp = fopen( filename, "r" );
+	char line[ MAXLEN ];
+	char *pos;
+	Sentence *ps;
+
+	if ( ! fp ) {
+		fprintf( stderr, "cannot open %s\n", filename );
+		return -1;
+	}
+	while ( nSentence < MAX_LINE && fgets( line, sizeof( line ), fp ) ) {
+		if ( line[ 0 ] == '#' || line[ 0 ] == ' ' )
+			continue;
+		pos = strstr( line, "<E>" );
+		if ( ! pos )
+			continue;
+		*pos = '\0';
+		chewing_Reset( ctx );
+		type_keystoke_by_string( ctx, line );
+		ps = &sentences[ nSentence ];
+		ps->nPhoneSeq = ctx->data->nPhoneSeq;
+		memcpy( ps->phoneSeq, ctx->data->phoneSeq, ps->nPhoneSeq * sizeof( uint16_t ) );
+		memcpy( &stream[ nStream ], ps->phoneSeq, ps->nPhoneSeq * sizeof( uint16_t ) );
+		nStream += ps->nPhoneSeq;
+		if ( ps->nPhoneSeq > 0 )
+			nSentence++;
+	}
+	fclose( fp );
+	chewing_Reset( ctx );
+	return nSentence ? 0 : -1;
+}
+
+static uint16_t random_phone( ChewingData *pgdata, unsigned int *seed )
+{
+	unsigned int i = ( next_random( seed ) << 15 | next_random( seed ) ) %
+		pgdata->static_data->phone_num;
+
+	return GetUint16LE( &pgdata->static_data->arrPhone[ i ] );
+}
+
+static int span_phrase( ChewingData *pgdata, Span *pspan, const uint16_t *phoneSeq, int len )
+{
+	Phrase phrase;
+
+	pspan->id = TreeFindPhrase( pgdata, 0, len - 1, phoneSeq );
+	if ( pspan->id == -1 || ! GetPhraseFirst( pgdata, &phrase, pspan->id ) )
+		return 0;
+	memcpy( pspan->phoneSeq, phoneSeq, len * sizeof( uint16_t ) );
+	pspan->phoneSeq[ len ] = 0;
+	strcpy( pspan->phrase, phrase.phrase );
+	return 1;
+}
+
+/* every span of the sentences that is a phrase of the dictionary */
+static void find_spans( ChewingData *pgdata )
+{
+	int i, begin, len;
+
+	for ( i = 0; i < nSentence; i++ ) {
+		for ( begin = 0; begin < sentences[ i ].nPhoneSeq; begin++ ) {
+			for ( len = 1; len <= MAX_PHRASE_LEN &&
+					begin + len <= sentences[ i ].nPhoneSeq; len++ ) {
+				if ( nSpan == MAX_SPAN )
+					return;
+				nSpan += span_phrase( pgdata, &spans[ nSpan ],
+					&sentences[ i ].phoneSeq[ begin ], len );
+			}
+		}
+	}
+}
+
+/*
+ * The phrases of the sentences, then phrases of two random phones of the
+ * dictionary, as the phrases a user dictionary grows with.
+ */
+static void find_user_phrases( ChewingData *pgdata, int n )
+{
+	unsigned int seed = 1;
+	uint16_t phoneSeq[ 2 ];
+
+	if ( n > MAX_USER_PHRASE )
+		n = MAX_USER_PHRASE;
+	for ( nUserPhrase = 0; nUserPhrase < n && nUserPhrase < nSpan; nUserPhrase++ )
+		userPhrases[ nUserPhrase ] = spans[ nUserPhrase ];
+	while ( nUserPhrase < n ) {
+		phoneSeq[ 0 ] = random_phone( pgdata, &seed );
+		phoneSeq[ 1 ] = random_phone( pgdata, &seed );
+		nUserPhrase += span_phrase( pgdata, &userPhrases[ nUserPhrase ], phoneSeq, 2 );
+	}
+}
+
+static int read_user_phrase( void *userdata, ChewingUserPhrase *entry )
+{
+	int *next = userdata;
+
+	if ( *next == nUserPhrase )
+		return 0;
+	entry->phoneSeq = userPhrases[ *next ].phoneSeq;
+	entry->phrase = userPhrases[ *next ].phrase;
+	entry->freq = 0;
+	++*next;
+	return 1;
+}
+
+/* a context whose user dictionary holds the first n user phrases */
+static ChewingContext *new_user_context( int n )
+{
+	ChewingContext *ctx;
+	int next = 0, saved = nUserPhrase;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+	ctx = new_context();
+	nUserPhrase = n;
+	nImported = chewing_userphrase_import( ctx, read_user_phrase, &next );
+	nUserPhrase = saved;
+	return ctx;
+}
+
+static long bench_tree_find_phrase( Arg *arg )
+{
+	ChewingData *pgdata = arg->ctx->data;
+	long nOp = 0;
+	int i, begin, end;
+
+	for ( i = 0; i < nSentence; i++ ) {
+		for ( begin = 0; begin < sentences[ i ].nPhoneSeq; begin++ ) {
+			for ( end = begin; end < begin + MAX_PHRASE_LEN &&
+					end < sentences[ i ].nPhoneSeq; end++ ) {
+				TreeFindPhrase( pgdata, begin, end, sentences[ i ].phoneSeq );
+				nOp++;
+			}
+		}
+	}
+	return nOp;
+}
+
+/* every character of every phone of the dictionary */
+static long bench_get_char( Arg *arg )
+{
+	ChewingData *pgdata = arg->ctx->data;
+	Word word;
+	long nOp = 0;
+	size_t i;
+
+	for ( i = 0; i < pgdata->static_data->phone_num; i++ ) {
+		if ( ! GetCharFirst( pgdata, &word,
+				GetUint16LE( &pgdata->static_data->arrPhone[ i ] ) ) )
+			continue;
+		do {
+			nOp++;
+		} while ( GetCharNext( pgdata, &word ) );
+	}
+	return nOp;
+}
+
+/* every phrase of the phrase ids of the spans */
+static long bench_get_phrase( Arg *arg )
+{
+	ChewingData *pgdata = arg->ctx->data;
+	Phrase phrase;
+	long nOp = 0;
+	int i;
+
+	for ( i = 0; i < nSpan; i++ ) {
+		if ( ! GetPhraseFirst( pgdata, &phrase, spans[ i ].id ) )
+			continue;
+		do {
+			nOp++;
+		} while ( GetPhraseNext( pgdata, &phrase ) );
+	}
+	return nOp;
+}
+
+/* the phrases on every span of the sentences, found or not */
+static long bench_hash_find( Arg *arg )
+{
+	ChewingData *pgdata = arg->ctx->data;
+	uint16_t phoneSeq[ MAX_PHRASE_LEN + 1 ];
+	HashCursor cursor;
+	HASH_ITEM *pItem;
+	long nOp = 0;
+	int i, begin, len;
+
+	for ( i = 0; i < nSentence; i++ ) {
+		for ( begin = 0; begin < sentences[ i ].nPhoneSeq; begin++ ) {
+			for ( len = 1; len <= MAX_PHRASE_LEN &&
+					begin + len <= sentences[ i ].nPhoneSeq; len++ ) {
+				memcpy( phoneSeq, &sentences[ i ].phoneSeq[ begin ], len * sizeof( uint16_t ) );
+				phoneSeq[ len ] = 0;
+				HashReadBegin( pgdata );
+				for ( pItem = HashFindPhonePhrase( pgdata, phoneSeq, &cursor ); pItem;
+						pItem = HashFindNextPhrase( pgdata, phoneSeq, &cursor ) )
+					;
+				HashReadEnd( pgdata );
+				nOp++;
+			}
+		}
+	}
+	return nOp;
+}
+
+static long bench_pinyin( Arg *arg )
+{
+	char pinyin[ 16 ], zuin[ 16 ];
+	long nOp = 0;
+	int i, n;
+
+	for ( n = 0; n < 100; n++ ) {
+		for ( i = 0; i < (int) ARRAY_SIZE( PINYIN ); i++ ) {
+			strcpy( pinyin, PINYIN[ i ] );
+			HanyuPinYinToZuin( arg->ctx->data, pinyin, zuin );
+			nOp++;
+		}
+	}
+	return nOp;
+}
+
+/* random keys of the layout, a syllable of at most 4 keys at a time */
+static long bench_zuin( Arg *arg )
+{
+	static const char KEYS[] = "1234567890-qwertyuiopasdfghjkl;zxcvbnm,./ ";
+	ChewingData *pgdata = arg->ctx->data;
+	ZuinData zuin;
+	unsigned int seed = 1;
+	long nOp;
+
+	memset( &zuin, 0, sizeof( zuin ) );
+	zuin.kbtype = arg->param;
+	for ( nOp = 0; nOp < 100000; nOp++ ) {
+		if ( ( nOp & 3 ) == 0 ) {
+			memset( &zuin, 0, sizeof( zuin ) );
+			zuin.kbtype = arg->param;
+		}
+		ZuinPhoInput( pgdata, &zuin, KEYS[ next_random( &seed ) % ( sizeof( KEYS ) - 1 ) ] );
+	}
+	return nOp;
+}
+
+/* param phones out of those of materials.txt, from scratch */
+static long bench_phrasing( Arg *arg )
+{
+	ChewingData *pgdata = arg->ctx->data;
+	uint16_t phoneSeq[ MAX_PHONE_SEQ_LEN ];
+	long nOp = 0;
+	int i;
+
+	for ( i = 0; i < nSentence; i++ ) {
+		memcpy( phoneSeq, &stream[ i * 7 % ( nStream - arg->param + 1 ) ],
+			arg->param * sizeof( uint16_t ) );
+		pgdata->phrasingCache.valid = 0;
+		Phrasing( pgdata,
+			&phrOut, phoneSeq, arg->param,
+			pgdata->selectStr, pgdata->selectInterval, 0,
+			pgdata->bArrBrkpt, pgdata->bUserArrCnnct );
+		nOp++;
+	}
+	return nOp;
+}
+
+/* the sentences of materials.txt, whole */
+static long bench_convert( Arg *arg )
+{
+	char buf[ MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ];
+	long nOp = 0;
+	int i;
+
+	for ( i = 0; i < nSentence; i++ ) {
+		chewing_convert_phone( arg->ctx, sentences[ i ].phoneSeq, sentences[ i ].nPhoneSeq,
+			buf, sizeof( buf ), NULL, NULL );
+		nOp++;
+	}
+	return nOp;
+}
+
+/* the first param phones of materials.txt, a window at a time beyond the buffer */
+static long bench_convert_long( Arg *arg )
+{
+	static char buf[ MAX_LINE * MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ];
+	long nOp;
+
+	for ( nOp = 0; nOp < 4; nOp++ )
+		chewing_convert_phone( arg->ctx, stream, arg->param, buf, sizeof( buf ), NULL, NULL );
+	return nOp;
+}
+
+/*
+ * Counts the characters of the phrases of the spans, param 0, or of all of
+ * them in one string, then finds the end of them by those characters;
+ * three operations each.
+ */
+static long bench_utf8( Arg *arg )
+{
+	static char text[ MAX_SPAN * 8 ];
+	static size_t nText;
+	long nOp = 0;
+	int i, n;
+
+	if ( nText == 0 ) {
+		for ( i = 0; i < nSpan && nText + sizeof( spans[ i ].phrase ) < sizeof( text ); i++ ) {
+			strcpy( text + nText, spans[ i ].phrase );
+			nText += strlen( spans[ i ].phrase );
+		}
+	}
+	if ( arg->param ) {
+		n = ueStrLen( text );
+		if ( ueStrNBytes( text, n ) == (int) nText && ueStrSeek( text, n ) == text + nText )
+			nOp += 3;
+		return nOp;
+	}
+	for ( i = 0; i < nSpan; i++ ) {
+		n = ueStrLen( spans[ i ].phrase );
+		if ( ueStrNBytes( spans[ i ].phrase, n ) > 0 && *ueStrSeek( spans[ i ].phrase, n ) == '\0' )
+			nOp += 3;
+	}
+	return nOp;
+}
+
+static long bench_new_delete( Arg *arg UNUSED )
+{
+	long nOp;
+
+	for ( nOp = 0; nOp < 20; nOp++ )
+		chewing_delete( chewing_new() );
+	return nOp;
+}
+
+int main( int argc, char *argv[] )
+{
+	static const int USER_SIZES[] = { 100, 1000, 10000 };
+	static const int SENTENCE_LENS[] = { 1, 2, 4, 8, 16, 32, MAX_SENTENCE };
+	/* enumerating every segmentation from scratch takes too long beyond */
+	static const int MAX_ENUMERATE_LEN = 16;
+	const char *materials = "materials.txt";
+	int maxUser = 10000;
+	char param[ 32 ];
+	char *kbString;
+	Arg arg;
+	int i;
+
+	for ( i = 1; i < argc; i++ ) {
+		if ( ! strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			rounds = atoi( argv[ ++i ] );
+		else if ( ! strcmp( argv[ i ], "-u" ) && i + 1 < argc )
+			maxUser = atoi( argv[ ++i ] );
+		else
+			materials = argv[ i ];
+	}
+	if ( rounds < 1 || rounds > MAX_ROUNDS ) {
+		fprintf( stderr, "rounds must be 1 to %d\n", MAX_ROUNDS );
+		return 1;
+	}
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" USER_DIR );
+	PLAT_MKDIR( USER_DIR );
+
+	/* nothing the user has learned, the dictionary alone */
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+	arg.ctx = new_context();
+	arg.param = 0;
+	if ( load_sentences( arg.ctx, materials ) )
+		return 1;
+	find_spans( arg.ctx->data );
+	find_user_phrases( arg.ctx->data, maxUser );
+	printf( "# %d sentences, %d phrase spans, %d user phrases at most\n",
+		nSentence, nSpan, nUserPhrase );
+	printf( "# name\tparameter\toperations\tmedian ns/op\tmin ns/op\n" );
+
+	run( "TreeFindPhrase", "-", bench_tree_find_phrase, &arg );
+	run( "GetCharFirst/Next", "-", bench_get_char, &arg );
+	run( "GetPhraseFirst/Next", "-", bench_get_phrase, &arg );
+	run( "HanyuPinYinToZuin", "-", bench_pinyin, &arg );
+	arg.param = 0;
+	run( "ueStrLen/NBytes/Seek", "phrase", bench_utf8, &arg );
+	arg.param = 1;
+	run( "ueStrLen/NBytes/Seek", "text", bench_utf8, &arg );
+	for ( arg.param = 0; arg.param < KB_TYPE_NUM; arg.param++ ) {
+		chewing_set_KBType( arg.ctx, arg.param );
+		kbString = chewing_get_KBString( arg.ctx );
+		run( "ZuinPhoInput", kbString, bench_zuin, &arg );
+		free( kbString );
+	}
+	for ( i = 0; i < (int) ARRAY_SIZE( SENTENCE_LENS ) && SENTENCE_LENS[ i ] <= nStream; i++ ) {
+		arg.param = SENTENCE_LENS[ i ];
+		if ( arg.param <= MAX_ENUMERATE_LEN ) {
+			chewing_set_phrasingEngine( arg.ctx, PHRASING_ENGINE_ENUMERATE );
+			sprintf( param, "enumerate:%d", arg.param );
+			run( "Phrasing", param, bench_phrasing, &arg );
+		}
+		chewing_set_phrasingEngine( arg.ctx, PHRASING_ENGINE_DP );
+		sprintf( param, "dp:%d", arg.param );
+		run( "Phrasing", param, bench_phrasing, &arg );
+	}
+	chewing_set_phrasingEngine( arg.ctx, PHRASING_ENGINE_ENUMERATE );
+	run( "chewing_convert_phone", "sentence", bench_convert, &arg );
+	for ( arg.param = 2 * MAX_PHONE_SEQ_LEN; arg.param <= nStream; arg.param *= 2 ) {
+		sprintf( param, "phones:%d", arg.param );
+		run( "chewing_convert_phone", param, bench_convert_long, &arg );
+	}
+	chewing_delete( arg.ctx );
+
+	for ( i = 0; i < (int) ARRAY_SIZE( USER_SIZES ) && USER_SIZES[ i ] <= nUserPhrase; i++ ) {
+		arg.ctx = new_user_context( USER_SIZES[ i ] );
+		sprintf( param, "user:%d", nImported );
+		run( "HashFindPhonePhrase", param, bench_hash_find, &arg );
+		chewing_delete( arg.ctx );
+	}
+
+	/* with the largest user dictionary left behind */
+	arg.ctx = NULL;
+	run( "chewing_new/delete", "-", bench_new_delete, &arg );
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+	return 0;
+}
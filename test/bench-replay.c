@@ -0,0 +1,257 @@
+/**
+ * bench-replay.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file bench-replay.c
+ * @brief Key stroke latency of replayed traces.
+ *
+ * Replays key stroke traces in the format of materials.txt, the keys of a
+ * line up to <E>, on one context set up as testchewing does, and times
+ * every chewing_handle_* call. The latencies are reported by the kind of
+ * key, and by the length of the buffer the key was typed into, as lines of
+ * tab separated fields:
+ *
+ *	group	value	keys	p50	p95	p99	max
+ *
+ * in microseconds. Lines starting with '#' are comments.
+ *
+ * usage: bench-replay [-n rounds] [trace ...]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chewing.h"
+#include "test.h"
+
+#define MAXLEN 1024
+#define MAX_TOKEN_LEN 16
+
+typedef struct {
+	double *sample;
+	int nSample, nAlloc;
+} Samples;
+
+enum {
+	KIND_SYLLABLE_END,	/* a key ending a syllable */
+	KIND_PHONE,	/* another key of a syllable, or a selection key */
+	KIND_SPACE,
+	KIND_TAB,
+	KIND_DOWN,
+	KIND_ENTER,
+	KIND_OTHER,
+	KIND_NUM
+};
+
+static const char *KIND_NAME[ KIND_NUM ] = {
+	"syllable-end", "phone", "space", "tab", "down", "enter", "other",
+};
+
+/* the first length of every group of buffer lengths */
+static const int BUFFER_LEN_FROM[] = { 0, 1, 5, 9, 17, 33 };
+#define BUFFER_LEN_NUM ARRAY_SIZE( BUFFER_LEN_FROM )
+
+static Samples byKind[ KIND_NUM ];
+static Samples byLen[ BUFFER_LEN_NUM ];
+static Samples all;
+
+static int selKey_define[ 11 ] = {'1','2','3','4','5','6','7','8','9','0',0};
+
+static double now_usec()
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void add_sample( Samples *ps, double value )
+{
+	if ( ps->nSample == ps->nAlloc ) {
+		ps->nAlloc = ps->nAlloc ? ps->nAlloc * 2 : 1024;
+		ps->sample = realloc( ps->sample, ps->nAlloc * sizeof( double ) );
+		if ( ! ps->sample ) {
+			fprintf( stderr, "out of memory\n" );
+			exit( 1 );
+		}
+	}
+	ps->sample[ ps->nSample++ ] = value;
+}
+
+static int comp_double( const void *a, const void *b )
+{
+	double diff = *(const double *) a - *(const double *) b;
+
+	return ( diff > 0 ) - ( diff < 0 );
+}
+
+static void report( const char *group, const char *value, Samples *ps )
+{
+	if ( ps->nSample == 0 )
+		return;
+	qsort( ps->sample, ps->nSample, sizeof( double ), comp_double );
+	printf( "%s\t%s\t%d\t%.2f\t%.2f\t%.2f\t%.2f\n",
+		group, value, ps->nSample,
+		ps->sample[ ps->nSample / 2 ],
+		ps->sample[ ps->nSample * 95 / 100 ],
+		ps->sample[ ps->nSample * 99 / 100 ],
+		ps->sample[ ps->nSample - 1 ] );
+	free( ps->sample );
+}
+
+/* split keys into key strokes, <X> counts as one */
+static const char *next_token( const char *keys, char *token )
+{
+	const char *end;
+	size_t len = 1;
+
+	if ( *keys == '<' && ( end = strchr( keys + 1, '>' ) ) && end - keys < MAX_TOKEN_LEN )
+		len = end - keys + 1;
+	memcpy( token, keys, len );
+	token[ len ] = '\0';
+	return keys + len;
+}
+
+/* whether a syllable is being typed, chewing_zuin_Check() is 1 if it is not */
+static int has_zuin( ChewingContext *ctx )
+{
+	return ! chewing_zuin_Check( ctx );
+}
+
+static int key_kind( const char *token, int zuinBefore, int zuinAfter )
+{
+	if ( ! strcmp( token, " " ) )
+		return KIND_SPACE;
+	if ( ! strcmp( token, "<T>" ) )
+		return KIND_TAB;
+	if ( ! strcmp( token, "<D>" ) )
+		return KIND_DOWN;
+	if ( ! strcmp( token, "<E>" ) )
+		return KIND_ENTER;
+	if ( token[ 1 ] != '\0' )
+		return KIND_OTHER;
+	return ( zuinBefore && ! zuinAfter ) ? KIND_SYLLABLE_END : KIND_PHONE;
+}
+
+static int buffer_len_group( int len )
+{
+	int i = BUFFER_LEN_NUM - 1;
+
+	while ( len < BUFFER_LEN_FROM[ i ] )
+		i--;
+	return i;
+}
+
+static void replay_keys( ChewingContext *ctx, const char *keys )
+{
+	char token[ MAX_TOKEN_LEN + 1 ];
+	int zuinBefore, bufferLen;
+	double start, elapsed;
+
+	while ( *keys ) {
+		keys = next_token( keys, token );
+		zuinBefore = has_zuin( ctx );
+		bufferLen = chewing_buffer_Len( ctx );
+		start = now_usec();
+		type_keystoke_by_string( ctx, token );
+		elapsed = now_usec() - start;
+		add_sample( &byKind[ key_kind( token, zuinBefore, has_zuin( ctx ) ) ], elapsed );
+		add_sample( &byLen[ buffer_len_group( bufferLen ) ], elapsed );
+		add_sample( &all, elapsed );
+	}
+}
+
+static int replay_trace( ChewingContext *ctx, const char *filename )
+{
+	FILE *fp = fopen( filename, "r" );
+	char line[ MAXLEN ];
+	char *pos;
+
+	if ( ! fp ) {
+		fprintf( stderr, "cannot open %s\n", filename );
+		return -1;
+	}
+	while ( fgets( line, sizeof( line ), fp ) ) {
+		if ( line[ 0 ] == '#' || line[ 0 ] == ' ' )
+			continue;
+		/* key strokes end with <E>, the expected string follows */
+		pos = strstr( line, "<E>" );
+		if ( ! pos )
+			continue;
+		pos[ 3 ] = '\0';
+		replay_keys( ctx, line );
+	}
+	fclose( fp );
+	return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+	static const char *DEFAULT_TRACE[] = { "materials.txt" };
+	const char **traces = DEFAULT_TRACE;
+	int nTrace = 1;
+	int rounds = 1;
+	ChewingContext *ctx;
+	char value[ 32 ];
+	int i, round;
+
+	for ( i = 1; i < argc; i++ ) {
+		if ( ! strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			rounds = atoi( argv[ ++i ] );
+		else
+			break;
+	}
+	if ( i < argc ) {
+		traces = (const char **) &argv[ i ];
+		nTrace = argc - i;
+	}
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	ctx = chewing_new();
+	if ( ! ctx ) {
+		fprintf( stderr, "chewing_new failed\n" );
+		return 1;
+	}
+	/* as testchewing, which the traces are written for */
+	chewing_set_candPerPage( ctx, 9 );
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	chewing_set_addPhraseDirection( ctx, 1 );
+	chewing_set_selKey( ctx, selKey_define, 10 );
+	chewing_set_spaceAsSelection( ctx, 1 );
+
+	for ( round = 0; round < rounds; round++ ) {
+		for ( i = 0; i < nTrace; i++ ) {
+			if ( replay_trace( ctx, traces[ i ] ) )
+				return 1;
+		}
+	}
+	chewing_delete( ctx );
+
+	printf( "# group\tvalue\tkeys\tp50\tp95\tp99\tmax (usec)\n" );
+	report( "all", "-", &all );
+	for ( i = 0; i < KIND_NUM; i++ )
+		report( "key", KIND_NAME[ i ], &byKind[ i ] );
+	for ( i = 0; i < (int) BUFFER_LEN_NUM; i++ ) {
+		if ( i + 1 < (int) BUFFER_LEN_NUM )
+			sprintf( value, "%d-%d", BUFFER_LEN_FROM[ i ], BUFFER_LEN_FROM[ i + 1 ] - 1 );
+		else
+			sprintf( value, "%d-", BUFFER_LEN_FROM[ i ] );
+		report( "buffer", value, &byLen[ i ] );
+	}
+	return 0;
+}
@@ -0,0 +1,443 @@
+/**
+ * bench-startup.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file bench-startup.c
+ * @brief Start up, phase by phase, with the page cache cold and warm.
+ *
+ * Runs the phases chewing_new() goes through one at a time, as
+ * InitStaticData() in chewingio.c does, then the first touch of every page
+ * of the dictionary, the load of a user dictionary of phrases, and, through
+ * the API, chewing_new() and the time until the first candidate list. The
+ * warm rounds follow one another; before every cold one the dictionary and
+ * the user dictionary are dropped from the page cache, by drop_caches where
+ * permitted and by posix_fadvise() otherwise. With USE_EMBEDDED_DATA the
+ * dictionary is in the binary and is neither searched for nor mapped. Every phase prints a line of
+ * tab separated fields:
+ *
+ *	phase	cache	rounds	median usec	min usec
+ *
+ * Lines starting with '#' are comments.
+ *
+ * usage: bench-startup [-n rounds] [-u user phrases]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "chewing.h"
+#include "chewing-private.h"
+#include "plat_path.h"
+#include "plat_types.h"
+#include "char-private.h"
+#include "chewingutil.h"
+#include "datafile-private.h"
+#include "dict-private.h"
+#include "global-private.h"
+#include "hanyupinyin-private.h"
+#include "hash-private.h"
+#include "tree-private.h"
+#include "zuin-private.h"
+#include "test.h"
+
+#define USER_DIR	TEST_HASH_DIR PLAT_SEPARATOR "startup"
+#define USER_FILE	USER_DIR PLAT_SEPARATOR HASH_FILE
+#define MAX_ROUNDS 64
+#define MAX_USER_PHRASE 100000
+
+enum {
+	PHASE_PATH,
+	PHASE_MMAP,
+	PHASE_CHAR,
+	PHASE_DICT,
+	PHASE_TREE,
+	PHASE_SYMBOL,
+	PHASE_EASY_SYMBOL,
+	PHASE_PINYIN,
+	PHASE_ZUIN,
+	PHASE_TOUCH,
+	PHASE_HASH,
+	PHASE_CHEWING_NEW,
+	PHASE_FIRST_CANDIDATE,
+	PHASE_NUM
+};
+
+static const char *PHASE_NAME[ PHASE_NUM ] = {
+	"path", "mmap", "char", "dict", "tree", "symbol", "easy-symbol", "pinyin",
+	"zuin", "touch", "hash", "chewing_new", "first-candidate",
+};
+
+enum {
+	CACHE_WARM,
+	CACHE_COLD,
+	CACHE_NUM
+};
+
+static const char *CACHE_NAME[ CACHE_NUM ] = { "warm", "cold" };
+
+/* a phone sequence and the first phrase of the dictionary on it */
+typedef struct {
+	uint16_t phoneSeq[ 3 ];
+	char phrase[ 2 * MAX_UTF8_SIZE + 1 ];
+} UserPhrase;
+
+static double sample[ PHASE_NUM ][ CACHE_NUM ][ MAX_ROUNDS ];
+static UserPhrase userPhrases[ MAX_USER_PHRASE ];
+static int nUserPhrase;
+static char dataFile[ PATH_MAX ];
+static int rounds = 10;
+
+static double now_usec()
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int comp_double( const void *a, const void *b )
+{
+	double diff = *(const double *) a - *(const double *) b;
+
+	return ( diff > 0 ) - ( diff < 0 );
+}
+
+/* the same numbers on every run */
+static unsigned int next_random( unsigned int *seed )
+{
+	*seed = *seed * 1103515245 + 12345;
+	return ( *seed >> 16 ) & 0x7fff;
+}
+
+/* drop filename from the page cache, 0 if it could be */
+static int evict_file( const char *filename )
+{
+#ifdef POSIX_FADV_DONTNEED
+	int fd = open( filename, O_RDONLY );
+	int ret;
+
+	if ( fd < 0 )
+		return -1;
+	/* dirty pages are not dropped */
+	fdatasync( fd );
+	ret = posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+	close( fd );
+	return ret ? -1 : 0;
+#else
+	(void) filename;
+	return -1;
+#endif
+}
+
+/* drop the dictionaries from the page cache, and say how once */
+static void evict_cache()
+{
+	static const char *how;
+	FILE *fp;
+
+	sync();
+	fp = fopen( "/proc/sys/vm/drop_caches", "w" );
+	if ( fp && fputs( "1", fp ) >= 0 && fclose( fp ) == 0 ) {
+		if ( ! how )
+			printf( "# %s\n", how = "cold: by drop_caches" );
+		return;
+	}
+	if ( fp )
+		fclose( fp );
+	/* the data is no file with USE_EMBEDDED_DATA */
+	if ( ( evict_file( dataFile ) == 0 ) | ( evict_file( USER_FILE ) == 0 ) ) {
+		if ( ! how )
+			printf( "# %s\n", how = "cold: by posix_fadvise" );
+		return;
+	}
+	if ( ! how )
+		printf( "# %s\n", how = "cold: not permitted, the cold rounds are warm" );
+}
+
+#ifdef USE_BINARY_DATA
+static void start_phase( double *last )
+{
+	*last = now_usec();
+}
+
+static void end_phase( double *last, int phase, int cache, int round )
+{
+	double now = now_usec();
+
+	sample[ phase ][ cache ][ round ] = now - *last;
+	*last = now;
+}
+
+/* what InitStaticData() does, a phase at a time */
+static int init_static_data( ChewingData *pgdata, int cache, int round )
+{
+	static const char * const DATA_FILES[] = { STATIC_DATA_FILE, NULL };
+	char search_path[ PATH_MAX ];
+	char path[ PATH_MAX ];
+	volatile const char *p;
+	const char *end;
+	char sum = 0;
+	double last;
+
+	start_phase( &last );
+#ifdef USE_EMBEDDED_DATA
+	/* linked in, nothing to search for */
+	(void) search_path;
+	(void) DATA_FILES;
+	path[ 0 ] = '\0';
+#else
+	if ( get_search_path( search_path, sizeof( search_path ) ) ||
+			find_path_by_files( search_path, DATA_FILES, path, sizeof( path ) ) )
+		return -1;
+#endif
+	end_phase( &last, PHASE_PATH, cache, round );
+
+	if ( InitDataFile( pgdata, path ) )
+		return -1;
+	end_phase( &last, PHASE_MMAP, cache, round );
+	if ( InitChar( pgdata, path ) )
+		return -1;
+	end_phase( &last, PHASE_CHAR, cache, round );
+	if ( InitDict( pgdata, path ) )
+		return -1;
+	end_phase( &last, PHASE_DICT, cache, round );
+	if ( InitTree( pgdata, path ) )
+		return -1;
+	end_phase( &last, PHASE_TREE, cache, round );
+	if ( InitSymbolTable( pgdata, path ) )
+		return -1;
+	end_phase( &last, PHASE_SYMBOL, cache, round );
+	if ( InitEasySymbolInput( pgdata, path ) )
+		return -1;
+	end_phase( &last, PHASE_EASY_SYMBOL, cache, round );
+	if ( ! InitHanyuPinYin( pgdata, path ) )
+		return -1;
+	end_phase( &last, PHASE_PINYIN, cache, round );
+	if ( InitZuin( pgdata ) )
+		return -1;
+	end_phase( &last, PHASE_ZUIN, cache, round );
+
+	/* the faults the lookups would take on the pages they reach */
+	p = pgdata->static_data->data;
+	end = (const char *) p + pgdata->static_data->dataSize;
+	for ( ; p < end; p += 4096 )
+		sum += *p;
+	end_phase( &last, PHASE_TOUCH, cache, round );
+
+	if ( InitHash( pgdata ) < 0 )
+		return -1;
+	end_phase( &last, PHASE_HASH, cache, round );
+	(void) sum;
+#ifndef USE_EMBEDDED_DATA
+	strcpy( dataFile, path );
+	strcat( dataFile, PLAT_SEPARATOR STATIC_DATA_FILE );
+#endif
+	return 0;
+}
+
+static void terminate_static_data( ChewingData *pgdata )
+{
+	TerminateHash( pgdata );
+	TerminateHanyuPinyin( pgdata );
+	TerminateEasySymbolTable( pgdata );
+	TerminateSymbolTable( pgdata );
+	TerminateTree( pgdata );
+	TerminateDict( pgdata );
+	TerminateChar( pgdata );
+	TerminateDataFile( pgdata );
+}
+
+static int run_phases( int cache, int round )
+{
+	ChewingData *pgdata = calloc( 1, sizeof( ChewingData ) );
+	int ret;
+
+	if ( ! pgdata || ! ( pgdata->static_data = calloc( 1, sizeof( ChewingStaticData ) ) ) ) {
+		fprintf( stderr, "out of memory\n" );
+		exit( 1 );
+	}
+	plat_mmap_set_invalid( &pgdata->static_data->data_mmap );
+	ret = init_static_data( pgdata, cache, round );
+	terminate_static_data( pgdata );
+	free( pgdata->static_data );
+	free( pgdata );
+	return ret;
+}
+#endif
+
+/* chewing_new(), then the keys of a syllable and down for its candidates */
+static int run_first_candidate( int cache, int round )
+{
+	ChewingContext *ctx;
+	double start, created;
+	int nChoice;
+
+	start = now_usec();
+	ctx = chewing_new();
+	created = now_usec();
+	if ( ! ctx )
+		return -1;
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	type_keystoke_by_string( ctx, "hk4<D>" );
+	nChoice = chewing_cand_TotalChoice( ctx );
+	sample[ PHASE_FIRST_CANDIDATE ][ cache ][ round ] = now_usec() - start;
+	sample[ PHASE_CHEWING_NEW ][ cache ][ round ] = created - start;
+	chewing_delete( ctx );
+	return nChoice > 0 ? 0 : -1;
+}
+
+/* phrases of two random phones of the dictionary, as a user dictionary grows */
+static void find_user_phrases( ChewingContext *ctx, int n )
+{
+	ChewingData *pgdata = ctx->data;
+	unsigned int seed = 1, i;
+	UserPhrase *pu;
+	Phrase phrase;
+	int id;
+
+	for ( nUserPhrase = 0; nUserPhrase < n; ) {
+		pu = &userPhrases[ nUserPhrase ];
+		for ( i = 0; i < 2; i++ ) {
+			pu->phoneSeq[ i ] = GetUint16LE( &pgdata->static_data->arrPhone[
+				( next_random( &seed ) << 15 | next_random( &seed ) ) %
+				pgdata->static_data->phone_num ] );
+		}
+		pu->phoneSeq[ 2 ] = 0;
+		id = TreeFindPhrase( pgdata, 0, 1, pu->phoneSeq );
+		if ( id == -1 || ! GetPhraseFirst( pgdata, &phrase, id ) )
+			continue;
+		strcpy( pu->phrase, phrase.phrase );
+		nUserPhrase++;
+	}
+}
+
+static int read_user_phrase( void *userdata, ChewingUserPhrase *entry )
+{
+	int *next = userdata;
+
+	if ( *next == nUserPhrase )
+		return 0;
+	entry->phoneSeq = userPhrases[ *next ].phoneSeq;
+	entry->phrase = userPhrases[ *next ].phrase;
+	entry->freq = 0;
+	++*next;
+	return 1;
+}
+
+static void remove_user_files()
+{
+	char filename[ sizeof( USER_FILE HASH_JOURNAL_SUFFIX ) + 8 ];
+	int slot;
+
+	remove( USER_FILE );
+	for ( slot = 0; slot < HASH_JOURNAL_SLOTS; slot++ ) {
+		snprintf( filename, sizeof( filename ), "%s" HASH_JOURNAL_SUFFIX ".%d",
+			USER_FILE, slot );
+		remove( filename );
+	}
+}
+
+/* a user dictionary of n phrases, written and flushed */
+static int make_user_dictionary( int n )
+{
+	ChewingContext *ctx;
+	int next = 0, nImported;
+
+	remove_user_files();
+	ctx = chewing_new();
+	if ( ! ctx )
+		return -1;
+	find_user_phrases( ctx, n );
+	nImported = chewing_userphrase_import( ctx, read_user_phrase, &next );
+	chewing_userphrase_flush( ctx );
+	chewing_delete( ctx );
+	return nImported;
+}
+
+static void report( int phase, int cache )
+{
+	double *ps = sample[ phase ][ cache ];
+
+	qsort( ps, rounds, sizeof( double ), comp_double );
+	printf( "%s\t%s\t%d\t%.1f\t%.1f\n",
+		PHASE_NAME[ phase ], CACHE_NAME[ cache ], rounds, ps[ rounds / 2 ], ps[ 0 ] );
+}
+
+int main( int argc, char *argv[] )
+{
+	int nUser = 10000, nImported;
+	int cache, round, phase;
+
+	for ( round = 1; round < argc; round++ ) {
+		if ( ! strcmp( argv[ round ], "-n" ) && round + 1 < argc )
+			rounds = atoi( argv[ ++round ] );
+		else if ( ! strcmp( argv[ round ], "-u" ) && round + 1 < argc )
+			nUser = atoi( argv[ ++round ] );
+	}
+	if ( rounds < 1 || rounds > MAX_ROUNDS ) {
+		fprintf( stderr, "rounds must be 1 to %d\n", MAX_ROUNDS );
+		return 1;
+	}
+	if ( nUser < 0 || nUser > MAX_USER_PHRASE ) {
+		fprintf( stderr, "user phrases must be 0 to %d\n", MAX_USER_PHRASE );
+		return 1;
+	}
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" USER_DIR );
+	PLAT_MKDIR( USER_DIR );
+
+	nImported = make_user_dictionary( nUser );
+	if ( nImported < 0 ) {
+		fprintf( stderr, "chewing_new failed\n" );
+		return 1;
+	}
+	printf( "# %d user phrases\n", nImported );
+
+	for ( cache = 0; cache < CACHE_NUM; cache++ ) {
+		for ( round = 0; round < rounds; round++ ) {
+#ifdef USE_BINARY_DATA
+			if ( cache == CACHE_COLD )
+				evict_cache();
+			if ( run_phases( cache, round ) ) {
+				fprintf( stderr, "the static data cannot be loaded\n" );
+				return 1;
+			}
+#endif
+			if ( cache == CACHE_COLD )
+				evict_cache();
+			if ( run_first_candidate( cache, round ) ) {
+				fprintf( stderr, "no candidate\n" );
+				return 1;
+			}
+		}
+	}
+
+	printf( "# phase\tcache\trounds\tmedian usec\tmin usec\n" );
+	for ( cache = 0; cache < CACHE_NUM; cache++ ) {
+		for ( phase = 0; phase < PHASE_NUM; phase++ ) {
+#ifndef USE_BINARY_DATA
+			if ( phase < PHASE_CHEWING_NEW )
+				continue;
+#endif
+			report( phase, cache );
+		}
+	}
+	remove_user_files();
+	return 0;
+}
@@ -18,6 +18,7 @@
 #include "chewing.h"
 #include "plat_types.h"
 #include "hash-private.h"
+#include "key2pho-private.h"
 #include "test.h"
 
 void test_select_candidate()
@@ -110,6 +111,198 @@ void test_select_candidate_phrase_choice_rearward()
 	chewing_Terminate();
 }
 
+void test_longest_phrase()
+{
+	ChewingContext *ctx;
+
+	remove( TEST_HASH_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+
+	// ㄓㄨㄥ ㄍㄨㄛˊ ㄑㄧㄥ ㄋㄧㄢˊ ㄈㄢˇ ㄍㄨㄥˋ ㄐㄧㄡˋ ㄍㄨㄛˊ ㄊㄨㄢˊ, of the
+	// most syllables a phrase has
+	type_keystoke_by_string( ctx, "5j/ eji6fu/ su06z03ej/4ru.4eji6wj06<E>" );
+	ok_commit_buffer( ctx, "中國青年反共救國團" );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+void test_hanyu_pinyin()
+{
+	ChewingContext *ctx;
+
+	remove( TEST_HASH_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	chewing_set_KBType( ctx, chewing_KBStr2Num( "KB_HANYU_PINYIN" ) );
+
+	// the longest initial and final come first: zh-ong, not z-h
+	type_keystoke_by_string( ctx, "zhong1guo2<E>" );
+	ok_commit_buffer( ctx, "中國" );
+
+	// "jue" is an initial of its own, and "lv" is ㄌㄩ
+	type_keystoke_by_string( ctx, "jue2lv4<E>" );
+	ok_commit_buffer( ctx, "決率" );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+typedef struct {
+	const char *phrase[ 2 ];
+	int freq[ 2 ];
+	uint16_t phoneSeq[ 3 ];
+	int next;
+} RankReader;
+
+static int read_rank_phrase( void *userdata, ChewingUserPhrase *entry )
+{
+	RankReader *reader = userdata;
+
+	if ( reader->next == ARRAY_SIZE( reader->phrase ) )
+		return 0;
+	entry->phoneSeq = reader->phoneSeq;
+	entry->phrase = reader->phrase[ reader->next ];
+	entry->freq = reader->freq[ reader->next ];
+	reader->next++;
+	return 1;
+}
+
+void test_rank_candidates()
+{
+	// ㄧˋㄕˋ has 15 phrases in dict, from 亦是 (3000) to 藝事 (0), in the
+	// order of their frequency. The user has 藝事 at 2500 and 意事 at 1500.
+	static const char *RANKED[] = {
+		"亦是", "藝事", "意識", "意事", "易事",
+		"義式", "軼事", "義士", "異事", "逸事",
+		"抑是", "異士", "議事", "逸士", "懿事",
+		"義試",
+	};
+
+	// the dictionary order, then the phrases only the user has
+	static const char *UNRANKED[] = {
+		"亦是", "意識", "易事", "義式", "軼事",
+		"義士", "異事", "逸事", "抑是", "異士",
+		"議事", "逸士", "懿事", "義試", "藝事",
+		"意事",
+	};
+
+	RankReader reader = {
+		{ "藝事", "意事" },
+		{ 2500, 1500 },
+		{ 0 },
+		0,
+	};
+	ChewingContext *ctx;
+
+	remove( TEST_HASH_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	reader.phoneSeq[ 0 ] = UintFromPhone( "ㄧˋ" );
+	reader.phoneSeq[ 1 ] = UintFromPhone( "ㄕˋ" );
+	ok( chewing_userphrase_import( ctx, read_rank_phrase, &reader ) == 2,
+		"user phrases shall be imported" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	chewing_set_candPerPage( ctx, 5 );
+
+	ok( chewing_get_rankCandidates( ctx ) == 0,
+		"rankCandidates shall be default value" );
+	type_keystoke_by_string( ctx, "u4g4<L><L><D>" ); // ㄧˋㄕˋ
+	ok_candidate( ctx, UNRANKED, ARRAY_SIZE( UNRANKED ) );
+	type_keystoke_by_string( ctx, "<EE>" );
+
+	chewing_set_rankCandidates( ctx, 1 );
+	ok( chewing_get_rankCandidates( ctx ) == 1,
+		"rankCandidates shall be 1" );
+
+	type_keystoke_by_string( ctx, "<D>" );
+	ok( chewing_cand_TotalChoice( ctx ) == ARRAY_SIZE( RANKED ),
+		"a phrase in both shall be a candidate once" );
+	ok_candidate( ctx, RANKED, ARRAY_SIZE( RANKED ) );
+
+	// the pages read are not ranked again
+	type_keystoke_by_string( ctx, "<R>" );
+	ok_candidate( ctx, RANKED + 5, ARRAY_SIZE( RANKED ) - 5 );
+	type_keystoke_by_string( ctx, "<L>" );
+	ok_candidate( ctx, RANKED, ARRAY_SIZE( RANKED ) );
+
+	// select 異事, as shown on the second page
+	type_keystoke_by_string( ctx, "<R>4<E>" );
+	ok_commit_buffer( ctx, RANKED[ 8 ] );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+void test_idle_prepares_candidates()
+{
+	static const char *CAND_1[] = {
+		"一上來",
+		"移上來",
+	};
+
+	static const char *CAND_2[] = {
+		"上來",
+		"快上", // XXX: bug?
+	};
+
+	ChewingContext *ctx;
+	ChewingMemory mem;
+
+	remove( TEST_HASH_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+
+	ok( chewing_idle( ctx, 1000 ) == 0, "nothing shall be prepared without input" );
+
+	type_keystoke_by_string( ctx, "u6g;4x96<L><L><L>" ); // ㄧˊㄕㄤˋㄌㄞˊ
+	ok( chewing_idle( ctx, 0 ) == 1, "no budget shall leave the work for later" );
+	ok( chewing_idle( ctx, 1000000 ) == 0, "the candidates shall be prepared" );
+	ok( chewing_idle( ctx, 0 ) == 0, "prepared candidates shall be kept" );
+	chewing_get_memory( ctx, &mem );
+	ok( mem.candidate > 0, "prepared candidates shall take memory" );
+
+	type_keystoke_by_string( ctx, "<D>" );
+	ok_candidate( ctx, CAND_1, ARRAY_SIZE( CAND_1 ) );
+	ok( chewing_idle( ctx, 1000000 ) == 0, "nothing shall be prepared in a choice" );
+	type_keystoke_by_string( ctx, "<EE>" );
+
+	// what is prepared for one span is not shown for another
+	ok( chewing_idle( ctx, 1000000 ) == 0, "the candidates shall be prepared" );
+	type_keystoke_by_string( ctx, "<R><D>" );
+	ok_candidate( ctx, CAND_2, ARRAY_SIZE( CAND_2 ) );
+
+	// select 移上來
+	type_keystoke_by_string( ctx, "<EE><L>" );
+	ok( chewing_idle( ctx, 1000000 ) == 0, "the candidates shall be prepared" );
+	type_keystoke_by_string( ctx, "<D>2<E>" );
+	ok_commit_buffer( ctx, CAND_1[1] );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
 int main()
 {
 	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
@@ -117,6 +310,10 @@ int main()
 
 	test_select_candidate();
 	test_select_candidate_phrase_choice_rearward();
+	test_longest_phrase();
+	test_hanyu_pinyin();
+	test_rank_candidates();
+	test_idle_prepares_candidates();
 
 	return exit_status();
 }
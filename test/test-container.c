@@ -0,0 +1,105 @@
+/**
+ * test-container.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "container-private.h"
+
+#define PAYLOAD "ji3cp3vu3cj0"
+#define PAYLOAD_OFFSET 32
+#define CONTAINER_SIZE ( PAYLOAD_OFFSET + sizeof( PAYLOAD ) )
+
+static void make_container( unsigned char *buf )
+{
+	memset( buf, 0, CONTAINER_SIZE );
+	memcpy( buf, CONTAINER_MAGIC, CONTAINER_MAGIC_LEN );
+	PutUint32LE( buf + 8, CONTAINER_VERSION );
+	PutUint32LE( buf + 12, 1 );
+	PutUint32LE( buf + 16, SECTION_DICT );
+	PutUint32LE( buf + 20, PAYLOAD_OFFSET );
+	PutUint32LE( buf + 24, sizeof( PAYLOAD ) );
+	PutUint32LE( buf + 28, ContainerChecksum( PAYLOAD, sizeof( PAYLOAD ) ) );
+	memcpy( buf + PAYLOAD_OFFSET, PAYLOAD, sizeof( PAYLOAD ) );
+}
+
+void test_checksum()
+{
+	unsigned char b[ 4 ];
+
+	ok( GetUint32LE( "\x78\x56\x34\x12" ) == 0x12345678, "GetUint32LE is little-endian" );
+	ok( GetUint16LE( "\x34\x12" ) == 0x1234, "GetUint16LE is little-endian" );
+	PutUint32LE( b, 0xfffffffe );
+	ok( (int32_t) GetUint32LE( b ) == -2, "PutUint32LE keeps a negative int32" );
+	PutUint16LE( b, 0xabcd );
+	ok( b[ 0 ] == 0xcd && b[ 1 ] == 0xab, "PutUint16LE is little-endian" );
+	/* the CRC-32 check value */
+	ok( ContainerChecksum( "123456789", 9 ) == 0xcbf43926, "ContainerChecksum is CRC-32" );
+}
+
+void test_section()
+{
+	unsigned char buf[ CONTAINER_SIZE ];
+	const void *section;
+	size_t size = 0;
+
+	make_container( buf );
+	ok( ContainerCheck( buf, sizeof( buf ) ) == 0, "ContainerCheck accepts a container" );
+	ok( ContainerVerify( buf, sizeof( buf ) ) == 0, "ContainerVerify accepts a container" );
+
+	section = ContainerGetSection( buf, SECTION_DICT, &size );
+	ok( section == buf + PAYLOAD_OFFSET && size == sizeof( PAYLOAD ),
+		"ContainerGetSection returns a view of the payload" );
+	ok( ContainerGetSection( buf, SECTION_PHONE_TREE, &size ) == NULL,
+		"ContainerGetSection returns NULL for a missing section" );
+}
+
+void test_corrupted()
+{
+	unsigned char buf[ CONTAINER_SIZE ];
+
+	make_container( buf );
+	buf[ 0 ] = 'X';
+	ok( ContainerCheck( buf, sizeof( buf ) ) != 0, "ContainerCheck rejects a bad magic" );
+
+	make_container( buf );
+	PutUint32LE( buf + 8, CONTAINER_VERSION + 1 );
+	ok( ContainerCheck( buf, sizeof( buf ) ) != 0, "ContainerCheck rejects another version" );
+
+	make_container( buf );
+	PutUint32LE( buf + 20, PAYLOAD_OFFSET + 1 );
+	ok( ContainerCheck( buf, sizeof( buf ) ) != 0, "ContainerCheck rejects a misaligned section" );
+
+	make_container( buf );
+	PutUint32LE( buf + 24, sizeof( PAYLOAD ) + 1 );
+	ok( ContainerCheck( buf, sizeof( buf ) ) != 0, "ContainerCheck rejects a truncated section" );
+
+	make_container( buf );
+	ok( ContainerCheck( buf, PAYLOAD_OFFSET ) != 0, "ContainerCheck rejects a truncated file" );
+
+	make_container( buf );
+	buf[ PAYLOAD_OFFSET ] ^= 1;
+	ok( ContainerCheck( buf, sizeof( buf ) ) == 0 &&
+		ContainerVerify( buf, sizeof( buf ) ) != 0,
+		"ContainerVerify rejects a corrupted payload" );
+}
+
+int main()
+{
+	test_checksum();
+	test_section();
+	test_corrupted();
+	return exit_status();
+}
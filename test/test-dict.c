@@ -0,0 +1,280 @@
+/**
+ * test-dict.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chewing.h"
+#include "chewing-private.h"
+#include "dict-private.h"
+#include "global-private.h"
+#include "hash-private.h"
+#include "key2pho-private.h"
+#include "tree-private.h"
+#include "plat_path.h"
+#include "plat_types.h"
+#include "test.h"
+
+#define OVERLAY_DIR	TEST_HASH_DIR PLAT_SEPARATOR "overlay"
+#define OVERLAY_USER_FILE	OVERLAY_DIR PLAT_SEPARATOR HASH_FILE
+
+/* phrase ids checked, all of them exist in the test data */
+#define PHRASE_ID_NUM 2000
+
+void test_nth_phrase()
+{
+	ChewingContext *ctx;
+	Phrase iter, nth;
+	int id, n, count;
+	int bad_count = 0, bad_phrase = 0, bad_end = 0;
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	for ( id = 0; id < PHRASE_ID_NUM; id++ ) {
+		count = GetPhraseCount( ctx->data, id );
+		n = 0;
+		if ( GetPhraseFirst( ctx->data, &iter, id ) ) {
+			do {
+				if ( GetPhraseNth( ctx->data, &nth, id, n ) != (int) strlen( iter.phrase ) ||
+						strcmp( nth.phrase, iter.phrase ) ||
+						nth.freq != iter.freq )
+					bad_phrase++;
+				n++;
+			} while ( GetPhraseNext( ctx->data, &iter ) );
+		}
+		if ( n != count )
+			bad_count++;
+		if ( GetPhraseNth( ctx->data, &nth, id, count ) != 0 )
+			bad_end++;
+	}
+	ok( bad_count == 0, "GetPhraseCount shall count the phrases of GetPhraseNext" );
+	ok( bad_phrase == 0, "GetPhraseNth shall return the phrases of GetPhraseNext" );
+	ok( bad_end == 0, "GetPhraseNth shall return 0 after the last phrase" );
+
+	chewing_delete( ctx );
+}
+
+void test_phrase_view()
+{
+	ChewingContext *ctx;
+	Phrase nth;
+	PhraseView view;
+	int id, n;
+	int bad_count = 0, bad_view = 0;
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	for ( id = 0; id < PHRASE_ID_NUM; id++ ) {
+		n = 0;
+		if ( GetPhraseViewFirst( ctx->data, &view, id ) ) {
+			do {
+				/* GetPhraseNth() leaves the cursor alone */
+				if ( GetPhraseNth( ctx->data, &nth, id, n++ ) != view.len ||
+						memcmp( view.phrase, nth.phrase, view.len ) ||
+						view.freq != nth.freq )
+					bad_view++;
+			} while ( GetPhraseViewNext( ctx->data, &view ) );
+		}
+		if ( n != GetPhraseCount( ctx->data, id ) )
+			bad_count++;
+	}
+	ok( bad_count == 0, "GetPhraseViewNext shall return every phrase" );
+	ok( bad_view == 0, "GetPhraseViewNext shall return the phrases of GetPhraseNth" );
+
+	chewing_delete( ctx );
+}
+
+typedef struct {
+	int nSystem, nUser;
+	int nCall;
+	int found;	/* 測試 is a phrase of the system dictionary */
+	int bad_index;
+} LookupResult;
+
+static int collect( void *userdata, int index, const ChewingDictEntry *entry )
+{
+	LookupResult *result = userdata;
+
+	result->nCall++;
+	if ( index != 0 )
+		result->bad_index++;
+	if ( entry->isUser )
+		result->nUser++;
+	else
+		result->nSystem++;
+	if ( !entry->isUser && entry->len == (int) strlen( "測試" ) &&
+			!memcmp( entry->phrase, "測試", entry->len ) )
+		result->found = 1;
+	return 0;
+}
+
+static int stop( void *userdata, int index UNUSED, const ChewingDictEntry *entry UNUSED )
+{
+	( (LookupResult *) userdata )->nCall++;
+	return 1;
+}
+
+void test_lookup_batch()
+{
+	ChewingContext *ctx;
+	unsigned short *seq;
+	unsigned short phones[ 3 ];
+	const unsigned short *batch[ 2 ];
+	LookupResult result;
+	int ret;
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	type_keystoke_by_string( ctx, "hk4g4" );
+	ok( chewing_get_phoneSeqLen( ctx ) == 2, "hk4g4 shall be two phones" );
+	seq = chewing_get_phoneSeq( ctx );
+	phones[ 0 ] = seq[ 0 ];
+	phones[ 1 ] = seq[ 1 ];
+	phones[ 2 ] = 0;
+	free( seq );
+	batch[ 0 ] = phones;
+	batch[ 1 ] = phones;
+
+	memset( &result, 0, sizeof( result ) );
+	ret = chewing_dict_lookup_batch( ctx, batch, 1, collect, &result );
+	ok( result.found, "chewing_dict_lookup_batch shall find 測試" );
+	ok( ret == result.nCall && ret == result.nSystem + result.nUser,
+		"chewing_dict_lookup_batch shall return the number of phrases" );
+	ok( result.bad_index == 0, "callback shall get the index of the sequence" );
+	ok( chewing_get_phoneSeqLen( ctx ) == 2,
+		"chewing_dict_lookup_batch shall not touch the input" );
+
+	memset( &result, 0, sizeof( result ) );
+	ret = chewing_dict_lookup_batch( ctx, batch, 2, stop, &result );
+	ok( ret == 1 && result.nCall == 1, "a non-zero return shall stop the lookup" );
+
+	ok( chewing_dict_lookup_batch( ctx, batch, 1, NULL, NULL ) == -1,
+		"chewing_dict_lookup_batch shall reject a NULL callback" );
+
+	chewing_delete( ctx );
+}
+
+/* the phrases learned by the two contexts of test_overlay() */
+static void remove_overlay_user_phrases()
+{
+	remove( OVERLAY_USER_FILE );
+	remove( OVERLAY_USER_FILE HASH_JOURNAL_SUFFIX ".0" );
+	remove( OVERLAY_USER_FILE HASH_JOURNAL_SUFFIX ".1" );
+}
+
+static int find_phrase( ChewingContext *ctx, const char *zuin1, const char *zuin2, const char *zuin3 )
+{
+	uint16_t phoneSeq[ 3 ];
+	int len = 0;
+
+	phoneSeq[ len++ ] = UintFromPhone( zuin1 );
+	phoneSeq[ len++ ] = UintFromPhone( zuin2 );
+	if ( zuin3 )
+		phoneSeq[ len++ ] = UintFromPhone( zuin3 );
+	return TreeFindPhrase( ctx->data, 0, len - 1, phoneSeq );
+}
+
+void test_overlay()
+{
+	static const char overlay[] =
+		"# 策士 first, 世間 gone, and a phrase the tree does not have\n"
+		"+ 策士 10000 ㄘㄜˋ ㄕˋ\n"
+		"- 世間 ㄕˋ ㄐㄧㄢ\n"
+		"+ 甲乙丙 50000 ㄘㄜˋ\tㄕˋ  ㄘㄜˋ\n"
+		"not a change\n"
+		"+ 壞 many ㄏㄨㄞˋ\n"
+		"+ 短 1 ㄘㄜˋ ㄕˋ\n";
+	ChewingContext *ctx, *base;
+	Phrase phrase;
+	FILE *fp;
+	int id, count;
+
+	/* what is typed is learned, away from the user phrases of the other tests */
+	PLAT_MKDIR( OVERLAY_DIR );
+	remove_overlay_user_phrases();
+	putenv( "CHEWING_USER_PATH=" OVERLAY_DIR );
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	base = chewing_new();
+	ok( base, "chewing_new shall not return NULL" );
+	count = GetPhraseCount( base->data, find_phrase( base, "ㄘㄜˋ", "ㄕˋ", NULL ) );
+
+	fp = fopen( OVERLAY_DIR PLAT_SEPARATOR DICT_OVERLAY_FILE, "w" );
+	ok( fp && fputs( overlay, fp ) >= 0 && !fclose( fp ), "the overlay shall be written" );
+
+	putenv( "CHEWING_PATH=" OVERLAY_DIR SEARCH_PATH_SEP CHEWING_DATA_PREFIX );
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall take the overlay of the search path" );
+	ok( ctx->data->static_data != base->data->static_data,
+		"the overlay shall not change the data of another search path" );
+
+	id = find_phrase( ctx, "ㄘㄜˋ", "ㄕˋ", NULL );
+	ok( id != -1 && GetPhraseFirst( ctx->data, &phrase, id ) && !strcmp( phrase.phrase, "策士" ),
+		"a phrase given a higher frequency shall come first" );
+	ok( GetPhraseMaxFreq( ctx->data, id ) == 10000, "the frequency shall be the one of the overlay" );
+	ok( GetPhraseCount( ctx->data, id ) == count,
+		"a changed phrase shall not be added again, a malformed one not at all" );
+	ok( GetPhraseNth( ctx->data, &phrase, id, 1 ) && !strcmp( phrase.phrase, "測試" ),
+		"the other phrases shall follow by frequency" );
+
+	ok( find_phrase( ctx, "ㄕˋ", "ㄐㄧㄢ", NULL ) == -1,
+		"a sequence whose phrases are all removed shall have none" );
+
+	id = find_phrase( ctx, "ㄘㄜˋ", "ㄕˋ", "ㄘㄜˋ" );
+	ok( id != -1 && GetPhraseCount( ctx->data, id ) == 1 &&
+		GetPhraseFirst( ctx->data, &phrase, id ) && !strcmp( phrase.phrase, "甲乙丙" ),
+		"a phrase of a sequence the tree does not have shall be added" );
+	ok( find_phrase( base, "ㄘㄜˋ", "ㄕˋ", "ㄘㄜˋ" ) == -1,
+		"the phrase shall not be in the dictionary without the overlay" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	type_keystoke_by_string( ctx, "hk4g4<E>" );
+	ok_commit_buffer( ctx, "策士" );
+	type_keystoke_by_string( ctx, "hk4g4hk4<E>" );
+	ok_commit_buffer( ctx, "甲乙丙" );
+
+	chewing_set_maxChiSymbolLen( base, 16 );
+	type_keystoke_by_string( base, "hk4g4<E>" );
+	ok_commit_buffer( base, "測試" );
+
+	chewing_delete( ctx );
+	chewing_delete( base );
+	remove( OVERLAY_DIR PLAT_SEPARATOR DICT_OVERLAY_FILE );
+	remove_overlay_user_phrases();
+}
+
+int main()
+{
+	test_nth_phrase();
+	test_phrase_view();
+	test_lookup_batch();
+#ifndef USE_EMBEDDED_DATA
+	/* the data linked in is the same whatever the search path */
+	test_overlay();
+#endif
+	return exit_status();
+}
@@ -14,8 +14,37 @@
 #include "test.h"
 #include "global.h"
 #include "chewing-utf8-util.h"
+#include "chewing-private.h"
 #include "key2pho-private.h"
 
+/* every layout shall look the keys up as PhoneInxFromKey() searches key_str */
+void test_key_table()
+{
+	KeyTable table;
+	int kbtype, key, type, n, inx, nDiff;
+
+	for ( kbtype = 0; kbtype < MAX_KBTYPE; kbtype++ ) {
+		if ( InitKeyTable( &table, kbtype ) )
+			continue;
+		nDiff = 0;
+		for ( key = 1; key < KEY_TABLE_SIZE; key++ ) {
+			for ( n = 0; n < MAX_KEY_READING; n++ ) {
+				for ( type = 0; type < 4; type++ ) {
+					inx = table.reading[ key ][ n ] &&
+						KEY_READING_TYPE( table.reading[ key ][ n ] ) == type ?
+						KEY_READING_INX( table.reading[ key ][ n ] ) : 0;
+					if ( inx != PhoneInxFromKey( key, type, kbtype, n + 1 ) )
+						nDiff++;
+				}
+			}
+		}
+		ok( nDiff == 0, "key table of layout %d shall match key_str, %d differ",
+			kbtype, nDiff );
+	}
+	ok( InitKeyTable( &table, MAX_KBTYPE ) == -1,
+		"InitKeyTable shall fail for an unknown layout" );
+}
+
 int main (int argc, char *argv[])
 {
 	char *u8phone;
@@ -46,5 +75,7 @@ int main (int argc, char *argv[])
 	PhoneFromKey( rt, "dj7", 0, 1 );
 	ok (!strcmp(rt, "ㄎㄨ˙"), "dj7");
 
+	test_key_table();
+
 	return exit_status();
 }
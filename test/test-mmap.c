@@ -42,8 +42,37 @@ void test_UnitFromPlatMmap()
 	plat_mmap_close( &m_mmap );
 }
 
+void test_PlatMmapOptions()
+{
+	plat_mmap m_mmap;
+	size_t offset = 0;
+	size_t csize;
+	size_t idx;
+	char *data_buf;
+
+	idx = plat_mmap_create(&m_mmap, TESTDATA, FLAG_ATTRIBUTE_READ);
+	ok (idx == 28, "plat_mmap_create");
+	ok (plat_mmap_advise(&m_mmap, 0, idx, FLAG_ADVICE_WILLNEED) == -1,
+		"plat_mmap_advise without a view");
+	if (idx > 0) {
+		csize = idx;
+		data_buf = (char *) plat_mmap_set_view_options(&m_mmap, &offset, &csize,
+			FLAG_MAP_POPULATE | FLAG_MAP_HUGEPAGE);
+		ok (data_buf && !strncmp(data_buf, "ji3cp3vu3cj0", 12),
+			"plat_mmap_set_view_options");
+		ok (plat_mmap_advise(&m_mmap, 0, csize, FLAG_ADVICE_RANDOM) == 0,
+			"plat_mmap_advise random");
+		ok (plat_mmap_advise(&m_mmap, 4, csize, FLAG_ADVICE_WILLNEED) == 0,
+			"plat_mmap_advise beyond the view");
+		ok (plat_mmap_advise(&m_mmap, csize + 1, 1, FLAG_ADVICE_NORMAL) == -1,
+			"plat_mmap_advise outside the view");
+	}
+	plat_mmap_close( &m_mmap );
+}
+
 int main (int argc, char *argv[])
 {
 	test_UnitFromPlatMmap();
+	test_PlatMmapOptions();
 	return exit_status();
 }
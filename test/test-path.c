@@ -29,6 +29,9 @@ int find_path_by_files(
 	size_t output_len );
 
 static const char *FILES[] = {
+#ifdef USE_BINARY_DATA
+	STATIC_DATA_FILE,
+#else
 	CHAR_FILE,
 	CHAR_INDEX_BEGIN_FILE,
 	DICT_FILE,
@@ -37,6 +40,7 @@ static const char *FILES[] = {
 	SYMBOL_TABLE_FILE,
 	SOFTKBD_TABLE_FILE,
 	PINYIN_TAB_NAME,
+#endif
 	NULL,
 };
 
@@ -0,0 +1,688 @@
+/**
+ * test-phrasing.c
+ *
+ * Copyright (c) 2012
+ *      libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chewing.h"
+#include "plat_types.h"
+#include "hash-private.h"
+#include "chewing-utf8-util.h"
+#include "test.h"
+
+/* the other tests share TEST_HASH_DIR, and run at the same time */
+#define TIE_DIR	TEST_HASH_DIR PLAT_SEPARATOR "phrasing"
+
+static const TestData PHRASING_DATA[] = {
+	{ "ru.4qu/6t;6rul e; fup6", "就平常交鋼琴" },
+	{ "xu3194xu.4b4y94rul4cjo4ej/ yji4", "禮拜六日再教會工作" },
+	{ "c06rm4ep vu u;6rm4u u;4t8 rup4", "韓劇跟西洋據一樣差勁" },
+};
+
+void test_set_phrasing_engine()
+{
+	chewing_Init( NULL, NULL );
+
+	ChewingContext *ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	ok( chewing_get_phrasingEngine( ctx ) == PHRASING_ENGINE_ENUMERATE,
+		"phrasingEngine shall be default value" );
+
+	ok( chewing_set_phrasingEngine( ctx, PHRASING_ENGINE_DP ) == 0,
+		"chewing_set_phrasingEngine shall succeed" );
+	ok( chewing_get_phrasingEngine( ctx ) == PHRASING_ENGINE_DP,
+		"phrasingEngine shall be PHRASING_ENGINE_DP" );
+
+	ok( chewing_set_phrasingEngine( ctx, -1 ) == -1,
+		"chewing_set_phrasingEngine shall fail on invalid engine" );
+	ok( chewing_get_phrasingEngine( ctx ) == PHRASING_ENGINE_DP,
+		"phrasingEngine shall not change" );
+
+	chewing_Reset( ctx );
+	ok( chewing_get_phrasingEngine( ctx ) == PHRASING_ENGINE_DP,
+		"phrasingEngine shall be kept by chewing_Reset" );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+void test_same_result()
+{
+	size_t i;
+	char *enumerate;
+	char *dp;
+
+	remove( TEST_HASH_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+
+	ChewingContext *ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+	ChewingContext *ctx_dp = chewing_new();
+	ok( ctx_dp, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	chewing_set_maxChiSymbolLen( ctx_dp, 16 );
+	chewing_set_phrasingEngine( ctx_dp, PHRASING_ENGINE_DP );
+
+	for ( i = 0; i < ARRAY_SIZE( PHRASING_DATA ); ++i ) {
+		type_keystoke_by_string( ctx, PHRASING_DATA[i].token );
+		type_keystoke_by_string( ctx_dp, PHRASING_DATA[i].token );
+
+		enumerate = chewing_buffer_String( ctx );
+		dp = chewing_buffer_String( ctx_dp );
+		ok( !strcmp( dp, PHRASING_DATA[i].expected ),
+			"buffer `%s' shall be `%s'", dp, PHRASING_DATA[i].expected );
+		ok( !strcmp( enumerate, dp ),
+			"both engines shall give the same buffer, `%s' and `%s'",
+			enumerate, dp );
+		chewing_free( enumerate );
+		chewing_free( dp );
+
+		chewing_Reset( ctx );
+		chewing_Reset( ctx_dp );
+	}
+
+	chewing_delete( ctx );
+	chewing_delete( ctx_dp );
+	chewing_Terminate();
+}
+
+void test_tab_cycle()
+{
+	size_t i;
+	int tab;
+	char *enumerate;
+	char *dp;
+
+	remove( TEST_HASH_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+
+	ChewingContext *ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+	ChewingContext *ctx_dp = chewing_new();
+	ok( ctx_dp, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	chewing_set_maxChiSymbolLen( ctx_dp, 16 );
+	chewing_set_phrasingEngine( ctx_dp, PHRASING_ENGINE_DP );
+
+	// every Tab shall pick the same next-best segmentation
+	for ( i = 0; i < ARRAY_SIZE( PHRASING_DATA ); ++i ) {
+		type_keystoke_by_string( ctx, PHRASING_DATA[i].token );
+		type_keystoke_by_string( ctx_dp, PHRASING_DATA[i].token );
+
+		for ( tab = 1; tab <= 10; ++tab ) {
+			type_keystoke_by_string( ctx, "<T>" );
+			type_keystoke_by_string( ctx_dp, "<T>" );
+
+			enumerate = chewing_buffer_String( ctx );
+			dp = chewing_buffer_String( ctx_dp );
+			ok( !strcmp( enumerate, dp ),
+				"Tab %d shall give the same buffer, `%s' and `%s'",
+				tab, enumerate, dp );
+			chewing_free( enumerate );
+			chewing_free( dp );
+		}
+
+		chewing_Reset( ctx );
+		chewing_Reset( ctx_dp );
+	}
+
+	chewing_delete( ctx );
+	chewing_delete( ctx_dp );
+	chewing_Terminate();
+}
+
+void test_edit_in_middle()
+{
+	char *buf;
+
+	remove( TEST_HASH_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+
+	ChewingContext *ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+
+	// re-phrasing after an edit shall match phrasing from scratch
+	type_keystoke_by_string( ctx, "ru.4qu/6t;6rul e; fup6" );
+	type_keystoke_by_string( ctx, "<L><L><L><B>t;6" );
+	buf = chewing_buffer_String( ctx );
+	ok( !strcmp( buf, PHRASING_DATA[0].expected ),
+		"buffer `%s' shall be `%s'", buf, PHRASING_DATA[0].expected );
+	chewing_free( buf );
+
+	type_keystoke_by_string( ctx, "<EN><B><B>e; fup6" );
+	buf = chewing_buffer_String( ctx );
+	ok( !strcmp( buf, PHRASING_DATA[0].expected ),
+		"buffer `%s' shall be `%s'", buf, PHRASING_DATA[0].expected );
+	chewing_free( buf );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+void test_long_ambiguous_buffer()
+{
+	int i;
+
+	remove( TEST_HASH_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+
+	ChewingContext *ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 39 );
+	chewing_set_phrasingEngine( ctx, PHRASING_ENGINE_DP );
+
+	// ㄧˋ repeated has a huge number of segmentations
+	for ( i = 0; i < 30; ++i )
+		type_keystoke_by_string( ctx, "u4" );
+	ok( chewing_buffer_Len( ctx ) == 30,
+		"buffer length `%d' shall be `30'", chewing_buffer_Len( ctx ) );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+/* the keys of a string, as far as chewing_handle_Default() takes them */
+static int string_keys( const char *str, int keys[] )
+{
+	int n;
+
+	for ( n = 0; str[ n ]; n++ )
+		keys[ n ] = (unsigned char) str[ n ];
+	return n;
+}
+
+static void ok_same_state( ChewingContext *ctx, ChewingContext *ref, const char *what )
+{
+	char *buf = chewing_buffer_String( ctx );
+	char *refbuf = chewing_buffer_String( ref );
+	IntervalType it, refit;
+	int same_interval = 1;
+
+	ok( !strcmp( buf, refbuf ), "%s: buffer `%s' shall be `%s'", what, buf, refbuf );
+	ok( chewing_cursor_Current( ctx ) == chewing_cursor_Current( ref ),
+		"%s: the cursor shall be the same", what );
+	chewing_interval_Enumerate( ctx );
+	chewing_interval_Enumerate( ref );
+	while ( chewing_interval_hasNext( ref ) ) {
+		chewing_interval_Get( ref, &refit );
+		if ( ! chewing_interval_hasNext( ctx ) ) {
+			same_interval = 0;
+			break;
+		}
+		chewing_interval_Get( ctx, &it );
+		if ( it.from != refit.from || it.to != refit.to )
+			same_interval = 0;
+	}
+	ok( same_interval && ! chewing_interval_hasNext( ctx ),
+		"%s: the intervals shall be the same", what );
+	chewing_free( buf );
+	chewing_free( refbuf );
+}
+
+void test_key_sequence()
+{
+	ChewingContext *ctx, *ref;
+	int keys[ 256 ];
+	char *commit, *refcommit;
+	size_t i;
+	int n, done, at, nCommit;
+
+	remove( TEST_HASH_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+
+	ctx = chewing_new();
+	ref = chewing_new();
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	chewing_set_maxChiSymbolLen( ref, 16 );
+
+	for ( i = 0; i < ARRAY_SIZE( PHRASING_DATA ); ++i ) {
+		n = string_keys( PHRASING_DATA[i].token, keys );
+		ok( chewing_handle_KeySequence( ctx, keys, n ) == n,
+			"chewing_handle_KeySequence shall handle every key" );
+		type_keystoke_by_string( ref, PHRASING_DATA[i].token );
+		ok_same_state( ctx, ref, PHRASING_DATA[i].token );
+		chewing_Reset( ctx );
+		chewing_Reset( ref );
+	}
+
+	/* a short buffer commits halfway, and the sequence stops there */
+	chewing_set_maxChiSymbolLen( ctx, 8 );
+	chewing_set_maxChiSymbolLen( ref, 8 );
+	n = string_keys( PHRASING_DATA[1].token, keys );
+	nCommit = 0;
+	for ( at = 0; at < n; at += done ) {
+		done = chewing_handle_KeySequence( ctx, keys + at, n - at );
+		if ( done <= 0 )
+			break;
+		for ( i = 0; (int) i < done; i++ )
+			chewing_handle_Default( ref, keys[ at + i ] );
+		ok( chewing_commit_Check( ctx ) == chewing_commit_Check( ref ),
+			"a commit shall be seen after the key that makes it" );
+		if ( chewing_commit_Check( ctx ) ) {
+			commit = chewing_commit_String( ctx );
+			refcommit = chewing_commit_String( ref );
+			ok( !strcmp( commit, refcommit ),
+				"commit `%s' shall be `%s'", commit, refcommit );
+			chewing_free( commit );
+			chewing_free( refcommit );
+			nCommit++;
+		}
+	}
+	ok( nCommit > 0, "a buffer of 8 shall commit" );
+	ok_same_state( ctx, ref, "after commits" );
+
+	ok( chewing_handle_KeySequence( ctx, keys, 0 ) == 0,
+		"an empty sequence shall handle no key" );
+	ok( chewing_handle_KeySequence( ctx, NULL, 1 ) == -1,
+		"chewing_handle_KeySequence shall fail without keys" );
+
+	chewing_delete( ctx );
+	chewing_delete( ref );
+	chewing_Terminate();
+}
+
+void test_stats()
+{
+	ChewingContext *ctx;
+	ChewingStats stats;
+
+	chewing_Init( NULL, NULL );
+	ctx = chewing_new();
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+
+	ok( chewing_get_stats( ctx, &stats ) == 0, "chewing_get_stats shall succeed" );
+	ok( stats.nPhrasing == 0 && stats.nCandList == 0,
+		"a new context shall have done nothing" );
+
+	type_keystoke_by_string( ctx, PHRASING_DATA[ 0 ].token );
+	chewing_get_stats( ctx, &stats );
+	ok( stats.nPhrasing > 0, "typing shall count segmentations" );
+	ok( stats.nInterval > 0 && stats.nRecord > 0 && stats.nTreeNode > 0,
+		"typing shall count phrases, segmentations and tree nodes" );
+	ok( stats.timePhrasing == 0, "nothing shall be timed by default" );
+
+	type_keystoke_by_string( ctx, "<D>" );
+	chewing_get_stats( ctx, &stats );
+	ok( stats.nCandList == 1, "opening the candidates shall count a list" );
+	ok( stats.nCandidate > 0 && stats.maxCandidate == stats.nCandidate,
+		"the candidates of the list shall be counted" );
+	type_keystoke_by_string( ctx, "<EE>" );
+
+	chewing_reset_stats( ctx );
+	chewing_get_stats( ctx, &stats );
+	ok( stats.nPhrasing == 0 && stats.nCandList == 0 && stats.nHashLookup == 0,
+		"chewing_reset_stats shall clear every counter" );
+
+	chewing_set_statsTimer( ctx, 1 );
+	ok( chewing_get_statsTimer( ctx ) == 1, "chewing_set_statsTimer shall set 1" );
+	chewing_Reset( ctx );
+	ok( chewing_get_statsTimer( ctx ) == 1, "the timers shall be kept by chewing_Reset" );
+	type_keystoke_by_string( ctx, PHRASING_DATA[ 1 ].token );
+	chewing_get_stats( ctx, &stats );
+	ok( stats.timePhrasing > 0, "segmentations shall be timed" );
+	ok( stats.timePhrasing >= stats.timeFindInterval + stats.timeDiscard +
+		stats.timeSaveList + stats.timeSort,
+		"the stages shall not take longer than the segmentations" );
+
+	ok( chewing_get_stats( ctx, NULL ) == -1, "chewing_get_stats shall refuse NULL" );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+/* open the single characters at the cursor, and select the second one */
+static void select_second_char( ChewingContext *ctx, char *selected, size_t size )
+{
+	char *cand;
+	int i;
+
+	selected[ 0 ] = '\0';
+	type_keystoke_by_string( ctx, "<D>" );
+	for ( i = 0; i < MAX_PHRASE_LEN && chewing_cand_TotalChoice( ctx ) > 0; i++ ) {
+		chewing_cand_Enumerate( ctx );
+		cand = chewing_cand_String( ctx );
+		if ( ueStrLen( cand ) == 1 && chewing_cand_hasNext( ctx ) ) {
+			chewing_free( cand );
+			cand = chewing_cand_String( ctx );
+			snprintf( selected, size, "%s", cand );
+			chewing_free( cand );
+			type_keystoke_by_string( ctx, "2" );
+			return;
+		}
+		chewing_free( cand );
+		type_keystoke_by_string( ctx, "<D>" );
+	}
+	type_keystoke_by_string( ctx, "<EE>" );
+}
+
+void test_selection()
+{
+	static const int POS[] = { 1, 4, 5, 8 };
+	char selected[ ARRAY_SIZE( POS ) ][ MAX_UTF8_SIZE + 1 ];
+	char keys[ 4 + 4 * MAX_PHONE_SEQ_LEN ];
+	char *buf;
+	ChewingContext *ctx;
+	size_t i, j;
+	int bKept;
+
+	chewing_Init( NULL, NULL );
+	ctx = chewing_new();
+	chewing_set_maxChiSymbolLen( ctx, 20 );
+	chewing_set_phraseChoiceRearward( ctx, 0 );
+
+	type_keystoke_by_string( ctx, PHRASING_DATA[ 1 ].token );
+	for ( i = 0; i < ARRAY_SIZE( POS ); i++ ) {
+		strcpy( keys, "<H>" );
+		for ( j = 0; j < (size_t) POS[ i ]; j++ )
+			strcat( keys, "<R>" );
+		type_keystoke_by_string( ctx, keys );
+		select_second_char( ctx, selected[ i ], sizeof( selected[ i ] ) );
+		ok( selected[ i ][ 0 ], "a character shall be selectable at %d", POS[ i ] );
+	}
+
+	/* phrasing again on more input keeps every selection */
+	type_keystoke_by_string( ctx, "<EN>" );
+	type_keystoke_by_string( ctx, PHRASING_DATA[ 0 ].token );
+	buf = chewing_buffer_String( ctx );
+	bKept = 1;
+	for ( i = 0; i < ARRAY_SIZE( POS ); i++ ) {
+		if ( strncmp( ueStrSeek( buf, POS[ i ] ), selected[ i ],
+				strlen( selected[ i ] ) ) )
+			bKept = 0;
+	}
+	ok( bKept, "the characters selected shall be kept in `%s'", buf );
+	chewing_free( buf );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+/* learn the single character want of the phone keys */
+static void learn_char( ChewingContext *ctx, const char *keys, const char *want )
+{
+	char key[ 2 ] = { 0 };
+	char *cand;
+	int i = 0;
+
+	type_keystoke_by_string( ctx, keys );
+	type_keystoke_by_string( ctx, "<D>" );
+	chewing_cand_Enumerate( ctx );
+	while ( chewing_cand_hasNext( ctx ) ) {
+		cand = chewing_cand_String( ctx );
+		if ( ! strcmp( cand, want ) ) {
+			chewing_free( cand );
+			break;
+		}
+		chewing_free( cand );
+		i++;
+	}
+	ok( i < chewing_cand_TotalChoice( ctx ), "`%s' shall be a candidate", want );
+	for ( ; i >= chewing_get_candPerPage( ctx ); i -= chewing_get_candPerPage( ctx ) )
+		type_keystoke_by_string( ctx, "<R>" );
+	key[ 0 ] = "1234567890"[ i ];
+	type_keystoke_by_string( ctx, key );
+	type_keystoke_by_string( ctx, "<E>" );
+}
+
+void test_tie_order()
+{
+	static const int ENGINE[] = { PHRASING_ENGINE_ENUMERATE, PHRASING_ENGINE_DP };
+	ChewingContext *ctx;
+	char *buf;
+	size_t i;
+
+	/* the phrases learned here shall not reach the other tests */
+	putenv( "CHEWING_USER_PATH=" TIE_DIR );
+	PLAT_MKDIR( TIE_DIR );
+	remove( TIE_DIR PLAT_SEPARATOR HASH_FILE );
+
+	chewing_Init( NULL, NULL );
+	ctx = chewing_new();
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	chewing_set_candPerPage( ctx, 10 );
+
+	/* both are learned once, so they score the same */
+	learn_char( ctx, "n ", "絲" );
+	learn_char( ctx, "n ", "撕" );
+
+	/*
+	 * 絲絲 then 撕, and 撕 then 絲絲, have equal scores. The record with
+	 * the greatest interval indexes wins, the first one here.
+	 */
+	for ( i = 0; i < ARRAY_SIZE( ENGINE ); i++ ) {
+		chewing_set_phrasingEngine( ctx, ENGINE[ i ] );
+		type_keystoke_by_string( ctx, "n n n " );
+		buf = chewing_buffer_String( ctx );
+		ok( ! strcmp( buf, "絲絲撕" ),
+			"buffer `%s' of engine %d shall be `絲絲撕'", buf, ENGINE[ i ] );
+		chewing_free( buf );
+		chewing_Reset( ctx );
+	}
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+}
+
+typedef struct {
+	int nEvent[ CHEWING_TRACE_CANDIDATE_OPEN + 1 ];
+	int nOpen;	/* phrasing begun and not ended */
+	int bBadEvent;
+	ChewingTraceEvent last;
+} TraceCount;
+
+static void count_event( void *userdata, const ChewingTraceEvent *event )
+{
+	TraceCount *count = userdata;
+
+	if ( event->type < CHEWING_TRACE_PHRASING_BEGIN ||
+			event->type > CHEWING_TRACE_CANDIDATE_OPEN ) {
+		count->bBadEvent = 1;
+		return;
+	}
+	if ( event->type == CHEWING_TRACE_PHRASING_BEGIN )
+		count->nOpen++;
+	else if ( event->type == CHEWING_TRACE_PHRASING_END && count->nOpen-- == 0 )
+		count->bBadEvent = 1;
+	else if ( event->type == CHEWING_TRACE_USERPHRASE_WRITE &&
+			( ! event->phrase || (int) ueStrLen( event->phrase ) != event->nPhone ) )
+		count->bBadEvent = 1;
+	count->nEvent[ event->type ]++;
+	count->last = *event;
+}
+
+void test_trace()
+{
+	ChewingContext *ctx;
+	TraceCount count;
+	int ret;
+
+	memset( &count, 0, sizeof( count ) );
+	chewing_Init( NULL, NULL );
+	ctx = chewing_new();
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+
+	ret = chewing_set_traceCallback( ctx, count_event, &count );
+#ifdef ENABLE_TRACE
+	ok( ret == 0, "chewing_set_traceCallback shall succeed" );
+
+	type_keystoke_by_string( ctx, PHRASING_DATA[ 0 ].token );
+	ok( count.nEvent[ CHEWING_TRACE_PHRASING_BEGIN ] > 0,
+		"typing shall begin phrasing" );
+	ok( count.nEvent[ CHEWING_TRACE_PHRASING_END ] ==
+		count.nEvent[ CHEWING_TRACE_PHRASING_BEGIN ] && count.nOpen == 0,
+		"every phrasing shall end" );
+	ok( count.last.type == CHEWING_TRACE_PHRASING_END &&
+		count.last.nPhone == 6 && count.last.nInterval > 0 && count.last.nRecord > 0,
+		"the end shall give the phones, phrases and segmentations" );
+
+	type_keystoke_by_string( ctx, "<D>" );
+	ok( count.nEvent[ CHEWING_TRACE_CANDIDATE_OPEN ] == 1 &&
+		count.last.type == CHEWING_TRACE_CANDIDATE_OPEN && count.last.nCandidate > 0,
+		"opening the candidates shall give their number" );
+	type_keystoke_by_string( ctx, "1<E>" );
+	ok( count.nEvent[ CHEWING_TRACE_USERPHRASE_WRITE ] > 0,
+		"a commit shall write user phrases" );
+	ok( ! count.bBadEvent, "the events shall be well formed" );
+
+	chewing_set_traceCallback( ctx, NULL, NULL );
+	memset( &count, 0, sizeof( count ) );
+	type_keystoke_by_string( ctx, PHRASING_DATA[ 1 ].token );
+	ok( count.nEvent[ CHEWING_TRACE_PHRASING_BEGIN ] == 0,
+		"no event shall be given without a callback" );
+#else
+	ok( ret == -1, "chewing_set_traceCallback shall fail without --enable-trace" );
+	type_keystoke_by_string( ctx, PHRASING_DATA[ 0 ].token );
+	ok( count.nEvent[ CHEWING_TRACE_PHRASING_BEGIN ] == 0,
+		"no event shall be given without --enable-trace" );
+#endif
+	ok( chewing_set_traceCallback( NULL, count_event, &count ) == -1,
+		"chewing_set_traceCallback shall refuse NULL" );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+void test_convert()
+{
+	ChewingContext *ctx;
+	unsigned short phoneSeq[ MAX_PHONE_SEQ_LEN ], longSeq[ 8 * MAX_PHONE_SEQ_LEN ], *seq;
+	IntervalType interval[ 8 * MAX_PHONE_SEQ_LEN ];
+	char buf[ 256 ], buffer[ 256 ], longBuf[ 8 * MAX_PHONE_SEQ_LEN * MAX_UTF8_SIZE + 1 ];
+	int len, nInterval, i;
+	size_t k;
+
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+
+	for ( k = 0; k < ARRAY_SIZE( PHRASING_DATA ); k++ ) {
+		chewing_Reset( ctx );
+		type_keystoke_by_string( ctx, PHRASING_DATA[ k ].token );
+		len = chewing_get_phoneSeqLen( ctx );
+		seq = chewing_get_phoneSeq( ctx );
+		memcpy( phoneSeq, seq, len * sizeof( phoneSeq[ 0 ] ) );
+		free( seq );
+		chewing_buffer_String_copy( ctx, buffer, sizeof( buffer ) );
+
+		nInterval = ARRAY_SIZE( interval );
+		ok( chewing_convert_phone( ctx, phoneSeq, len, buf, sizeof( buf ), interval, &nInterval ) ==
+			(int) strlen( buffer ),
+			"chewing_convert_phone shall return the length of the sentence" );
+		ok( strcmp( buf, buffer ) == 0,
+			"chewing_convert_phone shall phrase as typing does, `%s' but `%s'", buffer, buf );
+		ok( nInterval > 0 && interval[ 0 ].from == 0 && interval[ nInterval - 1 ].to <= len,
+			"the phrases of the sentence shall be given" );
+		for ( i = 1; i < nInterval; i++ ) {
+			if ( interval[ i ].from < interval[ i - 1 ].to )
+				break;
+		}
+		ok( i >= nInterval, "the phrases shall not overlap" );
+		chewing_buffer_String_copy( ctx, buf, sizeof( buf ) );
+		ok( strcmp( buf, buffer ) == 0 && chewing_get_phoneSeqLen( ctx ) == len,
+			"the edit buffer shall not change" );
+	}
+
+	/* far longer than the edit buffer */
+	for ( len = 0, k = 0; len + MAX_PHONE_SEQ_LEN <= (int) ARRAY_SIZE( longSeq ); k++ ) {
+		chewing_Reset( ctx );
+		type_keystoke_by_string( ctx, PHRASING_DATA[ k % ARRAY_SIZE( PHRASING_DATA ) ].token );
+		seq = chewing_get_phoneSeq( ctx );
+		memcpy( &longSeq[ len ], seq, chewing_get_phoneSeqLen( ctx ) * sizeof( longSeq[ 0 ] ) );
+		len += chewing_get_phoneSeqLen( ctx );
+		free( seq );
+	}
+	chewing_Reset( ctx );
+	nInterval = ARRAY_SIZE( interval );
+	ok( chewing_convert_phone( ctx, longSeq, len, longBuf, sizeof( longBuf ), interval, &nInterval ) ==
+		(int) strlen( longBuf ) && (int) ueStrLen( longBuf ) == len,
+		"a long sequence shall convert to a character for every phone" );
+	for ( i = 1; i < nInterval && i < (int) ARRAY_SIZE( interval ); i++ ) {
+		if ( interval[ i ].from < interval[ i - 1 ].to || interval[ i ].to > len )
+			break;
+	}
+	ok( nInterval > 0 && i >= nInterval, "the phrases of a long sequence shall not overlap" );
+	ok( chewing_convert_phone( ctx, longSeq, len, buf, sizeof( buf ), NULL, NULL ) ==
+		(int) strlen( longBuf ) && buf[ 0 ] == '\0', "a buffer too small shall be left empty" );
+
+	/* the edit buffer full, and one phone either side */
+	for ( i = MAX_PHONE_SEQ_LEN - 1; i <= MAX_PHONE_SEQ_LEN + 1; i++ ) {
+		ok( chewing_convert_phone( ctx, longSeq, i, longBuf, sizeof( longBuf ), NULL, NULL ) ==
+			(int) strlen( longBuf ) && (int) ueStrLen( longBuf ) == i,
+			"a sequence of %d phones shall convert to a character for every phone", i );
+	}
+
+	/* ㄘㄜˋ ㄕˋ */
+	chewing_Reset( ctx );
+	ok( chewing_convert_bopomofo( ctx, "\xE3\x84\x98\xE3\x84\x9C\xCB\x8B \xE3\x84\x95\xCB\x8B",
+			buf, sizeof( buf ), NULL, NULL ) == (int) strlen( "\xE6\xB8\xAC\xE8\xA9\xA6" ),
+		"chewing_convert_bopomofo shall succeed" );
+	ok( strcmp( buf, "\xE6\xB8\xAC\xE8\xA9\xA6" ) == 0, "the sentence shall be `\xE6\xB8\xAC\xE8\xA9\xA6' but `%s'", buf );
+	ok( chewing_get_phoneSeqLen( ctx ) == 0, "the edit buffer shall stay empty" );
+
+	ok( chewing_convert_bopomofo( ctx, "\xE3\x84\x98\xE3\x84\x9C\xCB\x8B x",
+			buf, sizeof( buf ), NULL, NULL ) == -1,
+		"chewing_convert_bopomofo shall fail on what is not bopomofo" );
+	ok( chewing_convert_bopomofo( ctx, "\xE3\x84\x98\xE3\x84\x9C\xCB\x8Bx",
+			buf, sizeof( buf ), NULL, NULL ) == -1,
+		"chewing_convert_bopomofo shall fail on a syllable with trailing garbage" );
+	ok( chewing_convert_bopomofo( ctx, " ", buf, sizeof( buf ), NULL, NULL ) == 0 &&
+		buf[ 0 ] == '\0', "no syllable shall convert to nothing" );
+
+	ok( chewing_convert_bopomofo( ctx, "\xE3\x84\x98\xE3\x84\x9C\xCB\x8B \xE3\x84\x95\xCB\x8B",
+			buf, 3, NULL, NULL ) == 6 && buf[ 0 ] == '\0',
+		"a buffer too small shall be left empty" );
+
+	phoneSeq[ 0 ] = 0;
+	ok( chewing_convert_phone( ctx, phoneSeq, 1, buf, sizeof( buf ), NULL, NULL ) == -1,
+		"chewing_convert_phone shall fail on phone 0" );
+	ok( chewing_convert_phone( ctx, phoneSeq, -1, buf, sizeof( buf ), NULL, NULL ) == -1,
+		"chewing_convert_phone shall fail on a negative length" );
+	ok( chewing_convert_phone( NULL, phoneSeq, 1, buf, sizeof( buf ), NULL, NULL ) == -1,
+		"chewing_convert_phone shall fail on NULL" );
+
+	chewing_delete( ctx );
+}
+
+int main()
+{
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	test_set_phrasing_engine();
+	test_same_result();
+	test_tab_cycle();
+	test_edit_in_middle();
+	test_long_ambiguous_buffer();
+	test_key_sequence();
+	test_stats();
+	test_trace();
+	test_selection();
+	test_tie_order();
+	test_convert();
+
+	return exit_status();
+}
@@ -16,6 +16,7 @@
 #include <string.h>
 
 #include "chewing.h"
+#include "chewing-private.h"
 #include "test.h"
 
 void test_reset_shall_not_clean_static_data()
@@ -44,8 +45,204 @@ void test_reset_shall_not_clean_static_data()
 	chewing_Terminate();
 }
 
+void test_reset_shall_clean_input()
+{
+	ChewingContext *ctx;
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	chewing_Init( NULL, NULL );
+
+	ctx = chewing_new();
+	ok( ctx, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+
+	/* ㄧˊㄕㄤˋㄌㄞˊ with 移上來 selected, a symbol, and ㄧ in zuin */
+	type_keystoke_by_string( ctx, "u6g;4x96<L><L><L><D>2`31u" );
+	ok( chewing_buffer_Len( ctx ) > 0, "there shall be a preedit to reset" );
+
+	/* neither the selection, the symbol nor the zuin shall be kept */
+	chewing_Reset( ctx );
+	type_keystoke_by_string( ctx, "u6g;4x96<E>" );
+	ok_commit_buffer( ctx, "一上來" );
+
+	type_keystoke_by_string( ctx, "u6g;4x96<L><L><L><D>2`31u" );
+	chewing_Reset( ctx );
+	type_keystoke_by_string( ctx, "hk4g4<E>" );
+	ok_commit_buffer( ctx, "測試" );
+	ok( chewing_cursor_Current( ctx ) == 0, "cursor shall be 0 after commit" );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+void test_snapshot_shall_restore_input()
+{
+	ChewingContext *ctx, *other;
+	char buf[ 512 ];
+	char bad[ 512 ];
+	char *expected, *got;
+	int len;
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	chewing_Init( NULL, NULL );
+
+	ctx = chewing_new();
+	other = chewing_new();
+	ok( ctx && other, "chewing_new shall not return NULL" );
+
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	chewing_set_maxChiSymbolLen( other, 16 );
+
+	/* ㄧˊㄕㄤˋㄌㄞˊ with 移上來 selected, a symbol, and ㄧ in zuin */
+	type_keystoke_by_string( ctx, "u6g;4x96<L><L><L><D>2`31u" );
+
+	len = chewing_snapshot( ctx, NULL, 0 );
+	ok( len > 0 && len <= (int) sizeof( buf ), "snapshot shall have a size" );
+	ok( chewing_snapshot( ctx, buf, sizeof( buf ) ) == len,
+		"snapshot shall be as long as its size" );
+
+	ok( chewing_restore( other, buf, len - 1 ) == -1,
+		"a truncated snapshot shall not restore" );
+	memcpy( bad, buf, len );
+	bad[ 4 ]++;
+	ok( chewing_restore( other, bad, len ) == -1,
+		"a snapshot of another version shall not restore" );
+	ok( chewing_buffer_Len( other ) == 0,
+		"a snapshot not restored shall not change the context" );
+
+	ok( chewing_restore( other, buf, len ) == 0, "snapshot shall restore" );
+
+	expected = chewing_buffer_String( ctx );
+	got = chewing_buffer_String( other );
+	ok( strcmp( got, expected ) == 0, "preedit `%s' shall be `%s'", got, expected );
+	chewing_free( got );
+	chewing_free( expected );
+
+	expected = chewing_zuin_String( ctx, NULL );
+	got = chewing_zuin_String( other, NULL );
+	ok( strcmp( got, expected ) == 0, "zuin `%s' shall be `%s'", got, expected );
+	chewing_free( got );
+	chewing_free( expected );
+
+	ok( chewing_cursor_Current( other ) == chewing_cursor_Current( ctx ),
+		"cursor shall be restored" );
+
+	/* both go on the same */
+	type_keystoke_by_string( ctx, "3<E>" );
+	type_keystoke_by_string( other, "3<E>" );
+	expected = chewing_commit_String( ctx );
+	ok_commit_buffer( other, expected );
+	chewing_free( expected );
+
+	chewing_delete( other );
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+/* the layout stays the one of the context restored */
+void test_snapshot_shall_keep_layout()
+{
+	ChewingContext *ctx, *other;
+	char buf[ 512 ];
+	int len;
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	chewing_Init( NULL, NULL );
+
+	ctx = chewing_new();
+	other = chewing_new();
+	ok( ctx && other, "chewing_new shall not return NULL" );
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	chewing_set_maxChiSymbolLen( other, 16 );
+	chewing_set_KBType( other, chewing_KBStr2Num( "KB_HSU" ) );
+
+	/* ㄘㄜˋ, and ㄧ in zuin */
+	type_keystoke_by_string( ctx, "hk4u" );
+	len = chewing_snapshot( ctx, buf, sizeof( buf ) );
+	ok( chewing_restore( other, buf, len ) == -1,
+		"a syllable typed on another layout shall not restore" );
+	ok( chewing_buffer_Len( other ) == 0 && chewing_zuin_Check( other ) == 1,
+		"a snapshot refused shall not change the context" );
+
+	/* ㄘㄜˋ alone */
+	type_keystoke_by_string( ctx, "<B>" );
+	len = chewing_snapshot( ctx, buf, sizeof( buf ) );
+	ok( chewing_restore( other, buf, len ) == 0,
+		"a snapshot with no syllable typed shall restore on another layout" );
+	ok( chewing_get_KBType( other ) == chewing_KBStr2Num( "KB_HSU" ),
+		"the layout of the context shall be kept" );
+	ok( chewing_buffer_Len( other ) == 1, "the buffer shall be restored" );
+
+	chewing_delete( other );
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
+/* every truncation and every byte changed, over-limit counts among them */
+void test_snapshot_shall_refuse_corrupted()
+{
+	static const unsigned char VALUES[] = { MAX_PHONE_SEQ_LEN + 1, 0x7f, 0xff };
+	ChewingContext *ctx, *other;
+	char buf[ 512 ];
+	char bad[ 512 ];
+	int len, n, i, k;
+	int nTruncated = 0, nRefused = 0, nLeft = 0;
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	chewing_Init( NULL, NULL );
+
+	ctx = chewing_new();
+	ok( ctx != NULL, "chewing_new shall not return NULL" );
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	type_keystoke_by_string( ctx, "u6g;4x96<L><L><L><D>2`31u" );
+	len = chewing_snapshot( ctx, buf, sizeof( buf ) );
+	ok( len > 0 && len <= (int) sizeof( buf ), "snapshot shall be taken" );
+
+	for ( n = 0; n < len; n++ ) {
+		other = chewing_new();
+		if ( chewing_restore( other, buf, n ) == -1 && chewing_buffer_Len( other ) == 0 )
+			nTruncated++;
+		chewing_delete( other );
+	}
+	ok( nTruncated == len, "no truncated snapshot shall restore, %d of %d refused",
+		nTruncated, len );
+
+	for ( i = 0; i < len; i++ ) {
+		for ( k = 0; k < (int) ARRAY_SIZE( VALUES ); k++ ) {
+			if ( (unsigned char) buf[ i ] == VALUES[ k ] )
+				continue;
+			memcpy( bad, buf, len );
+			bad[ i ] = VALUES[ k ];
+			other = chewing_new();
+			if ( chewing_restore( other, bad, len ) == -1 ) {
+				nRefused++;
+				nLeft += chewing_buffer_Len( other ) == 0;
+			}
+			chewing_delete( other );
+		}
+	}
+	ok( nRefused > 0 && nLeft == nRefused,
+		"a snapshot refused, over-limit counts among them, shall not change the context" );
+
+	chewing_delete( ctx );
+	chewing_Terminate();
+}
+
 int main ()
 {
 	test_reset_shall_not_clean_static_data();
+	test_reset_shall_clean_input();
+	test_snapshot_shall_restore_input();
+	test_snapshot_shall_keep_layout();
+	test_snapshot_shall_refuse_corrupted();
 	return exit_status();
 }
@@ -0,0 +1,228 @@
+/**
+ * test-static-data.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chewing.h"
+#include "chewing-private.h"
+#include "global-private.h"
+#include "plat_path.h"
+#include "test.h"
+
+void test_share_static_data()
+{
+	ChewingContext *ctx1, *ctx2;
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	ctx1 = chewing_new();
+	ctx2 = chewing_new();
+	ok( ctx1 && ctx2, "chewing_new shall not return NULL" );
+	ok( ctx1->data->static_data == ctx2->data->static_data,
+		"contexts with the same search path shall share static data" );
+	ok( ctx1->data->static_data->refcount == 2,
+		"static data shall be referenced by both contexts" );
+
+	chewing_delete( ctx1 );
+	ok( ctx2->data->static_data->refcount == 1,
+		"chewing_delete shall drop its reference" );
+
+	chewing_set_maxChiSymbolLen( ctx2, 16 );
+	type_keystoke_by_string( ctx2, "hk4g4<E>" );
+	ok_commit_buffer( ctx2, "測試" );
+
+	chewing_delete( ctx2 );
+}
+
+void test_separate_static_data()
+{
+	ChewingContext *ctx1, *ctx2;
+
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	ctx1 = chewing_new();
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX "_no_such_path" SEARCH_PATH_SEP CHEWING_DATA_PREFIX );
+	ctx2 = chewing_new();
+	ok( ctx1 && ctx2, "chewing_new shall not return NULL" );
+#ifdef USE_EMBEDDED_DATA
+	ok( ctx1->data->static_data == ctx2->data->static_data,
+		"the embedded data shall be shared whatever the search path" );
+#else
+	ok( ctx1->data->static_data != ctx2->data->static_data,
+		"contexts with different search paths shall not share static data" );
+#endif
+
+	chewing_delete( ctx1 );
+	chewing_delete( ctx2 );
+}
+
+void test_no_data_path()
+{
+	ChewingContext *ctx;
+
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX "_no_such_path" );
+	ctx = chewing_new();
+#ifdef USE_EMBEDDED_DATA
+	ok( ctx != NULL, "the embedded data shall need no search path" );
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	type_keystoke_by_string( ctx, "hk4g4<E>" );
+	ok_commit_buffer( ctx, "測試" );
+#else
+	ok( ctx == NULL, "chewing_new shall fail without the data" );
+#endif
+	chewing_delete( ctx );
+}
+
+void test_memory()
+{
+	ChewingContext *ctx1, *ctx2;
+	ChewingMemory mem1, mem2;
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+
+	ok( chewing_get_memory( NULL, &mem1 ) == -1, "chewing_get_memory shall fail on NULL" );
+
+	ctx1 = chewing_new();
+	ok( ctx1 != NULL, "chewing_new shall not return NULL" );
+	ok( chewing_get_memory( ctx1, NULL ) == -1, "chewing_get_memory shall fail on NULL" );
+	ok( chewing_get_memory( ctx1, &mem1 ) == 0, "chewing_get_memory shall succeed" );
+	ok( mem1.context > 0, "the context shall take memory" );
+	ok( mem1.shared > 0 && mem1.sharedPinyin > 0, "the shared data shall take memory" );
+#ifdef USE_BINARY_DATA
+	ok( mem1.sharedMapped > 0, "the dictionary shall be mapped" );
+	ok( mem1.sharedResident == (size_t) -1 || mem1.sharedResident <= mem1.sharedMapped,
+		"no more than the mapped bytes shall be resident" );
+#endif
+	ok( mem1.nSharedContext == 1, "the shared data shall have one context" );
+
+	ctx2 = chewing_new();
+	ok( chewing_get_memory( ctx2, &mem2 ) == 0, "chewing_get_memory shall succeed" );
+	ok( mem2.nSharedContext == 2, "the shared data shall have two contexts" );
+	ok( mem2.shared == mem1.shared && mem2.sharedMapped == mem1.sharedMapped,
+		"contexts sharing data shall report the same shared memory" );
+
+	chewing_set_maxChiSymbolLen( ctx2, 16 );
+	type_keystoke_by_string( ctx2, "hk4g4<E>" );
+	ok( chewing_get_memory( ctx2, &mem2 ) == 0, "chewing_get_memory shall succeed" );
+	ok( mem2.phrasing > 0, "phrasing shall take memory once a phrase is typed" );
+
+	chewing_delete( ctx1 );
+	ok( chewing_get_memory( ctx2, &mem2 ) == 0, "chewing_get_memory shall succeed" );
+	ok( mem2.nSharedContext == 1, "chewing_delete shall leave one context" );
+	chewing_delete( ctx2 );
+}
+
+#ifdef USE_BINARY_DATA
+/* STATIC_DATA_FILE in memory at a CONTAINER_ALIGN boundary of *block */
+static unsigned char *load_data( void **block, size_t *size )
+{
+	FILE *fp;
+	long len;
+	unsigned char *data = NULL;
+
+	*block = NULL;
+	fp = fopen( CHEWING_DATA_PREFIX "/" STATIC_DATA_FILE, "rb" );
+	if ( !fp )
+		return NULL;
+	if ( !fseek( fp, 0, SEEK_END ) && ( len = ftell( fp ) ) > 0 &&
+			!fseek( fp, 0, SEEK_SET ) && ( *block = malloc( len + 16 ) ) ) {
+		data = (unsigned char *) ( ( (uintptr_t) *block + 15 ) & ~(uintptr_t) 15 );
+		if ( fread( data, 1, len, fp ) == (size_t) len )
+			*size = len;
+		else
+			data = NULL;
+	}
+	fclose( fp );
+	return data;
+}
+#endif
+
+void test_data_buffer()
+{
+	ChewingContext *ctx1, *ctx2, *ctx3;
+#ifdef USE_BINARY_DATA
+	ChewingMemory mem;
+	unsigned char *data;
+	void *block;
+	size_t size = 0;
+#endif
+
+	putenv( "CHEWING_USER_PATH=" TEST_HASH_DIR );
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+
+	ok( chewing_new_with_data( NULL, 0 ) == NULL, "chewing_new_with_data shall fail on NULL" );
+
+#ifdef USE_BINARY_DATA
+	data = load_data( &block, &size );
+	ok( data != NULL, "the data file shall be read" );
+	if ( !data ) {
+		free( block );
+		return;
+	}
+
+	ok( chewing_new_with_data( data, 8 ) == NULL,
+		"chewing_new_with_data shall fail on a cut container" );
+	memmove( data + 1, data, size - 1 );
+	ok( chewing_new_with_data( data + 1, size - 1 ) == NULL,
+		"chewing_new_with_data shall fail on a container out of alignment" );
+	memmove( data, data + 1, size - 1 );
+
+	ctx3 = chewing_new();
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX "_no_such_path" );
+	ctx1 = chewing_new_with_data( data, size );
+	ctx2 = chewing_new_with_data( data, size );
+	ok( ctx1 && ctx2 && ctx3, "chewing_new_with_data shall need no search path" );
+	ok( ctx1->data->static_data == ctx2->data->static_data,
+		"contexts on the same data shall share it" );
+	ok( ctx1->data->static_data != ctx3->data->static_data,
+		"the data given shall not be shared with the data searched for" );
+	ok( ctx1->data->static_data->data == data,
+		"the data given shall be read in place" );
+
+	ok( chewing_get_memory( ctx1, &mem ) == 0, "chewing_get_memory shall succeed" );
+	ok( mem.sharedMapped == size && mem.sharedResident == (size_t) -1,
+		"the data given shall be reported, but not its resident pages" );
+
+	chewing_delete( ctx1 );
+	chewing_set_maxChiSymbolLen( ctx2, 16 );
+	type_keystoke_by_string( ctx2, "hk4g4<E>" );
+	ok_commit_buffer( ctx2, "測試" );
+
+	chewing_delete( ctx2 );
+	chewing_delete( ctx3 );
+	free( block );
+#else
+	(void) ctx2;
+	(void) ctx3;
+	ctx1 = chewing_new_with_data( "", 1 );
+	ok( ctx1 == NULL, "chewing_new_with_data shall fail without binary data" );
+#endif
+}
+
+int main()
+{
+	test_share_static_data();
+	test_separate_static_data();
+	test_no_data_path();
+	test_memory();
+	test_data_buffer();
+	return exit_status();
+}
@@ -0,0 +1,653 @@
+/**
+ * test-thread.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+/**
+ * @file test-thread.c
+ * @brief Contexts on threads of their own.
+ *
+ * Replays materials.txt on one context for the commit strings to expect,
+ * then on 1, 2, 4 ... threads at once, each creating and deleting its own
+ * contexts, and checks that every thread commits the same. Then converts
+ * the phones of materials.txt by chewing_convert_batch() on as many
+ * threads, and checks that each comes out as chewing_convert_phone() does.
+ * Last, converts them on threads whose contexts share the user phrases
+ * while another thread adds to them, and checks that none of the readers
+ * is disturbed; then deletes such contexts on threads at once, and checks
+ * that each wrote back its phrase. Reports how the key strokes and the
+ * sequences per second scale with the threads.
+ *
+ * usage: test-thread [-t max threads] [-n rounds] [materials.txt]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "chewing.h"
+#include "chewing-private.h"
+#include "hash-private.h"
+#include "plat_types.h"
+#include "test.h"
+
+#define USER_DIR	TEST_HASH_DIR PLAT_SEPARATOR "thread"
+#define MAXLEN 1024
+#define MAX_LINE 256
+/* phrases of phones 1 to SHARED_PHONE_NUM, which no line has */
+#define SHARED_PHONE_NUM 64
+
+typedef struct {
+	char keys[ MAXLEN ];
+	char commit[ MAXLEN ];
+	int nKey;
+} Line;
+
+typedef struct {
+	pthread_t thread;
+	int rounds;
+	int nMismatch;
+	int nFail;
+} Worker;
+
+typedef struct {
+	pthread_t thread;
+	ChewingContext *ctx;	/* sharing the user phrases with the writer */
+	unsigned short **phoneSeqs;
+	char **expected;
+	unsigned int *pDone;
+	int nRound;
+	int nMismatch;
+} Reader;
+
+typedef struct {
+	pthread_t thread;
+	ChewingContext *ctx;	/* sharing the user phrases with the other deleters */
+	unsigned int *pGo;	/* to delete ctx */
+	unsigned short phoneSeq[ 3 ];	/* of the phrase it added */
+	int bImported;
+} Deleter;
+
+static Line lines[ MAX_LINE ];
+static int nLine;
+
+static double now_sec()
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* key strokes in keys, <X> counts as one */
+static int count_keys( const char *keys )
+{
+	const char *end;
+	int n = 0;
+
+	while ( *keys ) {
+		if ( *keys == '<' && ( end = strchr( keys, '>' ) ) )
+			keys = end;
+		keys++;
+		n++;
+	}
+	return n;
+}
+
+static int load_materials( const char *filename )
+{
+	FILE *fp = fopen( filename, "r" );
+	char line[ MAXLEN ];
+	char *pos;
+
+	if ( ! fp ) {
+		fprintf( stderr, "cannot open %s\n", filename );
+		return -1;
+	}
+	while ( nLine < MAX_LINE && fgets( line, sizeof( line ), fp ) ) {
+		if ( line[ 0 ] == '#' || line[ 0 ] == ' ' )
+			continue;
+		/* key strokes end with <E>, the expected string follows */
+		pos = strstr( line, "<E>" );
+		if ( ! pos )
+			continue;
+		pos[ 3 ] = '\0';
+		strcpy( lines[ nLine ].keys, line );
+		lines[ nLine ].nKey = count_keys( line );
+		nLine++;
+	}
+	fclose( fp );
+	return 0;
+}
+
+static ChewingContext *new_context()
+{
+	ChewingContext *ctx = chewing_new();
+
+	/* longer than every line, so that nothing is committed early */
+	if ( ctx )
+		chewing_set_maxChiSymbolLen( ctx, 20 );
+	return ctx;
+}
+
+static void replay( ChewingContext *ctx, const Line *line, char *commit, int size )
+{
+	chewing_Reset( ctx );
+	type_keystoke_by_string( ctx, line->keys );
+	chewing_commit_String_copy( ctx, commit, size );
+}
+
+/* a new context for every round, so that the static data comes and goes */
+static void *run_worker( void *arg )
+{
+	Worker *pw = arg;
+	ChewingContext *ctx;
+	char commit[ MAXLEN ];
+	int round, i;
+
+	for ( round = 0; round < pw->rounds; round++ ) {
+		ctx = new_context();
+		if ( ! ctx ) {
+			pw->nFail++;
+			continue;
+		}
+		for ( i = 0; i < nLine; i++ ) {
+			replay( ctx, &lines[ i ], commit, sizeof( commit ) );
+			if ( strcmp( commit, lines[ i ].commit ) )
+				pw->nMismatch++;
+		}
+		chewing_delete( ctx );
+	}
+	return NULL;
+}
+
+/* keys per second of nThread threads */
+static double run_threads( int nThread, int rounds )
+{
+	Worker *worker = calloc( nThread, sizeof( Worker ) );
+	double start, elapsed;
+	int nMismatch = 0, nFail = 0, nStarted, nKey = 0;
+	int i;
+
+	if ( ! worker ) {
+		fprintf( stderr, "out of memory\n" );
+		exit( 1 );
+	}
+	start = now_sec();
+	for ( nStarted = 0; nStarted < nThread; nStarted++ ) {
+		worker[ nStarted ].rounds = rounds;
+		if ( pthread_create( &worker[ nStarted ].thread, NULL, run_worker, &worker[ nStarted ] ) )
+			break;
+	}
+	for ( i = 0; i < nStarted; i++ ) {
+		pthread_join( worker[ i ].thread, NULL );
+		nMismatch += worker[ i ].nMismatch;
+		nFail += worker[ i ].nFail;
+	}
+	elapsed = now_sec() - start;
+	free( worker );
+
+	ok( nStarted == nThread, "%d threads shall start", nThread );
+	ok( nFail == 0, "every context of %d threads shall be created", nThread );
+	ok( nMismatch == 0, "%d threads shall commit what one context does, %d differ",
+		nThread, nMismatch );
+
+	for ( i = 0; i < nLine; i++ )
+		nKey += lines[ i ].nKey;
+	return elapsed > 0 ? (double) nKey * rounds * nStarted / elapsed : 0.0;
+}
+
+/* the phones of every line, terminated by 0, as the buffer has them before <E> */
+static int load_phone_seqs( unsigned short *phoneSeqs[] )
+{
+	ChewingContext *ctx = new_context();
+	char keys[ MAXLEN ];
+	unsigned short *seq;
+	int i, len;
+
+	if ( ! ctx )
+		return -1;
+	for ( i = 0; i < nLine; i++ ) {
+		strcpy( keys, lines[ i ].keys );
+		keys[ strlen( keys ) - 3 ] = '\0';
+		chewing_Reset( ctx );
+		type_keystoke_by_string( ctx, keys );
+		len = chewing_get_phoneSeqLen( ctx );
+		phoneSeqs[ i ] = calloc( len + 1, sizeof( unsigned short ) );
+		seq = chewing_get_phoneSeq( ctx );
+		if ( ! phoneSeqs[ i ] || ! seq ) {
+			fprintf( stderr, "out of memory\n" );
+			exit( 1 );
+		}
+		memcpy( phoneSeqs[ i ], seq, len * sizeof( unsigned short ) );
+		free( seq );
+	}
+	chewing_delete( ctx );
+	return 0;
+}
+
+/* sequences per second of chewing_convert_batch() on nThread threads */
+static double run_batch( ChewingContext *ctx, const unsigned short *const phoneSeqs[],
+		char *expected[], int nThread, int rounds )
+{
+	int n = nLine * rounds;
+	const unsigned short **batch = calloc( n, sizeof( unsigned short * ) );
+	char **results = calloc( n, sizeof( char * ) );
+	int nConverted, nMismatch = 0;
+	double start, elapsed;
+	int i;
+
+	if ( ! batch || ! results ) {
+		fprintf( stderr, "out of memory\n" );
+		exit( 1 );
+	}
+	for ( i = 0; i < n; i++ )
+		batch[ i ] = phoneSeqs[ i % nLine ];
+
+	start = now_sec();
+	nConverted = chewing_convert_batch( ctx, batch, n, nThread, results );
+	elapsed = now_sec() - start;
+
+	for ( i = 0; i < n; i++ ) {
+		if ( ! results[ i ] || strcmp( results[ i ], expected[ i % nLine ] ) )
+			nMismatch++;
+		chewing_free( results[ i ] );
+	}
+	free( results );
+	free( batch );
+
+	ok( nConverted == n, "a batch on %d threads shall convert every sequence", nThread );
+	ok( nMismatch == 0, "a batch on %d threads shall convert as one context, in order, %d differ",
+		nThread, nMismatch );
+	return elapsed > 0 ? n / elapsed : 0.0;
+}
+
+/* the sequences one after another in one buffer, the sentences in another */
+static void test_convert_batch_buffer( ChewingContext *ctx, unsigned short *phoneSeqs[],
+		char *expected[], int nThread )
+{
+	unsigned short *phones;
+	char *buf, *sentence;
+	int nPhone = 0, nMismatch = 0, ret, len, i;
+
+	for ( i = 0; i < nLine; i++ ) {
+		for ( len = 0; phoneSeqs[ i ][ len ]; len++ )
+			;
+		nPhone += len + 1;
+	}
+	phones = calloc( nPhone, sizeof( unsigned short ) );
+	buf = calloc( nPhone, MAX_UTF8_SIZE );
+	if ( ! phones || ! buf ) {
+		fprintf( stderr, "out of memory\n" );
+		exit( 1 );
+	}
+	for ( i = 0, nPhone = 0; i < nLine; i++ ) {
+		for ( len = 0; phoneSeqs[ i ][ len ]; len++ )
+			phones[ nPhone++ ] = phoneSeqs[ i ][ len ];
+		phones[ nPhone++ ] = 0;
+	}
+
+	ok( chewing_convert_batch_buffer( ctx, phones, nPhone, nThread, buf,
+			nPhone * MAX_UTF8_SIZE - 1 ) == -1,
+		"chewing_convert_batch_buffer shall fail on a buffer too small" );
+	ok( chewing_convert_batch_buffer( ctx, phones, nPhone - 1, nThread, buf,
+			nPhone * MAX_UTF8_SIZE ) == -1,
+		"chewing_convert_batch_buffer shall fail on a sequence not terminated" );
+
+	ret = chewing_convert_batch_buffer( ctx, phones, nPhone, nThread, buf, nPhone * MAX_UTF8_SIZE );
+	ok( ret > 0, "chewing_convert_batch_buffer shall succeed" );
+	for ( i = 0, sentence = buf; i < nLine && sentence < buf + ret; i++ ) {
+		if ( strcmp( sentence, expected[ i ] ) )
+			nMismatch++;
+		sentence += strlen( sentence ) + 1;
+	}
+	ok( i == nLine && sentence == buf + ret && nMismatch == 0,
+		"chewing_convert_batch_buffer shall store every sentence in order, %d differ", nMismatch );
+
+	free( phones );
+	free( buf );
+}
+
+/*
+ * The phones of the lines one after another, in sequences as long as the
+ * edit buffer and one phone either side, converted in a batch as one at a
+ * time.
+ */
+static void test_convert_batch_long( ChewingContext *ctx, unsigned short *phoneSeqs[], int nThread )
+{
+	unsigned short seqs[ 3 ][ MAX_PHONE_SEQ_LEN + 2 ];
+	const unsigned short *batch[ 3 ];
+	char *results[ 3 ];
+	char expected[ ( MAX_PHONE_SEQ_LEN + 1 ) * MAX_UTF8_SIZE + 1 ];
+	int nMismatch = 0, line = 0, pos = 0, len, i, k;
+
+	for ( k = 0; k < 3; k++ ) {
+		len = MAX_PHONE_SEQ_LEN - 1 + k;
+		for ( i = 0; i < len; i++ ) {
+			while ( ! phoneSeqs[ line ][ pos ] ) {
+				line = ( line + 1 ) % nLine;
+				pos = 0;
+			}
+			seqs[ k ][ i ] = phoneSeqs[ line ][ pos++ ];
+		}
+		seqs[ k ][ len ] = 0;
+		batch[ k ] = seqs[ k ];
+	}
+
+	ok( chewing_convert_batch( ctx, batch, 3, nThread, results ) == 3,
+		"a batch of sequences around the edit buffer's length shall convert" );
+	for ( k = 0; k < 3; k++ ) {
+		len = MAX_PHONE_SEQ_LEN - 1 + k;
+		chewing_convert_phone( ctx, seqs[ k ], len, expected, sizeof( expected ), NULL, NULL );
+		if ( ! results[ k ] || strcmp( results[ k ], expected ) )
+			nMismatch++;
+		chewing_free( results[ k ] );
+	}
+	ok( nMismatch == 0, "sequences of %d to %d phones shall convert in a batch as alone, %d differ",
+		MAX_PHONE_SEQ_LEN - 1, MAX_PHONE_SEQ_LEN + 1, nMismatch );
+}
+
+static void test_convert_batch( int maxThread, int rounds )
+{
+	unsigned short *phoneSeqs[ MAX_LINE ];
+	char *expected[ MAX_LINE ];
+	char *result;
+	ChewingContext *ctx;
+	double base = 0.0, rate;
+	int nThread, len, i;
+
+	ctx = new_context();
+	if ( ! ctx || load_phone_seqs( phoneSeqs ) ) {
+		ok( 0, "the phone sequences shall be made" );
+		return;
+	}
+	for ( i = 0; i < nLine; i++ ) {
+		for ( len = 0; phoneSeqs[ i ][ len ]; len++ )
+			;
+		expected[ i ] = calloc( len * MAX_UTF8_SIZE + 1, 1 );
+		chewing_convert_phone( ctx, phoneSeqs[ i ], len, expected[ i ], len * MAX_UTF8_SIZE + 1, NULL, NULL );
+	}
+
+	ok( chewing_convert_batch( NULL, (const unsigned short *const *) phoneSeqs, 1, 1, &result ) == -1,
+		"chewing_convert_batch shall fail on NULL" );
+	ok( chewing_convert_batch( ctx, (const unsigned short *const *) phoneSeqs, 1, 0, &result ) == -1,
+		"chewing_convert_batch shall fail on no thread" );
+	ok( chewing_convert_batch( ctx, NULL, 0, 4, NULL ) == 0,
+		"chewing_convert_batch shall convert nothing in an empty batch" );
+
+	test_convert_batch_buffer( ctx, phoneSeqs, expected, maxThread );
+	test_convert_batch_long( ctx, phoneSeqs, maxThread );
+
+	for ( nThread = 1; nThread <= maxThread; nThread *= 2 ) {
+		rate = run_batch( ctx, (const unsigned short *const *) phoneSeqs, expected,
+			nThread, rounds * 8 );
+		if ( nThread == 1 )
+			base = rate;
+		printf( "# %2d threads: %10.0f sequences/s in a batch, %.2f times one thread\n",
+			nThread, rate, base > 0 ? rate / base : 0.0 );
+	}
+
+	for ( i = 0; i < nLine; i++ ) {
+		free( phoneSeqs[ i ] );
+		free( expected[ i ] );
+	}
+	chewing_delete( ctx );
+}
+
+/* convert every line until the writer is done, once at least */
+static void *run_reader( void *arg )
+{
+	Reader *pr = arg;
+	char buf[ MAXLEN ];
+	int i, len;
+
+	do {
+		for ( i = 0; i < nLine; i++ ) {
+			for ( len = 0; pr->phoneSeqs[ i ][ len ]; len++ )
+				;
+			chewing_convert_phone( pr->ctx, pr->phoneSeqs[ i ], len, buf, sizeof( buf ),
+				NULL, NULL );
+			if ( strcmp( buf, pr->expected[ i ] ) )
+				pr->nMismatch++;
+		}
+		pr->nRound++;
+	} while ( ! PLAT_ATOMIC_LOAD_UINT( pr->pDone ) );
+	return NULL;
+}
+
+/* every phone pair of 1 to SHARED_PHONE_NUM, enough for the table to grow */
+static int read_shared_phrase( void *userdata, ChewingUserPhrase *entry )
+{
+	static unsigned short phoneSeq[ 3 ];
+	int *pNext = userdata;
+
+	if ( *pNext == SHARED_PHONE_NUM * SHARED_PHONE_NUM )
+		return 0;
+	phoneSeq[ 0 ] = *pNext / SHARED_PHONE_NUM + 1;
+	phoneSeq[ 1 ] = *pNext % SHARED_PHONE_NUM + 1;
+	( *pNext )++;
+	entry->phoneSeq = phoneSeq;
+	entry->phrase = "測試";
+	entry->freq = 1;
+	return 1;
+}
+
+static int find_shared_phrase( void *userdata, int index UNUSED, const ChewingDictEntry *entry )
+{
+	if ( entry->isUser )
+		( *(int *) userdata )++;
+	return 0;
+}
+
+static void test_shared_user_phrase( int nThread )
+{
+	static const unsigned short lastSeq[] = { SHARED_PHONE_NUM, SHARED_PHONE_NUM, 0 };
+	const unsigned short *lookup[ 1 ] = { lastSeq };
+	unsigned short *phoneSeqs[ MAX_LINE ];
+	char *expected[ MAX_LINE ];
+	ChewingContext *ctx;
+	Reader *reader = calloc( nThread, sizeof( Reader ) );
+	unsigned int done = 0;
+	int nStarted, nMismatch = 0, nFound = 0, nNext = 0, bRead = 1;
+	int len, i;
+
+	ctx = new_context();
+	if ( ! reader || ! ctx || load_phone_seqs( phoneSeqs ) ) {
+		ok( 0, "the phone sequences shall be made" );
+		return;
+	}
+	for ( i = 0; i < nLine; i++ ) {
+		for ( len = 0; phoneSeqs[ i ][ len ]; len++ )
+			;
+		expected[ i ] = calloc( len * MAX_UTF8_SIZE + 1, 1 );
+		chewing_convert_phone( ctx, phoneSeqs[ i ], len, expected[ i ], len * MAX_UTF8_SIZE + 1, NULL, NULL );
+	}
+
+	/* the first reader joins on its own, the others are made from ctx */
+	chewing_set_shareUserPhrase( ctx, 1 );
+	for ( nStarted = 0; nStarted < nThread; nStarted++ ) {
+		reader[ nStarted ].ctx = nStarted ? chewing_new_from( ctx ) : new_context();
+		if ( ! reader[ nStarted ].ctx )
+			break;
+		chewing_set_shareUserPhrase( reader[ nStarted ].ctx, 1 );
+		reader[ nStarted ].phoneSeqs = phoneSeqs;
+		reader[ nStarted ].expected = expected;
+		reader[ nStarted ].pDone = &done;
+		if ( pthread_create( &reader[ nStarted ].thread, NULL, run_reader, &reader[ nStarted ] ) ) {
+			chewing_delete( reader[ nStarted ].ctx );
+			break;
+		}
+	}
+	ok( chewing_userphrase_import( ctx, read_shared_phrase, &nNext ) >= 0,
+		"chewing_userphrase_import shall add to the shared user phrases" );
+	PLAT_ATOMIC_STORE_UINT( &done, 1 );
+
+	for ( i = 0; i < nStarted; i++ ) {
+		pthread_join( reader[ i ].thread, NULL );
+		nMismatch += reader[ i ].nMismatch;
+		bRead = bRead && reader[ i ].nRound > 0;
+	}
+	ok( nStarted == nThread, "%d readers shall start", nThread );
+	ok( bRead && nMismatch == 0,
+		"readers of the shared user phrases shall convert as one context, %d differ", nMismatch );
+	ok( ctx->data->session.hashStore->nHashItem >= SHARED_PHONE_NUM * SHARED_PHONE_NUM,
+		"every phrase shall be in the shared store" );
+	if ( nStarted > 0 )
+		chewing_dict_lookup_batch( reader[ nStarted - 1 ].ctx, lookup, 1, find_shared_phrase, &nFound );
+	ok( nFound == 1, "a reader shall find the phrase added last" );
+
+	for ( i = 0; i < nStarted; i++ )
+		chewing_delete( reader[ i ].ctx );
+	for ( i = 0; i < nLine; i++ ) {
+		free( phoneSeqs[ i ] );
+		free( expected[ i ] );
+	}
+	chewing_delete( ctx );
+	free( reader );
+}
+
+/* the phrase of a deleter, on phones no reader has one on */
+static int read_deleter_phrase( void *userdata, ChewingUserPhrase *entry )
+{
+	Deleter *pd = userdata;
+
+	if ( pd->bImported )
+		return 0;
+	pd->bImported = 1;
+	entry->phoneSeq = pd->phoneSeq;
+	entry->phrase = "測驗";
+	entry->freq = 1;
+	return 1;
+}
+
+/* delete the context once every deleter is ready */
+static void *run_deleter( void *arg )
+{
+	Deleter *pd = arg;
+
+	while ( ! PLAT_ATOMIC_LOAD_UINT( pd->pGo ) )
+		;
+	chewing_delete( pd->ctx );
+	return NULL;
+}
+
+/*
+ * Contexts sharing the user phrases deleted on threads at once, each
+ * having just added a phrase, rounds times; the others still write back
+ * to the store when the last one is done with it.
+ */
+static void test_shared_delete( int nThread, int rounds )
+{
+	Deleter *deleter = calloc( nThread, sizeof( Deleter ) );
+	ChewingContext *ctx;
+	const unsigned short *lookup[ 1 ];
+	unsigned int go;
+	int nStarted = nThread, nFound = 0, nMissing = 0;
+	int round, i;
+
+	if ( ! deleter ) {
+		ok( 0, "the deleters shall be made" );
+		return;
+	}
+	for ( round = 0; round < rounds && nStarted == nThread; round++ ) {
+		PLAT_ATOMIC_STORE_UINT( &go, 0 );
+		for ( nStarted = 0; nStarted < nThread; nStarted++ ) {
+			deleter[ nStarted ].ctx = new_context();
+			if ( ! deleter[ nStarted ].ctx )
+				break;
+			chewing_set_shareUserPhrase( deleter[ nStarted ].ctx, 1 );
+			deleter[ nStarted ].pGo = &go;
+			deleter[ nStarted ].phoneSeq[ 0 ] = SHARED_PHONE_NUM + 1 + nStarted;
+			deleter[ nStarted ].phoneSeq[ 1 ] = round + 1;
+			deleter[ nStarted ].bImported = 0;
+			chewing_userphrase_import( deleter[ nStarted ].ctx, read_deleter_phrase,
+				&deleter[ nStarted ] );
+			if ( pthread_create( &deleter[ nStarted ].thread, NULL, run_deleter, &deleter[ nStarted ] ) ) {
+				chewing_delete( deleter[ nStarted ].ctx );
+				break;
+			}
+		}
+		PLAT_ATOMIC_STORE_UINT( &go, 1 );
+		for ( i = 0; i < nStarted; i++ )
+			pthread_join( deleter[ i ].thread, NULL );
+	}
+	ok( nStarted == nThread, "%d deleters shall start", nThread );
+
+	/* what every one of them added is written back */
+	ctx = new_context();
+	for ( round = 0; ctx && round < rounds; round++ ) {
+		for ( i = 0; i < nThread; i++ ) {
+			deleter[ i ].phoneSeq[ 0 ] = SHARED_PHONE_NUM + 1 + i;
+			deleter[ i ].phoneSeq[ 1 ] = round + 1;
+			lookup[ 0 ] = deleter[ i ].phoneSeq;
+			nFound = 0;
+			chewing_dict_lookup_batch( ctx, lookup, 1, find_shared_phrase, &nFound );
+			nMissing += nFound != 1;
+		}
+	}
+	ok( ctx && nMissing == 0,
+		"contexts deleted at once shall write back their user phrases, %d missing", nMissing );
+	chewing_delete( ctx );
+	free( deleter );
+}
+
+int main( int argc, char *argv[] )
+{
+	ChewingContext *ctx;
+	const char *materials = MATERIALS;
+	long ncpu = sysconf( _SC_NPROCESSORS_ONLN );
+	int maxThread = ncpu > 4 ? ( ncpu < 16 ? ncpu : 16 ) : 4;
+	int rounds = 2;
+	double base = 0.0, rate;
+	int nThread, i;
+
+	for ( i = 1; i < argc; i++ ) {
+		if ( ! strcmp( argv[ i ], "-t" ) && i + 1 < argc )
+			maxThread = atoi( argv[ ++i ] );
+		else if ( ! strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			rounds = atoi( argv[ ++i ] );
+		else
+			materials = argv[ i ];
+	}
+
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" USER_DIR );
+	PLAT_MKDIR( USER_DIR );
+
+	if ( load_materials( materials ) )
+		return 1;
+
+	/* the first round learns the phrases, the second one is what to expect */
+	ctx = new_context();
+	ok( ctx != NULL, "chewing_new shall succeed" );
+	if ( ! ctx )
+		return exit_status();
+	for ( i = 0; i < 2 * nLine; i++ )
+		replay( ctx, &lines[ i % nLine ], lines[ i % nLine ].commit, MAXLEN );
+	chewing_delete( ctx );
+
+	for ( nThread = 1; nThread <= maxThread; nThread *= 2 ) {
+		rate = run_threads( nThread, rounds );
+		if ( nThread == 1 )
+			base = rate;
+		printf( "# %2d threads: %10.0f keys/s, %.2f times one thread\n",
+			nThread, rate, base > 0 ? rate / base : 0.0 );
+	}
+
+	test_convert_batch( maxThread, rounds );
+	test_shared_user_phrase( maxThread );
+	test_shared_delete( maxThread, rounds * 8 );
+	return exit_status();
+}
@@ -0,0 +1,675 @@
+/**
+ * test-userphrase.c
+ *
+ * Copyright (c) 2012
+ *	libchewing Core Team. See ChangeLog for details.
+ *
+ * See the file "COPYING" for information on usage and redistribution
+ * of this file.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chewing.h"
+#include "chewing-private.h"
+#include "plat_types.h"
+#include "hash-private.h"
+#include "dict-private.h"
+#include "tree-private.h"
+#include "test.h"
+
+/* the other tests share TEST_HASH_DIR, and run at the same time */
+#define USER_DIR	TEST_HASH_DIR PLAT_SEPARATOR "userphrase"
+#define USER_FILE	USER_DIR PLAT_SEPARATOR HASH_FILE
+#define JOURNAL_FILE	USER_FILE HASH_JOURNAL_SUFFIX ".0"
+#define SAVED_FILE	USER_FILE ".saved"
+#define SAVED_JOURNAL	JOURNAL_FILE ".saved"
+
+typedef struct {
+	const char *keys;
+	const char *phrase;
+	unsigned short phones[ 3 ];
+} TestPhrase;
+
+static TestPhrase TEST_PHRASE[] = {
+	{ "hk4g4", "測試", { 0 } },
+	{ "su3cl3", "你好", { 0 } },
+};
+
+typedef struct {
+	const TestPhrase *phrase;
+	int found;
+} FindResult;
+
+static int find_user( void *userdata, int index UNUSED, const ChewingDictEntry *entry )
+{
+	FindResult *result = userdata;
+
+	if ( entry->isUser && entry->len == (int) strlen( result->phrase->phrase ) &&
+			!memcmp( entry->phrase, result->phrase->phrase, entry->len ) )
+		result->found = 1;
+	return 0;
+}
+
+/* whether tp is a user phrase of ctx, of a new context if it is NULL */
+static int has_user_phrase( ChewingContext *ctx, const TestPhrase *tp )
+{
+	ChewingContext *own = NULL;
+	const unsigned short *batch[ 1 ] = { tp->phones };
+	FindResult result = { tp, 0 };
+
+	if ( ! ctx )
+		ctx = own = chewing_new();
+	chewing_dict_lookup_batch( ctx, batch, 1, find_user, &result );
+	chewing_delete( own );
+	return result.found;
+}
+
+/* learn tp by typing it, into ctx or into a new context if it is NULL */
+static ChewingContext *learn( ChewingContext *ctx, TestPhrase *tp )
+{
+	unsigned short *seq;
+
+	if ( ! ctx )
+		ctx = chewing_new();
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	type_keystoke_by_string( ctx, tp->keys );
+	seq = chewing_get_phoneSeq( ctx );
+	tp->phones[ 0 ] = seq[ 0 ];
+	tp->phones[ 1 ] = seq[ 1 ];
+	tp->phones[ 2 ] = 0;
+	free( seq );
+	type_keystoke_by_string( ctx, "<E>" );
+	ok_commit_buffer( ctx, tp->phrase );
+	return ctx;
+}
+
+static long file_size( const char *filename )
+{
+	FILE *fp;
+	long size;
+
+	fp = fopen( filename, "rb" );
+	if ( !fp )
+		return -1;
+	fseek( fp, 0, SEEK_END );
+	size = ftell( fp );
+	fclose( fp );
+	return size;
+}
+
+static int copy_file( const char *from, const char *to )
+{
+	FILE *in, *out;
+	char buf[ 1024 ];
+	size_t len;
+
+	in = fopen( from, "rb" );
+	if ( !in )
+		return -1;
+	out = fopen( to, "wb" );
+	if ( !out ) {
+		fclose( in );
+		return -1;
+	}
+	while ( ( len = fread( buf, 1, sizeof( buf ), in ) ) > 0 )
+		fwrite( buf, 1, len, out );
+	fclose( in );
+	return fclose( out );
+}
+
+void test_flush()
+{
+	ChewingContext *ctx;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = learn( NULL, &TEST_PHRASE[ 0 ] );
+	ok( file_size( JOURNAL_FILE ) == HASH_JOURNAL_ENTRY_SIZE,
+		"a learned phrase shall be in the journal" );
+	ok( chewing_userphrase_flush( ctx ) == 0,
+		"chewing_userphrase_flush shall succeed" );
+	ok( file_size( JOURNAL_FILE ) == 0,
+		"chewing_userphrase_flush shall empty the journal" );
+	ok( has_user_phrase( NULL, &TEST_PHRASE[ 0 ] ),
+		"a flushed phrase shall be in the user dictionary" );
+	chewing_delete( ctx );
+}
+
+void test_replay()
+{
+	ChewingContext *ctx;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = chewing_new();
+	chewing_delete( ctx );
+	ok( copy_file( USER_FILE, SAVED_FILE ) == 0, "the empty dictionary shall be saved" );
+
+	/* what a process killed before it flushes leaves behind */
+	ctx = learn( NULL, &TEST_PHRASE[ 0 ] );
+	ok( copy_file( JOURNAL_FILE, SAVED_JOURNAL ) == 0, "the journal shall be saved" );
+	chewing_delete( ctx );
+	ok( file_size( JOURNAL_FILE ) == 0, "chewing_delete shall empty the journal" );
+	PLAT_RENAME( SAVED_FILE, USER_FILE );
+	PLAT_RENAME( SAVED_JOURNAL, JOURNAL_FILE );
+
+	ok( has_user_phrase( NULL, &TEST_PHRASE[ 0 ] ), "chewing_new shall replay the journal" );
+	ok( file_size( JOURNAL_FILE ) == 0, "a replayed journal shall be emptied" );
+	ok( file_size( USER_FILE ) == (long) ( strlen( BIN_HASH_SIG ) + 4 + FIELD_SIZE ),
+		"a replayed phrase shall be appended once" );
+}
+
+void test_defer_learning()
+{
+	ChewingContext *ctx;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = chewing_new();
+	chewing_set_deferLearning( ctx, 1 );
+	ok( chewing_get_deferLearning( ctx ) == 1, "chewing_set_deferLearning shall set 1" );
+	learn( ctx, &TEST_PHRASE[ 0 ] );
+	learn( ctx, &TEST_PHRASE[ 0 ] );
+	ok( has_user_phrase( ctx, &TEST_PHRASE[ 0 ] ),
+		"a deferred phrase shall be learned at once" );
+	ok( file_size( JOURNAL_FILE ) == 0,
+		"a deferred phrase shall not be in the journal" );
+	ok( chewing_userphrase_pump( ctx ) == 1,
+		"chewing_userphrase_pump shall write a phrase learned twice once" );
+	ok( file_size( JOURNAL_FILE ) == HASH_JOURNAL_ENTRY_SIZE,
+		"a pumped phrase shall be in the journal" );
+	ok( chewing_userphrase_pump( ctx ) == 0,
+		"chewing_userphrase_pump shall find nothing left" );
+
+	learn( ctx, &TEST_PHRASE[ 1 ] );
+	chewing_delete( ctx );
+	ok( has_user_phrase( NULL, &TEST_PHRASE[ 1 ] ),
+		"chewing_delete shall write a deferred phrase" );
+	ok( chewing_userphrase_pump( NULL ) == -1,
+		"chewing_userphrase_pump shall refuse a NULL context" );
+}
+
+/* contexts open the file apart, and lock it against each other as processes do */
+void test_shared()
+{
+	ChewingContext *ctx[ 2 ];
+	int i;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx[ 0 ] = chewing_new();
+	ctx[ 1 ] = chewing_new();
+	ok( access( USER_FILE HASH_JOURNAL_SUFFIX ".1", F_OK ) == 0,
+		"the second context shall take the second journal" );
+	for ( i = 0; i < 2; i++ )
+		learn( ctx[ i ], &TEST_PHRASE[ i ] );
+	for ( i = 0; i < 2; i++ )
+		ok( chewing_userphrase_flush( ctx[ i ] ) == 0, "chewing_userphrase_flush shall succeed" );
+
+	ok( file_size( USER_FILE ) == (long) ( strlen( BIN_HASH_SIG ) + 4 + 2 * FIELD_SIZE ),
+		"each phrase shall have its own record" );
+	ok( has_user_phrase( ctx[ 1 ], &TEST_PHRASE[ 0 ] ),
+		"a context shall take in the phrase the other wrote before it" );
+	ok( chewing_userphrase_flush( ctx[ 0 ] ) == 0 && has_user_phrase( ctx[ 0 ], &TEST_PHRASE[ 1 ] ),
+		"chewing_userphrase_flush shall take in the phrase the other wrote" );
+	for ( i = 0; i < 2; i++ )
+		ok( has_user_phrase( NULL, &TEST_PHRASE[ i ] ),
+			"both phrases shall be in the user dictionary" );
+
+	chewing_delete( ctx[ 0 ] );
+	chewing_delete( ctx[ 1 ] );
+	remove( USER_FILE HASH_JOURNAL_SUFFIX ".1" );
+}
+
+/* every pair of phones in both orders, which the old XOR hash folded */
+#define PAIR_PHONE_NUM 60
+
+void test_hash_table()
+{
+	ChewingContext *ctx;
+	UserPhraseData data;
+	uint16_t phoneSeq[ 4 ] = { 0 };
+	char wordSeq[] = "x";
+	HashCursor cursor;
+	HASH_ITEM *pItem;
+	int i, j;
+	int bad_insert = 0, bad_find = 0;
+	unsigned int nLookup, nProbe;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = chewing_new();
+	for ( i = 1; i <= PAIR_PHONE_NUM; i++ ) {
+		for ( j = 1; j <= PAIR_PHONE_NUM; j++ ) {
+			phoneSeq[ 0 ] = i;
+			phoneSeq[ 1 ] = j;
+			phoneSeq[ 2 ] = 0;
+			memset( &data, 0, sizeof( data ) );
+			data.phoneSeq = phoneSeq;
+			data.wordSeq = wordSeq;
+			if ( ! HashInsert( ctx->data, &data ) )
+				bad_insert++;
+		}
+	}
+	ok( bad_insert == 0, "HashInsert shall grow the table" );
+	ok( ctx->data->session.hashStore->nHashItem == PAIR_PHONE_NUM * PAIR_PHONE_NUM,
+		"every phone sequence shall be a new item" );
+	ok( ctx->data->session.hashStore->table->nSlot >= 2 * ctx->data->session.hashStore->nHashItem,
+		"the table shall be at most half full" );
+
+	nLookup = ctx->data->session.nHashLookup;
+	nProbe = ctx->data->session.nHashProbe;
+	phoneSeq[ 2 ] = 0;
+	for ( i = 1; i <= PAIR_PHONE_NUM; i++ ) {
+		for ( j = 1; j <= PAIR_PHONE_NUM; j++ ) {
+			phoneSeq[ 0 ] = i;
+			phoneSeq[ 1 ] = j;
+			pItem = HashFindEntry( ctx->data, phoneSeq, "x" );
+			if ( ! pItem || pItem->data.phoneSeq[ 0 ] != i || pItem->data.phoneSeq[ 1 ] != j )
+				bad_find++;
+		}
+	}
+	ok( bad_find == 0, "HashFindEntry shall find every phone sequence" );
+	nLookup = ctx->data->session.nHashLookup - nLookup;
+	nProbe = ctx->data->session.nHashProbe - nProbe;
+	ok( nLookup == PAIR_PHONE_NUM * PAIR_PHONE_NUM && nProbe < 3 * nLookup,
+		"a lookup shall take few probes, took %u for %u", nProbe, nLookup );
+
+	/* the same phones once more, which no item has */
+	nLookup = ctx->data->session.nHashLookup;
+	nProbe = ctx->data->session.nHashProbe;
+	phoneSeq[ 2 ] = 1;
+	for ( i = 1; i <= PAIR_PHONE_NUM; i++ ) {
+		for ( j = 1; j <= PAIR_PHONE_NUM; j++ ) {
+			phoneSeq[ 0 ] = i;
+			phoneSeq[ 1 ] = j;
+			if ( HashFindPhonePhrase( ctx->data, phoneSeq, &cursor ) )
+				bad_find++;
+		}
+	}
+	phoneSeq[ 2 ] = 0;
+	ok( bad_find == 0, "HashFindPhonePhrase shall not find a missing phone sequence" );
+	nLookup = ctx->data->session.nHashLookup - nLookup;
+	nProbe = ctx->data->session.nHashProbe - nProbe;
+	ok( nProbe * 10 < nLookup,
+		"a miss shall mostly take no probe, took %u for %u", nProbe, nLookup );
+
+	chewing_delete( ctx );
+}
+
+/* two lookups of the same phones shall not move each other */
+void test_nested_iter()
+{
+	ChewingContext *ctx;
+	UserPhraseData data, *outer, *inner;
+	UserPhraseIter outerIter, innerIter;
+	uint16_t phoneSeq[] = { 1, 2, 0 };
+	char *words[] = { "x", "y" };
+	int i, nOuter = 0, nInner = 0;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = chewing_new();
+	for ( i = 0; i < 2; i++ ) {
+		memset( &data, 0, sizeof( data ) );
+		data.phoneSeq = phoneSeq;
+		data.wordSeq = words[ i ];
+		HashInsert( ctx->data, &data );
+	}
+
+	for ( outer = UserGetPhraseFirst( ctx->data, &outerIter, phoneSeq ); outer;
+			outer = UserGetPhraseNext( ctx->data, &outerIter ) ) {
+		nOuter++;
+		for ( inner = UserGetPhraseFirst( ctx->data, &innerIter, phoneSeq ); inner;
+				inner = UserGetPhraseNext( ctx->data, &innerIter ) )
+			nInner++;
+	}
+	ok( nOuter == 2 && nInner == 4,
+		"nested lookups shall see every phrase, saw %d and %d", nOuter, nInner );
+
+	chewing_delete( ctx );
+}
+
+/* a learned phrase shall start from what a full scan of the dictionary gives */
+void test_load_freq()
+{
+	ChewingContext *ctx;
+	TestPhrase *tp = &TEST_PHRASE[ 0 ];
+	HASH_ITEM *pItem;
+	Phrase phrase;
+	int pho_id, origfreq = -1, maxfreq = -1;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = learn( NULL, tp );
+	pho_id = TreeFindPhrase( ctx->data, 0, 1, tp->phones );
+	if ( pho_id != -1 && GetPhraseFirst( ctx->data, &phrase, pho_id ) ) {
+		do {
+			if ( maxfreq < phrase.freq )
+				maxfreq = phrase.freq;
+			if ( ! strcmp( phrase.phrase, tp->phrase ) )
+				origfreq = phrase.freq;
+		} while ( GetPhraseNext( ctx->data, &phrase ) );
+	}
+	pItem = HashFindEntry( ctx->data, tp->phones, tp->phrase );
+	ok( pItem && origfreq != -1 && pItem->data.origfreq == origfreq,
+		"origfreq shall be the frequency of the phrase in the dictionary" );
+	ok( pItem && pItem->data.maxfreq == maxfreq,
+		"maxfreq shall be the highest frequency of the phones" );
+
+	chewing_delete( ctx );
+}
+
+/* the recentTime of the first record of the user dictionary */
+static long first_recent_time()
+{
+	FILE *fp;
+	unsigned char buf[ 4 ];
+	long ret = -1;
+
+	fp = fopen( USER_FILE, "rb" );
+	if ( !fp )
+		return -1;
+	if ( fseek( fp, strlen( BIN_HASH_SIG ) + 4 + 4, SEEK_SET ) == 0 &&
+			fread( buf, 4, 1, fp ) == 1 )
+		ret = buf[ 0 ] | buf[ 1 ] << 8 | buf[ 2 ] << 16 | (long) buf[ 3 ] << 24;
+	fclose( fp );
+	return ret;
+}
+
+void test_compact()
+{
+	ChewingContext *ctx, *other;
+	char garbage[ FIELD_SIZE ];
+	FILE *fp;
+	long header = strlen( BIN_HASH_SIG ) + 4;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = learn( NULL, &TEST_PHRASE[ 0 ] );
+	learn( ctx, &TEST_PHRASE[ 1 ] );
+	chewing_userphrase_flush( ctx );
+	/* a record that cannot be read, as an old version or a crash leaves */
+	memset( garbage, 0xff, sizeof( garbage ) );
+	fp = fopen( USER_FILE, "ab" );
+	fwrite( garbage, 1, sizeof( garbage ), fp );
+	fclose( fp );
+	other = chewing_new();
+
+	ok( chewing_userphrase_compact( ctx, 0 ) == 0, "chewing_userphrase_compact shall succeed" );
+	ok( file_size( USER_FILE ) == header + 2 * FIELD_SIZE,
+		"an illegal record shall be dropped" );
+	ok( first_recent_time() == 0, "lifetimes shall start from the oldest phrase" );
+	ok( has_user_phrase( NULL, &TEST_PHRASE[ 0 ] ) && has_user_phrase( NULL, &TEST_PHRASE[ 1 ] ),
+		"the phrases shall stay in the user dictionary" );
+
+	/* other still has the old file open */
+	learn( other, &TEST_PHRASE[ 0 ] );
+	ok( chewing_userphrase_flush( other ) == 0, "chewing_userphrase_flush shall succeed" );
+	ok( file_size( USER_FILE ) == header + 2 * FIELD_SIZE,
+		"a context shall write into the compacted file, where the phrase now is" );
+
+	ok( chewing_userphrase_compact( ctx, 1 ) == 0, "chewing_userphrase_compact shall succeed" );
+	ok( file_size( USER_FILE ) == header + FIELD_SIZE,
+		"a phrase back at its dictionary frequency shall be evicted" );
+	ok( has_user_phrase( NULL, &TEST_PHRASE[ 0 ] ),
+		"a phrase learned again shall not be evicted" );
+	ok( ! has_user_phrase( NULL, &TEST_PHRASE[ 1 ] ),
+		"the evicted phrase shall not be in the user dictionary" );
+
+	chewing_delete( other );
+	chewing_delete( ctx );
+	ok( file_size( USER_FILE ) == header + FIELD_SIZE,
+		"chewing_delete shall not bring an evicted phrase back" );
+}
+
+#define IMPORT_NUM 1000
+
+typedef struct {
+	int next;
+	int freq;	/* of every phrase, the phone if -1 */
+	unsigned short phoneSeq[ 3 ];
+} ImportReader;
+
+/* IMPORT_NUM phrases of one phone each, then two invalid ones */
+static int read_phrase( void *userdata, ChewingUserPhrase *entry )
+{
+	ImportReader *reader = userdata;
+	int n = reader->next++;
+
+	entry->phoneSeq = reader->phoneSeq;
+	entry->phrase = "\xE6\xB8\xAC";	/* 測 */
+	reader->phoneSeq[ 1 ] = 0;
+	if ( n < IMPORT_NUM ) {
+		reader->phoneSeq[ 0 ] = n + 1;
+		entry->freq = reader->freq == -1 ? n + 1 : reader->freq;
+		return 1;
+	}
+	if ( n == IMPORT_NUM ) {
+		/* more phones than characters */
+		reader->phoneSeq[ 1 ] = 2;
+		reader->phoneSeq[ 2 ] = 0;
+		return 1;
+	}
+	if ( n == IMPORT_NUM + 1 ) {
+		entry->phrase = "x";
+		return 1;
+	}
+	return 0;
+}
+
+typedef struct {
+	int n;
+	int bad;
+} ExportResult;
+
+static int check_phrase( void *userdata, const ChewingUserPhrase *entry )
+{
+	ExportResult *result = userdata;
+
+	result->n++;
+	if ( entry->phoneSeq[ 1 ] != 0 || entry->freq != entry->phoneSeq[ 0 ] ||
+			strcmp( entry->phrase, "\xE6\xB8\xAC" ) )
+		result->bad++;
+	return 0;
+}
+
+static int stop_export( void *userdata UNUSED, const ChewingUserPhrase *entry UNUSED )
+{
+	return 1;
+}
+
+void test_import_export()
+{
+	ChewingContext *ctx;
+	ImportReader reader;
+	ExportResult result = { 0, 0 };
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = chewing_new();
+	memset( &reader, 0, sizeof( reader ) );
+	reader.freq = -1;
+	ok( chewing_userphrase_import( ctx, read_phrase, &reader ) == IMPORT_NUM,
+		"chewing_userphrase_import shall import every valid phrase" );
+	ok( file_size( JOURNAL_FILE ) == 0, "an import shall not go through the journal" );
+	ok( file_size( USER_FILE ) == (long) ( strlen( BIN_HASH_SIG ) + 4 + IMPORT_NUM * FIELD_SIZE ),
+		"an import shall be written when it returns" );
+
+	memset( &reader, 0, sizeof( reader ) );
+	reader.freq = 0;
+	ok( chewing_userphrase_import( ctx, read_phrase, &reader ) == 0,
+		"importing without a frequency shall leave phrases there alone" );
+	ok( chewing_userphrase_export( ctx, stop_export, NULL ) == 1,
+		"chewing_userphrase_export shall stop when the callback says so" );
+	chewing_delete( ctx );
+
+	ctx = chewing_new();
+	ok( chewing_userphrase_export( ctx, check_phrase, &result ) == IMPORT_NUM &&
+			result.n == IMPORT_NUM,
+		"chewing_userphrase_export shall pass every phrase" );
+	ok( result.bad == 0, "an exported phrase shall be as imported" );
+	chewing_delete( ctx );
+}
+
+static int check_not_empty( void *userdata, const ChewingUserPhrase *entry )
+{
+	ExportResult *result = userdata;
+
+	result->n++;
+	if ( entry->phoneSeq[ 0 ] == 0 || entry->phrase[ 0 ] == '\0' )
+		result->bad++;
+	return 0;
+}
+
+/* the buffer full with symbols in front, which commit with no phone */
+void test_leading_symbols()
+{
+	ChewingContext *ctx;
+	ExportResult result = { 0, 0 };
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = chewing_new();
+	chewing_set_maxChiSymbolLen( ctx, 16 );
+	type_keystoke_by_string( ctx, "= = 83 ' '==;4<E>" );
+	chewing_userphrase_export( ctx, check_not_empty, &result );
+	ok( result.n > 0 && result.bad == 0,
+		"symbols committed in front shall not be learned as an empty phrase, %d of %d",
+		result.bad, result.n );
+	chewing_delete( ctx );
+
+	ctx = chewing_new();
+	result.n = result.bad = 0;
+	chewing_userphrase_export( ctx, check_not_empty, &result );
+	ok( result.bad == 0, "no empty phrase shall be in the user dictionary" );
+	chewing_delete( ctx );
+}
+
+void test_new_from()
+{
+	ChewingContext *ctx, *clone;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx = chewing_new();
+	chewing_set_candPerPage( ctx, 5 );
+	learn( ctx, &TEST_PHRASE[ 0 ] );
+	clone = chewing_new_from( ctx );
+	ok( clone != NULL, "chewing_new_from shall succeed" );
+	ok( clone->data->static_data == ctx->data->static_data,
+		"chewing_new_from shall share the static data" );
+	ok( chewing_get_candPerPage( clone ) == 5,
+		"chewing_new_from shall take the settings" );
+	ok_preedit_buffer( clone, "" );
+	ok( has_user_phrase( clone, &TEST_PHRASE[ 0 ] ),
+		"chewing_new_from shall copy the user phrases" );
+	ok( file_size( USER_FILE ) == (long) ( strlen( BIN_HASH_SIG ) + 4 + FIELD_SIZE ),
+		"chewing_new_from shall flush the template" );
+
+	learn( clone, &TEST_PHRASE[ 1 ] );
+	ok( chewing_userphrase_flush( clone ) == 0 && chewing_userphrase_flush( ctx ) == 0,
+		"chewing_userphrase_flush shall succeed" );
+	ok( has_user_phrase( ctx, &TEST_PHRASE[ 1 ] ),
+		"the template shall take in the phrase of the copy" );
+	ok( file_size( USER_FILE ) == (long) ( strlen( BIN_HASH_SIG ) + 4 + 2 * FIELD_SIZE ),
+		"a copied phrase shall keep its record" );
+
+	chewing_delete( ctx );
+	learn( clone, &TEST_PHRASE[ 0 ] );
+	chewing_delete( clone );
+	remove( USER_FILE HASH_JOURNAL_SUFFIX ".1" );
+
+	ok( chewing_new_from( NULL ) == NULL, "chewing_new_from shall need a template" );
+}
+
+/* contexts sharing the user phrases see what any of them learns at once */
+void test_share()
+{
+	ChewingContext *ctx[ 2 ], *clone;
+	int i;
+
+	remove( USER_FILE );
+	remove( JOURNAL_FILE );
+
+	ctx[ 0 ] = chewing_new();
+	ctx[ 1 ] = chewing_new();
+	ok( chewing_get_shareUserPhrase( ctx[ 0 ] ) == 0,
+		"the user phrases shall not be shared by default" );
+	learn( ctx[ 1 ], &TEST_PHRASE[ 1 ] );
+	for ( i = 0; i < 2; i++ ) {
+		chewing_set_shareUserPhrase( ctx[ i ], 1 );
+		ok( chewing_get_shareUserPhrase( ctx[ i ] ) == 1,
+			"chewing_set_shareUserPhrase shall share the user phrases" );
+	}
+	ok( ctx[ 0 ]->data->session.hashStore == ctx[ 1 ]->data->session.hashStore,
+		"contexts sharing the user phrases shall hold one store" );
+	ok( has_user_phrase( ctx[ 0 ], &TEST_PHRASE[ 1 ] ),
+		"a context moving to the shared store shall bring its phrases" );
+
+	learn( ctx[ 0 ], &TEST_PHRASE[ 0 ] );
+	ok( has_user_phrase( ctx[ 1 ], &TEST_PHRASE[ 0 ] ),
+		"a phrase shall be shared as soon as it is learned" );
+	clone = chewing_new_from( ctx[ 0 ] );
+	ok( clone && chewing_get_shareUserPhrase( clone ) == 1 &&
+			clone->data->session.hashStore == ctx[ 0 ]->data->session.hashStore,
+		"chewing_new_from shall share what the template shares" );
+	chewing_delete( clone );
+
+	chewing_set_shareUserPhrase( ctx[ 1 ], 0 );
+	ok( chewing_get_shareUserPhrase( ctx[ 1 ] ) == 0 &&
+			ctx[ 0 ]->data->session.hashStore != ctx[ 1 ]->data->session.hashStore,
+		"chewing_set_shareUserPhrase shall give back a store of its own" );
+	ok( has_user_phrase( ctx[ 1 ], &TEST_PHRASE[ 0 ] ),
+		"the store of its own shall be a copy of the shared one" );
+	chewing_set_shareUserPhrase( ctx[ 0 ], 0 );
+	ok( chewing_get_shareUserPhrase( ctx[ 0 ] ) == 0,
+		"the last context shall stop sharing" );
+
+	for ( i = 0; i < 2; i++ )
+		chewing_delete( ctx[ i ] );
+	for ( i = 0; i < 2; i++ )
+		ok( has_user_phrase( NULL, &TEST_PHRASE[ i ] ),
+			"the shared phrases shall be in the user dictionary" );
+	remove( USER_FILE HASH_JOURNAL_SUFFIX ".1" );
+}
+
+int main()
+{
+	putenv( "CHEWING_PATH=" CHEWING_DATA_PREFIX );
+	putenv( "CHEWING_USER_PATH=" USER_DIR );
+	PLAT_MKDIR( USER_DIR );
+
+	test_flush();
+	test_replay();
+	test_defer_learning();
+	test_shared();
+	test_hash_table();
+	test_nested_iter();
+	test_load_freq();
+	test_compact();
+	test_import_export();
+	test_leading_symbols();
+	test_new_from();
+	test_share();
+	return exit_status();
+}
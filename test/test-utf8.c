@@ -14,6 +14,49 @@
 #include "test.h"
 #include "chewing-utf8-util.h"
 
+/* the characters of str, one after another */
+static int count_chars(const char *str)
+{
+	int n = 0;
+
+	while (*str) {
+		str += ueBytesFromChar(*str);
+		n++;
+	}
+	return n;
+}
+
+/* ueStrLen of every prefix of a mix of 1 to 4 byte characters, at every
+ * offset, as the words it counts by fall on them */
+static void test_long_string()
+{
+	static const char *CHARS[] = { "a", "\xc3\xa9", "測", "\xf0\xa0\x80\x80" };
+	char buf[256];
+	size_t len = 0;
+	int nChar = 0;
+	int offset, bad = 0;
+
+	while (len + 4 < sizeof(buf) - 8) {
+		strcpy(buf + 8 + len, CHARS[nChar * 7 % 4]);
+		len += strlen(buf + 8 + len);
+		nChar++;
+		for (offset = 0; offset < 8; offset++) {
+			memmove(buf + offset, buf + 8, len + 1);
+			if (ueStrLen(buf + offset) != nChar ||
+					count_chars(buf + offset) != nChar)
+				bad++;
+			memmove(buf + 8, buf + offset, len + 1);
+		}
+	}
+	ok (bad == 0, "ueStrLen of %d strings up to %d bytes", nChar * 8, (int) len);
+	ok (ueStrNBytes(buf + 8, nChar) == (int) len, "ueStrNBytes");
+	ok (ueStrSeek(buf + 8, nChar) == buf + 8 + len, "ueStrSeek");
+
+	ok (ueStrLen("") == 0, "ueStrLen of empty string");
+	/* a truncated character at the end still counts */
+	ok (ueStrLen("測\xe6\xb8") == 2, "ueStrLen of truncated string");
+}
+
 int main (int argc, char *argv[])
 {
 	char *u8string;
@@ -41,5 +84,7 @@ int main (int argc, char *argv[])
 	u8string = ueStrSeek(u8string, 0);
 	ok (!strcmp(u8string, "測試計算長度"), "ueStrSeek");
 
+	test_long_string();
+
 	return exit_status();
 }
@@ -20,23 +20,27 @@ static unsigned int test_ok;
 BufferType COMMIT_BUFFER = {
 	.check = chewing_commit_Check,
 	.get_string = chewing_commit_String,
+	.copy_string = chewing_commit_String_copy,
 };
 
 BufferType PREEDIT_BUFFER = {
 	.check = chewing_buffer_Check,
 	.get_length = chewing_buffer_Len,
 	.get_string = chewing_buffer_String,
+	.copy_string = chewing_buffer_String_copy,
 };
 
 BufferType ZUIN_BUFFER = {
 	.check = chewing_zuin_Check,
 	.get_string_alt = chewing_zuin_String,
+	.copy_string = chewing_zuin_String_copy,
 };
 
 BufferType AUX_BUFFER = {
 	.check = chewing_aux_Check,
 	.get_length = chewing_aux_Length,
 	.get_string = chewing_aux_String,
+	.copy_string = chewing_aux_String_copy,
 };
 
 int get_keystroke( get_char_func get_char, void * param )
@@ -274,12 +278,34 @@ void internal_ok_buffer( const char *file, int line, ChewingContext *ctx,
 			"string function returned `%s' shall be `%s'", buf, expected );
 		chewing_free( buf );
 	}
+
+	if ( buffer->copy_string ) {
+		char copy[ 1024 ];
+
+		actual_ret = buffer->copy_string( ctx, copy, sizeof( copy ) );
+		internal_ok( file, line, actual_ret == expected_len,
+			"actual_ret == expected_len",
+			"copy function returned `%d' shall be `%d'", actual_ret, expected_len );
+		internal_ok( file, line, !strcmp( copy, expected ), "!strcmp( copy, expected )",
+			"copy function returned `%s' shall be `%s'", copy, expected );
+
+		/* one byte short, only whole characters shall be copied */
+		if ( expected_len > 0 ) {
+			actual_ret = buffer->copy_string( ctx, copy, expected_len );
+			internal_ok( file, line, actual_ret == expected_len &&
+				strlen( copy ) < (size_t) expected_len &&
+				!strncmp( copy, expected, strlen( copy ) ) &&
+				( expected[ strlen( copy ) ] & 0xc0 ) != 0x80,
+				"copy is a prefix of expected",
+				"truncated copy `%s' shall be a prefix of `%s'", copy, expected );
+		}
+	}
 }
 
 void internal_ok_candidate( const char *file, int line,
 	ChewingContext *ctx, const char *cand[], size_t cand_len )
 {
-	int i;
+	size_t i;
 	char *buf;
 
 	assert( ctx );
@@ -295,6 +321,23 @@ void internal_ok_candidate( const char *file, int line,
 		chewing_free( buf );
 	}
 
+	/* the copy accessor enumerates the same candidates */
+	chewing_cand_Enumerate( ctx );
+	for ( i = 0; i < cand_len; ++i ) {
+		char copy[ 64 ];
+		int len = strlen( cand[ i ] );
+
+		internal_ok( file, line, chewing_cand_String_copy( ctx, copy, len ) == len,
+			__func__, "truncated candidate copy shall return its length" );
+		internal_ok( file, line, strlen( copy ) < (size_t) len &&
+			!strncmp( copy, cand[ i ], strlen( copy ) ) &&
+			( cand[ i ][ strlen( copy ) ] & 0xc0 ) != 0x80, __func__,
+			"truncated candidate copy `%s' shall be a prefix of `%s'", copy, cand[ i ] );
+		internal_ok( file, line, chewing_cand_String_copy( ctx, copy, sizeof( copy ) ) == len &&
+			strcmp( copy, cand[ i ] ) == 0, __func__,
+			"candidate copy `%s' shall be `%s'", copy, cand[ i ] );
+	}
+
 	internal_ok( file, line , !chewing_cand_hasNext( ctx ), __func__,
 			"shall not have next candidate" );
 	buf = chewing_cand_String( ctx );
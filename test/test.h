@@ -57,6 +57,7 @@ typedef struct {
 	int (*get_length)(ChewingContext *ctx);
 	char * (*get_string)(ChewingContext *ctx);
 	char * (*get_string_alt)(ChewingContext *ctx, int *len);
+	int (*copy_string)(ChewingContext *ctx, char *buf, int size);
 } BufferType;
 
 extern BufferType COMMIT_BUFFER;